@@ -0,0 +1,419 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Multi-buffer AES-CTR and AES-XTS using the generic AES lookup tables
+ *
+ * The table based AES round is a long chain of dependent loads and XORs, so
+ * a single block leaves most of the execution units of a superscalar CPU
+ * idle. Both CTR and XTS encrypt independent blocks, so this driver runs
+ * AES_MB_LANES blocks through the rounds in lock-step, letting the CPU
+ * overlap the table lookups of the different lanes.
+ *
+ * The XTS batch operation additionally computes the tweaks of several
+ * requests together, which is the one serial step of an XTS request.
+ */
+
+#include <crypto/aes.h>
+#include <crypto/algapi.h>
+#include <crypto/gf128mul.h>
+#include <crypto/internal/skcipher.h>
+#include <crypto/scatterwalk.h>
+#include <crypto/xts.h>
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/string.h>
+#include <asm/unaligned.h>
+
+#define AES_MB_LANES		4
+#define AES_MB_BYTES		(AES_MB_LANES * AES_BLOCK_SIZE)
+
+struct aes_mb_xts_ctx {
+	struct crypto_aes_ctx key1;
+	struct crypto_aes_ctx key2;
+};
+
+static inline u8 byte(const u32 x, const unsigned n)
+{
+	return x >> (n << 3);
+}
+
+static __always_inline void aes_mb_fround(u32 bo[4], const u32 bi[4],
+					  const u32 *k)
+{
+	int n;
+
+	for (n = 0; n < 4; n++)
+		bo[n] = crypto_ft_tab[0][byte(bi[n], 0)] ^
+			crypto_ft_tab[1][byte(bi[(n + 1) & 3], 1)] ^
+			crypto_ft_tab[2][byte(bi[(n + 2) & 3], 2)] ^
+			crypto_ft_tab[3][byte(bi[(n + 3) & 3], 3)] ^ k[n];
+}
+
+static __always_inline void aes_mb_flround(u32 bo[4], const u32 bi[4],
+					   const u32 *k)
+{
+	int n;
+
+	for (n = 0; n < 4; n++)
+		bo[n] = crypto_fl_tab[0][byte(bi[n], 0)] ^
+			crypto_fl_tab[1][byte(bi[(n + 1) & 3], 1)] ^
+			crypto_fl_tab[2][byte(bi[(n + 2) & 3], 2)] ^
+			crypto_fl_tab[3][byte(bi[(n + 3) & 3], 3)] ^ k[n];
+}
+
+static __always_inline void aes_mb_iround(u32 bo[4], const u32 bi[4],
+					  const u32 *k)
+{
+	int n;
+
+	for (n = 0; n < 4; n++)
+		bo[n] = crypto_it_tab[0][byte(bi[n], 0)] ^
+			crypto_it_tab[1][byte(bi[(n + 3) & 3], 1)] ^
+			crypto_it_tab[2][byte(bi[(n + 2) & 3], 2)] ^
+			crypto_it_tab[3][byte(bi[(n + 1) & 3], 3)] ^ k[n];
+}
+
+static __always_inline void aes_mb_ilround(u32 bo[4], const u32 bi[4],
+					   const u32 *k)
+{
+	int n;
+
+	for (n = 0; n < 4; n++)
+		bo[n] = crypto_il_tab[0][byte(bi[n], 0)] ^
+			crypto_il_tab[1][byte(bi[(n + 3) & 3], 1)] ^
+			crypto_il_tab[2][byte(bi[(n + 2) & 3], 2)] ^
+			crypto_il_tab[3][byte(bi[(n + 1) & 3], 3)] ^ k[n];
+}
+
+/*
+ * Encrypt or decrypt the AES_MB_LANES blocks in @buf in place. Callers
+ * with fewer blocks leave the remaining lanes holding stale data.
+ */
+static void aes_mb_crypt_lanes(const struct crypto_aes_ctx *ctx, u8 *buf,
+			       bool enc)
+{
+	u32 b0[AES_MB_LANES][4], b1[AES_MB_LANES][4];
+	u32 (*s)[4] = b0, (*t)[4] = b1, (*tmp)[4];
+	const u32 *key = enc ? ctx->key_enc : ctx->key_dec;
+	const u32 *kp = key + 4;
+	int rounds = 6 + ctx->key_length / 4;
+	int l, n, r;
+
+	for (l = 0; l < AES_MB_LANES; l++)
+		for (n = 0; n < 4; n++)
+			s[l][n] = key[n] ^
+				  get_unaligned_le32(buf + l * AES_BLOCK_SIZE +
+						     n * 4);
+
+	for (r = 1; r < rounds; r++, kp += 4) {
+		for (l = 0; l < AES_MB_LANES; l++) {
+			if (enc)
+				aes_mb_fround(t[l], s[l], kp);
+			else
+				aes_mb_iround(t[l], s[l], kp);
+		}
+		tmp = s;
+		s = t;
+		t = tmp;
+	}
+
+	for (l = 0; l < AES_MB_LANES; l++) {
+		if (enc)
+			aes_mb_flround(t[l], s[l], kp);
+		else
+			aes_mb_ilround(t[l], s[l], kp);
+	}
+
+	for (l = 0; l < AES_MB_LANES; l++)
+		for (n = 0; n < 4; n++)
+			put_unaligned_le32(t[l][n],
+					   buf + l * AES_BLOCK_SIZE + n * 4);
+
+	memzero_explicit(b0, sizeof(b0));
+	memzero_explicit(b1, sizeof(b1));
+}
+
+static int aes_mb_ctr_setkey(struct crypto_skcipher *tfm, const u8 *in_key,
+			     unsigned int key_len)
+{
+	struct crypto_aes_ctx *ctx = crypto_skcipher_ctx(tfm);
+
+	return aes_expandkey(ctx, in_key, key_len);
+}
+
+static int aes_mb_ctr_crypt(struct skcipher_request *req)
+{
+	struct crypto_skcipher *tfm = crypto_skcipher_reqtfm(req);
+	const struct crypto_aes_ctx *ctx = crypto_skcipher_ctx(tfm);
+	u8 buf[AES_MB_BYTES];
+	struct skcipher_walk walk;
+	int err;
+
+	err = skcipher_walk_virt(&walk, req, false);
+
+	while (walk.nbytes > 0) {
+		const u8 *src = walk.src.virt.addr;
+		u8 *dst = walk.dst.virt.addr;
+		unsigned int nbytes = walk.nbytes;
+		unsigned int done, n, i;
+
+		/* Only the last step may end in a partial block */
+		if (walk.nbytes < walk.total)
+			nbytes = round_down(nbytes, AES_BLOCK_SIZE);
+		done = nbytes;
+
+		while (nbytes) {
+			n = min_t(unsigned int, nbytes, AES_MB_BYTES);
+			for (i = 0; i < n; i += AES_BLOCK_SIZE) {
+				memcpy(buf + i, walk.iv, AES_BLOCK_SIZE);
+				crypto_inc(walk.iv, AES_BLOCK_SIZE);
+			}
+			aes_mb_crypt_lanes(ctx, buf, true);
+			crypto_xor_cpy(dst, src, buf, n);
+			src += n;
+			dst += n;
+			nbytes -= n;
+		}
+
+		err = skcipher_walk_done(&walk, walk.nbytes - done);
+	}
+
+	memzero_explicit(buf, sizeof(buf));
+	return err;
+}
+
+static int aes_mb_xts_setkey(struct crypto_skcipher *tfm, const u8 *in_key,
+			     unsigned int key_len)
+{
+	struct aes_mb_xts_ctx *ctx = crypto_skcipher_ctx(tfm);
+	int err;
+
+	err = xts_verify_key(tfm, in_key, key_len);
+	if (err)
+		return err;
+
+	key_len /= 2;
+	return aes_expandkey(&ctx->key1, in_key, key_len) ?:
+	       aes_expandkey(&ctx->key2, in_key + key_len, key_len);
+}
+
+/* XOR @nbytes of @src with the tweaks starting at @t, advancing @t */
+static void aes_mb_xts_whiten(u8 *dst, const u8 *src, unsigned int nbytes,
+			      le128 *t)
+{
+	for (; nbytes; nbytes -= AES_BLOCK_SIZE) {
+		crypto_xor_cpy(dst, src, (u8 *)t, AES_BLOCK_SIZE);
+		gf128mul_x_ble(t, t);
+		src += AES_BLOCK_SIZE;
+		dst += AES_BLOCK_SIZE;
+	}
+}
+
+static int aes_mb_xts_crypt_one(struct skcipher_request *req,
+				const u8 *tweak, bool enc)
+{
+	struct crypto_skcipher *tfm = crypto_skcipher_reqtfm(req);
+	const struct aes_mb_xts_ctx *ctx = crypto_skcipher_ctx(tfm);
+	unsigned int tail = req->cryptlen % AES_BLOCK_SIZE;
+	struct skcipher_request subreq;
+	u8 buf[AES_MB_BYTES];
+	struct skcipher_walk walk;
+	le128 t, t2;
+	int err;
+
+	if (req->cryptlen < AES_BLOCK_SIZE)
+		return -EINVAL;
+
+	memcpy(&t, tweak, AES_BLOCK_SIZE);
+
+	/*
+	 * With ciphertext stealing, the last full block and the partial block
+	 * are handled separately below.
+	 */
+	skcipher_request_set_tfm(&subreq, tfm);
+	skcipher_request_set_callback(&subreq,
+				      skcipher_request_flags(req) &
+				      ~CRYPTO_TFM_REQ_MAY_BACKLOG,
+				      NULL, NULL);
+	skcipher_request_set_crypt(&subreq, req->src, req->dst,
+				   req->cryptlen - (tail ? tail + AES_BLOCK_SIZE
+							 : 0),
+				   req->iv);
+
+	err = skcipher_walk_virt(&walk, &subreq, false);
+
+	while (walk.nbytes > 0) {
+		const u8 *src = walk.src.virt.addr;
+		u8 *dst = walk.dst.virt.addr;
+		unsigned int nbytes = round_down(walk.nbytes, AES_BLOCK_SIZE);
+		unsigned int n;
+
+		while (nbytes) {
+			n = min_t(unsigned int, nbytes, AES_MB_BYTES);
+			t2 = t;
+			aes_mb_xts_whiten(buf, src, n, &t);
+			aes_mb_crypt_lanes(&ctx->key1, buf, enc);
+			aes_mb_xts_whiten(dst, buf, n, &t2);
+			src += n;
+			dst += n;
+			nbytes -= n;
+		}
+
+		err = skcipher_walk_done(&walk, walk.nbytes % AES_BLOCK_SIZE);
+	}
+
+	if (!err && tail) {
+		unsigned int offset = subreq.cryptlen;
+		u8 *a = buf, *b = buf + AES_BLOCK_SIZE;
+		le128 tm1 = t, tm = t;
+
+		gf128mul_x_ble(&tm, &tm);
+		if (!enc)
+			swap(tm1, tm);
+
+		scatterwalk_map_and_copy(buf, req->src, offset,
+					 AES_BLOCK_SIZE + tail, 0);
+
+		/* b holds the partial block, a the last full one */
+		crypto_xor(a, (u8 *)&tm1, AES_BLOCK_SIZE);
+		if (enc)
+			aes_encrypt(&ctx->key1, a, a);
+		else
+			aes_decrypt(&ctx->key1, a, a);
+		crypto_xor(a, (u8 *)&tm1, AES_BLOCK_SIZE);
+
+		/* Steal the tail of a to pad out the partial block */
+		memcpy(buf + 2 * AES_BLOCK_SIZE, a, tail);
+		memcpy(a, b, tail);
+
+		crypto_xor(a, (u8 *)&tm, AES_BLOCK_SIZE);
+		if (enc)
+			aes_encrypt(&ctx->key1, a, a);
+		else
+			aes_decrypt(&ctx->key1, a, a);
+		crypto_xor(a, (u8 *)&tm, AES_BLOCK_SIZE);
+
+		memcpy(b, buf + 2 * AES_BLOCK_SIZE, tail);
+		scatterwalk_map_and_copy(buf, req->dst, offset,
+					 AES_BLOCK_SIZE + tail, 1);
+	}
+
+	memzero_explicit(buf, sizeof(buf));
+	return err;
+}
+
+static int aes_mb_xts_crypt(struct skcipher_request *req, bool enc)
+{
+	struct crypto_skcipher *tfm = crypto_skcipher_reqtfm(req);
+	const struct aes_mb_xts_ctx *ctx = crypto_skcipher_ctx(tfm);
+	u8 tweak[AES_BLOCK_SIZE];
+
+	aes_encrypt(&ctx->key2, tweak, req->iv);
+	return aes_mb_xts_crypt_one(req, tweak, enc);
+}
+
+static int aes_mb_xts_encrypt(struct skcipher_request *req)
+{
+	return aes_mb_xts_crypt(req, true);
+}
+
+static int aes_mb_xts_decrypt(struct skcipher_request *req)
+{
+	return aes_mb_xts_crypt(req, false);
+}
+
+/* Compute the tweaks of up to AES_MB_LANES requests in one go */
+static int aes_mb_xts_crypt_batch(struct skcipher_request **reqs, int *errs,
+				  unsigned int nr, bool enc)
+{
+	struct crypto_skcipher *tfm = crypto_skcipher_reqtfm(reqs[0]);
+	const struct aes_mb_xts_ctx *ctx = crypto_skcipher_ctx(tfm);
+	u8 tweaks[AES_MB_BYTES];
+	unsigned int i, l, n;
+	int ret = 0;
+
+	for (i = 0; i < nr; i += n) {
+		n = min_t(unsigned int, nr - i, AES_MB_LANES);
+		for (l = 0; l < n; l++)
+			memcpy(tweaks + l * AES_BLOCK_SIZE, reqs[i + l]->iv,
+			       AES_BLOCK_SIZE);
+		aes_mb_crypt_lanes(&ctx->key2, tweaks, true);
+
+		for (l = 0; l < n; l++) {
+			errs[i + l] = aes_mb_xts_crypt_one(reqs[i + l],
+						tweaks + l * AES_BLOCK_SIZE,
+						enc);
+			if (errs[i + l] && !ret)
+				ret = errs[i + l];
+		}
+	}
+
+	memzero_explicit(tweaks, sizeof(tweaks));
+	return ret;
+}
+
+static int aes_mb_xts_encrypt_batch(struct skcipher_request **reqs,
+				    int *errs, unsigned int nr)
+{
+	return aes_mb_xts_crypt_batch(reqs, errs, nr, true);
+}
+
+static int aes_mb_xts_decrypt_batch(struct skcipher_request **reqs,
+				    int *errs, unsigned int nr)
+{
+	return aes_mb_xts_crypt_batch(reqs, errs, nr, false);
+}
+
+static struct skcipher_alg aes_mb_algs[] = { {
+	.base.cra_name		= "ctr(aes)",
+	.base.cra_driver_name	= "ctr-aes-mb-generic",
+	.base.cra_priority	= 150,
+	.base.cra_blocksize	= 1,
+	.base.cra_ctxsize	= sizeof(struct crypto_aes_ctx),
+	.base.cra_module	= THIS_MODULE,
+
+	.min_keysize		= AES_MIN_KEY_SIZE,
+	.max_keysize		= AES_MAX_KEY_SIZE,
+	.ivsize			= AES_BLOCK_SIZE,
+	.chunksize		= AES_BLOCK_SIZE,
+	.walksize		= AES_MB_BYTES,
+	.setkey			= aes_mb_ctr_setkey,
+	.encrypt		= aes_mb_ctr_crypt,
+	.decrypt		= aes_mb_ctr_crypt,
+}, {
+	.base.cra_name		= "xts(aes)",
+	.base.cra_driver_name	= "xts-aes-mb-generic",
+	.base.cra_priority	= 150,
+	.base.cra_blocksize	= AES_BLOCK_SIZE,
+	.base.cra_ctxsize	= sizeof(struct aes_mb_xts_ctx),
+	.base.cra_module	= THIS_MODULE,
+
+	.min_keysize		= 2 * AES_MIN_KEY_SIZE,
+	.max_keysize		= 2 * AES_MAX_KEY_SIZE,
+	.ivsize			= AES_BLOCK_SIZE,
+	.walksize		= AES_MB_BYTES,
+	.setkey			= aes_mb_xts_setkey,
+	.encrypt		= aes_mb_xts_encrypt,
+	.decrypt		= aes_mb_xts_decrypt,
+	.encrypt_batch		= aes_mb_xts_encrypt_batch,
+	.decrypt_batch		= aes_mb_xts_decrypt_batch,
+} };
+
+static int __init aes_mb_init(void)
+{
+	return crypto_register_skciphers(aes_mb_algs, ARRAY_SIZE(aes_mb_algs));
+}
+
+static void __exit aes_mb_exit(void)
+{
+	crypto_unregister_skciphers(aes_mb_algs, ARRAY_SIZE(aes_mb_algs));
+}
+
+subsys_initcall(aes_mb_init);
+module_exit(aes_mb_exit);
+
+MODULE_DESCRIPTION("Multi-buffer AES-CTR and AES-XTS (generic)");
+MODULE_LICENSE("GPL");
+MODULE_ALIAS_CRYPTO("ctr(aes)");
+MODULE_ALIAS_CRYPTO("xts(aes)");
+MODULE_ALIAS_CRYPTO("ctr-aes-mb-generic");
+MODULE_ALIAS_CRYPTO("xts-aes-mb-generic");
@@ -382,6 +382,47 @@ int crypto_ahash_digest(struct ahash_request *req)
 }
 EXPORT_SYMBOL_GPL(crypto_ahash_digest);
 
+int crypto_ahash_digest_batch(struct ahash_request **reqs, int *errs,
+			      unsigned int nr)
+{
+	struct crypto_ahash *tfm;
+	struct crypto_alg *alg;
+	unsigned long bits = 0;
+	unsigned int i;
+	int ret = 0;
+
+	if (!nr)
+		return 0;
+
+	tfm = crypto_ahash_reqtfm(reqs[0]);
+	alg = tfm->base.__crt_alg;
+
+	for (i = 0; i < nr; i++) {
+		if (WARN_ON_ONCE(crypto_ahash_reqtfm(reqs[i]) != tfm))
+			return -EINVAL;
+		bits |= (unsigned long)reqs[i]->result;
+	}
+
+	/* Unkeyed or misaligned batches take the single request path */
+	if (!tfm->digest_batch || bits & crypto_ahash_alignmask(tfm) ||
+	    crypto_ahash_get_flags(tfm) & CRYPTO_TFM_NEED_KEY) {
+		for (i = 0; i < nr; i++) {
+			errs[i] = crypto_ahash_digest(reqs[i]);
+			if (errs[i] && !ret)
+				ret = errs[i];
+		}
+		return ret;
+	}
+
+	for (i = 0; i < nr; i++)
+		crypto_stats_get(alg);
+	ret = tfm->digest_batch(reqs, errs, nr);
+	for (i = 0; i < nr; i++)
+		crypto_stats_ahash_final(reqs[i]->nbytes, errs[i], alg);
+	return ret;
+}
+EXPORT_SYMBOL_GPL(crypto_ahash_digest_batch);
+
 static void ahash_def_finup_done2(struct crypto_async_request *req, int err)
 {
 	struct ahash_request *areq = req->data;
@@ -467,6 +508,7 @@ static int crypto_ahash_init_tfm(struct crypto_tfm *tfm)
 	hash->final = alg->final;
 	hash->finup = alg->finup ?: ahash_def_finup;
 	hash->digest = alg->digest;
+	hash->digest_batch = alg->digest_batch;
 	hash->export = alg->export;
 	hash->import = alg->import;
 
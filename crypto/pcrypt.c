@@ -15,12 +15,17 @@
 #include <linux/slab.h>
 #include <linux/kobject.h>
 #include <linux/cpu.h>
+#include <linux/sched/isolation.h>
 #include <crypto/pcrypt.h>
 
 static struct padata_instance *pencrypt;
 static struct padata_instance *pdecrypt;
 static struct kset           *pcrypt_kset;
 
+static unsigned int nr_flows = 64;
+module_param(nr_flows, uint, 0444);
+MODULE_PARM_DESC(nr_flows, "Number of independently ordered flows (0 = single order)");
+
 struct pcrypt_instance_ctx {
 	struct crypto_aead_spawn spawn;
 	struct padata_shell *psenc;
@@ -31,6 +36,7 @@ struct pcrypt_instance_ctx {
 struct pcrypt_aead_ctx {
 	struct crypto_aead *child;
 	unsigned int cb_cpu;
+	u32 flow;
 };
 
 static inline struct pcrypt_instance_ctx *pcrypt_tfm_ictx(
@@ -106,6 +112,7 @@ static int pcrypt_aead_encrypt(struct aead_request *req)
 
 	padata->parallel = pcrypt_aead_enc;
 	padata->serial = pcrypt_aead_serial;
+	padata->flow = ctx->flow;
 
 	aead_request_set_tfm(creq, ctx->child);
 	aead_request_set_callback(creq, flags & ~CRYPTO_TFM_REQ_MAY_SLEEP,
@@ -155,6 +162,7 @@ static int pcrypt_aead_decrypt(struct aead_request *req)
 
 	padata->parallel = pcrypt_aead_dec;
 	padata->serial = pcrypt_aead_serial;
+	padata->flow = ctx->flow;
 
 	aead_request_set_tfm(creq, ctx->child);
 	aead_request_set_callback(creq, flags & ~CRYPTO_TFM_REQ_MAY_SLEEP,
@@ -174,18 +182,23 @@ static int pcrypt_aead_decrypt(struct aead_request *req)
 
 static int pcrypt_aead_init_tfm(struct crypto_aead *tfm)
 {
-	int cpu, cpu_index;
+	const struct cpumask *hk = housekeeping_cpumask(HK_TYPE_DOMAIN);
 	struct aead_instance *inst = aead_alg_instance(tfm);
 	struct pcrypt_instance_ctx *ictx = aead_instance_ctx(inst);
 	struct pcrypt_aead_ctx *ctx = crypto_aead_ctx(tfm);
 	struct crypto_aead *cipher;
+	unsigned int nr_cpus;
 
-	cpu_index = (unsigned int)atomic_inc_return(&ictx->tfm_count) %
-		    cpumask_weight(cpu_online_mask);
+	/* Every tfm (i.e. SA) is ordered as a flow of its own. */
+	ctx->flow = (u32)atomic_inc_return(&ictx->tfm_count);
 
-	ctx->cb_cpu = cpumask_first(cpu_online_mask);
-	for (cpu = 0; cpu < cpu_index; cpu++)
-		ctx->cb_cpu = cpumask_next(ctx->cb_cpu, cpu_online_mask);
+	/* Spread the callbacks over the online, non-isolated CPUs. */
+	nr_cpus = cpumask_weight_and(cpu_online_mask, hk);
+	if (nr_cpus)
+		ctx->cb_cpu = cpumask_nth_and(ctx->flow % nr_cpus,
+					      cpu_online_mask, hk);
+	else
+		ctx->cb_cpu = cpumask_first(cpu_online_mask);
 
 	cipher = crypto_spawn_aead(&ictx->spawn);
 
@@ -249,11 +262,11 @@ static int pcrypt_create_aead(struct crypto_template *tmpl, struct rtattr **tb,
 	err = -ENOMEM;
 
 	ctx = aead_instance_ctx(inst);
-	ctx->psenc = padata_alloc_shell(pencrypt);
+	ctx->psenc = padata_alloc_shell_flows(pencrypt, nr_flows);
 	if (!ctx->psenc)
 		goto err_free_inst;
 
-	ctx->psdec = padata_alloc_shell(pdecrypt);
+	ctx->psdec = padata_alloc_shell_flows(pdecrypt, nr_flows);
 	if (!ctx->psdec)
 		goto err_free_inst;
 
@@ -11,6 +11,8 @@
 #include <linux/init.h>
 #include <linux/module.h>
 #include <linux/mm.h>
+#include <linux/bitops.h>
+#include <linux/string.h>
 #include <linux/types.h>
 #include <crypto/sha2.h>
 #include <crypto/sha256_base.h>
@@ -58,12 +60,143 @@ int crypto_sha256_finup(struct shash_desc *desc, const u8 *data,
 }
 EXPORT_SYMBOL(crypto_sha256_finup);
 
+/*
+ * Multi-buffer support: the block function below runs SHA256_MB_LANES
+ * independent messages through the compression function in lock-step.
+ * The state is kept with the lane as the innermost index so that the
+ * compiler can interleave (or vectorize) the otherwise serially dependent
+ * round computations of the different messages.
+ */
+#define SHA256_MB_LANES		4
+
+static const u32 sha256_mb_K[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+	0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+	0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+	0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+	0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+	0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+	0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+	0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+	0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+#define mb_Ch(x, y, z)	((z) ^ ((x) & ((y) ^ (z))))
+#define mb_Maj(x, y, z)	(((x) & (y)) | ((z) & ((x) | (y))))
+#define mb_e0(x)	(ror32(x, 2) ^ ror32(x, 13) ^ ror32(x, 22))
+#define mb_e1(x)	(ror32(x, 6) ^ ror32(x, 11) ^ ror32(x, 25))
+#define mb_s0(x)	(ror32(x, 7) ^ ror32(x, 18) ^ ((x) >> 3))
+#define mb_s1(x)	(ror32(x, 17) ^ ror32(x, 19) ^ ((x) >> 10))
+
+static void sha256_mb_blocks(u32 state[8][SHA256_MB_LANES],
+			     const u8 *data[SHA256_MB_LANES],
+			     unsigned int nblocks)
+{
+	u32 W[16][SHA256_MB_LANES];
+	u32 v[8][SHA256_MB_LANES];
+	unsigned int i, l;
+
+	while (nblocks--) {
+		memcpy(v, state, sizeof(v));
+
+		for (i = 0; i < 64; i++) {
+			for (l = 0; l < SHA256_MB_LANES; l++) {
+				u32 t1, t2, w;
+
+				if (i < 16) {
+					w = get_unaligned_be32(data[l] + 4 * i);
+				} else {
+					w = mb_s1(W[(i - 2) & 15][l]) +
+					    W[(i - 7) & 15][l] +
+					    mb_s0(W[(i - 15) & 15][l]) +
+					    W[i & 15][l];
+				}
+				W[i & 15][l] = w;
+
+				t1 = v[7][l] + mb_e1(v[4][l]) +
+				     mb_Ch(v[4][l], v[5][l], v[6][l]) +
+				     sha256_mb_K[i] + w;
+				t2 = mb_e0(v[0][l]) +
+				     mb_Maj(v[0][l], v[1][l], v[2][l]);
+				v[7][l] = v[6][l];
+				v[6][l] = v[5][l];
+				v[5][l] = v[4][l];
+				v[4][l] = v[3][l] + t1;
+				v[3][l] = v[2][l];
+				v[2][l] = v[1][l];
+				v[1][l] = v[0][l];
+				v[0][l] = t1 + t2;
+			}
+		}
+
+		for (i = 0; i < 8; i++)
+			for (l = 0; l < SHA256_MB_LANES; l++)
+				state[i][l] += v[i][l];
+
+		for (l = 0; l < SHA256_MB_LANES; l++)
+			data[l] += SHA256_BLOCK_SIZE;
+	}
+
+	memzero_explicit(W, sizeof(W));
+	memzero_explicit(v, sizeof(v));
+}
+
+static int crypto_sha256_finup_mb(struct shash_desc *desc,
+				  const u8 * const data[], unsigned int len,
+				  u8 * const outs[], unsigned int num_msgs)
+{
+	const struct sha256_state *sctx = shash_desc_ctx(desc);
+	unsigned int nblocks = len / SHA256_BLOCK_SIZE;
+	unsigned int done = nblocks * SHA256_BLOCK_SIZE;
+	u32 state[8][SHA256_MB_LANES];
+	const u8 *ptrs[SHA256_MB_LANES];
+	struct sha256_state lane;
+	unsigned int i, l;
+
+	/* Only block-aligned starting states can be run in lock-step */
+	if (sctx->count % SHA256_BLOCK_SIZE)
+		return -EOPNOTSUPP;
+
+	/* Unused lanes redo the first message; their result is dropped */
+	for (l = 0; l < SHA256_MB_LANES; l++) {
+		ptrs[l] = data[l < num_msgs ? l : 0];
+		for (i = 0; i < 8; i++)
+			state[i][l] = sctx->state[i];
+	}
+
+	sha256_mb_blocks(state, ptrs, nblocks);
+
+	for (l = 0; l < num_msgs; l++) {
+		for (i = 0; i < 8; i++)
+			lane.state[i] = state[i][l];
+		lane.count = sctx->count + done;
+		sha256_update(&lane, data[l] + done, len - done);
+		if (crypto_shash_digestsize(desc->tfm) == SHA224_DIGEST_SIZE)
+			sha224_final(&lane, outs[l]);
+		else
+			sha256_final(&lane, outs[l]);
+	}
+
+	memzero_explicit(state, sizeof(state));
+	memzero_explicit(&lane, sizeof(lane));
+	return 0;
+}
+
 static struct shash_alg sha256_algs[2] = { {
 	.digestsize	=	SHA256_DIGEST_SIZE,
 	.init		=	sha256_base_init,
 	.update		=	crypto_sha256_update,
 	.final		=	crypto_sha256_final,
 	.finup		=	crypto_sha256_finup,
+	.finup_mb	=	crypto_sha256_finup_mb,
+	.mb_max_msgs	=	SHA256_MB_LANES,
 	.descsize	=	sizeof(struct sha256_state),
 	.base		=	{
 		.cra_name	=	"sha256",
@@ -78,6 +211,8 @@ static struct shash_alg sha256_algs[2] = { {
 	.update		=	crypto_sha256_update,
 	.final		=	crypto_sha256_final,
 	.finup		=	crypto_sha256_finup,
+	.finup_mb	=	crypto_sha256_finup_mb,
+	.mb_max_msgs	=	SHA256_MB_LANES,
 	.descsize	=	sizeof(struct sha256_state),
 	.base		=	{
 		.cra_name	=	"sha224",
@@ -194,6 +194,68 @@ int crypto_shash_finup(struct shash_desc *desc, const u8 *data,
 }
 EXPORT_SYMBOL_GPL(crypto_shash_finup);
 
+static int shash_finup_mb_fallback(struct shash_desc *desc,
+				   const u8 * const data[], unsigned int len,
+				   u8 * const outs[], unsigned int num_msgs)
+{
+	struct crypto_shash *tfm = desc->tfm;
+	SHASH_DESC_ON_STACK(desc2, tfm);
+	unsigned int i;
+	int err = 0;
+
+	for (i = 0; i < num_msgs && !err; i++) {
+		memcpy(desc2, desc, sizeof(*desc) + crypto_shash_descsize(tfm));
+		err = crypto_shash_finup(desc2, data[i], len, outs[i]);
+	}
+	shash_desc_zero(desc2);
+	return err;
+}
+
+static bool shash_mb_aligned(struct crypto_shash *tfm,
+			     const u8 * const data[], u8 * const outs[],
+			     unsigned int num_msgs)
+{
+	unsigned long alignmask = crypto_shash_alignmask(tfm);
+	unsigned long bits = 0;
+	unsigned int i;
+
+	for (i = 0; i < num_msgs; i++)
+		bits |= (unsigned long)data[i] | (unsigned long)outs[i];
+
+	return !(bits & alignmask);
+}
+
+int crypto_shash_finup_mb(struct shash_desc *desc, const u8 * const data[],
+			  unsigned int len, u8 * const outs[],
+			  unsigned int num_msgs)
+{
+	struct crypto_shash *tfm = desc->tfm;
+	struct shash_alg *shash = crypto_shash_alg(tfm);
+	unsigned int max = shash->mb_max_msgs;
+	int err = 0;
+
+	if (max < 2)
+		return shash_finup_mb_fallback(desc, data, len, outs, num_msgs);
+
+	while (num_msgs && !err) {
+		unsigned int n = min(num_msgs, max);
+
+		if (n < 2 || !shash_mb_aligned(tfm, data, outs, n)) {
+			err = shash_finup_mb_fallback(desc, data, len, outs, n);
+		} else {
+			err = shash->finup_mb(desc, data, len, outs, n);
+			if (err == -EOPNOTSUPP)
+				err = shash_finup_mb_fallback(desc, data, len,
+							      outs, n);
+		}
+		data += n;
+		outs += n;
+		num_msgs -= n;
+	}
+	return err;
+}
+EXPORT_SYMBOL_GPL(crypto_shash_finup_mb);
+
 static int shash_digest_unaligned(struct shash_desc *desc, const u8 *data,
 				  unsigned int len, u8 *out)
 {
@@ -352,6 +414,80 @@ static int shash_async_digest(struct ahash_request *req)
 	return shash_ahash_digest(req, desc);
 }
 
+/*
+ * Requests can be hashed together if their data is a single mappable
+ * chunk, which is the case shash_ahash_digest() handles without walking.
+ */
+static bool shash_ahash_req_is_linear(struct ahash_request *req)
+{
+	struct scatterlist *sg = req->src;
+
+	return req->nbytes &&
+	       req->nbytes <= min(sg->length,
+				  ((unsigned int)(PAGE_SIZE)) - sg->offset);
+}
+
+static void shash_async_digest_mb(struct ahash_request **reqs, int *errs,
+				  unsigned int n)
+{
+	struct crypto_ahash *tfm = crypto_ahash_reqtfm(reqs[0]);
+	struct crypto_shash **ctx = crypto_ahash_ctx(tfm);
+	struct shash_desc *desc = ahash_request_ctx(reqs[0]);
+	const u8 *data[HASH_MAX_MB_MSGS];
+	u8 *outs[HASH_MAX_MB_MSGS];
+	void *maps[HASH_MAX_MB_MSGS];
+	unsigned int i;
+	int err;
+
+	for (i = 0; i < n; i++) {
+		struct scatterlist *sg = reqs[i]->src;
+
+		maps[i] = kmap_local_page(sg_page(sg));
+		data[i] = maps[i] + sg->offset;
+		outs[i] = reqs[i]->result;
+	}
+
+	desc->tfm = *ctx;
+	err = crypto_shash_init(desc) ?:
+	      crypto_shash_finup_mb(desc, data, reqs[0]->nbytes, outs, n);
+
+	while (i--) {
+		kunmap_local(maps[i]);
+		errs[i] = err;
+	}
+}
+
+static int shash_async_digest_batch(struct ahash_request **reqs, int *errs,
+				    unsigned int nr)
+{
+	struct crypto_ahash *tfm = crypto_ahash_reqtfm(reqs[0]);
+	struct crypto_shash **ctx = crypto_ahash_ctx(tfm);
+	unsigned int max = crypto_shash_mb_max_msgs(*ctx);
+	unsigned int i = 0, n;
+	int ret = 0;
+
+	while (i < nr) {
+		/* Group runs of linear requests of the same length */
+		n = 0;
+		while (i + n < nr && n < max &&
+		       shash_ahash_req_is_linear(reqs[i + n]) &&
+		       reqs[i + n]->nbytes == reqs[i]->nbytes)
+			n++;
+
+		if (n > 1) {
+			shash_async_digest_mb(&reqs[i], &errs[i], n);
+		} else {
+			n = 1;
+			errs[i] = shash_async_digest(reqs[i]);
+		}
+
+		for (; n; n--, i++)
+			if (errs[i] && !ret)
+				ret = errs[i];
+	}
+	return ret;
+}
+
 static int shash_async_export(struct ahash_request *req, void *out)
 {
 	return crypto_shash_export(ahash_request_ctx(req), out);
@@ -399,6 +535,8 @@ int crypto_init_shash_ops_async(struct crypto_tfm *tfm)
 	crt->final = shash_async_final;
 	crt->finup = shash_async_finup;
 	crt->digest = shash_async_digest;
+	if (alg->mb_max_msgs > 1)
+		crt->digest_batch = shash_async_digest_batch;
 	if (crypto_shash_alg_has_setkey(alg))
 		crt->setkey = shash_async_setkey;
 
@@ -539,6 +677,14 @@ static int shash_prepare_alg(struct shash_alg *alg)
 	if ((alg->export && !alg->import) || (alg->import && !alg->export))
 		return -EINVAL;
 
+	if (alg->finup_mb) {
+		if (alg->mb_max_msgs < 2 ||
+		    alg->mb_max_msgs > HASH_MAX_MB_MSGS)
+			return -EINVAL;
+	} else {
+		alg->mb_max_msgs = 1;
+	}
+
 	base->cra_type = &crypto_shash_type;
 	base->cra_flags &= ~CRYPTO_ALG_TYPE_MASK;
 	base->cra_flags |= CRYPTO_ALG_TYPE_SHASH;
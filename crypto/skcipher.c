@@ -650,6 +650,64 @@ int crypto_skcipher_decrypt(struct skcipher_request *req)
 }
 EXPORT_SYMBOL_GPL(crypto_skcipher_decrypt);
 
+static int crypto_skcipher_batch(struct skcipher_request **reqs, int *errs,
+				 unsigned int nr, bool enc)
+{
+	struct crypto_skcipher *tfm;
+	struct skcipher_alg *alg;
+	int (*batch)(struct skcipher_request **reqs, int *errs,
+		     unsigned int nr);
+	unsigned int i;
+	int ret = 0;
+
+	if (!nr)
+		return 0;
+
+	tfm = crypto_skcipher_reqtfm(reqs[0]);
+	alg = crypto_skcipher_alg(tfm);
+	for (i = 1; i < nr; i++)
+		if (WARN_ON_ONCE(crypto_skcipher_reqtfm(reqs[i]) != tfm))
+			return -EINVAL;
+
+	batch = enc ? alg->encrypt_batch : alg->decrypt_batch;
+	if (!batch || crypto_skcipher_get_flags(tfm) & CRYPTO_TFM_NEED_KEY) {
+		for (i = 0; i < nr; i++) {
+			errs[i] = enc ? crypto_skcipher_encrypt(reqs[i]) :
+					crypto_skcipher_decrypt(reqs[i]);
+			if (errs[i] && !ret)
+				ret = errs[i];
+		}
+		return ret;
+	}
+
+	for (i = 0; i < nr; i++)
+		crypto_stats_get(&alg->base);
+	ret = batch(reqs, errs, nr);
+	for (i = 0; i < nr; i++) {
+		if (enc)
+			crypto_stats_skcipher_encrypt(reqs[i]->cryptlen,
+						      errs[i], &alg->base);
+		else
+			crypto_stats_skcipher_decrypt(reqs[i]->cryptlen,
+						      errs[i], &alg->base);
+	}
+	return ret;
+}
+
+int crypto_skcipher_encrypt_batch(struct skcipher_request **reqs, int *errs,
+				  unsigned int nr)
+{
+	return crypto_skcipher_batch(reqs, errs, nr, true);
+}
+EXPORT_SYMBOL_GPL(crypto_skcipher_encrypt_batch);
+
+int crypto_skcipher_decrypt_batch(struct skcipher_request **reqs, int *errs,
+				  unsigned int nr)
+{
+	return crypto_skcipher_batch(reqs, errs, nr, false);
+}
+EXPORT_SYMBOL_GPL(crypto_skcipher_decrypt_batch);
+
 static void crypto_skcipher_exit_tfm(struct crypto_tfm *tfm)
 {
 	struct crypto_skcipher *skcipher = __crypto_skcipher_cast(tfm);
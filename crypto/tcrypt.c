@@ -237,12 +237,18 @@ static int test_mb_aead_cycles(struct test_mb_aead_data *data, int enc,
 	return ret;
 }
 
-static void test_mb_aead_speed(const char *algo, int enc, int secs,
-			       struct aead_speed_template *template,
-			       unsigned int tcount, u8 authsize,
-			       unsigned int aad_size, u8 *keysize, u32 num_mb)
+/*
+ * The requests are spread round robin over @num_tfm transforms with the same
+ * key, so that per-tfm state, like the flow of each pcrypt tfm, is exercised.
+ */
+static void test_mb_aead_speed_tfms(const char *algo, int enc, int secs,
+				    struct aead_speed_template *template,
+				    unsigned int tcount, u8 authsize,
+				    unsigned int aad_size, u8 *keysize,
+				    u32 num_mb, u32 num_tfm)
 {
 	struct test_mb_aead_data *data;
+	struct crypto_aead **tfms;
 	struct crypto_aead *tfm;
 	unsigned int i, j, iv_len;
 	const int *b_size;
@@ -271,19 +277,27 @@ static void test_mb_aead_speed(const char *algo, int enc, int secs,
 	if (!data)
 		goto out_free_iv;
 
-	tfm = crypto_alloc_aead(algo, 0, 0);
-	if (IS_ERR(tfm)) {
-		pr_err("failed to load transform for %s: %ld\n",
-			algo, PTR_ERR(tfm));
+	tfms = kcalloc(num_tfm, sizeof(*tfms), GFP_KERNEL);
+	if (!tfms)
 		goto out_free_data;
-	}
 
-	ret = crypto_aead_setauthsize(tfm, authsize);
-	if (ret) {
-		pr_err("alg: aead: Failed to setauthsize for %s: %d\n", algo,
-		       ret);
-		goto out_free_tfm;
+	for (i = 0; i < num_tfm; i++) {
+		tfm = crypto_alloc_aead(algo, 0, 0);
+		if (IS_ERR(tfm)) {
+			pr_err("failed to load transform for %s: %ld\n",
+				algo, PTR_ERR(tfm));
+			goto out_free_tfm;
+		}
+		tfms[i] = tfm;
+
+		ret = crypto_aead_setauthsize(tfm, authsize);
+		if (ret) {
+			pr_err("alg: aead: Failed to setauthsize for %s: %d\n",
+			       algo, ret);
+			goto out_free_tfm;
+		}
 	}
+	tfm = tfms[0];
 
 	for (i = 0; i < num_mb; ++i)
 		if (testmgr_alloc_buf(data[i].xbuf)) {
@@ -307,7 +321,8 @@ static void test_mb_aead_speed(const char *algo, int enc, int secs,
 		}
 
 	for (i = 0; i < num_mb; ++i) {
-		data[i].req = aead_request_alloc(tfm, GFP_KERNEL);
+		data[i].req = aead_request_alloc(tfms[i % num_tfm],
+						 GFP_KERNEL);
 		if (!data[i].req) {
 			pr_err("alg: aead: Failed to allocate request for %s\n",
 			       algo);
@@ -324,8 +339,8 @@ static void test_mb_aead_speed(const char *algo, int enc, int secs,
 					  crypto_req_done, &data[i].wait);
 	}
 
-	pr_info("\ntesting speed of multibuffer %s (%s) %s\n", algo,
-		get_driver_name(crypto_aead, tfm), e);
+	pr_info("\ntesting speed of multibuffer %s (%s) %s, %u tfms\n",
+		algo, get_driver_name(crypto_aead, tfm), e, num_tfm);
 
 	i = 0;
 	do {
@@ -354,13 +369,16 @@ static void test_mb_aead_speed(const char *algo, int enc, int secs,
 				}
 			}
 
-			crypto_aead_clear_flags(tfm, ~0);
+			for (j = 0; j < num_tfm; j++) {
+				crypto_aead_clear_flags(tfms[j], ~0);
 
-			ret = crypto_aead_setkey(tfm, key, *keysize);
-			if (ret) {
-				pr_err("setkey() failed flags=%x\n",
-				       crypto_aead_get_flags(tfm));
-				goto out;
+				ret = crypto_aead_setkey(tfms[j], key,
+							 *keysize);
+				if (ret) {
+					pr_err("setkey() failed flags=%x\n",
+					       crypto_aead_get_flags(tfms[j]));
+					goto out;
+				}
 			}
 
 			iv_len = crypto_aead_ivsize(tfm);
@@ -440,13 +458,24 @@ static void test_mb_aead_speed(const char *algo, int enc, int secs,
 	for (i = 0; i < num_mb; ++i)
 		testmgr_free_buf(data[i].xbuf);
 out_free_tfm:
-	crypto_free_aead(tfm);
+	for (i = 0; i < num_tfm; i++)
+		crypto_free_aead(tfms[i]);
+	kfree(tfms);
 out_free_data:
 	kfree(data);
 out_free_iv:
 	kfree(iv);
 }
 
+static void test_mb_aead_speed(const char *algo, int enc, int secs,
+			       struct aead_speed_template *template,
+			       unsigned int tcount, u8 authsize,
+			       unsigned int aad_size, u8 *keysize, u32 num_mb)
+{
+	test_mb_aead_speed_tfms(algo, enc, secs, template, tcount, authsize,
+				aad_size, keysize, num_mb, 1);
+}
+
 static int test_aead_jiffies(struct aead_request *req, int enc,
 				int blen, int secs)
 {
@@ -953,6 +982,223 @@ static void test_hash_speed(const char *algo, unsigned int secs,
 	return test_ahash_speed_common(algo, secs, speed, CRYPTO_ALG_ASYNC);
 }
 
+struct test_mb_ahash_data {
+	struct scatterlist sg;
+	struct ahash_request *req;
+	struct crypto_wait wait;
+	char *xbuf;
+	char result[MAX_DIGEST_SIZE];
+};
+
+static int do_mult_ahash_op(struct test_mb_ahash_data *data, u32 num_mb,
+			    int *rc, struct ahash_request **reqs)
+{
+	int i, err = 0;
+
+	/* Fire up a bunch of concurrent requests */
+	if (reqs)
+		crypto_ahash_digest_batch(reqs, rc, num_mb);
+
+	for (i = 0; i < num_mb && !reqs; i++)
+		rc[i] = crypto_ahash_digest(data[i].req);
+
+	/* Wait for all requests to finish */
+	for (i = 0; i < num_mb; i++) {
+		rc[i] = crypto_wait_req(rc[i], &data[i].wait);
+
+		if (rc[i]) {
+			pr_info("concurrent request %d error %d\n", i, rc[i]);
+			err = rc[i];
+		}
+	}
+
+	return err;
+}
+
+static int test_mb_ahash_jiffies(struct test_mb_ahash_data *data, int blen,
+				 int secs, u32 num_mb,
+				 struct ahash_request **reqs)
+{
+	unsigned long start, end;
+	int bcount;
+	int ret = 0;
+	int *rc;
+
+	rc = kcalloc(num_mb, sizeof(*rc), GFP_KERNEL);
+	if (!rc)
+		return -ENOMEM;
+
+	for (start = jiffies, end = start + secs * HZ, bcount = 0;
+	     time_before(jiffies, end); bcount++) {
+		ret = do_mult_ahash_op(data, num_mb, rc, reqs);
+		if (ret)
+			goto out;
+	}
+
+	pr_cont("%d operations in %d seconds (%llu bytes)\n",
+		bcount * num_mb, secs, (u64)bcount * blen * num_mb);
+
+out:
+	kfree(rc);
+	return ret;
+}
+
+static int test_mb_ahash_cycles(struct test_mb_ahash_data *data, int blen,
+				u32 num_mb, struct ahash_request **reqs)
+{
+	unsigned long cycles = 0;
+	int ret = 0;
+	int i;
+	int *rc;
+
+	rc = kcalloc(num_mb, sizeof(*rc), GFP_KERNEL);
+	if (!rc)
+		return -ENOMEM;
+
+	/* Warm-up run. */
+	for (i = 0; i < 4; i++) {
+		ret = do_mult_ahash_op(data, num_mb, rc, reqs);
+		if (ret)
+			goto out;
+	}
+
+	/* The real thing. */
+	for (i = 0; i < 8; i++) {
+		cycles_t start, end;
+
+		start = get_cycles();
+		ret = do_mult_ahash_op(data, num_mb, rc, reqs);
+		end = get_cycles();
+
+		if (ret)
+			goto out;
+
+		cycles += end - start;
+	}
+
+	pr_cont("1 operation in %lu cycles (%d bytes)\n",
+		(cycles + 4) / (8 * num_mb), blen);
+
+out:
+	kfree(rc);
+	return ret;
+}
+
+/*
+ * Hash num_mb independent buffers per iteration, first one request at a
+ * time and then through the batch interface, so that multi-buffer
+ * implementations can be compared against the single stream case.
+ */
+static void test_mb_ahash_speed(const char *algo, unsigned int secs,
+				struct hash_speed *speed, u32 num_mb)
+{
+	struct test_mb_ahash_data *data;
+	struct ahash_request **reqs;
+	struct crypto_ahash *tfm;
+	unsigned int i, j;
+	int batch;
+	int ret;
+
+	data = kcalloc(num_mb, sizeof(*data), GFP_KERNEL);
+	if (!data)
+		return;
+
+	reqs = kcalloc(num_mb, sizeof(*reqs), GFP_KERNEL);
+	if (!reqs)
+		goto out_free_data;
+
+	tfm = crypto_alloc_ahash(algo, 0, 0);
+	if (IS_ERR(tfm)) {
+		pr_err("failed to load transform for %s: %ld\n",
+			algo, PTR_ERR(tfm));
+		goto out_free_data;
+	}
+
+	if (crypto_ahash_digestsize(tfm) > MAX_DIGEST_SIZE) {
+		pr_err("digestsize(%u) > %d\n", crypto_ahash_digestsize(tfm),
+		       MAX_DIGEST_SIZE);
+		goto out_free_tfm;
+	}
+
+	for (i = 0; i < num_mb; ++i) {
+		data[i].xbuf = (void *)__get_free_page(GFP_KERNEL);
+		if (!data[i].xbuf) {
+			while (i--)
+				free_page((unsigned long)data[i].xbuf);
+			goto out_free_tfm;
+		}
+		memset(data[i].xbuf, 0xff, PAGE_SIZE);
+	}
+
+	for (i = 0; i < num_mb; ++i) {
+		data[i].req = ahash_request_alloc(tfm, GFP_KERNEL);
+		if (!data[i].req) {
+			pr_err("alg: hash: Failed to allocate request for %s\n",
+			       algo);
+			while (i--)
+				ahash_request_free(data[i].req);
+			goto out_free_xbuf;
+		}
+
+		ahash_request_set_callback(data[i].req,
+					   CRYPTO_TFM_REQ_MAY_BACKLOG,
+					   crypto_req_done, &data[i].wait);
+		crypto_init_wait(&data[i].wait);
+		reqs[i] = data[i].req;
+	}
+
+	pr_info("\ntesting speed of multibuffer %s (%s)\n", algo,
+		get_driver_name(crypto_ahash, tfm));
+
+	for (i = 0; speed[i].blen != 0; i++) {
+		/* Only whole messages in a single page can be batched */
+		if (speed[i].blen != speed[i].plen ||
+		    speed[i].blen > PAGE_SIZE)
+			continue;
+
+		for (j = 0; j < num_mb; ++j) {
+			sg_init_one(&data[j].sg, data[j].xbuf, speed[i].blen);
+			ahash_request_set_crypt(data[j].req, &data[j].sg,
+						data[j].result, speed[i].blen);
+		}
+
+		for (batch = 0; batch < 2; batch++) {
+			pr_info("test%3u (%5u byte blocks, %s): ", i,
+				speed[i].blen, batch ? "batched" : "single");
+
+			if (secs) {
+				ret = test_mb_ahash_jiffies(data,
+							    speed[i].blen,
+							    secs, num_mb,
+							    batch ? reqs : NULL);
+				cond_resched();
+			} else {
+				ret = test_mb_ahash_cycles(data,
+							   speed[i].blen,
+							   num_mb,
+							   batch ? reqs : NULL);
+			}
+
+			if (ret) {
+				pr_err("hashing failed ret=%d\n", ret);
+				goto out;
+			}
+		}
+	}
+
+out:
+	for (i = 0; i < num_mb; ++i)
+		ahash_request_free(data[i].req);
+out_free_xbuf:
+	for (i = 0; i < num_mb; ++i)
+		free_page((unsigned long)data[i].xbuf);
+out_free_tfm:
+	crypto_free_ahash(tfm);
+out_free_data:
+	kfree(reqs);
+	kfree(data);
+}
+
 struct test_mb_skcipher_data {
 	struct scatterlist sg[XBUFSIZE];
 	struct skcipher_request *req;
@@ -961,12 +1207,18 @@ struct test_mb_skcipher_data {
 };
 
 static int do_mult_acipher_op(struct test_mb_skcipher_data *data, int enc,
-				u32 num_mb, int *rc)
+				u32 num_mb, int *rc,
+				struct skcipher_request **reqs)
 {
 	int i, err = 0;
 
 	/* Fire up a bunch of concurrent requests */
-	for (i = 0; i < num_mb; i++) {
+	if (reqs && enc == ENCRYPT)
+		crypto_skcipher_encrypt_batch(reqs, rc, num_mb);
+	else if (reqs)
+		crypto_skcipher_decrypt_batch(reqs, rc, num_mb);
+
+	for (i = 0; i < num_mb && !reqs; i++) {
 		if (enc == ENCRYPT)
 			rc[i] = crypto_skcipher_encrypt(data[i].req);
 		else
@@ -987,7 +1239,8 @@ static int do_mult_acipher_op(struct test_mb_skcipher_data *data, int enc,
 }
 
 static int test_mb_acipher_jiffies(struct test_mb_skcipher_data *data, int enc,
-				int blen, int secs, u32 num_mb)
+				int blen, int secs, u32 num_mb,
+				struct skcipher_request **reqs)
 {
 	unsigned long start, end;
 	int bcount;
@@ -1000,7 +1253,7 @@ static int test_mb_acipher_jiffies(struct test_mb_skcipher_data *data, int enc,
 
 	for (start = jiffies, end = start + secs * HZ, bcount = 0;
 	     time_before(jiffies, end); bcount++) {
-		ret = do_mult_acipher_op(data, enc, num_mb, rc);
+		ret = do_mult_acipher_op(data, enc, num_mb, rc, reqs);
 		if (ret)
 			goto out;
 	}
@@ -1014,7 +1267,8 @@ static int test_mb_acipher_jiffies(struct test_mb_skcipher_data *data, int enc,
 }
 
 static int test_mb_acipher_cycles(struct test_mb_skcipher_data *data, int enc,
-			       int blen, u32 num_mb)
+			       int blen, u32 num_mb,
+			       struct skcipher_request **reqs)
 {
 	unsigned long cycles = 0;
 	int ret = 0;
@@ -1027,7 +1281,7 @@ static int test_mb_acipher_cycles(struct test_mb_skcipher_data *data, int enc,
 
 	/* Warm-up run. */
 	for (i = 0; i < 4; i++) {
-		ret = do_mult_acipher_op(data, enc, num_mb, rc);
+		ret = do_mult_acipher_op(data, enc, num_mb, rc, reqs);
 		if (ret)
 			goto out;
 	}
@@ -1037,7 +1291,7 @@ static int test_mb_acipher_cycles(struct test_mb_skcipher_data *data, int enc,
 		cycles_t start, end;
 
 		start = get_cycles();
-		ret = do_mult_acipher_op(data, enc, num_mb, rc);
+		ret = do_mult_acipher_op(data, enc, num_mb, rc, reqs);
 		end = get_cycles();
 
 		if (ret)
@@ -1054,10 +1308,12 @@ static int test_mb_acipher_cycles(struct test_mb_skcipher_data *data, int enc,
 	return ret;
 }
 
-static void test_mb_skcipher_speed(const char *algo, int enc, int secs,
-				   struct cipher_speed_template *template,
-				   unsigned int tcount, u8 *keysize, u32 num_mb)
+static void __test_mb_skcipher_speed(const char *algo, int enc, int secs,
+				     struct cipher_speed_template *template,
+				     unsigned int tcount, u8 *keysize,
+				     u32 num_mb, bool batch)
 {
+	struct skcipher_request **reqs = NULL;
 	struct test_mb_skcipher_data *data;
 	struct crypto_skcipher *tfm;
 	unsigned int i, j, iv_len;
@@ -1076,6 +1332,12 @@ static void test_mb_skcipher_speed(const char *algo, int enc, int secs,
 	if (!data)
 		return;
 
+	if (batch) {
+		reqs = kcalloc(num_mb, sizeof(*reqs), GFP_KERNEL);
+		if (!reqs)
+			goto out_free_data;
+	}
+
 	tfm = crypto_alloc_skcipher(algo, 0, 0);
 	if (IS_ERR(tfm)) {
 		pr_err("failed to load transform for %s: %ld\n",
@@ -1106,10 +1368,13 @@ static void test_mb_skcipher_speed(const char *algo, int enc, int secs,
 					      CRYPTO_TFM_REQ_MAY_BACKLOG,
 					      crypto_req_done, &data[i].wait);
 		crypto_init_wait(&data[i].wait);
+		if (reqs)
+			reqs[i] = data[i].req;
 	}
 
-	pr_info("\ntesting speed of multibuffer %s (%s) %s\n", algo,
-		get_driver_name(crypto_skcipher, tfm), e);
+	pr_info("\ntesting speed of multibuffer %s (%s) %s%s\n", algo,
+		get_driver_name(crypto_skcipher, tfm), e,
+		batch ? " (batched)" : "");
 
 	i = 0;
 	do {
@@ -1178,11 +1443,11 @@ static void test_mb_skcipher_speed(const char *algo, int enc, int secs,
 			if (secs) {
 				ret = test_mb_acipher_jiffies(data, enc,
 							      bs, secs,
-							      num_mb);
+							      num_mb, reqs);
 				cond_resched();
 			} else {
 				ret = test_mb_acipher_cycles(data, enc,
-							     bs, num_mb);
+							     bs, num_mb, reqs);
 			}
 
 			if (ret) {
@@ -1205,9 +1470,27 @@ static void test_mb_skcipher_speed(const char *algo, int enc, int secs,
 out_free_tfm:
 	crypto_free_skcipher(tfm);
 out_free_data:
+	kfree(reqs);
 	kfree(data);
 }
 
+static void test_mb_skcipher_speed(const char *algo, int enc, int secs,
+				   struct cipher_speed_template *template,
+				   unsigned int tcount, u8 *keysize, u32 num_mb)
+{
+	__test_mb_skcipher_speed(algo, enc, secs, template, tcount, keysize,
+				 num_mb, false);
+}
+
+static void test_mb_skcipher_batch_speed(const char *algo, int enc, int secs,
+					 struct cipher_speed_template *template,
+					 unsigned int tcount, u8 *keysize,
+					 u32 num_mb)
+{
+	__test_mb_skcipher_speed(algo, enc, secs, template, tcount, keysize,
+				 num_mb, true);
+}
+
 static inline int do_one_acipher_op(struct skcipher_request *req, int ret)
 {
 	struct crypto_wait *wait = req->base.data;
@@ -2857,6 +3140,46 @@ static int do_test(const char *alg, u32 type, u32 mask, int m, u32 num_mb)
 				       speed_template_16_32, num_mb);
 		break;
 
+	case 700:
+		if (alg) {
+			test_mb_ahash_speed(alg, sec,
+					    generic_hash_speed_template,
+					    num_mb);
+			break;
+		}
+		test_mb_ahash_speed("sha256", sec, generic_hash_speed_template,
+				    num_mb);
+		test_mb_ahash_speed("sha224", sec, generic_hash_speed_template,
+				    num_mb);
+		break;
+
+	case 701:
+		test_mb_skcipher_batch_speed("ctr(aes)", ENCRYPT, sec, NULL, 0,
+					     speed_template_16_24_32, num_mb);
+		test_mb_skcipher_batch_speed("ctr(aes)", DECRYPT, sec, NULL, 0,
+					     speed_template_16_24_32, num_mb);
+		test_mb_skcipher_batch_speed("xts(aes)", ENCRYPT, sec, NULL, 0,
+					     speed_template_32_64, num_mb);
+		test_mb_skcipher_batch_speed("xts(aes)", DECRYPT, sec, NULL, 0,
+					     speed_template_32_64, num_mb);
+		break;
+
+	case 702:
+		/* All requests in one flow, then one flow per request */
+		test_mb_aead_speed("pcrypt(rfc4106(gcm(aes)))", ENCRYPT, sec,
+				   NULL, 0, 16, 16, aead_speed_template_20,
+				   num_mb);
+		test_mb_aead_speed_tfms("pcrypt(rfc4106(gcm(aes)))", ENCRYPT,
+					sec, NULL, 0, 16, 16,
+					aead_speed_template_20, num_mb, num_mb);
+		test_mb_aead_speed("pcrypt(rfc4106(gcm(aes)))", DECRYPT, sec,
+				   NULL, 0, 16, 16, aead_speed_template_20,
+				   num_mb);
+		test_mb_aead_speed_tfms("pcrypt(rfc4106(gcm(aes)))", DECRYPT,
+					sec, NULL, 0, 16, 16,
+					aead_speed_template_20, num_mb, num_mb);
+		break;
+
 	}
 
 	return ret;
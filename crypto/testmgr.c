@@ -1853,6 +1853,200 @@ static int test_hash_vs_generic_impl(const char *generic_driver,
 }
 #endif /* !CONFIG_CRYPTO_MANAGER_EXTRA_TESTS */
 
+/*
+ * The batched interfaces must give the same results as issuing one request at
+ * a time.  Compare them for every batch size up to one past the widest
+ * multi-buffer implementation, so that split batches are covered as well, and
+ * for a mix of message lengths around the usual block boundaries.
+ */
+#define MB_TEST_MAX_MSGS	(HASH_MAX_MB_MSGS + 1)
+
+static const unsigned int mb_test_lens[] = { 0, 1, 16, 55, 64, 65, 200, 1000 };
+
+static void mb_test_fill(u8 *buf, unsigned int len, unsigned int seed)
+{
+	unsigned int i;
+
+	for (i = 0; i < len; i++)
+		buf[i] = seed * 131 + i * 7 + (i >> 8);
+}
+
+struct hash_mb_test {
+	u8 *data;		/* one page of message data per request */
+	u8 prefix[32];
+	u8 outs[MB_TEST_MAX_MSGS][HASH_MAX_DIGESTSIZE];
+	u8 refs[MB_TEST_MAX_MSGS][HASH_MAX_DIGESTSIZE];
+	struct scatterlist sg[MB_TEST_MAX_MSGS];
+	struct ahash_request *reqs[MB_TEST_MAX_MSGS];
+	struct crypto_wait waits[MB_TEST_MAX_MSGS];
+	int errs[MB_TEST_MAX_MSGS];
+};
+
+/* crypto_ahash_digest_batch() with runs of equal and of differing lengths */
+static int test_ahash_digest_batch(const char *driver,
+				   struct crypto_ahash *tfm,
+				   struct hash_mb_test *t)
+{
+	unsigned int digestsize = crypto_ahash_digestsize(tfm);
+	unsigned int run, n, i, len;
+	int err;
+
+	for (run = 1; run <= MB_TEST_MAX_MSGS; run *= 3) {
+		for (n = 1; n <= MB_TEST_MAX_MSGS; n++) {
+			for (i = 0; i < n; i++) {
+				len = mb_test_lens[(n + i / run) %
+						   ARRAY_SIZE(mb_test_lens)];
+				mb_test_fill(&t->data[i * PAGE_SIZE], len,
+					     n + i);
+				sg_init_one(&t->sg[i], &t->data[i * PAGE_SIZE],
+					    len);
+				ahash_request_set_crypt(t->reqs[i], &t->sg[i],
+							t->refs[i], len);
+				err = crypto_wait_req(
+					crypto_ahash_digest(t->reqs[i]),
+					&t->waits[i]);
+				if (err) {
+					pr_err("alg: ahash: %s digest() failed with err %d on batch test, len=%u\n",
+					       driver, err, len);
+					return err;
+				}
+				ahash_request_set_crypt(t->reqs[i], &t->sg[i],
+							t->outs[i], len);
+			}
+
+			crypto_ahash_digest_batch(t->reqs, t->errs, n);
+			for (i = 0; i < n; i++) {
+				err = crypto_wait_req(t->errs[i], &t->waits[i]);
+				if (err) {
+					pr_err("alg: ahash: %s digest_batch() failed with err %d on request %u of %u\n",
+					       driver, err, i, n);
+					return err;
+				}
+				if (memcmp(t->outs[i], t->refs[i],
+					   digestsize) != 0) {
+					pr_err("alg: ahash: %s digest_batch() gave wrong result on request %u of %u, len=%u\n",
+					       driver, i, n,
+					       t->reqs[i]->nbytes);
+					return -EINVAL;
+				}
+			}
+			cond_resched();
+		}
+	}
+	return 0;
+}
+
+/* crypto_shash_finup_mb() after an empty and a non-empty common prefix */
+static int test_shash_finup_mb(const char *driver, struct shash_desc *desc,
+			       struct hash_mb_test *t)
+{
+	unsigned int digestsize = crypto_shash_digestsize(desc->tfm);
+	const u8 *data[MB_TEST_MAX_MSGS];
+	u8 *outs[MB_TEST_MAX_MSGS];
+	unsigned int l, plen, n, i, len;
+	int err;
+
+	for (i = 0; i < MB_TEST_MAX_MSGS; i++) {
+		data[i] = &t->data[i * PAGE_SIZE];
+		outs[i] = t->outs[i];
+	}
+
+	for (l = 0; l < ARRAY_SIZE(mb_test_lens); l++) {
+		len = mb_test_lens[l];
+		for (i = 0; i < MB_TEST_MAX_MSGS; i++)
+			mb_test_fill(&t->data[i * PAGE_SIZE], len, l + i);
+
+		for (plen = 0; plen <= sizeof(t->prefix);
+		     plen += sizeof(t->prefix)) {
+			for (i = 0; i < MB_TEST_MAX_MSGS; i++) {
+				err = crypto_shash_init(desc) ?:
+				      crypto_shash_update(desc, t->prefix,
+							  plen) ?:
+				      crypto_shash_finup(desc, data[i], len,
+							 t->refs[i]);
+				if (err) {
+					pr_err("alg: shash: %s finup() failed with err %d on batch test, len=%u\n",
+					       driver, err, len);
+					return err;
+				}
+			}
+
+			for (n = 1; n <= MB_TEST_MAX_MSGS; n++) {
+				memset(t->outs, 0, sizeof(t->outs));
+				err = crypto_shash_init(desc) ?:
+				      crypto_shash_update(desc, t->prefix,
+							  plen) ?:
+				      crypto_shash_finup_mb(desc, data, len,
+							    outs, n);
+				if (err) {
+					pr_err("alg: shash: %s finup_mb() failed with err %d on %u messages, len=%u\n",
+					       driver, err, n, len);
+					return err;
+				}
+				for (i = 0; i < n; i++) {
+					if (memcmp(t->outs[i], t->refs[i],
+						   digestsize) != 0) {
+						pr_err("alg: shash: %s finup_mb() gave wrong result on message %u of %u, len=%u, prefix=%u\n",
+						       driver, i, n, len, plen);
+						return -EINVAL;
+					}
+				}
+			}
+			cond_resched();
+		}
+	}
+	return 0;
+}
+
+static int test_hash_mb(const char *driver, struct ahash_request *req,
+			struct shash_desc *desc)
+{
+	struct crypto_ahash *tfm = crypto_ahash_reqtfm(req);
+	struct hash_mb_test *t;
+	unsigned int i;
+	int err;
+
+	/* Nothing to compare against until a test vector has set a key */
+	if (crypto_ahash_get_flags(tfm) & CRYPTO_TFM_NEED_KEY)
+		return 0;
+
+	t = kzalloc(sizeof(*t), GFP_KERNEL);
+	if (!t)
+		goto out_nomem;
+	t->data = kmalloc(MB_TEST_MAX_MSGS * PAGE_SIZE, GFP_KERNEL);
+	if (!t->data)
+		goto out_nomem;
+	for (i = 0; i < MB_TEST_MAX_MSGS; i++) {
+		t->reqs[i] = ahash_request_alloc(tfm, GFP_KERNEL);
+		if (!t->reqs[i])
+			goto out_nomem;
+		crypto_init_wait(&t->waits[i]);
+		ahash_request_set_callback(t->reqs[i],
+					   CRYPTO_TFM_REQ_MAY_SLEEP |
+					   CRYPTO_TFM_REQ_MAY_BACKLOG,
+					   crypto_req_done, &t->waits[i]);
+	}
+	mb_test_fill(t->prefix, sizeof(t->prefix), 0);
+
+	err = test_ahash_digest_batch(driver, tfm, t);
+	if (!err && desc)
+		err = test_shash_finup_mb(driver, desc, t);
+	goto out;
+
+out_nomem:
+	pr_err("alg: hash: failed to allocate batch test buffers for %s\n",
+	       driver);
+	err = -ENOMEM;
+out:
+	if (t) {
+		for (i = 0; i < MB_TEST_MAX_MSGS; i++)
+			ahash_request_free(t->reqs[i]);
+		kfree(t->data);
+		kfree(t);
+	}
+	return err;
+}
+
 static int alloc_shash(const char *driver, u32 type, u32 mask,
 		       struct crypto_shash **tfm_ret,
 		       struct shash_desc **desc_ret)
@@ -1960,6 +2154,11 @@ static int __alg_test_hash(const struct hash_testvec *vecs,
 			goto out;
 		cond_resched();
 	}
+
+	err = test_hash_mb(driver, req, desc);
+	if (err)
+		goto out;
+
 	err = test_hash_vs_generic_impl(generic_driver, maxkeysize, req,
 					desc, tsgl, hashstate);
 out:
@@ -3233,6 +3432,194 @@ static int test_skcipher(int enc, const struct cipher_test_suite *suite,
 	return 0;
 }
 
+/*
+ * Compare crypto_skcipher_{en,de}crypt_batch() against one request at a time.
+ * The key and the message lengths are taken from the test vectors, so that
+ * every request is valid for the mode.
+ */
+struct skcipher_batch_test {
+	u8 *data;		/* ptext, single and batch output pages */
+	u8 ivs[MB_TEST_MAX_MSGS][MAX_IVLEN];
+	unsigned int lens[MB_TEST_MAX_MSGS];
+	unsigned int vec_lens[MB_TEST_MAX_MSGS];
+	unsigned int nr_vec_lens;
+	struct scatterlist src[MB_TEST_MAX_MSGS];
+	struct scatterlist dst[MB_TEST_MAX_MSGS];
+	struct skcipher_request *reqs[MB_TEST_MAX_MSGS];
+	struct crypto_wait waits[MB_TEST_MAX_MSGS];
+	int errs[MB_TEST_MAX_MSGS];
+};
+
+static u8 *skcipher_batch_buf(struct skcipher_batch_test *t, unsigned int i,
+			      unsigned int which)
+{
+	return &t->data[(3 * i + which) * PAGE_SIZE];
+}
+
+static void skcipher_batch_prep(struct skcipher_batch_test *t, unsigned int i,
+				unsigned int ivsize, unsigned int which)
+{
+	struct skcipher_request *req = t->reqs[i];
+
+	mb_test_fill(t->ivs[i], ivsize, i + 1);
+	sg_init_one(&t->dst[i], skcipher_batch_buf(t, i, which), t->lens[i]);
+	skcipher_request_set_crypt(req, &t->src[i], &t->dst[i], t->lens[i],
+				   t->ivs[i]);
+}
+
+static int test_skcipher_batch_run(const char *driver,
+				   struct skcipher_batch_test *t,
+				   unsigned int n, unsigned int ivsize)
+{
+	unsigned int i;
+	int err;
+
+	/* Reference ciphertexts, one request at a time */
+	for (i = 0; i < n; i++) {
+		mb_test_fill(skcipher_batch_buf(t, i, 0), t->lens[i], n + i);
+		sg_init_one(&t->src[i], skcipher_batch_buf(t, i, 0),
+			    t->lens[i]);
+		skcipher_batch_prep(t, i, ivsize, 1);
+		err = crypto_wait_req(crypto_skcipher_encrypt(t->reqs[i]),
+				      &t->waits[i]);
+		if (err) {
+			pr_err("alg: skcipher: %s encryption failed with err %d on batch test, len=%u\n",
+			       driver, err, t->lens[i]);
+			return err;
+		}
+	}
+
+	for (i = 0; i < n; i++)
+		skcipher_batch_prep(t, i, ivsize, 2);
+	crypto_skcipher_encrypt_batch(t->reqs, t->errs, n);
+	for (i = 0; i < n; i++) {
+		err = crypto_wait_req(t->errs[i], &t->waits[i]);
+		if (err) {
+			pr_err("alg: skcipher: %s encrypt_batch() failed with err %d on request %u of %u\n",
+			       driver, err, i, n);
+			return err;
+		}
+		if (memcmp(skcipher_batch_buf(t, i, 2),
+			   skcipher_batch_buf(t, i, 1), t->lens[i]) != 0) {
+			pr_err("alg: skcipher: %s encrypt_batch() gave wrong result on request %u of %u, len=%u\n",
+			       driver, i, n, t->lens[i]);
+			return -EINVAL;
+		}
+	}
+
+	/* And back again, in place */
+	for (i = 0; i < n; i++) {
+		skcipher_batch_prep(t, i, ivsize, 2);
+		t->reqs[i]->src = &t->dst[i];
+	}
+	crypto_skcipher_decrypt_batch(t->reqs, t->errs, n);
+	for (i = 0; i < n; i++) {
+		err = crypto_wait_req(t->errs[i], &t->waits[i]);
+		if (err) {
+			pr_err("alg: skcipher: %s decrypt_batch() failed with err %d on request %u of %u\n",
+			       driver, err, i, n);
+			return err;
+		}
+		if (memcmp(skcipher_batch_buf(t, i, 2),
+			   skcipher_batch_buf(t, i, 0), t->lens[i]) != 0) {
+			pr_err("alg: skcipher: %s decrypt_batch() gave wrong result on request %u of %u, len=%u\n",
+			       driver, i, n, t->lens[i]);
+			return -EINVAL;
+		}
+	}
+	return 0;
+}
+
+static int test_skcipher_batch(const char *driver,
+			       const struct cipher_test_suite *suite,
+			       struct crypto_skcipher *tfm)
+{
+	struct skcipher_alg *alg = crypto_skcipher_alg(tfm);
+	unsigned int ivsize = crypto_skcipher_ivsize(tfm);
+	const struct cipher_testvec *key_vec = NULL;
+	struct skcipher_batch_test *t;
+	unsigned int run, n, i;
+	int err;
+
+	/* Without batch hooks the API just loops, as covered by the vectors */
+	if (!alg->encrypt_batch && !alg->decrypt_batch)
+		return 0;
+	if (WARN_ON(ivsize > MAX_IVLEN))
+		return -EINVAL;
+
+	t = kzalloc(sizeof(*t), GFP_KERNEL);
+	if (!t)
+		goto out_nomem;
+
+	for (i = 0; i < suite->count; i++) {
+		const struct cipher_testvec *vec = &suite->vecs[i];
+
+		if ((fips_enabled && vec->fips_skip) || vec->setkey_error ||
+		    vec->crypt_error || vec->len > PAGE_SIZE)
+			continue;
+		if (!key_vec)
+			key_vec = vec;
+		if (t->nr_vec_lens < ARRAY_SIZE(t->vec_lens))
+			t->vec_lens[t->nr_vec_lens++] = vec->len;
+	}
+	if (!key_vec) {
+		err = 0;
+		goto out;
+	}
+
+	t->data = kmalloc(3 * MB_TEST_MAX_MSGS * PAGE_SIZE, GFP_KERNEL);
+	if (!t->data)
+		goto out_nomem;
+	for (i = 0; i < MB_TEST_MAX_MSGS; i++) {
+		t->reqs[i] = skcipher_request_alloc(tfm, GFP_KERNEL);
+		if (!t->reqs[i])
+			goto out_nomem;
+		crypto_init_wait(&t->waits[i]);
+		skcipher_request_set_callback(t->reqs[i],
+					      CRYPTO_TFM_REQ_MAY_SLEEP |
+					      CRYPTO_TFM_REQ_MAY_BACKLOG,
+					      crypto_req_done, &t->waits[i]);
+	}
+
+	if (key_vec->wk)
+		crypto_skcipher_set_flags(tfm, CRYPTO_TFM_REQ_FORBID_WEAK_KEYS);
+	else
+		crypto_skcipher_clear_flags(tfm,
+					    CRYPTO_TFM_REQ_FORBID_WEAK_KEYS);
+	err = crypto_skcipher_setkey(tfm, key_vec->key, key_vec->klen);
+	if (err) {
+		pr_err("alg: skcipher: %s setkey failed with err %d on batch test\n",
+		       driver, err);
+		goto out;
+	}
+
+	for (run = 1; run <= MB_TEST_MAX_MSGS; run *= 3) {
+		for (n = 1; n <= MB_TEST_MAX_MSGS; n++) {
+			for (i = 0; i < n; i++)
+				t->lens[i] = t->vec_lens[(n + i / run) %
+							 t->nr_vec_lens];
+			err = test_skcipher_batch_run(driver, t, n, ivsize);
+			if (err)
+				goto out;
+			cond_resched();
+		}
+	}
+	goto out;
+
+out_nomem:
+	pr_err("alg: skcipher: failed to allocate batch test buffers for %s\n",
+	       driver);
+	err = -ENOMEM;
+out:
+	if (t) {
+		for (i = 0; i < MB_TEST_MAX_MSGS; i++)
+			skcipher_request_free(t->reqs[i]);
+		kfree(t->data);
+		kfree(t);
+	}
+	return err;
+}
+
 static int alg_test_skcipher(const struct alg_test_desc *desc,
 			     const char *driver, u32 type, u32 mask)
 {
@@ -3279,6 +3666,10 @@ static int alg_test_skcipher(const struct alg_test_desc *desc,
 	if (err)
 		goto out;
 
+	err = test_skcipher_batch(driver, suite, tfm);
+	if (err)
+		goto out;
+
 	err = test_skcipher_vs_generic_impl(desc->generic_driver, req, tsgls);
 out:
 	free_cipher_test_sglists(tsgls);
@@ -172,5 +172,6 @@ MODULE_LICENSE("GPL");
 core_initcall(register_xor_blocks);
 #endif
 
-module_init(calibrate_xor_blocks);
+/* the benchmark only replaces the template registered above */
+device_initcall_parallel(calibrate_xor_blocks);
 module_exit(xor_exit);
@@ -504,6 +504,8 @@ static void dma_chan_put(struct dma_chan *chan)
 		/* Make sure all operations have completed */
 		dmaengine_synchronize(chan);
 		chan->device->device_free_chan_resources(chan);
+		chan->callback_batch = NULL;
+		chan->callback_batch_param = NULL;
 	}
 
 	/* If the channel is used via a DMA request router, free the mapping */
@@ -88,6 +88,11 @@ static bool polled;
 module_param(polled, bool, 0644);
 MODULE_PARM_DESC(polled, "Use polling for completion instead of interrupts");
 
+static unsigned int max_inflight;
+module_param(max_inflight, uint, 0644);
+MODULE_PARM_DESC(max_inflight,
+		"Throughput mode: descriptors in flight per thread, no verification (default: 0, off)");
+
 /**
  * struct dmatest_params - test parameters.
  * @buf_size:		size of the memcpy test buffer
@@ -104,6 +109,7 @@ MODULE_PARM_DESC(polled, "Use polling for completion instead of interrupts");
  * @alignment:		custom data address alignment taken as 2^alignment
  * @transfer_size:	custom transfer size in bytes
  * @polled:		use polling for completion instead of interrupts
+ * @max_inflight:	throughput mode, number of descriptors kept in flight
  */
 struct dmatest_params {
 	unsigned int	buf_size;
@@ -120,6 +126,7 @@ struct dmatest_params {
 	int		alignment;
 	unsigned int	transfer_size;
 	bool		polled;
+	unsigned int	max_inflight;
 };
 
 /**
@@ -219,6 +226,15 @@ struct dmatest_data {
 	unsigned int	off;
 };
 
+/* one outstanding descriptor in throughput mode */
+struct dmatest_inflight {
+	struct dmatest_thread	*thread;
+	dma_cookie_t		cookie;
+	ktime_t			submitted;
+	ktime_t			completed;
+	enum dmaengine_tx_result result;
+};
+
 struct dmatest_thread {
 	struct list_head	node;
 	struct dmatest_info	*info;
@@ -231,6 +247,9 @@ struct dmatest_thread {
 	struct dmatest_done test_done;
 	bool			done;
 	bool			pending;
+	struct dmatest_inflight	*inflight;
+	unsigned int		nr_inflight;
+	atomic_t		inflight_done;
 };
 
 struct dmatest_chan {
@@ -444,6 +463,42 @@ static void dmatest_callback(void *arg)
 	}
 }
 
+static void dmatest_inflight_complete(struct dmatest_inflight *slot,
+				      const struct dmaengine_result *res)
+{
+	struct dmatest_thread *thread = slot->thread;
+
+	slot->completed = ktime_get();
+	slot->result = res->result;
+	if (atomic_inc_return(&thread->inflight_done) ==
+	    READ_ONCE(thread->nr_inflight))
+		wake_up_all(&thread->done_wait);
+}
+
+static void dmatest_inflight_callback(void *arg,
+				      const struct dmaengine_result *res)
+{
+	dmatest_inflight_complete(arg, res);
+}
+
+static void dmatest_batch_callback(void *arg,
+				   const struct dmaengine_batch_result *res,
+				   unsigned int count)
+{
+	struct dmatest_thread *thread = arg;
+	unsigned int i, j;
+
+	for (i = 0; i < count; i++) {
+		for (j = 0; j < READ_ONCE(thread->nr_inflight); j++) {
+			if (thread->inflight[j].cookie == res[i].cookie) {
+				dmatest_inflight_complete(&thread->inflight[j],
+							  &res[i].result);
+				break;
+			}
+		}
+	}
+}
+
 static unsigned int min_odd(unsigned int x, unsigned int y)
 {
 	unsigned int val = min(x, y);
@@ -503,6 +558,145 @@ static unsigned long long dmatest_KBs(s64 runtime, unsigned long long len)
 	return FIXPT_TO_INT(dmatest_persec(runtime, len >> 10));
 }
 
+/*
+ * Throughput mode: keep params->max_inflight memcpy or memset descriptors
+ * in flight, without data verification, and record how long each one takes
+ * from submission to its completion being reported. Completions are
+ * collected through the channel's batch callback when the driver supports
+ * it and the channel is not shared with other test threads.
+ */
+static int dmatest_throughput(struct dmatest_thread *thread, unsigned int len,
+			      enum dma_ctrl_flags flags,
+			      unsigned int *total_tests,
+			      unsigned int *failed_tests,
+			      unsigned long long *total_len)
+{
+	struct dmatest_params *params = &thread->info->params;
+	struct dma_chan *chan = thread->chan;
+	struct dma_device *dev = chan->device;
+	struct device *dma_dev = dmaengine_get_dma_device(chan);
+	u64 lat_total = 0, lat_max = 0, nr_lat = 0;
+	dma_addr_t src_dma, dst_dma;
+	bool batch = false;
+	unsigned int i;
+	int ret;
+
+	thread->inflight = kcalloc(params->max_inflight,
+				   sizeof(*thread->inflight), GFP_KERNEL);
+	if (!thread->inflight)
+		return -ENOMEM;
+
+	src_dma = dma_map_single(dma_dev, thread->src.aligned[0], len,
+				 DMA_TO_DEVICE);
+	ret = dma_mapping_error(dma_dev, src_dma);
+	if (ret)
+		goto err_free;
+
+	dst_dma = dma_map_single(dma_dev, thread->dst.aligned[0], len,
+				 DMA_FROM_DEVICE);
+	ret = dma_mapping_error(dma_dev, dst_dma);
+	if (ret)
+		goto err_unmap_src;
+
+	if (params->threads_per_chan == 1)
+		batch = !dmaengine_set_batch_callback(chan,
+					dmatest_batch_callback, thread);
+
+	while (!(kthread_should_stop() ||
+	       (params->iterations && *total_tests >= params->iterations))) {
+		unsigned int nr = params->max_inflight;
+
+		if (params->iterations)
+			nr = min(nr, params->iterations - *total_tests);
+
+		atomic_set(&thread->inflight_done, 0);
+		WRITE_ONCE(thread->nr_inflight, nr);
+		for (i = 0; i < nr; i++) {
+			struct dmatest_inflight *slot = &thread->inflight[i];
+			struct dma_async_tx_descriptor *tx;
+
+			if (thread->type == DMA_MEMCPY)
+				tx = dev->device_prep_dma_memcpy(chan, dst_dma,
+								 src_dma, len,
+								 flags);
+			else
+				tx = dev->device_prep_dma_memset(chan, dst_dma,
+						*thread->src.aligned[0], len,
+						flags);
+			if (!tx)
+				break;
+
+			slot->thread = thread;
+			slot->completed = 0;
+			if (!batch) {
+				tx->callback_result = dmatest_inflight_callback;
+				tx->callback_param = slot;
+			}
+
+			slot->submitted = ktime_get();
+			slot->cookie = dmaengine_submit(tx);
+			if (dma_submit_error(slot->cookie))
+				break;
+		}
+		WRITE_ONCE(thread->nr_inflight, i);
+		*total_tests += nr;
+
+		if (!i) {
+			result("prep error", *total_tests, 0, 0, len, 0);
+			*failed_tests += nr;
+			msleep(100);
+			continue;
+		}
+
+		dma_async_issue_pending(chan);
+
+		wait_event_freezable_timeout(thread->done_wait,
+				atomic_read(&thread->inflight_done) == i,
+				msecs_to_jiffies(params->timeout));
+
+		if (atomic_read(&thread->inflight_done) != i) {
+			result("test timed out", *total_tests, 0, 0, len, 0);
+			dmaengine_terminate_sync(chan);
+			*failed_tests += nr;
+			break;
+		}
+
+		*failed_tests += nr - i;
+		for (i = 0; i < thread->nr_inflight; i++) {
+			struct dmatest_inflight *slot = &thread->inflight[i];
+			u64 lat;
+
+			if (slot->result != DMA_TRANS_NOERROR) {
+				(*failed_tests)++;
+				continue;
+			}
+
+			lat = ktime_to_ns(ktime_sub(slot->completed,
+						    slot->submitted));
+			lat_total += lat;
+			lat_max = max(lat_max, lat);
+			nr_lat++;
+			*total_len += len;
+		}
+	}
+
+	if (batch)
+		dmaengine_set_batch_callback(chan, NULL, NULL);
+
+	if (nr_lat)
+		pr_info("%s: %s completion latency avg %llu ns max %llu ns over %llu descriptors\n",
+			current->comm, batch ? "batched" : "per-descriptor",
+			div64_u64(lat_total, nr_lat), lat_max, nr_lat);
+
+	dma_unmap_single(dma_dev, dst_dma, len, DMA_FROM_DEVICE);
+err_unmap_src:
+	dma_unmap_single(dma_dev, src_dma, len, DMA_TO_DEVICE);
+err_free:
+	kfree(thread->inflight);
+	thread->inflight = NULL;
+	return ret;
+}
+
 static void __dmatest_free_test_data(struct dmatest_data *d, unsigned int cnt)
 {
 	unsigned int i;
@@ -679,6 +873,19 @@ static int dmatest_func(void *data)
 	else
 		flags = DMA_CTRL_ACK | DMA_PREP_INTERRUPT;
 
+	if (params->max_inflight &&
+	    (thread->type == DMA_MEMCPY || thread->type == DMA_MEMSET)) {
+		unsigned int len = params->transfer_size ?: buf_size;
+
+		len = (len >> align) << align;
+		ktime = ktime_get();
+		ret = dmatest_throughput(thread, len ?: 1 << align, flags,
+					 &total_tests, &failed_tests,
+					 &total_len);
+		runtime = ktime_to_us(ktime_sub(ktime_get(), ktime));
+		goto err_pq_array;
+	}
+
 	ktime = ktime_get();
 	while (!(kthread_should_stop() ||
 	       (params->iterations && total_tests >= params->iterations))) {
@@ -905,6 +1112,7 @@ static int dmatest_func(void *data)
 	runtime = ktime_to_us(ktime);
 
 	ret = 0;
+err_pq_array:
 	kfree(dma_pq);
 err_srcs_array:
 	kfree(srcs);
@@ -1026,6 +1234,11 @@ static int dmatest_add_channel(struct dmatest_info *info,
 		pr_warn("DMA_COMPLETION_NO_ORDER, polled disabled\n");
 	}
 
+	if (info->params.max_inflight && info->params.polled) {
+		info->params.polled = false;
+		pr_warn("throughput mode needs completion callbacks, polled disabled\n");
+	}
+
 	if (dma_has_cap(DMA_MEMCPY, dma_dev->cap_mask)) {
 		if (dmatest == 0) {
 			cnt = dmatest_add_threads(info, dtc, DMA_MEMCPY);
@@ -1107,6 +1320,7 @@ static void add_threaded_test(struct dmatest_info *info)
 	params->alignment = alignment;
 	params->transfer_size = transfer_size;
 	params->polled = polled;
+	params->max_inflight = max_inflight;
 
 	request_channels(info, DMA_MEMCPY);
 	request_channels(info, DMA_MEMSET);
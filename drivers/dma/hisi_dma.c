@@ -72,6 +72,8 @@
 
 #define HISI_DMA_Q_OFFSET			0x100
 #define HISI_DMA_Q_DEPTH_VAL			1024
+/* completed memcpy descriptors kept per channel for the prep path */
+#define HISI_DMA_DESC_POOL_MAX			64
 
 #define PCI_BAR_2				2
 
@@ -483,11 +485,18 @@ hisi_dma_prep_dma_memcpy(struct dma_chan *c, dma_addr_t dst, dma_addr_t src,
 			 size_t len, unsigned long flags)
 {
 	struct hisi_dma_chan *chan = to_hisi_dma_chan(c);
+	struct virt_dma_desc *vd;
 	struct hisi_dma_desc *desc;
 
-	desc = kzalloc(sizeof(*desc), GFP_NOWAIT);
-	if (!desc)
-		return NULL;
+	vd = vchan_desc_pool_get(&chan->vc);
+	if (vd) {
+		desc = to_hisi_dma_desc(vd);
+		memset(desc, 0, sizeof(*desc));
+	} else {
+		desc = kzalloc(sizeof(*desc), GFP_NOWAIT);
+		if (!desc)
+			return NULL;
+	}
 
 	desc->sqe.length = cpu_to_le32(len);
 	desc->sqe.src_addr = cpu_to_le64(src);
@@ -710,6 +719,8 @@ static void hisi_dma_enable_qps(struct hisi_dma_dev *hdma_dev)
 		hdma_dev->chan[i].hdma_dev = hdma_dev;
 		hdma_dev->chan[i].vc.desc_free = hisi_dma_desc_free;
 		vchan_init(&hdma_dev->chan[i].vc, &hdma_dev->dma_dev);
+		vchan_desc_pool_init(&hdma_dev->chan[i].vc,
+				     HISI_DMA_DESC_POOL_MAX);
 		hisi_dma_enable_qp(hdma_dev, i);
 	}
 }
@@ -76,15 +76,26 @@ struct virt_dma_desc *vchan_find_desc(struct virt_dma_chan *vc,
 }
 EXPORT_SYMBOL_GPL(vchan_find_desc);
 
+/* Number of results handed to a batch callback in one go */
+#define VCHAN_BATCH_MAX		16
+
 /*
  * This tasklet handles the completion of a DMA descriptor by
  * calling its callback and freeing it.
+ *
+ * If the client registered a batch callback, descriptors without a
+ * callback of their own are reported through it, up to VCHAN_BATCH_MAX
+ * at a time. The pending batch is flushed before any per-descriptor
+ * callback runs so that clients observe completions in order.
  */
 static void vchan_complete(struct tasklet_struct *t)
 {
 	struct virt_dma_chan *vc = from_tasklet(vc, t, task);
+	struct dmaengine_batch_result batch[VCHAN_BATCH_MAX];
+	dma_async_tx_callback_batch batch_cb;
 	struct virt_dma_desc *vd, *_vd;
 	struct dmaengine_desc_callback cb;
+	unsigned int nr = 0;
 	LIST_HEAD(head);
 
 	spin_lock_irq(&vc->lock);
@@ -100,12 +111,52 @@ static void vchan_complete(struct tasklet_struct *t)
 
 	dmaengine_desc_callback_invoke(&cb, &vd->tx_result);
 
-	list_for_each_entry_safe(vd, _vd, &head, node) {
+	/* pairs with WRITE_ONCE() in dmaengine_set_batch_callback() */
+	batch_cb = READ_ONCE(vc->chan.callback_batch);
+
+	list_for_each_entry(vd, &head, node) {
 		dmaengine_desc_get_callback(&vd->tx, &cb);
 
-		list_del(&vd->node);
+		if (batch_cb && !dmaengine_desc_callback_valid(&cb)) {
+			batch[nr].cookie = vd->tx.cookie;
+			batch[nr].result = vd->tx_result;
+			if (++nr == VCHAN_BATCH_MAX) {
+				batch_cb(vc->chan.callback_batch_param,
+					 batch, nr);
+				nr = 0;
+			}
+			continue;
+		}
+
+		if (nr) {
+			batch_cb(vc->chan.callback_batch_param, batch, nr);
+			nr = 0;
+		}
 		dmaengine_desc_callback_invoke(&cb, &vd->tx_result);
-		vchan_vdesc_fini(vd);
+	}
+
+	if (nr)
+		batch_cb(vc->chan.callback_batch_param, batch, nr);
+
+	/*
+	 * vc.lock is not held here, so park all reusable descriptors, and
+	 * refill the descriptor pool, under a single acquisition instead of
+	 * taking it once per descriptor.
+	 */
+	spin_lock_irq(&vc->lock);
+	list_for_each_entry_safe(vd, _vd, &head, node) {
+		if (dmaengine_desc_test_reuse(&vd->tx)) {
+			list_move(&vd->node, &vc->desc_allocated);
+		} else if (vc->desc_pool_len < vc->desc_pool_max) {
+			list_move(&vd->node, &vc->desc_pool);
+			vc->desc_pool_len++;
+		}
+	}
+	spin_unlock_irq(&vc->lock);
+
+	list_for_each_entry_safe(vd, _vd, &head, node) {
+		list_del(&vd->node);
+		vc->desc_free(vd);
 	}
 }
 
@@ -130,10 +181,14 @@ void vchan_init(struct virt_dma_chan *vc, struct dma_device *dmadev)
 	INIT_LIST_HEAD(&vc->desc_issued);
 	INIT_LIST_HEAD(&vc->desc_completed);
 	INIT_LIST_HEAD(&vc->desc_terminated);
+	INIT_LIST_HEAD(&vc->desc_pool);
+	vc->desc_pool_len = 0;
+	vc->desc_pool_max = 0;
 
 	tasklet_setup(&vc->task, vchan_complete);
 
 	vc->chan.device = dmadev;
+	dmadev->completion_batch = true;
 	list_add_tail(&vc->chan.device_node, &dmadev->channels);
 }
 EXPORT_SYMBOL_GPL(vchan_init);
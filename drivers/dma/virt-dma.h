@@ -32,6 +32,9 @@ struct virt_dma_chan {
 	struct list_head desc_issued;
 	struct list_head desc_completed;
 	struct list_head desc_terminated;
+	struct list_head desc_pool;
+	unsigned int desc_pool_len;
+	unsigned int desc_pool_max;
 
 	struct virt_dma_desc *cyclic;
 };
@@ -124,6 +127,53 @@ static inline void vchan_vdesc_fini(struct virt_dma_desc *vd)
 	}
 }
 
+/**
+ * vchan_desc_pool_init - enable recycling of completed descriptors
+ * @vc: virtual channel to configure
+ * @max: maximum number of descriptors kept around, 0 disables the pool
+ *
+ * Completed descriptors that are not marked for reuse are parked in a
+ * per-channel pool instead of being handed to desc_free, so that the prep
+ * callbacks can pick them up again with vchan_desc_pool_get(). Only
+ * drivers whose descriptors are interchangeable (fixed size, no per
+ * transfer resources left attached) should enable this. The pool is
+ * emptied by vchan_free_chan_resources().
+ */
+static inline void vchan_desc_pool_init(struct virt_dma_chan *vc,
+	unsigned int max)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&vc->lock, flags);
+	vc->desc_pool_max = max;
+	spin_unlock_irqrestore(&vc->lock, flags);
+}
+
+/**
+ * vchan_desc_pool_get - take a descriptor from the channel's pool
+ * @vc: virtual channel to obtain the descriptor from
+ *
+ * Returns a previously completed descriptor, or NULL if the pool is empty
+ * in which case the caller allocates a new one. The descriptor must be
+ * prepared again with vchan_tx_prep().
+ */
+static inline struct virt_dma_desc *vchan_desc_pool_get(struct virt_dma_chan *vc)
+{
+	struct virt_dma_desc *vd;
+	unsigned long flags;
+
+	spin_lock_irqsave(&vc->lock, flags);
+	vd = list_first_entry_or_null(&vc->desc_pool, struct virt_dma_desc,
+				      node);
+	if (vd) {
+		list_del(&vd->node);
+		vc->desc_pool_len--;
+	}
+	spin_unlock_irqrestore(&vc->lock, flags);
+
+	return vd;
+}
+
 /**
  * vchan_cyclic_callback - report the completion of a period
  * @vd: virtual descriptor
@@ -194,6 +244,8 @@ static inline void vchan_free_chan_resources(struct virt_dma_chan *vc)
 	vchan_get_all_descriptors(vc, &head);
 	list_for_each_entry(vd, &head, node)
 		dmaengine_desc_clear_reuse(&vd->tx);
+	list_splice_tail_init(&vc->desc_pool, &head);
+	vc->desc_pool_len = 0;
 	spin_unlock_irqrestore(&vc->lock, flags);
 
 	vchan_dma_desc_free_list(vc, &head);
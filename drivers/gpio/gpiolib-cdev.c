@@ -15,9 +15,12 @@
 #include <linux/gpio/driver.h>
 #include <linux/hte.h>
 #include <linux/interrupt.h>
+#include <linux/irq.h>
 #include <linux/irqreturn.h>
 #include <linux/kernel.h>
 #include <linux/kfifo.h>
+#include <linux/log2.h>
+#include <linux/mm.h>
 #include <linux/module.h>
 #include <linux/mutex.h>
 #include <linux/pinctrl/consumer.h>
@@ -27,6 +30,7 @@
 #include <linux/spinlock.h>
 #include <linux/timekeeping.h>
 #include <linux/uaccess.h>
+#include <linux/vmalloc.h>
 #include <linux/workqueue.h>
 
 #include <uapi/linux/gpio.h>
@@ -469,16 +473,57 @@ static int linehandle_create(struct gpio_device *gdev, void __user *ip)
 }
 #endif /* CONFIG_GPIO_CDEV_V1 */
 
+/*
+ * The number of hardirq timestamps that may be queued for an IRQ thread.
+ * Must be a power of two.
+ */
+#define LINE_TS_BATCH	8
+
+/**
+ * struct line_ts - a timestamp captured in hardirq context
+ * @timestamp_ns: the time of the edge
+ * @req_seqno: the seqno drawn from the line request for the edge
+ * @drops: the number of edges dropped on the line before this one
+ */
+struct line_ts {
+	u64 timestamp_ns;
+	u32 req_seqno;
+	u32 drops;
+};
+
+/*
+ * Returns the level after the edge in slot @idx of a batch ending at @head,
+ * for a line with both edges enabled.  @level and @drops are read by the
+ * IRQ thread after it acquired @head.  Consecutive edges alternate, so the
+ * level is derived from @level only if no edge was dropped after this one;
+ * otherwise the level read by the thread is reported as is.
+ */
+static int line_ts_level(const struct line_ts *ts, unsigned int idx,
+			 unsigned int head, u32 drops, int level)
+{
+	if (ts->drops != drops)
+		return level;
+
+	return level ^ ((head - 1 - idx) & 1);
+}
+
 /**
  * struct line - contains the state of a requested line
  * @node: to store the object in supinfo_tree if supplemental
  * @desc: the GPIO descriptor for this line.
  * @req: the corresponding line request
  * @irq: the interrupt triggered in response to events on this GPIO
+ * @irq_nested: @irq is a nested threaded interrupt, so edge_irq_handler()
+ * never runs and edge_irq_thread() is called once per edge
  * @eflags: the edge flags, GPIO_V2_LINE_FLAG_EDGE_RISING and/or
  * GPIO_V2_LINE_FLAG_EDGE_FALLING, indicating the edge detection applied
- * @timestamp_ns: cache for the timestamp storing it between hardirq and
- * IRQ thread, used to bring the timestamp close to the actual event
+ * @timestamp_ns: cache for the HTE timestamp storing it between the HTE
+ * callbacks
+ * @ts_batch: timestamps captured by the hardirq handler and not yet turned
+ * into events by the IRQ thread
+ * @ts_head: index of the next free slot in @ts_batch
+ * @ts_tail: index of the oldest pending slot in @ts_batch
+ * @ts_drops: the number of edges dropped because @ts_batch was full
  * @req_seqno: the seqno for the current edge event in the sequence of
  * events for the corresponding line request. This is drawn from the @req.
  * @line_seqno: the seqno for the current edge event in the sequence of
@@ -500,6 +545,7 @@ struct line {
 	 */
 	struct linereq *req;
 	unsigned int irq;
+	bool irq_nested;
 	/*
 	 * The flags for the active edge detector configuration.
 	 *
@@ -511,12 +557,23 @@ struct line {
 	 */
 	u64 edflags;
 	/*
-	 * timestamp_ns and req_seqno are accessed only by
-	 * edge_irq_handler() and edge_irq_thread(), which are themselves
-	 * mutually exclusive, so no additional protection is necessary.
+	 * timestamp_ns and req_seqno are accessed only by process_hw_ts()
+	 * and process_hw_ts_thread(), or by edge_irq_thread() for nested
+	 * interrupts, which are mutually exclusive, so no additional
+	 * protection is necessary.
 	 */
 	u64 timestamp_ns;
 	u32 req_seqno;
+	/*
+	 * ts_batch is a single producer, single consumer ring.
+	 * edge_irq_handler() is the only writer of ts_head and ts_drops and
+	 * edge_irq_thread() the only writer of ts_tail, and the two may run
+	 * concurrently, so the indices are published with release semantics.
+	 */
+	struct line_ts ts_batch[LINE_TS_BATCH];
+	unsigned int ts_head;
+	unsigned int ts_tail;
+	u32 ts_drops;
 	/*
 	 * line_seqno is accessed by either edge_irq_thread() or
 	 * debounce_work_func(), which are themselves mutually exclusive,
@@ -587,6 +644,11 @@ static DEFINE_SPINLOCK(supinfo_lock);
  * @wait: wait queue that handles blocking reads of events
  * @event_buffer_size: the number of elements allocated in @events
  * @events: KFIFO for the GPIO events
+ * @ring: the mmap()ed event ring, or NULL if events are queued in @events
+ * @ring_events: the event slots of @ring
+ * @ring_mask: the number of slots in @ring_events, minus one
+ * @ring_head: the kernel copy of the @ring producer index
+ * @ring_polled: @ring_head when poll() last reported the ring readable
  * @seqno: the sequence number for edge events generated on all lines in
  * this line request.  Note that this is not used when @num_lines is 1, as
  * the line_seqno is then the same and is cheaper to calculate.
@@ -602,6 +664,16 @@ struct linereq {
 	wait_queue_head_t wait;
 	u32 event_buffer_size;
 	DECLARE_KFIFO_PTR(events, struct gpio_v2_line_event);
+	/*
+	 * The ring fields are set once by linereq_mmap() and are otherwise
+	 * only accessed with wait.lock held.  The ring is mapped read-only,
+	 * so nothing is ever read back from it.
+	 */
+	struct gpio_v2_line_event_ring *ring;
+	struct gpio_v2_line_event *ring_events;
+	u32 ring_mask;
+	u32 ring_head;
+	u32 ring_polled;
 	atomic_t seqno;
 	struct mutex config_mutex;
 	struct line lines[];
@@ -738,22 +810,62 @@ static void line_set_debounce_period(struct line *line,
 	 GPIO_V2_LINE_FLAG_EVENT_CLOCK_HTE | \
 	 GPIO_V2_LINE_EDGE_FLAGS)
 
+/* Called with lr->wait.lock held. */
+static inline bool linereq_ring_pending(struct linereq *lr)
+{
+	return lr->ring_head != lr->ring_polled;
+}
+
+/*
+ * Called with lr->wait.lock held.  The reader's tail is not known to the
+ * kernel, so like the kfifo the ring overwrites the oldest event when the
+ * reader falls behind.  head_reserved is published before the slot is
+ * written so that the reader can tell a slot it copied was overwritten.
+ */
+static void linereq_ring_put(struct linereq *lr,
+			     struct gpio_v2_line_event *le)
+{
+	struct gpio_v2_line_event_ring *ring = lr->ring;
+	u32 head = lr->ring_head;
+
+	WRITE_ONCE(ring->head_reserved, head + 1);
+	/* pairs with the userspace read barrier before head_reserved */
+	smp_wmb();
+	lr->ring_events[head & lr->ring_mask] = *le;
+	lr->ring_head = ++head;
+	/* pairs with the userspace acquire of head before reading slots */
+	smp_store_release(&ring->head, head);
+}
+
 static void linereq_put_event(struct linereq *lr,
 			      struct gpio_v2_line_event *le)
 {
 	bool overflow = false;
+	bool wake = true;
 
 	spin_lock(&lr->wait.lock);
-	if (kfifo_is_full(&lr->events)) {
-		overflow = true;
-		kfifo_skip(&lr->events);
+	if (lr->ring) {
+		/*
+		 * Only wake the reader for the first event since poll() last
+		 * reported the ring readable, it drains everything up to head
+		 * once woken.
+		 */
+		wake = !linereq_ring_pending(lr);
+		linereq_ring_put(lr, le);
+	} else {
+		if (kfifo_is_full(&lr->events)) {
+			overflow = true;
+			kfifo_skip(&lr->events);
+		}
+		kfifo_in(&lr->events, le, 1);
 	}
-	kfifo_in(&lr->events, le, 1);
 	spin_unlock(&lr->wait.lock);
-	if (!overflow)
-		wake_up_poll(&lr->wait, EPOLLIN);
-	else
+	if (!overflow) {
+		if (wake)
+			wake_up_poll(&lr->wait, EPOLLIN);
+	} else {
 		pr_debug_ratelimited("event FIFO is full - event dropped\n");
+	}
 }
 
 static u64 line_event_timestamp(struct line *line)
@@ -894,48 +1006,88 @@ static int hte_edge_setup(struct line *line, u64 eflags)
 }
 #endif /* CONFIG_HTE */
 
-static irqreturn_t edge_irq_thread(int irq, void *p)
+static void line_put_edge_event(struct line *line, u64 timestamp_ns,
+				u32 req_seqno, int level)
 {
-	struct line *line = p;
 	struct linereq *lr = line->req;
 	struct gpio_v2_line_event le;
 
 	/* Do not leak kernel stack to userspace */
 	memset(&le, 0, sizeof(le));
 
-	if (line->timestamp_ns) {
-		le.timestamp_ns = line->timestamp_ns;
-	} else {
-		/*
-		 * We may be running from a nested threaded interrupt in
-		 * which case we didn't get the timestamp from
-		 * edge_irq_handler().
-		 */
-		le.timestamp_ns = line_event_timestamp(line);
-		if (lr->num_lines != 1)
-			line->req_seqno = atomic_inc_return(&lr->seqno);
-	}
-	line->timestamp_ns = 0;
+	le.timestamp_ns = timestamp_ns;
+	le.id = line_event_id(level);
+	line->line_seqno++;
+	le.line_seqno = line->line_seqno;
+	le.seqno = (lr->num_lines == 1) ? le.line_seqno : req_seqno;
+	le.offset = gpio_chip_hwgpio(line->desc);
 
-	switch (READ_ONCE(line->edflags) & GPIO_V2_LINE_EDGE_FLAGS) {
+	linereq_put_event(lr, &le);
+}
+
+static int line_edge_level(struct line *line, u64 eflags)
+{
+	switch (eflags) {
 	case GPIO_V2_LINE_FLAG_EDGE_BOTH:
-		le.id = line_event_id(gpiod_get_value_cansleep(line->desc));
-		break;
+		return gpiod_get_value_cansleep(line->desc);
 	case GPIO_V2_LINE_FLAG_EDGE_RISING:
-		le.id = GPIO_V2_LINE_EVENT_RISING_EDGE;
-		break;
-	case GPIO_V2_LINE_FLAG_EDGE_FALLING:
-		le.id = GPIO_V2_LINE_EVENT_FALLING_EDGE;
-		break;
+		return 1;
 	default:
+		return 0;
+	}
+}
+
+static irqreturn_t edge_irq_thread(int irq, void *p)
+{
+	struct line *line = p;
+	struct linereq *lr = line->req;
+	unsigned int head, tail;
+	struct line_ts *ts;
+	u64 eflags;
+	int level;
+	u32 drops;
+
+	eflags = READ_ONCE(line->edflags) & GPIO_V2_LINE_EDGE_FLAGS;
+	if (!eflags)
 		return IRQ_NONE;
+
+	/*
+	 * A nested threaded interrupt bypasses edge_irq_handler(), so the
+	 * thread runs once per edge and takes the timestamp itself.
+	 */
+	if (line->irq_nested) {
+		if (lr->num_lines != 1)
+			line->req_seqno = atomic_inc_return(&lr->seqno);
+		line_put_edge_event(line, line_event_timestamp(line),
+				    line->req_seqno,
+				    line_edge_level(line, eflags));
+		return IRQ_HANDLED;
 	}
-	line->line_seqno++;
-	le.line_seqno = line->line_seqno;
-	le.seqno = (lr->num_lines == 1) ? le.line_seqno : line->req_seqno;
-	le.offset = gpio_chip_hwgpio(line->desc);
 
-	linereq_put_event(lr, &le);
+	/* pairs with the release in edge_irq_handler() */
+	head = smp_load_acquire(&line->ts_head);
+	tail = line->ts_tail;
+
+	/*
+	 * Edge interrupts are not masked while the thread runs, so it may be
+	 * woken again for edges it has already drained.
+	 */
+	if (head == tail)
+		return IRQ_HANDLED;
+
+	/* The level is read after head so that it follows every batched edge. */
+	level = line_edge_level(line, eflags);
+	drops = READ_ONCE(line->ts_drops);
+
+	for (; tail != head; tail++) {
+		ts = &line->ts_batch[tail % LINE_TS_BATCH];
+		line_put_edge_event(line, ts->timestamp_ns, ts->req_seqno,
+				    (eflags == GPIO_V2_LINE_FLAG_EDGE_BOTH) ?
+				    line_ts_level(ts, tail, head, drops, level) :
+				    level);
+		/* pairs with the acquire in edge_irq_handler() */
+		smp_store_release(&line->ts_tail, tail + 1);
+	}
 
 	return IRQ_HANDLED;
 }
@@ -944,15 +1096,34 @@ static irqreturn_t edge_irq_handler(int irq, void *p)
 {
 	struct line *line = p;
 	struct linereq *lr = line->req;
+	unsigned int head = line->ts_head;
+	struct line_ts *ts;
+
+	/*
+	 * The thread has fallen LINE_TS_BATCH edges behind, so drop this
+	 * one rather than overwrite a slot it may be reading.  The thread
+	 * has yet to drain the full batch, so it need not be woken.
+	 */
+	if (head - smp_load_acquire(&line->ts_tail) >= LINE_TS_BATCH) {
+		WRITE_ONCE(line->ts_drops, line->ts_drops + 1);
+		pr_debug_ratelimited("timestamp batch is full - event dropped\n");
+		return IRQ_HANDLED;
+	}
 
 	/*
 	 * Just store the timestamp in hardirq context so we get it as
 	 * close in time as possible to the actual event.
 	 */
-	line->timestamp_ns = line_event_timestamp(line);
+	ts = &line->ts_batch[head % LINE_TS_BATCH];
+	ts->timestamp_ns = line_event_timestamp(line);
+	ts->req_seqno = 0;
+	ts->drops = line->ts_drops;
 
 	if (lr->num_lines != 1)
-		line->req_seqno = atomic_inc_return(&lr->seqno);
+		ts->req_seqno = atomic_inc_return(&lr->seqno);
+
+	/* pairs with the acquire in edge_irq_thread() */
+	smp_store_release(&line->ts_head, head + 1);
 
 	return IRQ_WAKE_THREAD;
 }
@@ -1190,6 +1361,15 @@ static int edge_detector_setup(struct line *line,
 		irqflags |= test_bit(FLAG_ACTIVE_LOW, &line->desc->flags) ?
 			IRQF_TRIGGER_RISING : IRQF_TRIGGER_FALLING;
 	irqflags |= IRQF_ONESHOT;
+	/*
+	 * The edge flow handler does not mask oneshot interrupts, so edges
+	 * arriving while edge_irq_thread() is still emitting events are
+	 * timestamped by edge_irq_handler() and batched rather than lost.
+	 */
+	line->ts_head = 0;
+	line->ts_tail = 0;
+	line->ts_drops = 0;
+	line->irq_nested = irq_check_status_bit(irq, IRQ_NESTED_THREAD);
 
 	/* Request a thread to read the events */
 	ret = request_threaded_irq(irq, edge_irq_handler, edge_irq_thread,
@@ -1625,9 +1805,17 @@ static __poll_t linereq_poll_unlocked(struct file *file,
 
 	poll_wait(file, &lr->wait, wait);
 
-	if (!kfifo_is_empty_spinlocked_noirqsave(&lr->events,
-						 &lr->wait.lock))
+	if (READ_ONCE(lr->ring)) {
+		spin_lock(&lr->wait.lock);
+		if (linereq_ring_pending(lr)) {
+			events = EPOLLIN | EPOLLRDNORM;
+			lr->ring_polled = lr->ring_head;
+		}
+		spin_unlock(&lr->wait.lock);
+	} else if (!kfifo_is_empty_spinlocked_noirqsave(&lr->events,
+							&lr->wait.lock)) {
 		events = EPOLLIN | EPOLLRDNORM;
+	}
 
 	return events;
 }
@@ -1654,6 +1842,10 @@ static ssize_t linereq_read_unlocked(struct file *file, char __user *buf,
 	if (count < sizeof(le))
 		return -EINVAL;
 
+	/* events are delivered through the ring once it is mapped */
+	if (READ_ONCE(lr->ring))
+		return -EBUSY;
+
 	do {
 		spin_lock(&lr->wait.lock);
 		if (kfifo_is_empty(&lr->events)) {
@@ -1704,6 +1896,73 @@ static ssize_t linereq_read(struct file *file, char __user *buf,
 				linereq_read_unlocked);
 }
 
+static int linereq_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct linereq *lr = file->private_data;
+	struct gpio_v2_line_event_ring *ring;
+	unsigned long size = vma->vm_end - vma->vm_start;
+	unsigned long num_events;
+	int ret;
+
+	if (!lr->gdev->chip)
+		return -ENODEV;
+
+	if (vma->vm_pgoff || size <= PAGE_SIZE)
+		return -EINVAL;
+
+	/* the ring is written only by the kernel and must be seen by it */
+	if (!(vma->vm_flags & VM_SHARED) || (vma->vm_flags & VM_WRITE))
+		return -EINVAL;
+	vma->vm_flags &= ~VM_MAYWRITE;
+
+	num_events = (size - PAGE_SIZE) / sizeof(struct gpio_v2_line_event);
+	if (!is_power_of_2(num_events) ||
+	    num_events > GPIO_V2_LINES_MAX * 1024)
+		return -EINVAL;
+
+	mutex_lock(&lr->config_mutex);
+
+	if (lr->ring) {
+		ret = -EBUSY;
+		goto out_unlock;
+	}
+
+	ring = vmalloc_user(size);
+	if (!ring) {
+		ret = -ENOMEM;
+		goto out_unlock;
+	}
+
+	ring->num_events = num_events;
+	ring->events_offset = PAGE_SIZE;
+
+	ret = remap_vmalloc_range(vma, ring, 0);
+	if (ret) {
+		vfree(ring);
+		goto out_unlock;
+	}
+
+	/*
+	 * Switch event delivery over to the ring.  Events already queued in
+	 * the kfifo are discarded as read() is no longer available to
+	 * return them.
+	 */
+	spin_lock(&lr->wait.lock);
+	lr->ring_events = (void *)ring + PAGE_SIZE;
+	lr->ring_mask = num_events - 1;
+	lr->ring_head = 0;
+	lr->ring_polled = 0;
+	if (kfifo_initialized(&lr->events))
+		kfifo_reset(&lr->events);
+	WRITE_ONCE(lr->ring, ring);
+	spin_unlock(&lr->wait.lock);
+
+out_unlock:
+	mutex_unlock(&lr->config_mutex);
+
+	return ret;
+}
+
 static void linereq_free(struct linereq *lr)
 {
 	struct line *line;
@@ -1720,6 +1979,7 @@ static void linereq_free(struct linereq *lr)
 		gpiod_free(line->desc);
 	}
 	kfifo_free(&lr->events);
+	vfree(lr->ring);
 	kfree(lr->label);
 	put_device(&lr->gdev->dev);
 	kfree(lr);
@@ -1752,6 +2012,7 @@ static const struct file_operations line_fileops = {
 	.release = linereq_release,
 	.read = linereq_read,
 	.poll = linereq_poll,
+	.mmap = linereq_mmap,
 	.owner = THIS_MODULE,
 	.llseek = noop_llseek,
 	.unlocked_ioctl = linereq_ioctl,
@@ -1927,9 +2188,17 @@ static int linereq_create(struct gpio_device *gdev, void __user *ip)
  * @irq: the interrupt that trigger in response to events on this GPIO
  * @wait: wait queue that handles blocking reads of events
  * @events: KFIFO for the GPIO events
- * @timestamp: cache for the timestamp storing it between hardirq
- * and IRQ thread, used to bring the timestamp close to the actual
- * event
+ * @irq_nested: @irq is a nested threaded interrupt, so
+ * lineevent_irq_handler() never runs
+ * @timestamps: timestamps captured in hardirq and not yet turned into
+ * events by the IRQ thread, used to bring the timestamp close to the
+ * actual event
+ * @ts_head: index of the next free slot in @timestamps, written only by
+ * lineevent_irq_handler()
+ * @ts_tail: index of the oldest pending slot in @timestamps, written only
+ * by lineevent_irq_thread()
+ * @ts_drops: the number of edges dropped because @timestamps was full,
+ * written only by lineevent_irq_handler()
  */
 struct lineevent_state {
 	struct gpio_device *gdev;
@@ -1937,9 +2206,13 @@ struct lineevent_state {
 	struct gpio_desc *desc;
 	u32 eflags;
 	int irq;
+	bool irq_nested;
 	wait_queue_head_t wait;
 	DECLARE_KFIFO(events, struct gpioevent_data, 16);
-	u64 timestamp;
+	struct line_ts timestamps[LINE_TS_BATCH];
+	unsigned int ts_head;
+	unsigned int ts_tail;
+	u32 ts_drops;
 };
 
 #define GPIOEVENT_REQUEST_VALID_FLAGS \
@@ -2132,43 +2405,17 @@ static const struct file_operations lineevent_fileops = {
 #endif
 };
 
-static irqreturn_t lineevent_irq_thread(int irq, void *p)
+static void lineevent_put_event(struct lineevent_state *le, u64 timestamp,
+				u32 id)
 {
-	struct lineevent_state *le = p;
 	struct gpioevent_data ge;
 	int ret;
 
 	/* Do not leak kernel stack to userspace */
 	memset(&ge, 0, sizeof(ge));
 
-	/*
-	 * We may be running from a nested threaded interrupt in which case
-	 * we didn't get the timestamp from lineevent_irq_handler().
-	 */
-	if (!le->timestamp)
-		ge.timestamp = ktime_get_ns();
-	else
-		ge.timestamp = le->timestamp;
-
-	if (le->eflags & GPIOEVENT_REQUEST_RISING_EDGE
-	    && le->eflags & GPIOEVENT_REQUEST_FALLING_EDGE) {
-		int level = gpiod_get_value_cansleep(le->desc);
-
-		if (level)
-			/* Emit low-to-high event */
-			ge.id = GPIOEVENT_EVENT_RISING_EDGE;
-		else
-			/* Emit high-to-low event */
-			ge.id = GPIOEVENT_EVENT_FALLING_EDGE;
-	} else if (le->eflags & GPIOEVENT_REQUEST_RISING_EDGE) {
-		/* Emit low-to-high event */
-		ge.id = GPIOEVENT_EVENT_RISING_EDGE;
-	} else if (le->eflags & GPIOEVENT_REQUEST_FALLING_EDGE) {
-		/* Emit high-to-low event */
-		ge.id = GPIOEVENT_EVENT_FALLING_EDGE;
-	} else {
-		return IRQ_NONE;
-	}
+	ge.timestamp = timestamp;
+	ge.id = id;
 
 	ret = kfifo_in_spinlocked_noirqsave(&le->events, &ge,
 					    1, &le->wait.lock);
@@ -2176,6 +2423,65 @@ static irqreturn_t lineevent_irq_thread(int irq, void *p)
 		wake_up_poll(&le->wait, EPOLLIN);
 	else
 		pr_debug_ratelimited("event FIFO is full - event dropped\n");
+}
+
+static int lineevent_level(struct lineevent_state *le)
+{
+	if (le->eflags & GPIOEVENT_REQUEST_RISING_EDGE
+	    && le->eflags & GPIOEVENT_REQUEST_FALLING_EDGE)
+		return gpiod_get_value_cansleep(le->desc);
+	/* Emit low-to-high event for rising edges only */
+	return !!(le->eflags & GPIOEVENT_REQUEST_RISING_EDGE);
+}
+
+static irqreturn_t lineevent_irq_thread(int irq, void *p)
+{
+	struct lineevent_state *le = p;
+	unsigned int head, tail;
+	struct line_ts *ts;
+	bool both;
+	int level;
+	u32 drops;
+
+	if (!(le->eflags & GPIOEVENT_REQUEST_VALID_FLAGS))
+		return IRQ_NONE;
+
+	/*
+	 * A nested threaded interrupt bypasses lineevent_irq_handler(), so
+	 * the thread runs once per edge and takes the timestamp itself.
+	 */
+	if (le->irq_nested) {
+		lineevent_put_event(le, ktime_get_ns(),
+				    lineevent_level(le) ?
+				    GPIOEVENT_EVENT_RISING_EDGE :
+				    GPIOEVENT_EVENT_FALLING_EDGE);
+		return IRQ_HANDLED;
+	}
+
+	/* pairs with the release in lineevent_irq_handler() */
+	head = smp_load_acquire(&le->ts_head);
+	tail = le->ts_tail;
+
+	/* already drained, see edge_irq_thread() */
+	if (head == tail)
+		return IRQ_HANDLED;
+
+	level = lineevent_level(le);
+	drops = READ_ONCE(le->ts_drops);
+	both = (le->eflags & GPIOEVENT_REQUEST_VALID_FLAGS) ==
+	       GPIOEVENT_REQUEST_VALID_FLAGS;
+
+	for (; tail != head; tail++) {
+		int lvl;
+
+		ts = &le->timestamps[tail % LINE_TS_BATCH];
+		lvl = both ? line_ts_level(ts, tail, head, drops, level) : level;
+		lineevent_put_event(le, ts->timestamp_ns,
+				    lvl ? GPIOEVENT_EVENT_RISING_EDGE :
+					  GPIOEVENT_EVENT_FALLING_EDGE);
+		/* pairs with the acquire in lineevent_irq_handler() */
+		smp_store_release(&le->ts_tail, tail + 1);
+	}
 
 	return IRQ_HANDLED;
 }
@@ -2183,12 +2489,26 @@ static irqreturn_t lineevent_irq_thread(int irq, void *p)
 static irqreturn_t lineevent_irq_handler(int irq, void *p)
 {
 	struct lineevent_state *le = p;
+	unsigned int head = le->ts_head;
+	struct line_ts *ts;
+
+	/* see edge_irq_handler() */
+	if (head - smp_load_acquire(&le->ts_tail) >= LINE_TS_BATCH) {
+		WRITE_ONCE(le->ts_drops, le->ts_drops + 1);
+		pr_debug_ratelimited("timestamp batch is full - event dropped\n");
+		return IRQ_HANDLED;
+	}
 
 	/*
 	 * Just store the timestamp in hardirq context so we get it as
 	 * close in time as possible to the actual event.
 	 */
-	le->timestamp = ktime_get_ns();
+	ts = &le->timestamps[head % LINE_TS_BATCH];
+	ts->timestamp_ns = ktime_get_ns();
+	ts->drops = le->ts_drops;
+
+	/* pairs with the acquire in lineevent_irq_thread() */
+	smp_store_release(&le->ts_head, head + 1);
 
 	return IRQ_WAKE_THREAD;
 }
@@ -2284,6 +2604,7 @@ static int lineevent_create(struct gpio_device *gdev, void __user *ip)
 
 	INIT_KFIFO(le->events);
 	init_waitqueue_head(&le->wait);
+	le->irq_nested = irq_check_status_bit(irq, IRQ_NESTED_THREAD);
 
 	/* Request a thread to read the events */
 	ret = request_threaded_irq(irq,
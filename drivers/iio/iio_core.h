@@ -12,6 +12,7 @@
 #include <linux/kernel.h>
 #include <linux/device.h>
 
+struct iio_block_queue;
 struct iio_buffer;
 struct iio_chan_spec;
 struct iio_dev;
@@ -21,6 +22,7 @@ extern const struct device_type iio_device_type;
 struct iio_dev_buffer_pair {
 	struct iio_dev		*indio_dev;
 	struct iio_buffer	*buffer;
+	struct iio_block_queue	*blocks;
 };
 
 #define IIO_IOCTL_UNHANDLED	1
@@ -13,12 +13,20 @@
 #include <linux/kernel.h>
 #include <linux/export.h>
 #include <linux/device.h>
+#include <linux/dma-buf.h>
+#include <linux/dma-mapping.h>
+#include <linux/dma-resv.h>
 #include <linux/file.h>
 #include <linux/fs.h>
 #include <linux/cdev.h>
+#include <linux/highmem.h>
+#include <linux/mm.h>
+#include <linux/scatterlist.h>
+#include <linux/sizes.h>
 #include <linux/slab.h>
 #include <linux/poll.h>
 #include <linux/sched/signal.h>
+#include <linux/vmalloc.h>
 
 #include <linux/iio/iio.h>
 #include <linux/iio/iio-opaque.h>
@@ -28,6 +36,8 @@
 #include <linux/iio/buffer.h>
 #include <linux/iio/buffer_impl.h>
 
+#include <uapi/linux/iio/buffer-block.h>
+
 static const char * const iio_endian_prefix[] = {
 	[IIO_BE] = "be",
 	[IIO_LE] = "le",
@@ -1498,6 +1508,615 @@ static void iio_buffer_unregister_legacy_sysfs_groups(struct iio_dev *indio_dev)
 	kfree(iio_dev_opaque->legacy_scan_el_group.attrs);
 }
 
+/* The largest block that can be requested through the block interface */
+#define IIO_BUFFER_BLOCK_MAX_SIZE	SZ_16M
+
+enum iio_block_state {
+	IIO_BLOCK_STATE_DEQUEUED,
+	IIO_BLOCK_STATE_QUEUED,
+	IIO_BLOCK_STATE_DONE,
+};
+
+/**
+ * struct iio_block - a block of scan data exported as a dma-buf
+ * @head:	entry in the incoming or outgoing list of the queue
+ * @dmabuf:	the dma-buf exporting the block
+ * @vaddr:	kernel mapping of the block memory
+ * @size:	size of the block in bytes
+ * @bytes_used:	number of bytes of scan data stored in the block
+ * @scans:	number of scans stored in the block
+ * @id:		index of the block in its queue
+ * @state:	which side currently owns the block
+ * @lock:	protects the DMA mappings kept in the attachments' priv
+ *
+ * The block memory is owned by the dma-buf and freed when its last
+ * reference is dropped, which may be after the queue is gone.
+ */
+struct iio_block {
+	struct list_head head;
+	struct dma_buf *dmabuf;
+	void *vaddr;
+	size_t size;
+	size_t bytes_used;
+	unsigned int scans;
+	unsigned int id;
+	enum iio_block_state state;
+	struct mutex lock;
+};
+
+/**
+ * struct iio_block_queue - block based access to an IIO buffer
+ * @access:		access functions installed on the buffer while the
+ *			queue exists, redirecting stored scans into blocks
+ * @orig_access:	the access functions of the underlying buffer
+ * @buffer:		the buffer the queue is attached to
+ * @lock:		protects the lists, block states and @data_available
+ * @incoming:		blocks enqueued by userspace, the first one is being
+ *			filled
+ * @outgoing:		filled blocks waiting to be dequeued
+ * @data_available:	number of scans in the @outgoing blocks
+ * @num_blocks:		number of allocated blocks
+ * @blocks:		the allocated blocks, indexed by id
+ */
+struct iio_block_queue {
+	struct iio_buffer_access_funcs access;
+	const struct iio_buffer_access_funcs *orig_access;
+	struct iio_buffer *buffer;
+	spinlock_t lock;
+	struct list_head incoming;
+	struct list_head outgoing;
+	size_t data_available;
+	unsigned int num_blocks;
+	struct iio_block *blocks[IIO_BUFFER_BLOCK_MAX];
+};
+
+static struct iio_block_queue *iio_buffer_to_block_queue(struct iio_buffer *buf)
+{
+	return container_of(buf->access, struct iio_block_queue, access);
+}
+
+/* Called with queue->lock held */
+static void iio_block_done(struct iio_block_queue *queue,
+			   struct iio_block *block)
+{
+	block->state = IIO_BLOCK_STATE_DONE;
+	list_move_tail(&block->head, &queue->outgoing);
+	queue->data_available += block->scans;
+}
+
+static void iio_demux_into(struct iio_buffer *buffer, void *dataout,
+			   const void *datain)
+{
+	struct iio_demux_table *t;
+
+	list_for_each_entry(t, &buffer->demux_list, l)
+		memcpy(dataout + t->to, datain + t->from, t->length);
+}
+
+/*
+ * Store a scan into the block being filled. With @demux set the scan is
+ * demuxed straight into the block instead of going through the demux
+ * bounce buffer first, so it is copied exactly once.
+ */
+static int __iio_block_store(struct iio_buffer *buf, const void *data,
+			     bool demux)
+{
+	struct iio_block_queue *queue = iio_buffer_to_block_queue(buf);
+	size_t datum_size = buf->bytes_per_datum;
+	struct iio_block *block;
+	unsigned long flags;
+	void *dst;
+	int ret = 0;
+
+	spin_lock_irqsave(&queue->lock, flags);
+
+	block = list_first_entry_or_null(&queue->incoming, struct iio_block,
+					 head);
+	if (!block) {
+		ret = -EBUSY;
+		goto out_unlock;
+	}
+
+	if (datum_size > block->size) {
+		ret = -EINVAL;
+		goto out_unlock;
+	}
+
+	dst = block->vaddr + block->bytes_used;
+	if (demux && !list_empty(&buf->demux_list))
+		iio_demux_into(buf, dst, data);
+	else
+		memcpy(dst, data, datum_size);
+	block->bytes_used += datum_size;
+	block->scans++;
+
+	/* only whole scans are stored, so hand the block out once full */
+	if (block->size - block->bytes_used < datum_size)
+		iio_block_done(queue, block);
+
+out_unlock:
+	spin_unlock_irqrestore(&queue->lock, flags);
+
+	return ret;
+}
+
+static int iio_block_store_to(struct iio_buffer *buf, const void *data)
+{
+	return __iio_block_store(buf, data, false);
+}
+
+static size_t iio_block_data_available(struct iio_buffer *buf)
+{
+	struct iio_block_queue *queue = iio_buffer_to_block_queue(buf);
+
+	return READ_ONCE(queue->data_available);
+}
+
+static struct sg_table *iio_block_map_dma_buf(struct dma_buf_attachment *at,
+					      enum dma_data_direction dir)
+{
+	struct iio_block *block = at->dmabuf->priv;
+	unsigned int i, nr_pages = block->size >> PAGE_SHIFT;
+	struct sg_table *sgt;
+	struct page **pages;
+	int ret;
+
+	pages = kmalloc_array(nr_pages, sizeof(*pages), GFP_KERNEL);
+	if (!pages)
+		return ERR_PTR(-ENOMEM);
+
+	for (i = 0; i < nr_pages; i++)
+		pages[i] = vmalloc_to_page(block->vaddr + i * PAGE_SIZE);
+
+	sgt = kzalloc(sizeof(*sgt), GFP_KERNEL);
+	if (!sgt) {
+		ret = -ENOMEM;
+		goto error_free_pages;
+	}
+
+	ret = sg_alloc_table_from_pages(sgt, pages, nr_pages, 0, block->size,
+					GFP_KERNEL);
+	if (ret)
+		goto error_free_sgt;
+
+	ret = dma_map_sgtable(at->dev, sgt, dir, 0);
+	if (ret)
+		goto error_free_table;
+
+	kfree(pages);
+
+	mutex_lock(&block->lock);
+	at->priv = sgt;
+	mutex_unlock(&block->lock);
+
+	return sgt;
+
+error_free_table:
+	sg_free_table(sgt);
+error_free_sgt:
+	kfree(sgt);
+error_free_pages:
+	kfree(pages);
+	return ERR_PTR(ret);
+}
+
+static void iio_block_unmap_dma_buf(struct dma_buf_attachment *at,
+				    struct sg_table *sgt,
+				    enum dma_data_direction dir)
+{
+	struct iio_block *block = at->dmabuf->priv;
+
+	mutex_lock(&block->lock);
+	at->priv = NULL;
+	mutex_unlock(&block->lock);
+
+	dma_unmap_sgtable(at->dev, sgt, dir, 0);
+	sg_free_table(sgt);
+	kfree(sgt);
+}
+
+static int iio_block_mmap(struct dma_buf *dmabuf, struct vm_area_struct *vma)
+{
+	struct iio_block *block = dmabuf->priv;
+
+	return remap_vmalloc_range(vma, block->vaddr, vma->vm_pgoff);
+}
+
+/*
+ * The core fills the blocks through their vmalloc mapping, while importers
+ * may access them through non-coherent DMA mappings and userspace through
+ * its own mapping, so bracket CPU access with cache maintenance on all of
+ * them.
+ */
+static int iio_block_begin_cpu_access(struct dma_buf *dmabuf,
+				      enum dma_data_direction dir)
+{
+	struct iio_block *block = dmabuf->priv;
+	struct dma_buf_attachment *at;
+
+	dma_resv_lock(dmabuf->resv, NULL);
+	mutex_lock(&block->lock);
+	list_for_each_entry(at, &dmabuf->attachments, node) {
+		if (at->priv)
+			dma_sync_sgtable_for_cpu(at->dev, at->priv, dir);
+	}
+	mutex_unlock(&block->lock);
+	dma_resv_unlock(dmabuf->resv);
+
+	flush_kernel_vmap_range(block->vaddr, block->size);
+
+	return 0;
+}
+
+static int iio_block_end_cpu_access(struct dma_buf *dmabuf,
+				    enum dma_data_direction dir)
+{
+	struct iio_block *block = dmabuf->priv;
+	struct dma_buf_attachment *at;
+
+	invalidate_kernel_vmap_range(block->vaddr, block->size);
+
+	dma_resv_lock(dmabuf->resv, NULL);
+	mutex_lock(&block->lock);
+	list_for_each_entry(at, &dmabuf->attachments, node) {
+		if (at->priv)
+			dma_sync_sgtable_for_device(at->dev, at->priv, dir);
+	}
+	mutex_unlock(&block->lock);
+	dma_resv_unlock(dmabuf->resv);
+
+	return 0;
+}
+
+static void iio_block_release(struct dma_buf *dmabuf)
+{
+	struct iio_block *block = dmabuf->priv;
+
+	mutex_destroy(&block->lock);
+	vfree(block->vaddr);
+	kfree(block);
+}
+
+static const struct dma_buf_ops iio_block_dmabuf_ops = {
+	.map_dma_buf = iio_block_map_dma_buf,
+	.unmap_dma_buf = iio_block_unmap_dma_buf,
+	.begin_cpu_access = iio_block_begin_cpu_access,
+	.end_cpu_access = iio_block_end_cpu_access,
+	.mmap = iio_block_mmap,
+	.release = iio_block_release,
+};
+
+static struct iio_block *iio_block_alloc(size_t size, unsigned int id)
+{
+	DEFINE_DMA_BUF_EXPORT_INFO(exp_info);
+	struct iio_block *block;
+	int ret;
+
+	block = kzalloc(sizeof(*block), GFP_KERNEL);
+	if (!block)
+		return ERR_PTR(-ENOMEM);
+
+	block->vaddr = vmalloc_user(size);
+	if (!block->vaddr) {
+		ret = -ENOMEM;
+		goto error_free_block;
+	}
+
+	block->size = size;
+	block->id = id;
+	block->state = IIO_BLOCK_STATE_DEQUEUED;
+	INIT_LIST_HEAD(&block->head);
+	mutex_init(&block->lock);
+
+	exp_info.ops = &iio_block_dmabuf_ops;
+	exp_info.size = size;
+	exp_info.flags = O_RDWR;
+	exp_info.priv = block;
+
+	block->dmabuf = dma_buf_export(&exp_info);
+	if (IS_ERR(block->dmabuf)) {
+		ret = PTR_ERR(block->dmabuf);
+		goto error_free_vaddr;
+	}
+
+	return block;
+
+error_free_vaddr:
+	vfree(block->vaddr);
+error_free_block:
+	kfree(block);
+	return ERR_PTR(ret);
+}
+
+static void iio_block_queue_free(struct iio_block_queue *queue)
+{
+	unsigned int i;
+
+	/* the block memory lives on while userspace holds a dma-buf fd */
+	for (i = 0; i < queue->num_blocks; i++)
+		dma_buf_put(queue->blocks[i]->dmabuf);
+
+	kfree(queue);
+}
+
+static long iio_buffer_block_alloc(struct iio_dev_buffer_pair *ib,
+				   unsigned long arg)
+{
+	struct iio_buffer_block_alloc_req __user *ureq = (void __user *)arg;
+	struct iio_dev *indio_dev = ib->indio_dev;
+	struct iio_buffer *buffer = ib->buffer;
+	struct iio_buffer_block_alloc_req req;
+	struct iio_block_queue *queue;
+	struct iio_block *block;
+	unsigned int i;
+	size_t size;
+	int ret;
+
+	if (copy_from_user(&req, ureq, sizeof(req)))
+		return -EFAULT;
+
+	if (memchr_inv(req.reserved, 0, sizeof(req.reserved)))
+		return -EINVAL;
+
+	if (!req.count || req.count > IIO_BUFFER_BLOCK_MAX)
+		return -EINVAL;
+
+	size = PAGE_ALIGN(req.size);
+	if (!size || size > IIO_BUFFER_BLOCK_MAX_SIZE)
+		return -EINVAL;
+
+	if (buffer->direction != IIO_BUFFER_DIRECTION_IN)
+		return -EPERM;
+
+	queue = kzalloc(sizeof(*queue), GFP_KERNEL);
+	if (!queue)
+		return -ENOMEM;
+
+	spin_lock_init(&queue->lock);
+	INIT_LIST_HEAD(&queue->incoming);
+	INIT_LIST_HEAD(&queue->outgoing);
+	queue->buffer = buffer;
+
+	for (i = 0; i < req.count; i++) {
+		block = iio_block_alloc(size, i);
+		if (IS_ERR(block)) {
+			ret = PTR_ERR(block);
+			goto error_free_queue;
+		}
+		queue->blocks[queue->num_blocks++] = block;
+	}
+
+	/*
+	 * Report the size before the queue is installed, so that a fault
+	 * tears it down before any other ioctl on the fd can see it.
+	 */
+	req.size = size;
+	if (copy_to_user(ureq, &req, sizeof(req))) {
+		ret = -EFAULT;
+		goto error_free_queue;
+	}
+
+	mutex_lock(&indio_dev->mlock);
+
+	if (ib->blocks || iio_buffer_is_active(buffer)) {
+		mutex_unlock(&indio_dev->mlock);
+		ret = -EBUSY;
+		goto error_free_queue;
+	}
+
+	/*
+	 * Redirect the buffer into the blocks. Everything but the data path
+	 * keeps going to the underlying buffer implementation.
+	 */
+	queue->orig_access = buffer->access;
+	queue->access = *buffer->access;
+	queue->access.store_to = iio_block_store_to;
+	queue->access.data_available = iio_block_data_available;
+	queue->access.read = NULL;
+	queue->access.write = NULL;
+	queue->access.remove_from = NULL;
+	queue->access.space_available = NULL;
+	buffer->access = &queue->access;
+
+	/* pairs with the acquire in the other block ioctls */
+	smp_store_release(&ib->blocks, queue);
+
+	mutex_unlock(&indio_dev->mlock);
+
+	return 0;
+
+error_free_queue:
+	iio_block_queue_free(queue);
+	return ret;
+}
+
+static void iio_buffer_block_detach(struct iio_dev_buffer_pair *ib)
+{
+	struct iio_dev *indio_dev = ib->indio_dev;
+	struct iio_buffer *buffer = ib->buffer;
+	struct iio_block_queue *queue = ib->blocks;
+
+	mutex_lock(&indio_dev->mlock);
+
+	/* the blocks go away with the fd, so stop filling them first */
+	if (iio_buffer_is_active(buffer))
+		__iio_update_buffers(indio_dev, NULL, buffer);
+
+	buffer->access = queue->orig_access;
+	ib->blocks = NULL;
+
+	mutex_unlock(&indio_dev->mlock);
+
+	iio_block_queue_free(queue);
+}
+
+static struct iio_block *iio_buffer_block_get(struct iio_dev_buffer_pair *ib,
+					      struct iio_buffer_block *ublock,
+					      unsigned long arg)
+{
+	struct iio_block_queue *queue = smp_load_acquire(&ib->blocks);
+
+	if (!queue)
+		return ERR_PTR(-EINVAL);
+
+	if (copy_from_user(ublock, (void __user *)arg, sizeof(*ublock)))
+		return ERR_PTR(-EFAULT);
+
+	if (ublock->id >= queue->num_blocks)
+		return ERR_PTR(-EINVAL);
+
+	return queue->blocks[ublock->id];
+}
+
+static long iio_buffer_block_query(struct iio_dev_buffer_pair *ib,
+				   unsigned long arg)
+{
+	struct iio_buffer_block ublock;
+	struct iio_block *block;
+	int fd;
+
+	block = iio_buffer_block_get(ib, &ublock, arg);
+	if (IS_ERR(block))
+		return PTR_ERR(block);
+
+	get_dma_buf(block->dmabuf);
+	fd = dma_buf_fd(block->dmabuf, O_CLOEXEC);
+	if (fd < 0) {
+		dma_buf_put(block->dmabuf);
+		return fd;
+	}
+
+	memset(&ublock, 0, sizeof(ublock));
+	ublock.id = block->id;
+	ublock.size = block->size;
+	ublock.bytes_used = block->bytes_used;
+	ublock.fd = fd;
+
+	/* as for IIO_BUFFER_GET_FD_IOCTL, the fd is left to the process */
+	if (copy_to_user((void __user *)arg, &ublock, sizeof(ublock)))
+		return -EFAULT;
+
+	return 0;
+}
+
+static long iio_buffer_block_enqueue(struct iio_dev_buffer_pair *ib,
+				     unsigned long arg)
+{
+	struct iio_block_queue *queue;
+	struct iio_buffer_block ublock;
+	struct iio_block *block;
+	int ret = 0;
+
+	block = iio_buffer_block_get(ib, &ublock, arg);
+	if (IS_ERR(block))
+		return PTR_ERR(block);
+
+	queue = ib->blocks;
+
+	spin_lock_irq(&queue->lock);
+	if (block->state != IIO_BLOCK_STATE_DEQUEUED) {
+		ret = -EBUSY;
+	} else {
+		block->bytes_used = 0;
+		block->scans = 0;
+		block->state = IIO_BLOCK_STATE_QUEUED;
+		list_add_tail(&block->head, &queue->incoming);
+	}
+	spin_unlock_irq(&queue->lock);
+
+	return ret;
+}
+
+/* Called with queue->lock held */
+static struct iio_block *iio_buffer_block_next(struct iio_block_queue *queue)
+{
+	struct iio_block *block;
+
+	/* drain the partially filled block if the buffer was disabled */
+	if (list_empty(&queue->outgoing) &&
+	    !iio_buffer_is_active(queue->buffer)) {
+		block = list_first_entry_or_null(&queue->incoming,
+						 struct iio_block, head);
+		if (block && block->bytes_used)
+			iio_block_done(queue, block);
+	}
+
+	return list_first_entry_or_null(&queue->outgoing, struct iio_block,
+					head);
+}
+
+static long iio_buffer_block_dequeue(struct iio_dev_buffer_pair *ib,
+				     struct file *filp, unsigned long arg)
+{
+	struct iio_block_queue *queue = smp_load_acquire(&ib->blocks);
+	struct iio_dev *indio_dev = ib->indio_dev;
+	struct iio_buffer_block ublock;
+	struct iio_block *block;
+	int ret;
+
+	if (!queue)
+		return -EINVAL;
+
+	spin_lock_irq(&queue->lock);
+	while (!(block = iio_buffer_block_next(queue))) {
+		spin_unlock_irq(&queue->lock);
+
+		/* a disabled buffer has nothing more to hand out */
+		if ((filp->f_flags & O_NONBLOCK) ||
+		    !iio_buffer_is_active(queue->buffer))
+			return -EAGAIN;
+
+		ret = wait_event_interruptible(queue->buffer->pollq,
+				!list_empty_careful(&queue->outgoing) ||
+				!iio_buffer_is_active(queue->buffer) ||
+				!indio_dev->info);
+		if (ret)
+			return ret;
+		if (!indio_dev->info)
+			return -ENODEV;
+
+		spin_lock_irq(&queue->lock);
+	}
+
+	list_del_init(&block->head);
+	block->state = IIO_BLOCK_STATE_DEQUEUED;
+	queue->data_available -= block->scans;
+
+	memset(&ublock, 0, sizeof(ublock));
+	ublock.id = block->id;
+	ublock.size = block->size;
+	ublock.bytes_used = block->bytes_used;
+	ublock.fd = -1;
+	spin_unlock_irq(&queue->lock);
+
+	if (copy_to_user((void __user *)arg, &ublock, sizeof(ublock)))
+		return -EFAULT;
+
+	return 0;
+}
+
+static long iio_buffer_chrdev_ioctl(struct file *filp, unsigned int cmd,
+				    unsigned long arg)
+{
+	struct iio_dev_buffer_pair *ib = filp->private_data;
+
+	if (!ib->indio_dev->info)
+		return -ENODEV;
+
+	switch (cmd) {
+	case IIO_BUFFER_BLOCK_ALLOC_IOCTL:
+		return iio_buffer_block_alloc(ib, arg);
+	case IIO_BUFFER_BLOCK_QUERY_IOCTL:
+		return iio_buffer_block_query(ib, arg);
+	case IIO_BUFFER_BLOCK_ENQUEUE_IOCTL:
+		return iio_buffer_block_enqueue(ib, arg);
+	case IIO_BUFFER_BLOCK_DEQUEUE_IOCTL:
+		return iio_buffer_block_dequeue(ib, filp, arg);
+	default:
+		return -EINVAL;
+	}
+}
+
 static int iio_buffer_chrdev_release(struct inode *inode, struct file *filep)
 {
 	struct iio_dev_buffer_pair *ib = filep->private_data;
@@ -1506,6 +2125,9 @@ static int iio_buffer_chrdev_release(struct inode *inode, struct file *filep)
 
 	wake_up(&buffer->pollq);
 
+	if (ib->blocks)
+		iio_buffer_block_detach(ib);
+
 	kfree(ib);
 	clear_bit(IIO_BUSY_BIT_POS, &buffer->flags);
 	iio_device_put(indio_dev);
@@ -1519,6 +2141,8 @@ static const struct file_operations iio_buffer_chrdev_fileops = {
 	.read = iio_buffer_read,
 	.write = iio_buffer_write,
 	.poll = iio_buffer_poll,
+	.unlocked_ioctl = iio_buffer_chrdev_ioctl,
+	.compat_ioctl = compat_ptr_ioctl,
 	.release = iio_buffer_chrdev_release,
 };
 
@@ -1821,23 +2445,22 @@ EXPORT_SYMBOL_GPL(iio_validate_scan_mask_onehot);
 static const void *iio_demux(struct iio_buffer *buffer,
 				 const void *datain)
 {
-	struct iio_demux_table *t;
-
 	if (list_empty(&buffer->demux_list))
 		return datain;
-	list_for_each_entry(t, &buffer->demux_list, l)
-		memcpy(buffer->demux_bounce + t->to,
-		       datain + t->from, t->length);
+	iio_demux_into(buffer, buffer->demux_bounce, datain);
 
 	return buffer->demux_bounce;
 }
 
 static int iio_push_to_buffer(struct iio_buffer *buffer, const void *data)
 {
-	const void *dataout = iio_demux(buffer, data);
 	int ret;
 
-	ret = buffer->access->store_to(buffer, dataout);
+	/* block queues demux straight into the block, see __iio_block_store() */
+	if (buffer->access->store_to == iio_block_store_to)
+		ret = __iio_block_store(buffer, data, true);
+	else
+		ret = buffer->access->store_to(buffer, iio_demux(buffer, data));
 	if (ret)
 		return ret;
 
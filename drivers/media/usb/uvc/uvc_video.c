@@ -1858,6 +1858,13 @@ static int uvc_init_video_isoc(struct uvc_streaming *stream,
 		urb->pipe = usb_rcvisocpipe(stream->dev->udev,
 				ep->desc.bEndpointAddress);
 		urb->transfer_flags = URB_ISO_ASAP | URB_NO_TRANSFER_DMA_MAP;
+		/*
+		 * URBs are resubmitted from their completion handler, so every
+		 * other URB interrupting is enough to keep the stream going and
+		 * halves the number of interrupts.
+		 */
+		if (uvc_urb_index(uvc_urb) & 1)
+			urb->transfer_flags |= URB_NO_INTERRUPT;
 		urb->transfer_dma = uvc_urb->dma;
 		urb->interval = ep->desc.bInterval;
 		urb->transfer_buffer = uvc_urb->buffer;
@@ -2453,7 +2453,10 @@ static int tun_xdp_one(struct tun_struct *tun,
 
 	xdp_prog = rcu_dereference(tun->xdp_prog);
 	if (xdp_prog) {
-		if (gso->gso_type) {
+		/* vhost-net batches frames bigger than a page only while no
+		 * XDP program is attached, in case one raced with it.
+		 */
+		if (gso->gso_type || buflen > PAGE_SIZE) {
 			skb_xdp = true;
 			goto build;
 		}
@@ -1501,11 +1501,10 @@ static void n_tty_lookahead_flow_ctrl(struct tty_struct *tty, const unsigned cha
 	}
 }
 
-static void
-n_tty_receive_buf_real_raw(struct tty_struct *tty, const unsigned char *cp,
-			   const char *fp, int count)
+/* Append @count chars to the read buffer, the caller has checked for room */
+static void n_tty_copy_to_read_buf(struct n_tty_data *ldata,
+				   const unsigned char *cp, size_t count)
 {
-	struct n_tty_data *ldata = tty->disc_data;
 	size_t n, head;
 
 	head = ldata->read_head & (N_TTY_BUF_SIZE - 1);
@@ -1521,6 +1520,15 @@ n_tty_receive_buf_real_raw(struct tty_struct *tty, const unsigned char *cp,
 	ldata->read_head += n;
 }
 
+static void
+n_tty_receive_buf_real_raw(struct tty_struct *tty, const unsigned char *cp,
+			   const char *fp, int count)
+{
+	struct n_tty_data *ldata = tty->disc_data;
+
+	n_tty_copy_to_read_buf(ldata, cp, count);
+}
+
 static void
 n_tty_receive_buf_raw(struct tty_struct *tty, const unsigned char *cp,
 		      const char *fp, int count)
@@ -1552,14 +1560,78 @@ n_tty_receive_buf_closing(struct tty_struct *tty, const unsigned char *cp,
 	}
 }
 
+/**
+ * n_tty_plain_run	-	length of a run of ordinary input chars
+ * @tty: terminal device
+ * @cp: input chars
+ * @fp: flags for each char (if %NULL, all chars are %TTY_NORMAL)
+ * @count: number of input chars in @cp
+ *
+ * Returns the number of leading chars in @cp that n_tty_receive_char() would
+ * store unmodified and without side effects, so they can be bulk-copied into
+ * the read buffer. Returns 0 if the current termios settings transform or
+ * echo every char; the caller then falls back to per-char processing.
+ *
+ * Locking: n_tty_receive_buf()/producer path:
+ *	caller holds non-exclusive %termios_rwsem
+ */
+static size_t n_tty_plain_run(struct tty_struct *tty, const unsigned char *cp,
+			      const char *fp, size_t count)
+{
+	struct n_tty_data *ldata = tty->disc_data;
+	bool parmrk = I_PARMRK(tty);
+	size_t n;
+
+	if (ldata->lnext || L_ECHO(tty) || L_EXTPROC(tty) || I_ISTRIP(tty) ||
+	    (I_IUCLC(tty) && L_IEXTEN(tty)))
+		return 0;
+	/* the first ordinary char restarts output */
+	if (tty->flow.stopped && !tty->flow.tco_stopped && I_IXON(tty) &&
+	    I_IXANY(tty))
+		return 0;
+
+	if (fp) {
+		const char *flagged = memchr_inv(fp, TTY_NORMAL, count);
+
+		if (flagged)
+			count = flagged - fp;
+	}
+
+	for (n = 0; n < count; n++) {
+		unsigned char c = cp[n];
+
+		/* PARMRK doubles \377, which takes two slots */
+		if (test_bit(c, ldata->char_map) ||
+		    (parmrk && c == (unsigned char) '\377'))
+			break;
+	}
+
+	return n;
+}
+
 static void n_tty_receive_buf_standard(struct tty_struct *tty,
 		const unsigned char *cp, const char *fp, int count, bool lookahead_done)
 {
 	struct n_tty_data *ldata = tty->disc_data;
 	char flag = TTY_NORMAL;
 
-	while (count--) {
-		unsigned char c = *cp++;
+	while (count > 0) {
+		unsigned char c;
+		size_t n;
+
+		/* Copy runs of chars that need no special handling in one go */
+		n = n_tty_plain_run(tty, cp, fp, count);
+		if (n) {
+			n_tty_copy_to_read_buf(ldata, cp, n);
+			cp += n;
+			if (fp)
+				fp += n;
+			count -= n;
+			continue;
+		}
+
+		c = *cp++;
+		count--;
 
 		if (fp)
 			flag = *fp++;
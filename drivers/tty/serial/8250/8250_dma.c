@@ -70,10 +70,17 @@ static void dma_rx_complete(void *param)
 	struct uart_8250_port *p = param;
 	struct uart_8250_dma *dma = p->dma;
 	unsigned long flags;
+	u32 rx;
 
 	spin_lock_irqsave(&p->port.lock, flags);
-	if (dma->rx_running)
+	if (dma->rx_running) {
+		rx = p->port.icount.rx;
 		__dma_rx_complete(p);
+		serial8250_rx_burst(p, p->port.icount.rx - rx);
+		/* Timestamp mode keeps a transfer armed at all times */
+		if (p->rx_tstamp)
+			dma->rx_dma(p);
+	}
 	spin_unlock_irqrestore(&p->port.lock, flags);
 }
 
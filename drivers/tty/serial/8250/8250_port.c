@@ -1889,6 +1889,120 @@ unsigned int serial8250_modem_status(struct uart_8250_port *up)
 }
 EXPORT_SYMBOL_GPL(serial8250_modem_status);
 
+/**
+ * serial8250_rx_burst - account for a burst of received bytes
+ * @up: uart 8250 port
+ * @count: number of bytes just pushed to the tty layer
+ *
+ * In receive timestamp mode each burst is timestamped and kept for
+ * TIOCGRXTSTAMP, overwriting the oldest unread burst when the ring is full.
+ *
+ * Called with the port lock held.
+ */
+void serial8250_rx_burst(struct uart_8250_port *up, unsigned int count)
+{
+	struct serial_rx_burst *burst;
+
+	if (!count)
+		return;
+
+	if (up->rx_tstamp) {
+		burst = &up->rx_bursts[up->rx_burst_head];
+		burst->offset = up->rx_offset;
+		burst->tstamp_ns = ktime_get_ns();
+		burst->count = count;
+
+		up->rx_burst_head = (up->rx_burst_head + 1) % SER_RX_BURSTS_MAX;
+		if (up->rx_burst_nr < SER_RX_BURSTS_MAX)
+			up->rx_burst_nr++;
+		else
+			up->rx_burst_lost++;
+	}
+
+	up->rx_offset += count;
+}
+
+static int serial8250_get_rx_tstamp(struct uart_8250_port *up,
+				    struct serial_rx_tstamp __user *arg)
+{
+	struct serial_rx_tstamp ts = {};
+	unsigned long flags;
+	unsigned int i, tail;
+
+	spin_lock_irqsave(&up->port.lock, flags);
+	tail = up->rx_burst_head + SER_RX_BURSTS_MAX - up->rx_burst_nr;
+	for (i = 0; i < up->rx_burst_nr; i++)
+		ts.bursts[i] = up->rx_bursts[(tail + i) % SER_RX_BURSTS_MAX];
+	ts.nr = up->rx_burst_nr;
+	ts.lost = up->rx_burst_lost;
+	up->rx_burst_nr = 0;
+	up->rx_burst_lost = 0;
+	spin_unlock_irqrestore(&up->port.lock, flags);
+
+	if (copy_to_user(arg, &ts, sizeof(ts)))
+		return -EFAULT;
+
+	return 0;
+}
+
+/*
+ * Receive timestamp mode: drop the RX FIFO trigger level to one byte, keep
+ * an RX DMA transfer armed on ports that use DMA, flushed on the character
+ * timeout, and record each burst for TIOCGRXTSTAMP.
+ *
+ * Called with the port mutex held.
+ */
+static int serial8250_set_rx_tstamp(struct uart_8250_port *up,
+				    int __user *arg)
+{
+	struct uart_port *port = &up->port;
+	unsigned long flags;
+	int enable;
+
+	if (get_user(enable, arg))
+		return -EFAULT;
+	if (!!enable == up->rx_tstamp)
+		return 0;
+
+	spin_lock_irqsave(&port->lock, flags);
+	up->rx_tstamp = !!enable;
+	up->rx_burst_nr = 0;
+	up->rx_burst_lost = 0;
+
+	if (up->capabilities & UART_CAP_FIFO && port->fifosize > 1) {
+		if (enable) {
+			up->rx_tstamp_trig = up->fcr & UART_FCR_TRIGGER_MASK;
+			up->fcr &= ~UART_FCR_TRIGGER_MASK;
+			up->fcr |= UART_FCR_TRIGGER_1;
+		} else {
+			up->fcr &= ~UART_FCR_TRIGGER_MASK;
+			up->fcr |= up->rx_tstamp_trig;
+		}
+		serial_port_out(port, UART_FCR, up->fcr);
+	}
+
+	if (enable && up->dma)
+		up->dma->rx_dma(up);
+	spin_unlock_irqrestore(&port->lock, flags);
+
+	return 0;
+}
+
+static int serial8250_ioctl(struct uart_port *port, unsigned int cmd,
+			    unsigned long arg)
+{
+	struct uart_8250_port *up = up_to_u8250p(port);
+
+	switch (cmd) {
+	case TIOCGRXTSTAMP:
+		return serial8250_get_rx_tstamp(up, (void __user *)arg);
+	case TIOCSRXTSTAMP:
+		return serial8250_set_rx_tstamp(up, (int __user *)arg);
+	}
+
+	return -ENOIOCTLCMD;
+}
+
 static bool handle_rx_dma(struct uart_8250_port *up, unsigned int iir)
 {
 	switch (iir & 0x3f) {
@@ -1948,12 +2062,17 @@ int serial8250_handle_irq(struct uart_port *port, unsigned int iir)
 
 	if (status & (UART_LSR_DR | UART_LSR_BI) && !skip_rx) {
 		struct irq_data *d;
+		u32 rx = port->icount.rx;
 
 		d = irq_get_irq_data(port->irq);
 		if (d && irqd_is_wakeup_set(d))
 			pm_wakeup_event(tport->tty->dev, 0);
 		if (!up->dma || handle_rx_dma(up, iir))
 			status = serial8250_rx_chars(up, status);
+		serial8250_rx_burst(up, port->icount.rx - rx);
+		/* Timestamp mode re-arms RX DMA right after the flush */
+		if (up->dma && up->rx_tstamp)
+			up->dma->rx_dma(up);
 	}
 	serial8250_modem_status(up);
 	if ((status & UART_LSR_THRE) && (up->ier & UART_IER_THRI)) {
@@ -2204,6 +2323,17 @@ int serial8250_do_startup(struct uart_port *port)
 		up->capabilities = uart_config[port->type].flags;
 	up->mcr = 0;
 
+	/* Receive timestamp mode lasts until the port is closed */
+	if (up->rx_tstamp) {
+		up->fcr &= ~UART_FCR_TRIGGER_MASK;
+		up->fcr |= up->rx_tstamp_trig;
+		up->rx_tstamp = false;
+	}
+	up->rx_burst_head = 0;
+	up->rx_burst_nr = 0;
+	up->rx_burst_lost = 0;
+	up->rx_offset = 0;
+
 	if (port->iotype != up->cur_iotype)
 		set_io_from_upio(port);
 
@@ -2787,8 +2917,13 @@ serial8250_do_set_termios(struct uart_port *port, struct ktermios *termios,
 
 	up->lcr = cval;					/* Save computed LCR */
 
+	/*
+	 * Ports in receive timestamp mode interrupt (or request DMA) on every
+	 * received byte instead of waiting for the trigger level or the
+	 * character timeout.
+	 */
 	if (up->capabilities & UART_CAP_FIFO && port->fifosize > 1) {
-		if (baud < 2400 && !up->dma) {
+		if ((baud < 2400 && !up->dma) || up->rx_tstamp) {
 			up->fcr &= ~UART_FCR_TRIGGER_MASK;
 			up->fcr |= UART_FCR_TRIGGER_1;
 		}
@@ -3267,6 +3402,7 @@ static const struct uart_ops serial8250_pops = {
 	.request_port	= serial8250_request_port,
 	.config_port	= serial8250_config_port,
 	.verify_port	= serial8250_verify_port,
+	.ioctl		= serial8250_ioctl,
 #ifdef CONFIG_CONSOLE_POLL
 	.poll_get_char = serial8250_get_poll_char,
 	.poll_put_char = serial8250_put_poll_char,
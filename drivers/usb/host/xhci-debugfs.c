@@ -403,6 +403,43 @@ static const struct file_operations port_fops = {
 	.release		= single_release,
 };
 
+static int xhci_isoc_stats_show(struct seq_file *s, void *unused)
+{
+	struct xhci_virt_ep	*ep = s->private;
+	struct xhci_hcd		*xhci = ep->xhci;
+	unsigned long		flags;
+	u64			tds, intr_tds;
+
+	spin_lock_irqsave(&xhci->lock, flags);
+	tds = ep->isoc_tds;
+	intr_tds = ep->isoc_intr_tds;
+	spin_unlock_irqrestore(&xhci->lock, flags);
+
+	seq_printf(s, "tds: %llu\n", tds);
+	seq_printf(s, "interrupting tds: %llu\n", intr_tds);
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(xhci_isoc_stats);
+
+static int xhci_event_stats_show(struct seq_file *s, void *unused)
+{
+	struct xhci_hcd		*xhci = s->private;
+	unsigned long		flags;
+	u64			irqs, events;
+
+	spin_lock_irqsave(&xhci->lock, flags);
+	irqs = xhci->irq_count;
+	events = xhci->irq_events;
+	spin_unlock_irqrestore(&xhci->lock, flags);
+
+	seq_printf(s, "interrupts: %llu\n", irqs);
+	seq_printf(s, "events: %llu\n", events);
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(xhci_event_stats);
+
 static void xhci_debugfs_create_files(struct xhci_hcd *xhci,
 				      struct xhci_file_map *files,
 				      size_t nentries, void *data,
@@ -465,6 +502,12 @@ void xhci_debugfs_create_endpoint(struct xhci_hcd *xhci,
 						   &epriv->show_ring,
 						   epriv->name,
 						   spriv->root);
+	debugfs_create_file("isoc-stats", 0444, epriv->root,
+			    &dev->eps[ep_index], &xhci_isoc_stats_fops);
+	debugfs_create_u32("isoc-ioc-interval", 0644, epriv->root,
+			   &dev->eps[ep_index].isoc_ioc_interval);
+	debugfs_create_bool("isoc-event-data", 0644, epriv->root,
+			    &dev->eps[ep_index].isoc_event_data);
 	spriv->eps[ep_index] = epriv;
 }
 
@@ -697,6 +740,9 @@ void xhci_debugfs_init(struct xhci_hcd *xhci)
 				     "event-ring",
 				     xhci->debugfs_root);
 
+	debugfs_create_file("event-stats", 0444, xhci->debugfs_root, xhci,
+			    &xhci_event_stats_fops);
+
 	xhci->debugfs_slots = debugfs_create_dir("devices", xhci->debugfs_root);
 
 	xhci_debugfs_create_ports(xhci, xhci->debugfs_root);
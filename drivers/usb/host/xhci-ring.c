@@ -751,6 +751,7 @@ static void xhci_giveback_urb_in_irq(struct xhci_hcd *xhci,
 
 	if (usb_pipetype(urb->pipe) == PIPE_ISOCHRONOUS) {
 		xhci_to_hcd(xhci)->self.bandwidth_isoc_reqs--;
+		xhci->isoc_bei_pending -= urb_priv->num_bei_tds;
 		if (xhci_to_hcd(xhci)->self.bandwidth_isoc_reqs	== 0) {
 			if (xhci->quirks & XHCI_AMD_PLL_FIX)
 				usb_amd_quirk_pll_enable();
@@ -2380,6 +2381,7 @@ static int process_isoc_td(struct xhci_hcd *xhci, struct xhci_virt_ep *ep,
 	struct usb_iso_packet_descriptor *frame;
 	u32 trb_comp_code;
 	bool sum_trbs_for_length = false;
+	bool event_data;
 	u32 remaining, requested, ep_trb_len;
 	int short_framestatus;
 
@@ -2393,6 +2395,11 @@ static int process_isoc_td(struct xhci_hcd *xhci, struct xhci_virt_ep *ep,
 	short_framestatus = td->urb->transfer_flags & URB_SHORT_NOT_OK ?
 		-EREMOTEIO : 0;
 
+	/* An Event Data TRB reports the bytes transferred, not a residue */
+	event_data = le32_to_cpu(event->flags) & EVENT_DATA;
+	if (event_data)
+		remaining = requested - min(remaining, requested);
+
 	/* handle completion code */
 	switch (trb_comp_code) {
 	case COMP_SUCCESS:
@@ -2453,7 +2460,9 @@ static int process_isoc_td(struct xhci_hcd *xhci, struct xhci_virt_ep *ep,
 	if (td->urb_length_set)
 		goto finish_td;
 
-	if (sum_trbs_for_length)
+	if (event_data)
+		frame->actual_length = requested - remaining;
+	else if (sum_trbs_for_length)
 		frame->actual_length = sum_trb_lengths(xhci, ep->ring, ep_trb) +
 			ep_trb_len - remaining;
 	else
@@ -3163,10 +3172,12 @@ irqreturn_t xhci_irq(struct usb_hcd *hcd)
 	}
 
 	event_ring_deq = xhci->event_ring->dequeue;
+	xhci->irq_count++;
 	/* FIXME this should be a delayed service routine
 	 * that clears the EHB.
 	 */
 	while (xhci_handle_event(xhci) > 0) {
+		xhci->irq_events++;
 		if (event_loop++ < TRBS_PER_SEGMENT / 2)
 			continue;
 		xhci_update_erst_dequeue(xhci, event_ring_deq);
@@ -4043,27 +4054,83 @@ static int xhci_get_isoc_frame_id(struct xhci_hcd *xhci,
 	return start_frame;
 }
 
-/* Check if we should generate event interrupt for a TD in an isoc URB */
-static bool trb_block_event_intr(struct xhci_hcd *xhci, int num_tds, int i)
+/*
+ * Check if we should generate event interrupt for a TD in an isoc URB.
+ *
+ * Every TD still gets an event (IOC), only the interrupt is blocked, so the
+ * status of each TD is reported when the next interrupting TD completes.
+ * The last TD of an URB interrupts unless the class driver submitted it with
+ * URB_NO_INTERRUPT, promising that a later URB on the endpoint will.
+ *
+ * Within that, an endpoint interrupts at least every isoc_ioc_interval TDs,
+ * and the blocked events of all endpoints together are bounded to half the
+ * event ring, so neither one endpoint nor many of them fill the event ring
+ * between two interrupts.
+ */
+static bool trb_block_event_intr(struct xhci_hcd *xhci,
+				 struct xhci_virt_ep *xep, struct urb *urb,
+				 int num_tds, int i)
 {
+	struct urb_priv *urb_priv = urb->hcpriv;
+	unsigned int interval;
+	bool block;
+
 	if (xhci->hci_version < 0x100)
 		return false;
-	/* always generate an event interrupt for the last TD */
-	if (i == num_tds - 1)
-		return false;
+
+	interval = READ_ONCE(xep->isoc_ioc_interval);
+	if (!interval || interval > ISOC_BEI_MAX)
+		interval = ISOC_BEI_MAX;
 	/*
 	 * If AVOID_BEI is set the host handles full event rings poorly,
 	 * generate an event at least every 8th TD to clear the event ring
 	 */
-	if (i && xhci->quirks & XHCI_AVOID_BEI)
-		return !!(i % xhci->isoc_bei_interval);
+	if (xhci->quirks & XHCI_AVOID_BEI)
+		interval = min(interval, xhci->isoc_bei_interval);
+
+	if (i == num_tds - 1 && !(urb->transfer_flags & URB_NO_INTERRUPT))
+		block = false;
+	else
+		block = xep->isoc_blocked_tds + 1 < interval;
 
-	return true;
+	if (block && xhci->isoc_bei_pending >=
+	    xhci->event_ring->num_segs * TRBS_PER_SEGMENT / 2)
+		block = false;
+
+	xep->isoc_tds++;
+	if (block) {
+		xep->isoc_blocked_tds++;
+		xhci->isoc_bei_pending++;
+		urb_priv->num_bei_tds++;
+	} else {
+		xep->isoc_blocked_tds = 0;
+		xep->isoc_intr_tds++;
+	}
+
+	return block;
+}
+
+/*
+ * Queue an Event Data TRB as the last TRB of an isoc TD. Its parameter is
+ * its own address, so the transfer event points at td->last_trb as usual,
+ * but carries the number of bytes transferred in the TD (EDTLA) instead of
+ * a residue. Short packets skip to it, so the data TRBs don't need ISP.
+ */
+static void queue_isoc_event_data(struct xhci_hcd *xhci,
+				  struct xhci_ring *ep_ring, u32 field)
+{
+	dma_addr_t addr = xhci_trb_virt_to_dma(ep_ring->enq_seg,
+					       ep_ring->enqueue);
+
+	queue_trb(xhci, ep_ring, false, lower_32_bits(addr),
+		  upper_32_bits(addr), TRB_INTR_TARGET(0),
+		  field | TRB_TYPE(TRB_EVENT_DATA) | ep_ring->cycle_state);
 }
 
 /* This is for isoc transfer */
 static int xhci_queue_isoc_tx(struct xhci_hcd *xhci, gfp_t mem_flags,
-		struct urb *urb, int slot_id, unsigned int ep_index)
+		struct urb *urb, int slot_id, unsigned int ep_index,
+		bool event_data)
 {
 	struct xhci_ring *ep_ring;
 	struct urb_priv *urb_priv;
@@ -4114,7 +4181,7 @@ static int xhci_queue_isoc_tx(struct xhci_hcd *xhci, gfp_t mem_flags,
 		last_burst_pkt_count = xhci_get_last_burst_packet_count(xhci,
 							urb, total_pkt_count);
 
-		trbs_per_td = count_isoc_trbs_needed(urb, i);
+		trbs_per_td = count_isoc_trbs_needed(urb, i) + event_data;
 
 		ret = prepare_transfer(xhci, xhci->devs[slot_id], ep_index,
 				urb->stream_id, trbs_per_td, urb, i, mem_flags);
@@ -4148,7 +4215,7 @@ static int xhci_queue_isoc_tx(struct xhci_hcd *xhci, gfp_t mem_flags,
 			field |= TRB_TBC(burst_count);
 
 		/* fill the rest of the TRB fields, and remaining normal TRBs */
-		for (j = 0; j < trbs_per_td; j++) {
+		for (j = 0; j < trbs_per_td - event_data; j++) {
 			u32 remainder = 0;
 
 			/* only first TRB is isoc, overwrite otherwise */
@@ -4157,7 +4224,7 @@ static int xhci_queue_isoc_tx(struct xhci_hcd *xhci, gfp_t mem_flags,
 					ep_ring->cycle_state;
 
 			/* Only set interrupt on short packet for IN EPs */
-			if (usb_urb_dir_in(urb))
+			if (usb_urb_dir_in(urb) && !event_data)
 				field |= TRB_ISP;
 
 			/* Set the chain bit for all except the last TRB  */
@@ -4169,7 +4236,8 @@ static int xhci_queue_isoc_tx(struct xhci_hcd *xhci, gfp_t mem_flags,
 				td->last_trb = ep_ring->enqueue;
 				td->last_trb_seg = ep_ring->enq_seg;
 				field |= TRB_IOC;
-				if (trb_block_event_intr(xhci, num_tds, i))
+				if (trb_block_event_intr(xhci, xep, urb,
+							 num_tds, i))
 					field |= TRB_BEI;
 			}
 			/* Calculate TRB length */
@@ -4209,6 +4277,15 @@ static int xhci_queue_isoc_tx(struct xhci_hcd *xhci, gfp_t mem_flags,
 			ret = -EINVAL;
 			goto cleanup;
 		}
+
+		if (event_data) {
+			td->last_trb = ep_ring->enqueue;
+			td->last_trb_seg = ep_ring->enq_seg;
+			field = TRB_IOC;
+			if (trb_block_event_intr(xhci, xep, urb, num_tds, i))
+				field |= TRB_BEI;
+			queue_isoc_event_data(xhci, ep_ring, field);
+		}
 	}
 
 	/* store the next frame id */
@@ -4230,6 +4307,9 @@ static int xhci_queue_isoc_tx(struct xhci_hcd *xhci, gfp_t mem_flags,
 	for (i--; i >= 0; i--)
 		list_del_init(&urb_priv->td[i].td_list);
 
+	xhci->isoc_bei_pending -= urb_priv->num_bei_tds;
+	urb_priv->num_bei_tds = 0;
+
 	/* Use the first TD as a temporary variable to turn the TDs we've queued
 	 * into No-ops with a software-owned cycle bit. That way the hardware
 	 * won't accidentally start executing bogus TDs when we partially
@@ -4265,6 +4345,7 @@ int xhci_queue_isoc_tx_prepare(struct xhci_hcd *xhci, gfp_t mem_flags,
 	int num_tds, num_trbs, i;
 	int ret;
 	struct xhci_virt_ep *xep;
+	bool event_data;
 	int ist;
 
 	xdev = xhci->devs[slot_id];
@@ -4272,10 +4353,14 @@ int xhci_queue_isoc_tx_prepare(struct xhci_hcd *xhci, gfp_t mem_flags,
 	ep_ring = xdev->eps[ep_index].ring;
 	ep_ctx = xhci_get_ep_ctx(xhci, xdev->out_ctx, ep_index);
 
+	/* latched per URB, the debugfs knob may change under us */
+	event_data = READ_ONCE(xep->isoc_event_data) &&
+		     xhci->hci_version >= 0x100;
+
 	num_trbs = 0;
 	num_tds = urb->number_of_packets;
 	for (i = 0; i < num_tds; i++)
-		num_trbs += count_isoc_trbs_needed(urb, i);
+		num_trbs += count_isoc_trbs_needed(urb, i) + event_data;
 
 	/* Check the ring to guarantee there is enough room for the whole urb.
 	 * Do not insert any td of the urb to the ring if the check failed.
@@ -4327,7 +4412,12 @@ int xhci_queue_isoc_tx_prepare(struct xhci_hcd *xhci, gfp_t mem_flags,
 skip_start_over:
 	ep_ring->num_trbs_free_temp = ep_ring->num_trbs_free;
 
-	return xhci_queue_isoc_tx(xhci, mem_flags, urb, slot_id, ep_index);
+	/* Nothing left on the ring can be waiting for a deferred interrupt */
+	if (list_empty(&ep_ring->td_list))
+		xep->isoc_blocked_tds = 0;
+
+	return xhci_queue_isoc_tx(xhci, mem_flags, urb, slot_id, ep_index,
+				  event_data);
 }
 
 /****		Command Ring Operations		****/
@@ -973,6 +973,15 @@ struct xhci_virt_ep {
 	int			next_frame_id;
 	/* Use new Isoch TRB layout needed for extended TBC support */
 	bool			use_extended_tbc;
+	/* Isoch TDs queued with BEI since the last interrupting one */
+	unsigned int		isoc_blocked_tds;
+	/* Interrupt at least every this many isoch TDs, 0 for ISOC_BEI_MAX */
+	unsigned int		isoc_ioc_interval;
+	/* End isoch TDs with an Event Data TRB, see xHCI 4.11.5.2 */
+	bool			isoc_event_data;
+	/* Isoch interrupt moderation statistics */
+	u64			isoc_tds;
+	u64			isoc_intr_tds;
 };
 
 enum xhci_overhead_type {
@@ -1539,6 +1548,11 @@ static inline const char *xhci_trb_type_string(u8 type)
  */
 #define AVOID_BEI_INTERVAL_MIN	8
 #define AVOID_BEI_INTERVAL_MAX	32
+/*
+ * Upper limit, and default, of the per endpoint isoc interrupt interval:
+ * at most this many isoc TDs in a row on one endpoint interrupt only once.
+ */
+#define ISOC_BEI_MAX		(TRBS_PER_SEGMENT / 4)
 
 struct xhci_segment {
 	union xhci_trb		*trbs;
@@ -1671,6 +1685,8 @@ struct xhci_scratchpad {
 struct urb_priv {
 	int	num_tds;
 	int	num_tds_done;
+	/* TDs queued with BEI, accounted in xhci->isoc_bei_pending */
+	int	num_bei_tds;
 	struct	xhci_td	td[];
 };
 
@@ -1787,7 +1803,12 @@ struct xhci_hcd {
 	/* imod_interval in ns (I * 250ns) */
 	u32		imod_interval;
 	u32		isoc_bei_interval;
+	/* isoc TDs queued with BEI whose URB has not been given back yet */
+	unsigned int	isoc_bei_pending;
 	int		event_ring_max;
+	/* interrupts serviced and events handled, for debugfs */
+	u64		irq_count;
+	u64		irq_events;
 	/* 4KB min, 128MB max */
 	int		page_size;
 	/* Valid values are 12 to 20, inclusive */
@@ -40,6 +40,11 @@ module_param(experimental_zcopytx, int, 0444);
 MODULE_PARM_DESC(experimental_zcopytx, "Enable Zero Copy TX;"
 		                       " 1 -Enable; 0 - Disable");
 
+static bool busyloop_adaptive = true;
+module_param(busyloop_adaptive, bool, 0644);
+MODULE_PARM_DESC(busyloop_adaptive, "Scale busy polling to the observed "
+		 "interval between virtqueue wakeups, within busyloop_timeout");
+
 /* Max number of bytes transferred before requeueing the job.
  * Using this limit prevents one virtqueue from starving others. */
 #define VHOST_NET_WEIGHT 0x80000
@@ -98,6 +103,11 @@ struct vhost_net_ubuf_ref {
 };
 
 #define VHOST_NET_BATCH 64
+
+/* Largest linear frame built for batched TX when no XDP program is attached
+ * to the backend. Bigger GSO frames go through the single packet path.
+ */
+#define VHOST_NET_XDP_MAX_BUFLEN (PAGE_SIZE << SKB_FRAG_PAGE_ORDER)
 struct vhost_net_buf {
 	void **queue;
 	int tail;
@@ -126,6 +136,12 @@ struct vhost_net_virtqueue {
 	struct vhost_net_buf rxq;
 	/* Batched XDP buffs */
 	struct xdp_buff *xdp;
+	/* Adaptive busy polling, in busy_clock() units: start of the current
+	 * idle period (0 if not idle) and moving average of how long it took
+	 * new work to show up. Only touched by the worker of this virtqueue.
+	 */
+	unsigned long idle_start;
+	unsigned long idle_avg;
 };
 
 struct vhost_net {
@@ -420,6 +436,53 @@ static bool vhost_can_busy_poll(unsigned long endtime)
 		      !signal_pending(current));
 }
 
+/* Called whenever new work may have shown up on a virtqueue: fold the length
+ * of the idle period that just ended into the moving average.
+ */
+static void vhost_net_busy_poll_wakeup(struct vhost_net_virtqueue *nvq)
+{
+	unsigned long timeout = nvq->vq.busyloop_timeout;
+	unsigned long idle;
+
+	if (!nvq->idle_start)
+		return;
+
+	idle = busy_clock() - nvq->idle_start;
+	nvq->idle_start = 0;
+
+	/* A long pause says little more than "longer than we'd poll", don't
+	 * let it hold the average up for many periods afterwards.
+	 */
+	idle = min(idle, timeout << 2);
+	nvq->idle_avg = (nvq->idle_avg * 7 + idle) >> 3;
+}
+
+/* How long to poll for, given busyloop_timeout as the upper bound. */
+static unsigned long
+vhost_net_busy_poll_budget(struct vhost_net_virtqueue *nvq)
+{
+	unsigned long timeout = nvq->vq.busyloop_timeout;
+	unsigned long avg = nvq->idle_avg;
+
+	if (!busyloop_adaptive || !avg)
+		return timeout;
+
+	/* Work usually comes back well within the timeout: poll for a bit
+	 * longer than it typically takes, not for the whole timeout.
+	 */
+	if (avg < timeout / 2)
+		return avg * 2;
+
+	/* Work usually takes longer to come back than we're allowed to poll,
+	 * so most of the polling would be wasted. Keep polling briefly to
+	 * notice when the rate picks up again.
+	 */
+	if (avg >= timeout)
+		return timeout >> 3;
+
+	return timeout;
+}
+
 static void vhost_net_disable_vq(struct vhost_net *n,
 				 struct vhost_virtqueue *vq)
 {
@@ -523,10 +586,12 @@ static void vhost_net_busy_poll(struct vhost_net *net,
 				bool *busyloop_intr,
 				bool poll_rx)
 {
+	struct vhost_net_virtqueue *nvq;
 	unsigned long busyloop_timeout;
 	unsigned long endtime;
 	struct socket *sock;
 	struct vhost_virtqueue *vq = poll_rx ? tvq : rvq;
+	bool found = false;
 
 	/* Try to hold the vq mutex of the paired virtqueue. We can't
 	 * use mutex_lock() here since we could not guarantee a
@@ -538,26 +603,31 @@ static void vhost_net_busy_poll(struct vhost_net *net,
 	vhost_disable_notify(&net->dev, vq);
 	sock = vhost_vq_get_backend(rvq);
 
-	busyloop_timeout = poll_rx ? rvq->busyloop_timeout:
-				     tvq->busyloop_timeout;
+	nvq = container_of(poll_rx ? rvq : tvq, struct vhost_net_virtqueue, vq);
+	busyloop_timeout = vhost_net_busy_poll_budget(nvq);
 
 	preempt_disable();
-	endtime = busy_clock() + busyloop_timeout;
+	nvq->idle_start = busy_clock() ?: 1;
+	endtime = nvq->idle_start + busyloop_timeout;
 
 	while (vhost_can_busy_poll(endtime)) {
-		if (vhost_has_work(&net->dev)) {
+		if (vhost_vq_has_work(poll_rx ? rvq : tvq)) {
 			*busyloop_intr = true;
 			break;
 		}
 
 		if ((sock_has_rx_data(sock) &&
 		     !vhost_vq_avail_empty(&net->dev, rvq)) ||
-		    !vhost_vq_avail_empty(&net->dev, tvq))
+		    !vhost_vq_avail_empty(&net->dev, tvq)) {
+			found = true;
 			break;
+		}
 
 		cpu_relax();
 	}
 
+	if (found)
+		vhost_net_busy_poll_wakeup(nvq);
 	preempt_enable();
 
 	if (poll_rx || sock_has_rx_data(sock))
@@ -703,7 +773,8 @@ static int vhost_net_build_xdp(struct vhost_net_virtqueue *nvq,
 	struct xdp_buff *xdp = &nvq->xdp[nvq->batched_xdp];
 	struct tun_xdp_hdr *hdr;
 	size_t len = iov_iter_count(from);
-	int headroom = vhost_sock_xdp(sock) ? XDP_PACKET_HEADROOM : 0;
+	bool sock_xdp = vhost_sock_xdp(sock);
+	int headroom = sock_xdp ? XDP_PACKET_HEADROOM : 0;
 	int buflen = SKB_DATA_ALIGN(sizeof(struct skb_shared_info));
 	int pad = SKB_DATA_ALIGN(VHOST_NET_RX_PAD + headroom + nvq->sock_hlen);
 	int sock_hlen = nvq->sock_hlen;
@@ -713,8 +784,12 @@ static int vhost_net_build_xdp(struct vhost_net_virtqueue *nvq,
 	if (unlikely(len < nvq->sock_hlen))
 		return -EFAULT;
 
+	/* XDP programs expect the frame to fit in a page. Without one, GSO
+	 * frames can be batched too, as long as they fit in a page frag.
+	 */
 	if (SKB_DATA_ALIGN(len + pad) +
-	    SKB_DATA_ALIGN(sizeof(struct skb_shared_info)) > PAGE_SIZE)
+	    SKB_DATA_ALIGN(sizeof(struct skb_shared_info)) >
+	    (sock_xdp ? PAGE_SIZE : VHOST_NET_XDP_MAX_BUFLEN))
 		return -ENOSPC;
 
 	buflen += SKB_DATA_ALIGN(len + pad);
@@ -723,6 +798,10 @@ static int vhost_net_build_xdp(struct vhost_net_virtqueue *nvq,
 						 alloc_frag, GFP_KERNEL)))
 		return -ENOMEM;
 
+	/* Refill falls back to order-0 pages under memory pressure */
+	if (unlikely(alloc_frag->offset + buflen > alloc_frag->size))
+		return -ENOSPC;
+
 	buf = (char *)page_address(alloc_frag->page) + alloc_frag->offset;
 	copied = copy_page_from_iter(alloc_frag->page,
 				     alloc_frag->offset +
@@ -1263,6 +1342,7 @@ static void handle_tx_kick(struct vhost_work *work)
 						  poll.work);
 	struct vhost_net *net = container_of(vq->dev, struct vhost_net, dev);
 
+	vhost_net_busy_poll_wakeup(&net->vqs[VHOST_NET_VQ_TX]);
 	handle_tx(net);
 }
 
@@ -1272,6 +1352,7 @@ static void handle_rx_kick(struct vhost_work *work)
 						  poll.work);
 	struct vhost_net *net = container_of(vq->dev, struct vhost_net, dev);
 
+	vhost_net_busy_poll_wakeup(&net->vqs[VHOST_NET_VQ_RX]);
 	handle_rx(net);
 }
 
@@ -1286,6 +1367,7 @@ static void handle_rx_net(struct vhost_work *work)
 {
 	struct vhost_net *net = container_of(work, struct vhost_net,
 					     poll[VHOST_NET_VQ_RX].work);
+	vhost_net_busy_poll_wakeup(&net->vqs[VHOST_NET_VQ_RX]);
 	handle_rx(net);
 }
 
@@ -1339,6 +1421,8 @@ static int vhost_net_open(struct inode *inode, struct file *f)
 		n->vqs[i].vhost_hlen = 0;
 		n->vqs[i].sock_hlen = 0;
 		n->vqs[i].rx_ring = NULL;
+		n->vqs[i].idle_start = 0;
+		n->vqs[i].idle_avg = 0;
 		vhost_net_buf_init(&n->vqs[i].rxq);
 	}
 	vhost_dev_init(dev, vqs, VHOST_NET_VQ_MAX,
@@ -1346,8 +1430,10 @@ static int vhost_net_open(struct inode *inode, struct file *f)
 		       VHOST_NET_PKT_WEIGHT, VHOST_NET_WEIGHT, true,
 		       NULL);
 
-	vhost_poll_init(n->poll + VHOST_NET_VQ_TX, handle_tx_net, EPOLLOUT, dev);
-	vhost_poll_init(n->poll + VHOST_NET_VQ_RX, handle_rx_net, EPOLLIN, dev);
+	vhost_poll_init(n->poll + VHOST_NET_VQ_TX, handle_tx_net, EPOLLOUT, dev,
+			vqs[VHOST_NET_VQ_TX]);
+	vhost_poll_init(n->poll + VHOST_NET_VQ_RX, handle_rx_net, EPOLLIN, dev,
+			vqs[VHOST_NET_VQ_RX]);
 
 	f->private_data = n;
 	n->page_frag.page = NULL;
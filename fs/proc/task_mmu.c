@@ -19,6 +19,7 @@
 #include <linux/shmem_fs.h>
 #include <linux/uaccess.h>
 #include <linux/pkeys.h>
+#include <linux/sysctl.h>
 
 #include <asm/elf.h>
 #include <asm/tlb.h>
@@ -446,7 +447,7 @@ static void smaps_page_accumulate(struct mem_size_stats *mss,
 
 static void smaps_account(struct mem_size_stats *mss, struct page *page,
 		bool compound, bool young, bool dirty, bool locked,
-		bool migration)
+		bool migration, int sharers)
 {
 	int i, nr = compound ? compound_nr(page) : 1;
 	unsigned long size = nr * PAGE_SIZE;
@@ -480,14 +481,17 @@ static void smaps_account(struct mem_size_stats *mss, struct page *page,
 	 * call page_mapcount() even with PTL held if the page is not mapped,
 	 * especially for migration entries.  Treat regular migration entries
 	 * as mapcount == 1.
+	 *
+	 * A page under a pte table shared by fork() is mapped by @sharers mms
+	 * through a single mapcount.
 	 */
-	if ((page_count(page) == 1) || migration) {
+	if ((page_count(page) == 1 && sharers == 1) || migration) {
 		smaps_page_accumulate(mss, page, size, size << PSS_SHIFT, dirty,
 			locked, true);
 		return;
 	}
 	for (i = 0; i < nr; i++, page++) {
-		int mapcount = page_mapcount(page);
+		int mapcount = page_mapcount(page) * sharers;
 		unsigned long pss = PAGE_SIZE << PSS_SHIFT;
 		if (mapcount >= 2)
 			pss /= mapcount;
@@ -524,7 +528,7 @@ static void smaps_pte_hole_lookup(unsigned long addr, struct mm_walk *walk)
 }
 
 static void smaps_pte_entry(pte_t *pte, unsigned long addr,
-		struct mm_walk *walk)
+		struct mm_walk *walk, int sharers)
 {
 	struct mem_size_stats *mss = walk->private;
 	struct vm_area_struct *vma = walk->vma;
@@ -543,7 +547,7 @@ static void smaps_pte_entry(pte_t *pte, unsigned long addr,
 			int mapcount;
 
 			mss->swap += PAGE_SIZE;
-			mapcount = swp_swapcount(swpent);
+			mapcount = swp_swapcount(swpent) * sharers;
 			if (mapcount >= 2) {
 				u64 pss_delta = (u64)PAGE_SIZE << PSS_SHIFT;
 
@@ -565,7 +569,8 @@ static void smaps_pte_entry(pte_t *pte, unsigned long addr,
 	if (!page)
 		return;
 
-	smaps_account(mss, page, false, young, dirty, locked, migration);
+	smaps_account(mss, page, false, young, dirty, locked, migration,
+		      sharers);
 }
 
 #ifdef CONFIG_TRANSPARENT_HUGEPAGE
@@ -601,7 +606,7 @@ static void smaps_pmd_entry(pmd_t *pmd, unsigned long addr,
 		mss->file_thp += HPAGE_PMD_SIZE;
 
 	smaps_account(mss, page, true, pmd_young(*pmd), pmd_dirty(*pmd),
-		      locked, migration);
+		      locked, migration, 1);
 }
 #else
 static void smaps_pmd_entry(pmd_t *pmd, unsigned long addr,
@@ -616,6 +621,7 @@ static int smaps_pte_range(pmd_t *pmd, unsigned long addr, unsigned long end,
 	struct vm_area_struct *vma = walk->vma;
 	pte_t *pte;
 	spinlock_t *ptl;
+	int sharers;
 
 	ptl = pmd_trans_huge_lock(pmd, vma);
 	if (ptl) {
@@ -632,8 +638,9 @@ static int smaps_pte_range(pmd_t *pmd, unsigned long addr, unsigned long end,
 	 * in here.
 	 */
 	pte = pte_offset_map_lock(vma->vm_mm, pmd, addr, &ptl);
+	sharers = lazy_pte_table_sharers(pmd);
 	for (; addr != end; pte++, addr += PAGE_SIZE)
-		smaps_pte_entry(pte, addr, walk);
+		smaps_pte_entry(pte, addr, walk, sharers);
 	pte_unmap_unlock(pte - 1, ptl);
 out:
 	cond_resched();
@@ -751,12 +758,14 @@ static int smaps_hugetlb_range(pte_t *pte, unsigned long hmask,
 static const struct mm_walk_ops smaps_walk_ops = {
 	.pmd_entry		= smaps_pte_range,
 	.hugetlb_entry		= smaps_hugetlb_range,
+	.read_only		= true,
 };
 
 static const struct mm_walk_ops smaps_shmem_walk_ops = {
 	.pmd_entry		= smaps_pte_range,
 	.hugetlb_entry		= smaps_hugetlb_range,
 	.pte_hole		= smaps_pte_hole,
+	.read_only		= true,
 };
 
 /*
@@ -803,6 +812,163 @@ static void smap_gather_stats(struct vm_area_struct *vma,
 		walk_page_range(vma->vm_mm, start, vma->vm_end, ops, mss);
 }
 
+/*
+ * Time-limited cache of the smaps_rollup contents.
+ *
+ * Monitoring agents read smaps_rollup of large processes every few seconds,
+ * each read walking every page table with mmap_lock held. With
+ * vm.smaps_rollup_max_age_ms set, a read returns the previous result again,
+ * without walking or taking mmap_lock, if that is at most this many
+ * milliseconds old and the mm's RSS and swap counters, VMA count and total
+ * size are unchanged since it was gathered. That drops the result after most
+ * faults, unmaps and mapping changes, but not all of them: Pss, Referenced
+ * and the clean/dirty split change without touching these counters, and may
+ * be as old as the limit. Tracking that exactly, per VMA, would take a hook
+ * wherever a PTE of the mm, or for Pss of any mm sharing its pages, changes.
+ * 0, the default, disables the cache.
+ */
+static unsigned int sysctl_smaps_rollup_max_age_ms;
+
+struct smaps_cache_key {
+	unsigned long counters[NR_MM_COUNTERS];
+	unsigned long total_vm;
+	int map_count;
+};
+
+struct smaps_cache {
+	struct mutex lock;		/* taken before mmap_lock */
+	bool valid;
+	unsigned long stamp;		/* jiffies when the walk started */
+	struct smaps_cache_key key;	/* mm state when the walk started */
+	unsigned long start, end;	/* range shown in the header */
+	struct mem_size_stats mss;
+};
+
+static struct ctl_table smaps_sysctls[] = {
+	{
+		.procname	= "smaps_rollup_max_age_ms",
+		.data		= &sysctl_smaps_rollup_max_age_ms,
+		.maxlen		= sizeof(unsigned int),
+		.mode		= 0644,
+		.proc_handler	= proc_douintvec,
+	},
+	{ }
+};
+
+static int __init smaps_sysctl_init(void)
+{
+	register_sysctl_init("vm", smaps_sysctls);
+	return 0;
+}
+fs_initcall(smaps_sysctl_init);
+
+void smaps_cache_free(struct mm_struct *mm)
+{
+	kfree(mm->smaps_cache);
+}
+
+static struct smaps_cache *smaps_cache_get(struct mm_struct *mm)
+{
+	struct smaps_cache *cache = READ_ONCE(mm->smaps_cache);
+
+	if (cache)
+		return cache;
+
+	cache = kzalloc(sizeof(*cache), GFP_KERNEL_ACCOUNT);
+	if (!cache)
+		return NULL;
+	mutex_init(&cache->lock);
+
+	if (cmpxchg(&mm->smaps_cache, NULL, cache)) {
+		kfree(cache);
+		cache = READ_ONCE(mm->smaps_cache);
+	}
+	return cache;
+}
+
+/*
+ * Return the cache of @mm with its lock held, or NULL if it is disabled or
+ * memory is short, in which case the rollup is gathered as before.
+ */
+static int smaps_cache_lock(struct mm_struct *mm, struct smaps_cache **cachep)
+{
+	struct smaps_cache *cache;
+
+	*cachep = NULL;
+	if (!READ_ONCE(sysctl_smaps_rollup_max_age_ms))
+		return 0;
+
+	cache = smaps_cache_get(mm);
+	if (!cache)
+		return 0;
+	if (mutex_lock_killable(&cache->lock))
+		return -EINTR;
+
+	*cachep = cache;
+	return 0;
+}
+
+static void smaps_cache_key_get(struct mm_struct *mm,
+				struct smaps_cache_key *key)
+{
+	int i;
+
+	memset(key, 0, sizeof(*key));
+	for (i = 0; i < NR_MM_COUNTERS; i++)
+		key->counters[i] = get_mm_counter(mm, i);
+	key->total_vm = READ_ONCE(mm->total_vm);
+	key->map_count = READ_ONCE(mm->map_count);
+}
+
+/*
+ * Copy out the cached rollup if it is still current enough. Otherwise note
+ * the state of @mm for the walk that is about to gather a new one.
+ */
+static bool smaps_cache_lookup(struct smaps_cache *cache,
+			       struct mm_struct *mm,
+			       struct mem_size_stats *mss,
+			       unsigned long *start, unsigned long *end)
+{
+	unsigned int max_age_ms = READ_ONCE(sysctl_smaps_rollup_max_age_ms);
+	struct smaps_cache_key key;
+
+	if (!cache)
+		return false;
+
+	smaps_cache_key_get(mm, &key);
+	if (cache->valid &&
+	    time_before(jiffies,
+			cache->stamp + msecs_to_jiffies(max_age_ms)) &&
+	    !memcmp(&key, &cache->key, sizeof(key))) {
+		*mss = cache->mss;
+		*start = cache->start;
+		*end = cache->end;
+		return true;
+	}
+
+	cache->valid = false;
+	cache->stamp = jiffies;
+	cache->key = key;
+	return false;
+}
+
+static void smaps_cache_unlock(struct smaps_cache *cache,
+			       const struct mem_size_stats *mss,
+			       unsigned long start, unsigned long end,
+			       bool complete)
+{
+	if (!cache)
+		return;
+
+	if (complete && !cache->valid) {
+		cache->mss = *mss;
+		cache->start = start;
+		cache->end = end;
+		cache->valid = true;
+	}
+	mutex_unlock(&cache->lock);
+}
+
 #define SEQ_PUT_DEC(str, val) \
 		seq_put_decimal_ull_width(m, str, (val) >> 10, 8)
 
@@ -874,10 +1040,15 @@ static int show_smap(struct seq_file *m, void *v)
 	return 0;
 }
 
-static int show_smaps_rollup(struct seq_file *m, void *v)
+/*
+ * Gather the statistics of all VMAs of the mm of @priv into @mss, and the
+ * range they span into @start and @end.
+ */
+static int smaps_rollup_gather(struct proc_maps_private *priv,
+			       struct mem_size_stats *mss,
+			       unsigned long *start, unsigned long *end)
 {
-	struct proc_maps_private *priv = m->private;
-	struct mem_size_stats mss;
+	struct smaps_cache *cache;
 	struct mm_struct *mm = priv->mm;
 	struct vm_area_struct *vma;
 	unsigned long vma_start = 0, last_vma_end = 0;
@@ -893,12 +1064,19 @@ static int show_smaps_rollup(struct seq_file *m, void *v)
 		goto out_put_task;
 	}
 
-	memset(&mss, 0, sizeof(mss));
+	memset(mss, 0, sizeof(*mss));
 
-	ret = mmap_read_lock_killable(mm);
+	ret = smaps_cache_lock(mm, &cache);
 	if (ret)
 		goto out_put_mm;
 
+	if (smaps_cache_lookup(cache, mm, mss, &vma_start, &last_vma_end))
+		goto out_cache;
+
+	ret = mmap_read_lock_killable(mm);
+	if (ret)
+		goto out_cache;
+
 	hold_task_mempolicy(priv);
 	vma = mas_find(&mas, ULONG_MAX);
 
@@ -907,7 +1085,7 @@ static int show_smaps_rollup(struct seq_file *m, void *v)
 
 	vma_start = vma->vm_start;
 	do {
-		smap_gather_stats(vma, &mss, 0);
+		smap_gather_stats(vma, mss, 0);
 		last_vma_end = vma->vm_end;
 
 		/*
@@ -920,7 +1098,7 @@ static int show_smaps_rollup(struct seq_file *m, void *v)
 			ret = mmap_read_lock_killable(mm);
 			if (ret) {
 				release_task_mempolicy(priv);
-				goto out_put_mm;
+				goto out_cache;
 			}
 
 			/*
@@ -970,29 +1148,46 @@ static int show_smaps_rollup(struct seq_file *m, void *v)
 
 			/* Case 4 above */
 			if (vma->vm_end > last_vma_end)
-				smap_gather_stats(vma, &mss, last_vma_end);
+				smap_gather_stats(vma, mss, last_vma_end);
 		}
 		/* Case 2 above */
 	} while ((vma = mas_find(&mas, ULONG_MAX)) != NULL);
 
 empty_set:
-	show_vma_header_prefix(m, vma_start, last_vma_end, 0, 0, 0, 0);
-	seq_pad(m, ' ');
-	seq_puts(m, "[rollup]\n");
-
-	__show_smap(m, &mss, true);
-
 	release_task_mempolicy(priv);
 	mmap_read_unlock(mm);
 
+out_cache:
+	smaps_cache_unlock(cache, mss, vma_start, last_vma_end, !ret);
 out_put_mm:
 	mmput(mm);
 out_put_task:
 	put_task_struct(priv->task);
 	priv->task = NULL;
 
+	*start = vma_start;
+	*end = last_vma_end;
 	return ret;
 }
+
+static int show_smaps_rollup(struct seq_file *m, void *v)
+{
+	struct proc_maps_private *priv = m->private;
+	struct mem_size_stats mss;
+	unsigned long start, end;
+	int ret;
+
+	ret = smaps_rollup_gather(priv, &mss, &start, &end);
+	if (ret)
+		return ret;
+
+	show_vma_header_prefix(m, start, end, 0, 0, 0, 0);
+	seq_pad(m, ' ');
+	seq_puts(m, "[rollup]\n");
+
+	__show_smap(m, &mss, true);
+	return 0;
+}
 #undef SEQ_PUT_DEC
 
 static const struct seq_operations proc_pid_smaps_op = {
@@ -1055,11 +1250,78 @@ const struct file_operations proc_pid_smaps_operations = {
 	.release	= proc_map_release,
 };
 
+/* Binary smaps_rollup, optionally of only the fields the mm counts */
+static int do_smaps_rollup_query(struct proc_maps_private *priv,
+				 void __user *uarg)
+{
+	struct procfs_smaps_rollup karg;
+	struct mem_size_stats mss;
+	struct mm_struct *mm = priv->mm;
+	unsigned long start, end;
+	u64 usize;
+	int err;
+
+	if (get_user(usize, (u64 __user *)uarg))
+		return -EFAULT;
+	if (usize < offsetofend(struct procfs_smaps_rollup, swap))
+		return -EINVAL;
+	err = copy_struct_from_user(&karg, sizeof(karg), uarg, usize);
+	if (err)
+		return err;
+	if (karg.flags & ~PROCFS_SMAPS_ROLLUP_FAST)
+		return -EINVAL;
+
+	if (!mm || !mmget_not_zero(mm))
+		return -ESRCH;
+	karg.rss_anon = get_mm_counter(mm, MM_ANONPAGES) << PAGE_SHIFT;
+	karg.rss_file = get_mm_counter(mm, MM_FILEPAGES) << PAGE_SHIFT;
+	karg.rss_shmem = get_mm_counter(mm, MM_SHMEMPAGES) << PAGE_SHIFT;
+	karg.swap = get_mm_counter(mm, MM_SWAPENTS) << PAGE_SHIFT;
+	mmput(mm);
+
+	if (karg.flags & PROCFS_SMAPS_ROLLUP_FAST) {
+		karg.rss = karg.rss_anon + karg.rss_file + karg.rss_shmem;
+		karg.pss = karg.pss_anon = karg.pss_file = karg.pss_shmem = 0;
+		karg.swap_pss = 0;
+	} else {
+		err = smaps_rollup_gather(priv, &mss, &start, &end);
+		if (err)
+			return err;
+		karg.rss = mss.resident;
+		karg.swap = mss.swap;
+		karg.pss = mss.pss >> PSS_SHIFT;
+		karg.pss_anon = mss.pss_anon >> PSS_SHIFT;
+		karg.pss_file = mss.pss_file >> PSS_SHIFT;
+		karg.pss_shmem = mss.pss_shmem >> PSS_SHIFT;
+		karg.swap_pss = mss.swap_pss >> PSS_SHIFT;
+	}
+
+	if (copy_to_user(uarg, &karg, min_t(size_t, sizeof(karg), usize)))
+		return -EFAULT;
+	return 0;
+}
+
+static long smaps_rollup_ioctl(struct file *file, unsigned int cmd,
+			       unsigned long arg)
+{
+	struct seq_file *seq = file->private_data;
+	struct proc_maps_private *priv = seq->private;
+
+	switch (cmd) {
+	case PROCFS_SMAPS_ROLLUP_QUERY:
+		return do_smaps_rollup_query(priv, (void __user *)arg);
+	default:
+		return -ENOIOCTLCMD;
+	}
+}
+
 const struct file_operations proc_pid_smaps_rollup_operations = {
 	.open		= smaps_rollup_open,
 	.read		= seq_read,
 	.llseek		= seq_lseek,
 	.release	= smaps_rollup_release,
+	.unlocked_ioctl	= smaps_rollup_ioctl,
+	.compat_ioctl	= compat_ptr_ioctl,
 };
 
 enum clear_refs_types {
@@ -1402,7 +1664,8 @@ static int pagemap_pte_hole(unsigned long start, unsigned long end,
 }
 
 static pagemap_entry_t pte_to_pagemap_entry(struct pagemapread *pm,
-		struct vm_area_struct *vma, unsigned long addr, pte_t pte)
+		struct vm_area_struct *vma, unsigned long addr, pte_t pte,
+		bool shared_table)
 {
 	u64 frame = 0, flags = 0;
 	struct page *page = NULL;
@@ -1447,7 +1710,7 @@ static pagemap_entry_t pte_to_pagemap_entry(struct pagemapread *pm,
 
 	if (page && !PageAnon(page))
 		flags |= PM_FILE;
-	if (page && !migration && page_mapcount(page) == 1)
+	if (page && !migration && !shared_table && page_mapcount(page) == 1)
 		flags |= PM_MMAP_EXCLUSIVE;
 	if (vma->vm_flags & VM_SOFTDIRTY)
 		flags |= PM_SOFT_DIRTY;
@@ -1462,6 +1725,7 @@ static int pagemap_pmd_range(pmd_t *pmdp, unsigned long addr, unsigned long end,
 	struct pagemapread *pm = walk->private;
 	spinlock_t *ptl;
 	pte_t *pte, *orig_pte;
+	bool shared_table;
 	int err = 0;
 #ifdef CONFIG_TRANSPARENT_HUGEPAGE
 	bool migration = false;
@@ -1544,10 +1808,11 @@ static int pagemap_pmd_range(pmd_t *pmdp, unsigned long addr, unsigned long end,
 	 * goes beyond vma->vm_end.
 	 */
 	orig_pte = pte = pte_offset_map_lock(walk->mm, pmdp, addr, &ptl);
+	shared_table = lazy_pte_table_shared(pmdp);
 	for (; addr < end; pte++, addr += PAGE_SIZE) {
 		pagemap_entry_t pme;
 
-		pme = pte_to_pagemap_entry(pm, vma, addr, *pte);
+		pme = pte_to_pagemap_entry(pm, vma, addr, *pte, shared_table);
 		err = add_to_pagemap(addr, &pme, pm);
 		if (err)
 			break;
@@ -1617,6 +1882,7 @@ static const struct mm_walk_ops pagemap_ops = {
 	.pmd_entry	= pagemap_pmd_range,
 	.pte_hole	= pagemap_pte_hole,
 	.hugetlb_entry	= pagemap_hugetlb_range,
+	.read_only	= true,
 };
 
 /*
@@ -1923,6 +2189,7 @@ static int gather_hugetlb_stats(pte_t *pte, unsigned long hmask,
 static const struct mm_walk_ops show_numa_ops = {
 	.hugetlb_entry = gather_hugetlb_stats,
 	.pmd_entry = gather_pte_stats,
+	.read_only = true,
 };
 
 /*
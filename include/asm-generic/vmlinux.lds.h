@@ -945,6 +945,7 @@
 #define INIT_CALLS_LEVEL(level)						\
 		__initcall##level##_start = .;				\
 		KEEP(*(.initcall##level##.init))			\
+		__initcall##level##s_start = .;				\
 		KEEP(*(.initcall##level##s.init))			\
 
 #define INIT_CALLS							\
@@ -959,7 +960,11 @@
 		INIT_CALLS_LEVEL(rootfs)				\
 		INIT_CALLS_LEVEL(6)					\
 		INIT_CALLS_LEVEL(7)					\
-		__initcall_end = .;
+		__initcall_end = .;					\
+		. = ALIGN(8);						\
+		__initcall_parallel_start = .;				\
+		KEEP(*(.initcall_parallel.init))			\
+		__initcall_parallel_end = .;
 
 #define CON_INITCALL							\
 		__con_initcall_start = .;				\
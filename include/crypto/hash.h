@@ -129,6 +129,12 @@ struct ahash_request {
  * @exit_tfm: Deinitialize the cryptographic transformation object.
  *	      This is a counterpart to @init_tfm, used to remove
  *	      various changes set in @init_tfm.
+ * @digest_batch: **[optional]** Perform @digest on a batch of requests that
+ *		  all use the same transformation object. Implementations can
+ *		  use this to process several independent messages at once,
+ *		  e.g. in the lanes of a multi-buffer engine. The result of
+ *		  each request is stored in the matching slot of the error
+ *		  array, and the first non-zero result is returned.
  * @halg: see struct hash_alg_common
  */
 struct ahash_alg {
@@ -143,6 +149,8 @@ struct ahash_alg {
 		      unsigned int keylen);
 	int (*init_tfm)(struct crypto_ahash *tfm);
 	void (*exit_tfm)(struct crypto_ahash *tfm);
+	int (*digest_batch)(struct ahash_request **reqs, int *errs,
+			    unsigned int nr);
 
 	struct hash_alg_common halg;
 };
@@ -162,6 +170,9 @@ struct shash_desc {
 
 #define HASH_MAX_STATESIZE	512
 
+/* Maximum number of messages a multi-buffer shash can hash at once */
+#define HASH_MAX_MB_MSGS	8
+
 #define SHASH_DESC_ON_STACK(shash, ctx)					     \
 	char __##shash##_desc[sizeof(struct shash_desc) + HASH_MAX_DESCSIZE] \
 		__aligned(__alignof__(struct shash_desc));		     \
@@ -177,6 +188,15 @@ struct shash_desc {
  * @export: see struct ahash_alg
  * @import: see struct ahash_alg
  * @setkey: see struct ahash_alg
+ * @finup_mb: **[optional]** Multi-buffer hashing. Finish the digests of
+ *	      @num_msgs messages of equal length at once, starting each of them
+ *	      from the state in the descriptor, which is left unchanged. This
+ *	      lets an implementation interleave the processing of independent
+ *	      messages. It is only called with 2 <= num_msgs <= @mb_max_msgs
+ *	      and may return -EOPNOTSUPP to make the caller fall back to
+ *	      hashing the messages one at a time.
+ * @mb_max_msgs: Maximum number of messages that @finup_mb accepts, at most
+ *		 %HASH_MAX_MB_MSGS. Set to 1 by the API if @finup_mb is absent.
  * @init_tfm: Initialize the cryptographic transformation object.
  *	      This function is called only once at the instantiation
  *	      time, right after the transformation context was
@@ -208,10 +228,14 @@ struct shash_alg {
 	int (*import)(struct shash_desc *desc, const void *in);
 	int (*setkey)(struct crypto_shash *tfm, const u8 *key,
 		      unsigned int keylen);
+	int (*finup_mb)(struct shash_desc *desc, const u8 * const data[],
+			unsigned int len, u8 * const outs[],
+			unsigned int num_msgs);
 	int (*init_tfm)(struct crypto_shash *tfm);
 	void (*exit_tfm)(struct crypto_shash *tfm);
 
 	unsigned int descsize;
+	unsigned int mb_max_msgs;
 
 	/* These fields must match hash_alg_common. */
 	unsigned int digestsize
@@ -231,6 +255,8 @@ struct crypto_ahash {
 	int (*import)(struct ahash_request *req, const void *in);
 	int (*setkey)(struct crypto_ahash *tfm, const u8 *key,
 		      unsigned int keylen);
+	int (*digest_batch)(struct ahash_request **reqs, int *errs,
+			    unsigned int nr);
 
 	unsigned int reqsize;
 	struct crypto_tfm base;
@@ -477,6 +503,23 @@ int crypto_ahash_final(struct ahash_request *req);
  */
 int crypto_ahash_digest(struct ahash_request *req);
 
+/**
+ * crypto_ahash_digest_batch() - calculate message digests for many buffers
+ * @reqs: array of @nr requests, all using the same cipher handle
+ * @errs: array of @nr slots receiving the result of each request
+ * @nr: number of requests
+ *
+ * This function behaves like calling crypto_ahash_digest() on each request,
+ * but allows the implementation to hash the independent messages together,
+ * e.g. with a multi-buffer engine. Each slot of @errs receives what
+ * crypto_ahash_digest() would have returned for the request; requests that
+ * complete asynchronously report through their own completion callback.
+ *
+ * Return: 0 if all requests returned 0, otherwise the first non-zero result
+ */
+int crypto_ahash_digest_batch(struct ahash_request **reqs, int *errs,
+			      unsigned int nr);
+
 /**
  * crypto_ahash_export() - extract current message digest state
  * @req: reference to the ahash_request handle whose state is exported
@@ -795,6 +838,18 @@ static inline unsigned int crypto_shash_statesize(struct crypto_shash *tfm)
 	return crypto_shash_alg(tfm)->statesize;
 }
 
+/**
+ * crypto_shash_mb_max_msgs() - obtain the multi-buffer width
+ * @tfm: cipher handle
+ *
+ * Return: the number of messages the algorithm can hash in parallel with
+ *	   crypto_shash_finup_mb(), or 1 if it has no multi-buffer support
+ */
+static inline unsigned int crypto_shash_mb_max_msgs(struct crypto_shash *tfm)
+{
+	return crypto_shash_alg(tfm)->mb_max_msgs;
+}
+
 static inline u32 crypto_shash_get_flags(struct crypto_shash *tfm)
 {
 	return crypto_tfm_get_flags(crypto_shash_tfm(tfm));
@@ -998,6 +1053,26 @@ int crypto_shash_final(struct shash_desc *desc, u8 *out);
 int crypto_shash_finup(struct shash_desc *desc, const u8 *data,
 		       unsigned int len, u8 *out);
 
+/**
+ * crypto_shash_finup_mb() - calculate message digests of several buffers
+ * @desc: the starting state, which is left unchanged
+ * @data: array of @num_msgs messages
+ * @len: length of each message in bytes; all messages have the same length
+ * @outs: array of @num_msgs output buffers for the digests
+ * @num_msgs: number of messages
+ *
+ * This is equivalent to calling crypto_shash_finup() on a copy of @desc for
+ * each message, except that algorithms with multi-buffer support hash up to
+ * crypto_shash_mb_max_msgs() messages in parallel. Any number of messages
+ * may be passed; larger batches are split up.
+ *
+ * Context: Any context.
+ * Return: 0 if all message digests were calculated; < 0 if an error occurred
+ */
+int crypto_shash_finup_mb(struct shash_desc *desc, const u8 * const data[],
+			  unsigned int len, u8 * const outs[],
+			  unsigned int num_msgs);
+
 static inline void shash_desc_zero(struct shash_desc *desc)
 {
 	memzero_explicit(desc,
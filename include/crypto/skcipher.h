@@ -83,6 +83,14 @@ struct crypto_sync_skcipher {
  *	     be called in parallel with the same transformation object.
  * @decrypt: Decrypt a single block. This is a reverse counterpart to @encrypt
  *	     and the conditions are exactly the same.
+ * @encrypt_batch: Optional. Encrypt a batch of requests that all use the same
+ *		   transformation object, as if @encrypt was called on each of
+ *		   them. This allows an implementation to process independent
+ *		   requests together, e.g. in the lanes of a multi-buffer
+ *		   engine. The result of each request is stored in the
+ *		   matching slot of the error array and the first non-zero
+ *		   result is returned.
+ * @decrypt_batch: Optional. Counterpart to @encrypt_batch for decryption.
  * @init: Initialize the cryptographic transformation object. This function
  *	  is used to initialize the cryptographic transformation object.
  *	  This function is called only once at the instantiation time, right
@@ -103,13 +111,18 @@ struct crypto_sync_skcipher {
  * 	      in parallel. Should be a multiple of chunksize.
  * @base: Definition of a generic crypto algorithm.
  *
- * All fields except @ivsize are mandatory and must be filled.
+ * All fields except @ivsize and the batch operations are mandatory and must
+ * be filled.
  */
 struct skcipher_alg {
 	int (*setkey)(struct crypto_skcipher *tfm, const u8 *key,
 	              unsigned int keylen);
 	int (*encrypt)(struct skcipher_request *req);
 	int (*decrypt)(struct skcipher_request *req);
+	int (*encrypt_batch)(struct skcipher_request **reqs, int *errs,
+			     unsigned int nr);
+	int (*decrypt_batch)(struct skcipher_request **reqs, int *errs,
+			     unsigned int nr);
 	int (*init)(struct crypto_skcipher *tfm);
 	void (*exit)(struct crypto_skcipher *tfm);
 
@@ -435,6 +448,36 @@ int crypto_skcipher_encrypt(struct skcipher_request *req);
  */
 int crypto_skcipher_decrypt(struct skcipher_request *req);
 
+/**
+ * crypto_skcipher_encrypt_batch() - encrypt several independent requests
+ * @reqs: array of @nr requests, all using the same cipher handle
+ * @errs: array of @nr slots receiving the result of each request
+ * @nr: number of requests
+ *
+ * This function behaves like calling crypto_skcipher_encrypt() on each
+ * request, but allows the implementation to process the requests together,
+ * e.g. with a multi-buffer engine. Each slot of @errs receives what
+ * crypto_skcipher_encrypt() would have returned for the request; requests
+ * that complete asynchronously report through their own completion callback.
+ *
+ * Return: 0 if all requests returned 0, otherwise the first non-zero result
+ */
+int crypto_skcipher_encrypt_batch(struct skcipher_request **reqs, int *errs,
+				  unsigned int nr);
+
+/**
+ * crypto_skcipher_decrypt_batch() - decrypt several independent requests
+ * @reqs: array of @nr requests, all using the same cipher handle
+ * @errs: array of @nr slots receiving the result of each request
+ * @nr: number of requests
+ *
+ * Counterpart to crypto_skcipher_encrypt_batch() for decryption.
+ *
+ * Return: 0 if all requests returned 0, otherwise the first non-zero result
+ */
+int crypto_skcipher_decrypt_batch(struct skcipher_request **reqs, int *errs,
+				  unsigned int nr);
+
 /**
  * DOC: Symmetric Key Cipher Request Handle
  *
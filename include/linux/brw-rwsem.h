@@ -0,0 +1,153 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Big reader rw-semaphore.
+ *
+ * A sleeping reader-writer lock for read-mostly data whose readers must
+ * not bounce a shared cache line. The reader side is selected when the
+ * lock is initialized:
+ *
+ *  - shared:  readers and writers use the embedded rw_semaphore, which
+ *             behaves exactly like a plain rwsem.
+ *  - percpu:  readers only touch a per-CPU counter. Writers exclude each
+ *             other with the embedded rw_semaphore, make new readers back
+ *             off and wait for the readers already inside to leave.
+ *
+ * Unlike percpu_rw_semaphore, a percpu mode writer does not wait for an RCU
+ * grace period, so its latency is bounded by the longest read-side critical
+ * section rather than by RCU. In exchange, the reader fast path carries a
+ * full memory barrier in lock and unlock. Writers are preferred: readers
+ * arriving while a writer is pending wait until it releases the lock.
+ */
+#ifndef _LINUX_BRW_RWSEM_H
+#define _LINUX_BRW_RWSEM_H
+
+#include <linux/atomic.h>
+#include <linux/percpu.h>
+#include <linux/rcuwait.h>
+#include <linux/rwsem.h>
+#include <linux/wait.h>
+#include <linux/lockdep.h>
+
+/* Use per-CPU reader counters instead of the shared rwsem count. */
+#define BRW_RWSEM_PERCPU	0x1
+
+struct brw_semaphore {
+	struct rw_semaphore	rwsem;
+	unsigned int __percpu	*read_count;
+	int			writer;
+	struct rcuwait		writer_wait;
+	wait_queue_head_t	waiters;
+};
+
+#define __DEFINE_BRW_RWSEM(name, is_static)				\
+static DEFINE_PER_CPU(unsigned int, __brw_rwsem_rc_##name);		\
+is_static struct brw_semaphore name = {					\
+	.rwsem = __RWSEM_INITIALIZER(name.rwsem),			\
+	.read_count = &__brw_rwsem_rc_##name,				\
+	.writer = 0,							\
+	.writer_wait = __RCUWAIT_INITIALIZER(name.writer_wait),		\
+	.waiters = __WAIT_QUEUE_HEAD_INITIALIZER(name.waiters),		\
+}
+
+/* Statically defined big reader rwsems always use percpu mode. */
+#define DEFINE_BRW_RWSEM(name)		\
+	__DEFINE_BRW_RWSEM(name, /* not static */)
+#define DEFINE_STATIC_BRW_RWSEM(name)	\
+	__DEFINE_BRW_RWSEM(name, static)
+
+static inline bool brw_rwsem_is_percpu(struct brw_semaphore *sem)
+{
+	return sem->read_count != NULL;
+}
+
+extern void __brw_down_read(struct brw_semaphore *sem);
+
+/*
+ * Announce the reader on this CPU and check for a pending writer. Either
+ * the writer sees the increment and waits for us, or we see the writer and
+ * back off. The acquire pairs with the release in brw_up_write() so that a
+ * reader admitted after a writer sees its critical section.
+ */
+static inline bool __brw_read_enter(struct brw_semaphore *sem)
+{
+	this_cpu_inc(*sem->read_count);
+	smp_mb(); /* A matches D */
+	return likely(!smp_load_acquire(&sem->writer));
+}
+
+static inline void __brw_read_exit(struct brw_semaphore *sem)
+{
+	/*
+	 * If the writer sees our decrement it must also see the critical
+	 * section; and if it went to sleep before seeing it, we must see
+	 * it pending and wake it.
+	 */
+	smp_mb(); /* B matches C */
+	this_cpu_dec(*sem->read_count);
+	smp_mb(); /* E matches D */
+	if (unlikely(READ_ONCE(sem->writer)))
+		rcuwait_wake_up(&sem->writer_wait);
+}
+
+static inline void brw_down_read(struct brw_semaphore *sem)
+{
+	might_sleep();
+
+	if (!brw_rwsem_is_percpu(sem)) {
+		down_read(&sem->rwsem);
+		return;
+	}
+
+	rwsem_acquire_read(&sem->rwsem.dep_map, 0, 0, _RET_IP_);
+	if (!__brw_read_enter(sem))
+		__brw_down_read(sem);
+}
+
+static inline int brw_down_read_trylock(struct brw_semaphore *sem)
+{
+	if (!brw_rwsem_is_percpu(sem))
+		return down_read_trylock(&sem->rwsem);
+
+	if (!__brw_read_enter(sem)) {
+		__brw_read_exit(sem);
+		return 0;
+	}
+
+	rwsem_acquire_read(&sem->rwsem.dep_map, 0, 1, _RET_IP_);
+	return 1;
+}
+
+static inline void brw_up_read(struct brw_semaphore *sem)
+{
+	if (!brw_rwsem_is_percpu(sem)) {
+		up_read(&sem->rwsem);
+		return;
+	}
+
+	rwsem_release(&sem->rwsem.dep_map, _RET_IP_);
+	__brw_read_exit(sem);
+}
+
+extern void brw_down_write(struct brw_semaphore *sem);
+extern int brw_down_write_trylock(struct brw_semaphore *sem);
+extern void brw_up_write(struct brw_semaphore *sem);
+
+extern void __brw_init_rwsem(struct brw_semaphore *sem, unsigned int flags,
+			     const char *name, struct lock_class_key *key);
+extern void brw_free_rwsem(struct brw_semaphore *sem);
+
+/*
+ * Initialize a big reader rwsem, in percpu mode if @flags has
+ * BRW_RWSEM_PERCPU. If the per-CPU counters cannot be allocated the lock
+ * falls back to shared mode, so initialization never fails.
+ */
+#define brw_init_rwsem(sem, flags)				\
+do {								\
+	static struct lock_class_key __key;			\
+								\
+	__brw_init_rwsem((sem), (flags), #sem, &__key);		\
+} while (0)
+
+#define brw_rwsem_assert_held(sem)	lockdep_assert_held(&(sem)->rwsem)
+
+#endif /* _LINUX_BRW_RWSEM_H */
@@ -306,6 +306,11 @@ struct dma_router {
 	void (*route_free)(struct device *dev, void *route_data);
 };
 
+struct dmaengine_batch_result;
+typedef void (*dma_async_tx_callback_batch)(void *dma_async_param,
+				const struct dmaengine_batch_result *results,
+				unsigned int count);
+
 /**
  * struct dma_chan - devices supply DMA channels, clients use them
  * @device: ptr to the dma device who supplies this channel, always !%NULL
@@ -324,6 +329,9 @@ struct dma_router {
  * @router: pointer to the DMA router structure
  * @route_data: channel specific data for the router
  * @private: private data for certain client-channel associations
+ * @callback_batch: optional routine reporting the results of several
+ *	completed descriptors at once, see dmaengine_set_batch_callback()
+ * @callback_batch_param: parameter passed to @callback_batch
  */
 struct dma_chan {
 	struct dma_device *device;
@@ -349,6 +357,9 @@ struct dma_chan {
 	void *route_data;
 
 	void *private;
+
+	dma_async_tx_callback_batch callback_batch;
+	void *callback_batch_param;
 };
 
 /**
@@ -549,6 +560,16 @@ struct dmaengine_result {
 typedef void (*dma_async_tx_callback_result)(void *dma_async_param,
 				const struct dmaengine_result *result);
 
+/**
+ * struct dmaengine_batch_result - result of one descriptor in a batch
+ * @cookie: cookie of the completed transaction
+ * @result: transaction result
+ */
+struct dmaengine_batch_result {
+	dma_cookie_t cookie;
+	struct dmaengine_result result;
+};
+
 struct dmaengine_unmap_data {
 #if IS_ENABLED(CONFIG_DMA_ENGINE_RAID)
 	u16 map_cnt;
@@ -840,6 +861,8 @@ struct dma_filter {
  *	will just return a simple status code
  * @device_issue_pending: push pending transactions to hardware
  * @descriptor_reuse: a submitted transfer can be resubmitted after completion
+ * @completion_batch: completions of descriptors without their own callback
+ *	can be reported through the channel's batch callback
  * @device_release: called sometime atfer dma_async_device_unregister() is
  *     called and there are no further references to this structure. This
  *     must be implemented to free resources however many existing drivers
@@ -877,6 +900,7 @@ struct dma_device {
 	u32 max_burst;
 	u32 max_sg_burst;
 	bool descriptor_reuse;
+	bool completion_batch;
 	enum dma_residue_granularity residue_granularity;
 
 	int (*device_alloc_chan_resources)(struct dma_chan *chan);
@@ -1570,6 +1594,33 @@ static inline int dmaengine_desc_free(struct dma_async_tx_descriptor *desc)
 	return desc->desc_free(desc);
 }
 
+/**
+ * dmaengine_set_batch_callback - report completions in batches
+ * @chan: DMA channel
+ * @callback: routine called with an array of completed transactions, or
+ *	%NULL to go back to per-descriptor reporting
+ * @param: opaque parameter passed to @callback
+ *
+ * Once set, descriptors submitted without a callback of their own are
+ * reported through @callback, several at a time, from the same context in
+ * which per-descriptor callbacks would have run. Descriptors that carry a
+ * callback are still reported individually, in completion order relative
+ * to the batched ones.
+ *
+ * Must only be called while no transfers are in flight on @chan.
+ */
+static inline int dmaengine_set_batch_callback(struct dma_chan *chan,
+		dma_async_tx_callback_batch callback, void *param)
+{
+	if (!chan->device->completion_batch)
+		return -EOPNOTSUPP;
+
+	chan->callback_batch_param = param;
+	/* pairs with READ_ONCE() in the completion path */
+	WRITE_ONCE(chan->callback_batch, callback);
+	return 0;
+}
+
 /* --- DMA device --- */
 
 int dma_async_device_register(struct dma_device *device);
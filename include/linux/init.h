@@ -297,6 +297,57 @@ extern bool initcall_debug;
 
 #define console_initcall(fn)	___define_initcall(fn, con, .con_initcall)
 
+/*
+ * Parallel initcalls run on worker threads once every initcall listed after
+ * @fn has returned, concurrently with the plain initcalls of their level.
+ * They have all returned before the next level starts, and only the plain
+ * initcalls keep their link order. Dependencies are other parallel initcall
+ * functions of the same or an earlier level, which must be declared where
+ * they are referenced, e.g.:
+ *
+ *	device_initcall_parallel(foo_codec_init, foo_bus_init);
+ *
+ * Booting with initcall_parallel=0 runs them serially, in dependency order,
+ * after the plain initcalls of their level.
+ */
+struct initcall_parallel {
+	initcall_t fn;
+	const initcall_t *deps;
+	unsigned int nr_deps;
+	int level;
+};
+
+#define __define_initcall_parallel(fn, lvl, ...)			\
+	static const initcall_t __initcall_deps_##fn[] __initconst =	\
+		{ __VA_ARGS__ };					\
+	static const struct initcall_parallel __initcall_parallel_##fn	\
+		__used __section(".initcall_parallel.init")		\
+		__aligned(__alignof__(struct initcall_parallel)) = {	\
+		.fn = fn,						\
+		.deps = __initcall_deps_##fn,				\
+		.nr_deps = sizeof(__initcall_deps_##fn) /		\
+			   sizeof(__initcall_deps_##fn[0]),		\
+		.level = lvl,						\
+	};								\
+	static_assert(__same_type(initcall_t, &fn))
+
+#define pure_initcall_parallel(fn, ...)		\
+	__define_initcall_parallel(fn, 0, ##__VA_ARGS__)
+#define core_initcall_parallel(fn, ...)		\
+	__define_initcall_parallel(fn, 1, ##__VA_ARGS__)
+#define postcore_initcall_parallel(fn, ...)	\
+	__define_initcall_parallel(fn, 2, ##__VA_ARGS__)
+#define arch_initcall_parallel(fn, ...)		\
+	__define_initcall_parallel(fn, 3, ##__VA_ARGS__)
+#define subsys_initcall_parallel(fn, ...)	\
+	__define_initcall_parallel(fn, 4, ##__VA_ARGS__)
+#define fs_initcall_parallel(fn, ...)		\
+	__define_initcall_parallel(fn, 5, ##__VA_ARGS__)
+#define device_initcall_parallel(fn, ...)	\
+	__define_initcall_parallel(fn, 6, ##__VA_ARGS__)
+#define late_initcall_parallel(fn, ...)		\
+	__define_initcall_parallel(fn, 7, ##__VA_ARGS__)
+
 struct obs_kernel_param {
 	const char *str;
 	int (*setup_func)(char *);
@@ -196,9 +196,18 @@ struct kvm_io_range {
 
 #define NR_IOBUS_DEVS 1000
 
+/*
+ * Devices are sorted by address in range[]. Ranges that no other range
+ * overlaps (typically ioeventfds) are also hashed by address into hash[],
+ * which is allocated right after range[] and holds indexes into it, so
+ * that exact address accesses do not need a binary search.
+ */
 struct kvm_io_bus {
 	int dev_count;
 	int ioeventfd_count;
+	unsigned int hash_bits;
+	int *hash;
+	struct rcu_head rcu;
 	struct kvm_io_range range[];
 };
 
@@ -306,6 +315,23 @@ struct kvm_mmio_fragment {
 	unsigned len;
 };
 
+enum kvm_wake_source {
+	KVM_WAKE_TIMER,
+	KVM_WAKE_IRQ,
+	KVM_NR_WAKE_SOURCES,
+};
+
+/*
+ * Per-vCPU wakeup history used by the predictive halt-polling policy.  For
+ * each wakeup source, period_ns is a moving average of the interval between
+ * wakeups and jitter_ns a moving average of its deviation.
+ */
+struct kvm_halt_predictor {
+	u64 last_wake_ns[KVM_NR_WAKE_SOURCES];
+	u64 period_ns[KVM_NR_WAKE_SOURCES];
+	u64 jitter_ns[KVM_NR_WAKE_SOURCES];
+};
+
 struct kvm_vcpu {
 	struct kvm *kvm;
 #ifdef CONFIG_PREEMPT_NOTIFIERS
@@ -333,6 +359,7 @@ struct kvm_vcpu {
 	sigset_t sigset;
 	unsigned int halt_poll_ns;
 	bool valid_wakeup;
+	struct kvm_halt_predictor halt_predict;
 
 #ifdef CONFIG_HAS_IOMEM
 	int mmio_needed;
@@ -1858,6 +1885,9 @@ struct _kvm_stats_desc {
 	STATS_DESC_TIME_NSEC(VCPU_GENERIC, halt_poll_success_ns),	       \
 	STATS_DESC_TIME_NSEC(VCPU_GENERIC, halt_poll_fail_ns),		       \
 	STATS_DESC_TIME_NSEC(VCPU_GENERIC, halt_wait_ns),		       \
+	STATS_DESC_COUNTER(VCPU_GENERIC, halt_poll_predict_hits),	       \
+	STATS_DESC_COUNTER(VCPU_GENERIC, halt_poll_predict_misses),	       \
+	STATS_DESC_TIME_NSEC(VCPU_GENERIC, halt_poll_predict_wasted_ns),       \
 	STATS_DESC_LOGHIST_TIME_NSEC(VCPU_GENERIC, halt_poll_success_hist,     \
 			HALT_POLL_HIST_COUNT),				       \
 	STATS_DESC_LOGHIST_TIME_NSEC(VCPU_GENERIC, halt_poll_fail_hist,	       \
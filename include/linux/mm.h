@@ -2419,6 +2419,9 @@ static inline bool pgtable_pte_page_ctor(struct page *page)
 {
 	if (!ptlock_init(page))
 		return false;
+#ifdef CONFIG_LAZY_PTE_COPY
+	atomic_set(&page->pt_share_count, 1);
+#endif
 	__SetPageTable(page);
 	inc_lruvec_page_state(page, NR_PAGETABLE);
 	return true;
@@ -2458,6 +2461,77 @@ static inline void pgtable_pte_page_dtor(struct page *page)
 	((unlikely(pmd_none(*(pmd))) && __pte_alloc_kernel(pmd))? \
 		NULL: pte_offset_kernel(pmd, address))
 
+#ifdef CONFIG_LAZY_PTE_COPY
+/*
+ * A pte table shared between several mms by fork() is write-protected and
+ * must not be modified: unshare it first, or skip it if only looking.
+ */
+static inline bool lazy_pte_pmd_shared(pmd_t pmd)
+{
+	return pmd_present(pmd) && !pmd_trans_huge(pmd) && !pmd_devmap(pmd) &&
+	       atomic_read(&pmd_page(pmd)->pt_share_count) > 1;
+}
+
+static inline bool lazy_pte_table_shared(pmd_t *pmd)
+{
+	return lazy_pte_pmd_shared(READ_ONCE(*pmd));
+}
+
+/*
+ * Number of mms mapping the pte table at @pmd. Pages under a shared table
+ * are accounted once in their mapcount however many mms map the table, so
+ * walkers that report sharing have to scale by this. Stable under the
+ * table's ptl.
+ */
+static inline int lazy_pte_table_sharers(pmd_t *pmd)
+{
+	if (!lazy_pte_table_shared(pmd))
+		return 1;
+	return atomic_read(&pmd_page(READ_ONCE(*pmd))->pt_share_count);
+}
+
+extern int __lazy_pte_unshare(struct vm_area_struct *vma, pmd_t *pmd,
+			      unsigned long addr, gfp_t gfp);
+extern void lazy_pte_drain(struct mmu_gather *tlb);
+
+/*
+ * Give @vma's mm a private copy of the pte table mapping @addr if it is
+ * shared. Cannot fail if @gfp has __GFP_NOFAIL.
+ */
+static inline int lazy_pte_unshare(struct vm_area_struct *vma, pmd_t *pmd,
+				   unsigned long addr, gfp_t gfp)
+{
+	if (likely(!lazy_pte_table_shared(pmd)))
+		return 0;
+	return __lazy_pte_unshare(vma, pmd, addr, gfp);
+}
+#else
+static inline bool lazy_pte_pmd_shared(pmd_t pmd)
+{
+	return false;
+}
+
+static inline bool lazy_pte_table_shared(pmd_t *pmd)
+{
+	return false;
+}
+
+static inline int lazy_pte_table_sharers(pmd_t *pmd)
+{
+	return 1;
+}
+
+static inline int lazy_pte_unshare(struct vm_area_struct *vma, pmd_t *pmd,
+				   unsigned long addr, gfp_t gfp)
+{
+	return 0;
+}
+
+static inline void lazy_pte_drain(struct mmu_gather *tlb)
+{
+}
+#endif /* CONFIG_LAZY_PTE_COPY */
+
 #if USE_SPLIT_PMD_PTLOCKS
 
 static struct page *pmd_to_page(pmd_t *pmd)
@@ -123,6 +123,14 @@ extern void cleanup_module(void);
 #define late_initcall(fn)		module_init(fn)
 #define late_initcall_sync(fn)		module_init(fn)
 
+#define core_initcall_parallel(fn, ...)		module_init(fn)
+#define postcore_initcall_parallel(fn, ...)	module_init(fn)
+#define arch_initcall_parallel(fn, ...)		module_init(fn)
+#define subsys_initcall_parallel(fn, ...)	module_init(fn)
+#define fs_initcall_parallel(fn, ...)		module_init(fn)
+#define device_initcall_parallel(fn, ...)	module_init(fn)
+#define late_initcall_parallel(fn, ...)		module_init(fn)
+
 #define console_initcall(fn)		module_init(fn)
 
 /* Each module must use one module_init(). */
@@ -29,6 +29,7 @@
  * @pd: Pointer to the internal control structure.
  * @cb_cpu: Callback cpu for serializatioon.
  * @seq_nr: Sequence number of the parallelized data object.
+ * @flow: Flow of the object, set by the caller on shells with flows.
  * @info: Used to pass information from the parallel to the serial function.
  * @parallel: Parallel execution function.
  * @serial: Serial complete function.
@@ -38,6 +39,7 @@ struct padata_priv {
 	struct parallel_data	*pd;
 	int			cb_cpu;
 	unsigned int		seq_nr;
+	u32			flow;
 	int			info;
 	void                    (*parallel)(struct padata_priv *padata);
 	void                    (*serial)(struct padata_priv *padata);
@@ -48,10 +50,12 @@ struct padata_priv {
  *
  * @list: List head.
  * @lock: List lock.
+ * @depth: Number of objects on @list, kept for reorder lists only.
  */
 struct padata_list {
 	struct list_head        list;
 	spinlock_t              lock;
+	unsigned int		depth;
 };
 
 /**
@@ -67,6 +71,41 @@ struct padata_serial_queue {
        struct parallel_data *pd;
 };
 
+/**
+ * struct padata_flow - Reorder state of one flow
+ *
+ * @reorder: Objects of the flow waiting for serialization, by sequence number.
+ * @lock: Protects @reorder and the sequence numbers.
+ * @seq_nr: Sequence number of the last object of the flow.
+ * @processed: Sequence number of the next object to serialize.
+ * @depth: Number of objects on @reorder.
+ */
+struct padata_flow {
+	struct list_head	reorder;
+	spinlock_t		lock;
+	unsigned int		seq_nr;
+	unsigned int		processed;
+	unsigned int		depth;
+} ____cacheline_aligned_in_smp;
+
+/**
+ * struct padata_reorder_stats - Per-CPU reorder queue statistics of a shell
+ *
+ * @enqueued: Objects done with parallel processing and put on a reorder queue.
+ * @serialized: Objects handed to the serial workers.
+ * @reordered: Objects that finished ahead of an earlier object.
+ * @max_depth: Longest reorder queue an object was put on from this CPU.
+ *
+ * The objects waiting to be ordered are the sum of @enqueued less the sum
+ * of @serialized over all CPUs.
+ */
+struct padata_reorder_stats {
+	unsigned long		enqueued;
+	unsigned long		serialized;
+	unsigned long		reordered;
+	unsigned int		max_depth;
+};
+
 /**
  * struct padata_cpumask - The cpumasks for the parallel/serial workers
  *
@@ -91,6 +130,8 @@ struct padata_cpumask {
  * @cpu: Next CPU to be processed.
  * @cpumask: The cpumasks in use for parallel and serial workers.
  * @reorder_work: work struct for reordering.
+ * @flows: Per-flow reorder state, used instead of @reorder_list if set.
+ * @nr_flows: Number of entries in @flows.
  * @lock: Reorder lock.
  */
 struct parallel_data {
@@ -103,6 +144,8 @@ struct parallel_data {
 	int				cpu;
 	struct padata_cpumask		cpumask;
 	struct work_struct		reorder_work;
+	struct padata_flow		*flows;
+	unsigned int			nr_flows;
 	spinlock_t                      ____cacheline_aligned lock;
 };
 
@@ -115,12 +158,16 @@ struct parallel_data {
  * @pd: Actual parallel_data structure which may be substituted on the fly.
  * @opd: Pointer to old pd to be freed by padata_replace.
  * @list: List entry in padata_instance list.
+ * @nr_flows: Number of independently ordered flows, 0 to order all objects.
+ * @stats: Per-CPU reorder queue statistics, kept across pd replacements.
  */
 struct padata_shell {
 	struct padata_instance		*pinst;
 	struct parallel_data __rcu	*pd;
 	struct parallel_data		*opd;
 	struct list_head		list;
+	unsigned int			nr_flows;
+	struct padata_reorder_stats __percpu *stats;
 };
 
 /**
@@ -185,6 +232,8 @@ static inline void __init padata_init(void) {}
 extern struct padata_instance *padata_alloc(const char *name);
 extern void padata_free(struct padata_instance *pinst);
 extern struct padata_shell *padata_alloc_shell(struct padata_instance *pinst);
+extern struct padata_shell *
+padata_alloc_shell_flows(struct padata_instance *pinst, unsigned int nr_flows);
 extern void padata_free_shell(struct padata_shell *ps);
 extern int padata_do_parallel(struct padata_shell *ps,
 			      struct padata_priv *padata, int *cb_cpu);
@@ -220,6 +220,15 @@ static inline struct pid *tgid_pidfd_to_pid(const struct file *file)
 
 #endif /* CONFIG_PROC_FS */
 
+struct mm_struct;
+#ifdef CONFIG_PROC_PAGE_MONITOR
+extern void smaps_cache_free(struct mm_struct *mm);
+#else
+static inline void smaps_cache_free(struct mm_struct *mm)
+{
+}
+#endif
+
 struct net;
 
 static inline struct proc_dir_entry *proc_net_mkdir(
@@ -7,6 +7,7 @@
 #ifndef _LINUX_SERIAL_8250_H
 #define _LINUX_SERIAL_8250_H
 
+#include <linux/serial.h>
 #include <linux/serial_core.h>
 #include <linux/serial_reg.h>
 #include <linux/platform_device.h>
@@ -138,6 +139,15 @@ struct uart_8250_port {
 	/* Serial port overrun backoff */
 	struct delayed_work overrun_backoff;
 	u32 overrun_backoff_time_ms;
+
+	/* Receive burst timestamps, recorded in TIOCSRXTSTAMP mode */
+	bool			rx_tstamp;
+	unsigned char		rx_tstamp_trig;	/* FCR trigger to restore */
+	struct serial_rx_burst	rx_bursts[SER_RX_BURSTS_MAX];
+	unsigned int		rx_burst_head;
+	unsigned int		rx_burst_nr;
+	unsigned int		rx_burst_lost;
+	u64			rx_offset;
 };
 
 static inline struct uart_8250_port *up_to_u8250p(struct uart_port *up)
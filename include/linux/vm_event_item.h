@@ -143,6 +143,10 @@ enum vm_event_item { PGPGIN, PGPGOUT, PSWPIN, PSWPOUT,
 		ZSWPIN,
 		ZSWPOUT,
 #endif
+#ifdef CONFIG_LAZY_PTE_COPY
+		PTE_TABLE_SHARE,
+		PTE_TABLE_UNSHARE,
+#endif
 #ifdef CONFIG_X86
 		DIRECT_MAP_LEVEL2_SPLIT,
 		DIRECT_MAP_LEVEL3_SPLIT,
@@ -80,6 +80,7 @@ extern const struct nft_set_type nft_set_rbtree_type;
 extern const struct nft_set_type nft_set_bitmap_type;
 extern const struct nft_set_type nft_set_pipapo_type;
 extern const struct nft_set_type nft_set_pipapo_avx2_type;
+extern const struct nft_set_type nft_set_pipapo_neon_type;
 
 #ifdef CONFIG_RETPOLINE
 bool nft_rhash_lookup(const struct net *net, const struct nft_set *set,
@@ -104,12 +105,14 @@ nft_set_do_lookup(const struct net *net, const struct nft_set *set,
 }
 #endif
 
-/* called from nft_pipapo_avx2.c */
+/* called from nft_pipapo_avx2.c and nft_set_pipapo_neon.c */
 bool nft_pipapo_lookup(const struct net *net, const struct nft_set *set,
 		       const u32 *key, const struct nft_set_ext **ext);
 /* called from nft_set_pipapo.c */
 bool nft_pipapo_avx2_lookup(const struct net *net, const struct nft_set *set,
 			    const u32 *key, const struct nft_set_ext **ext);
+bool nft_pipapo_neon_lookup(const struct net *net, const struct nft_set *set,
+			    const u32 *key, const struct nft_set_ext **ext);
 
 void nft_counter_init_seqcount(void);
 
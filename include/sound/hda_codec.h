@@ -260,6 +260,7 @@ struct hda_codec {
 	unsigned int forced_resume:1; /* forced resume for jack */
 	unsigned int no_stream_clean_at_suspend:1; /* do not clean streams at suspend */
 	unsigned int ctl_dev_id:1; /* old control element id build behaviour */
+	unsigned int build_deferred:1; /* PCMs/controls built by the bus */
 
 #ifdef CONFIG_PM
 	unsigned long power_on_acct;
@@ -316,6 +317,7 @@ int snd_hda_codec_device_new(struct hda_bus *bus, struct snd_card *card,
 		      unsigned int codec_addr, struct hda_codec *codec,
 		      bool snddev_managed);
 int snd_hda_codec_configure(struct hda_codec *codec);
+int snd_hda_codec_build_deferred(struct hda_codec *codec);
 int snd_hda_codec_update_widgets(struct hda_codec *codec);
 void snd_hda_codec_register(struct hda_codec *codec);
 void snd_hda_codec_unregister(struct hda_codec *codec);
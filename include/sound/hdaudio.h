@@ -75,10 +75,13 @@ struct hdac_device {
 	/* verb exec op override */
 	int (*exec_verb)(struct hdac_device *dev, unsigned int cmd,
 			 unsigned int flags, unsigned int *res);
+	int (*exec_verbs)(struct hdac_device *dev, const unsigned int *cmds,
+			  unsigned int *res, unsigned int num);
 
 	/* widgets */
 	unsigned int num_nodes;
 	hda_nid_t start_nid, end_nid;
+	struct hdac_topo_cache *topo;	/* cached parameters, may be NULL */
 
 	/* misc flags */
 	atomic_t in_pm;		/* suspend/resume being performed */
@@ -126,6 +129,9 @@ int snd_hdac_device_set_chip_name(struct hdac_device *codec, const char *name);
 int snd_hdac_codec_modalias(struct hdac_device *hdac, char *buf, size_t size);
 
 int snd_hdac_refresh_widgets(struct hdac_device *codec);
+#ifdef CONFIG_SND_HDA_TOPO_CACHE
+extern const struct attribute_group snd_hdac_topo_attr_group;
+#endif
 
 int snd_hdac_read(struct hdac_device *codec, hda_nid_t nid,
 		  unsigned int verb, unsigned int parm, unsigned int *res);
@@ -135,6 +141,10 @@ int snd_hdac_read_parm_uncached(struct hdac_device *codec, hda_nid_t nid,
 				int parm);
 int snd_hdac_override_parm(struct hdac_device *codec, hda_nid_t nid,
 			   unsigned int parm, unsigned int val);
+int snd_hdac_exec_verbs(struct hdac_device *codec, const unsigned int *cmds,
+			unsigned int *res, unsigned int num);
+int snd_hdac_prefetch_parms(struct hdac_device *codec, const hda_nid_t *nids,
+			    unsigned int num, unsigned int parm);
 int snd_hdac_get_connections(struct hdac_device *codec, hda_nid_t nid,
 			     hda_nid_t *conn_list, int max_conns);
 int snd_hdac_get_sub_nodes(struct hdac_device *codec, hda_nid_t nid,
@@ -326,6 +336,11 @@ struct hdac_bus {
 	unsigned int last_cmd[HDA_MAX_CODECS];	/* last sent command */
 	wait_queue_head_t rirb_wq;
 
+	/* responses of batched verbs in flight, protected by reg_lock */
+	u32 *batch_res[HDA_MAX_CODECS];
+	unsigned int batch_len[HDA_MAX_CODECS];
+	unsigned int batch_max[HDA_MAX_CODECS];
+
 	/* CORB/RIRB and position buffers */
 	struct snd_dma_buffer rb;
 	struct snd_dma_buffer posbuf;
@@ -347,6 +362,7 @@ struct hdac_bus {
 	bool corbrp_self_clear:1;	/* CORBRP clears itself after reset */
 	bool polling_mode:1;
 	bool needs_damn_long_delay:1;
+	bool batch_verbs:1;		/* several verbs in flight per codec */
 
 	int poll_count;
 
@@ -382,6 +398,9 @@ int snd_hdac_bus_init(struct hdac_bus *bus, struct device *dev,
 void snd_hdac_bus_exit(struct hdac_bus *bus);
 int snd_hdac_bus_exec_verb_unlocked(struct hdac_bus *bus, unsigned int addr,
 				    unsigned int cmd, unsigned int *res);
+int snd_hdac_bus_exec_verbs_unlocked(struct hdac_bus *bus, unsigned int addr,
+				     const unsigned int *cmds,
+				     unsigned int *res, unsigned int num);
 
 void snd_hdac_codec_link_up(struct hdac_device *codec);
 void snd_hdac_codec_link_down(struct hdac_device *codec);
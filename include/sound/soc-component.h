@@ -221,6 +221,8 @@ struct snd_soc_component {
 
 	/* attached dynamic objects */
 	struct list_head dobj_list;
+	/* topology objects not created yet */
+	struct snd_soc_tplg_lazy *tplg_lazy;
 
 	/*
 	 * DO NOT use any of the fields below in drivers, they are temporary and
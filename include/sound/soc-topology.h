@@ -30,6 +30,7 @@ struct snd_soc_dai_link;
 struct snd_soc_dai_driver;
 struct snd_soc_dai;
 struct snd_soc_dapm_route;
+struct snd_soc_pcm_runtime;
 
 /* dynamic object type */
 enum snd_soc_dobj_type {
@@ -101,6 +102,21 @@ struct snd_soc_tplg_widget_events {
 			struct snd_kcontrol *k, int event);
 };
 
+/*
+ * Topology loader flags, see snd_soc_tplg_ops.flags
+ *
+ * IN_PLACE: the caller keeps the firmware until the topology is removed
+ * with snd_soc_tplg_component_remove(), so that names are referenced in
+ * the firmware instead of being copied.
+ *
+ * LAZY_WIDGETS: DAPM widgets and the routes between them are created when
+ * a PCM whose stream reaches them is opened for the first time instead of
+ * at load time.  Requires IN_PLACE.  The widget controls don't exist until
+ * then, and the complete callback sees only the widgets created at load.
+ */
+#define SND_SOC_TPLG_FLAG_IN_PLACE	(1 << 0)
+#define SND_SOC_TPLG_FLAG_LAZY_WIDGETS	(1 << 1)
+
 /*
  * Public API - Used by component drivers to load and unload dynamic objects
  * and their resources.
@@ -164,6 +180,9 @@ struct snd_soc_tplg_ops {
 	/* vendor specific bytes ext handlers available for binding */
 	const struct snd_soc_tplg_bytes_ext_ops *bytes_ext_ops;
 	int bytes_ext_ops_count;
+
+	/* loader behaviour, SND_SOC_TPLG_FLAG_* */
+	unsigned int flags;
 };
 
 #ifdef CONFIG_SND_SOC_TOPOLOGY
@@ -186,6 +205,9 @@ int snd_soc_tplg_widget_bind_event(struct snd_soc_dapm_widget *w,
 	const struct snd_soc_tplg_widget_events *events, int num_events,
 	u16 event_type);
 
+/* Creates the deferred widgets used by a PCM stream */
+int snd_soc_tplg_pcm_open(struct snd_soc_pcm_runtime *rtd, int stream);
+
 #else
 
 static inline int snd_soc_tplg_component_remove(struct snd_soc_component *comp)
@@ -193,6 +215,12 @@ static inline int snd_soc_tplg_component_remove(struct snd_soc_component *comp)
 	return 0;
 }
 
+static inline int snd_soc_tplg_pcm_open(struct snd_soc_pcm_runtime *rtd,
+					int stream)
+{
+	return 0;
+}
+
 #endif
 
 #endif
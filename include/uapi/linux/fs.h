@@ -93,6 +93,31 @@ struct file_dedupe_range {
 	struct file_dedupe_range_info info[];
 };
 
+/* Flags for struct procfs_smaps_rollup */
+#define PROCFS_SMAPS_ROLLUP_FAST	0x1	/* only what the mm counts */
+
+/*
+ * Argument of PROCFS_SMAPS_ROLLUP_QUERY on /proc/<pid>/smaps_rollup, all
+ * sizes in bytes. With PROCFS_SMAPS_ROLLUP_FAST only the fields up to swap
+ * are filled in, from counters kept by the mm, without walking page tables;
+ * swap then does not include swapped out shmem. rss_anon, rss_file and
+ * rss_shmem always come from those counters.
+ */
+struct procfs_smaps_rollup {
+	__u64 size;		/* in - sizeof(struct procfs_smaps_rollup) */
+	__u64 flags;		/* in - PROCFS_SMAPS_ROLLUP_* */
+	__u64 rss;		/* out */
+	__u64 rss_anon;		/* out */
+	__u64 rss_file;		/* out */
+	__u64 rss_shmem;	/* out */
+	__u64 swap;		/* out */
+	__u64 pss;		/* out - zero with PROCFS_SMAPS_ROLLUP_FAST */
+	__u64 pss_anon;		/* out - ditto */
+	__u64 pss_file;		/* out - ditto */
+	__u64 pss_shmem;	/* out - ditto */
+	__u64 swap_pss;		/* out - ditto */
+};
+
 /* And dynamically-tunable limits and defaults: */
 struct files_stat_struct {
 	unsigned long nr_files;		/* read only */
@@ -216,6 +241,10 @@ struct fsxattr {
 #define FS_IOC_GETFSLABEL		_IOR(0x94, 49, char[FSLABEL_MAX])
 #define FS_IOC_SETFSLABEL		_IOW(0x94, 50, char[FSLABEL_MAX])
 
+/* /proc/<pid>/smaps_rollup ioctl */
+#define PROCFS_IOCTL_MAGIC		'f'
+#define PROCFS_SMAPS_ROLLUP_QUERY	_IOWR(PROCFS_IOCTL_MAGIC, 18, struct procfs_smaps_rollup)
+
 /*
  * Inode flags (FS_IOC_GETFLAGS / FS_IOC_SETFLAGS)
  *
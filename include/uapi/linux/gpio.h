@@ -300,6 +300,43 @@ struct gpio_v2_line_event {
 	__u32 padding[6];
 };
 
+/**
+ * struct gpio_v2_line_event_ring - Header of the mmap()able line event ring
+ * @head: index of the next event to be written, updated only by the kernel
+ * after the event slot has been written
+ * @head_reserved: index following the slot being written, updated by the
+ * kernel before the event slot is written
+ * @num_events: the number of event slots in the ring, always a power of two
+ * @events_offset: offset in bytes from the start of the mapping to the
+ * first &struct gpio_v2_line_event slot
+ * @padding: reserved for future use
+ *
+ * A line request fd may be mmap()ed once, read-only and shared, at offset
+ * 0, with a length of one page for this header plus a power of two number
+ * of &struct gpio_v2_line_event slots.  From then on edge events are
+ * written to the ring instead of being returned by read().
+ *
+ * The ring is never written by userspace.  The kernel keeps writing when
+ * the reader falls behind, overwriting the oldest events.  @head and
+ * @head_reserved are free running and are reduced modulo @num_events to
+ * index a slot.  The reader keeps its own tail, reads @head with acquire
+ * semantics and copies the slots from its tail up to @head.  It then reads
+ * @head_reserved, after a read barrier, and discards the copied slots with
+ * an index below @head_reserved minus @num_events, as those may have been
+ * overwritten while being copied.  Lost events show up as gaps in seqno.
+ *
+ * The fd polls readable if events were written since poll last reported
+ * it readable.
+ */
+struct gpio_v2_line_event_ring {
+	__u32 head;
+	__u32 head_reserved;
+	__u32 num_events;
+	__u32 events_offset;
+	/* Space reserved for future use. */
+	__u32 padding[12];
+};
+
 /*
  * ABI v1
  *
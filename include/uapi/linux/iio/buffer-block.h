@@ -0,0 +1,58 @@
+/* SPDX-License-Identifier: GPL-2.0 WITH Linux-syscall-note */
+/* industrial I/O block based buffer access
+ *
+ * Blocks are allocated by the IIO core on a buffer fd obtained through
+ * IIO_BUFFER_GET_FD_IOCTL and exported to userspace as dma-bufs, which can
+ * be mmap()ed or passed on to another device without copying the samples.
+ */
+#ifndef _UAPI_IIO_BUFFER_BLOCK_H_
+#define _UAPI_IIO_BUFFER_BLOCK_H_
+
+#include <linux/ioctl.h>
+#include <linux/types.h>
+
+/* The maximum number of blocks that can be allocated on a buffer */
+#define IIO_BUFFER_BLOCK_MAX	64
+
+/**
+ * struct iio_buffer_block_alloc_req - Descriptor for allocating IIO blocks
+ * @size:	size of each block in bytes, rounded up to a page
+ * @count:	number of blocks to allocate, at most %IIO_BUFFER_BLOCK_MAX
+ * @reserved:	reserved for future use, must be zero
+ */
+struct iio_buffer_block_alloc_req {
+	__u32 size;
+	__u32 count;
+	__u32 reserved[2];
+};
+
+/**
+ * struct iio_buffer_block - Descriptor for a single IIO block
+ * @id:		index of the block, from 0 to the allocated count minus one
+ * @size:	total size of the block in bytes
+ * @bytes_used:	number of bytes of scan data in the block, set on dequeue
+ * @fd:		dma-buf file descriptor of the block, set on query
+ * @reserved:	reserved for future use, must be zero
+ *
+ * Blocks can be allocated once per buffer fd, while the buffer is disabled,
+ * and are released when the fd is closed. Newly allocated blocks belong to
+ * userspace and must be enqueued before the buffer is enabled. Enqueued
+ * blocks are filled with whole scans in order and handed back through
+ * IIO_BUFFER_BLOCK_DEQUEUE_IOCTL once full, or once the buffer is disabled.
+ * The buffer fd polls readable while a filled block is waiting to be
+ * dequeued.
+ */
+struct iio_buffer_block {
+	__u32 id;
+	__u32 size;
+	__u32 bytes_used;
+	__s32 fd;
+	__u64 reserved[2];
+};
+
+#define IIO_BUFFER_BLOCK_ALLOC_IOCTL	_IOWR('i', 0x92, struct iio_buffer_block_alloc_req)
+#define IIO_BUFFER_BLOCK_QUERY_IOCTL	_IOWR('i', 0x93, struct iio_buffer_block)
+#define IIO_BUFFER_BLOCK_ENQUEUE_IOCTL	_IOW('i', 0x94, struct iio_buffer_block)
+#define IIO_BUFFER_BLOCK_DEQUEUE_IOCTL	_IOWR('i', 0x95, struct iio_buffer_block)
+
+#endif /* _UAPI_IIO_BUFFER_BLOCK_H_ */
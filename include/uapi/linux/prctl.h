@@ -281,6 +281,10 @@ struct prctl_mm_map {
 # define PR_SME_VL_LEN_MASK		0xffff
 # define PR_SME_VL_INHERIT		(1 << 17) /* inherit across exec */
 
+/* Share anonymous page tables with children at fork, copy on first write */
+#define PR_SET_LAZY_PTE_COPY		90
+#define PR_GET_LAZY_PTE_COPY		91
+
 #define PR_SET_VMA		0x53564d41
 # define PR_SET_VMA_ANON_NAME		0
 
@@ -11,6 +11,7 @@
 #ifndef _UAPI_LINUX_SERIAL_H
 #define _UAPI_LINUX_SERIAL_H
 
+#include <linux/ioctl.h>
 #include <linux/types.h>
 
 #include <linux/tty_flags.h>
@@ -165,4 +166,35 @@ struct serial_iso7816 {
 	__u32	reserved[5];
 };
 
+/*
+ * Receive timestamps, see Documentation/userspace-api/serial-rx-tstamp.rst.
+ *
+ * TIOCSRXTSTAMP takes a pointer to an int, non-zero to enable the mode on a
+ * port which supports it and zero to disable it. The mode ends when the
+ * port is closed. TIOCGRXTSTAMP returns and consumes the bursts recorded
+ * since the previous call, oldest first.
+ *
+ * Each burst covers bytes drained from the receiver together. @offset is
+ * the position of its first byte in the stream of bytes received since the
+ * port was opened, so readers can match bursts to the data they read.
+ * @tstamp_ns is when the burst was drained, not when its first byte arrived.
+ */
+struct serial_rx_burst {
+	__u64	offset;
+	__u64	tstamp_ns;		/* CLOCK_MONOTONIC */
+	__u32	count;			/* bytes in the burst */
+	__u32	reserved;
+};
+
+#define SER_RX_BURSTS_MAX	16
+
+struct serial_rx_tstamp {
+	__u32	nr;			/* valid entries in bursts[] */
+	__u32	lost;			/* bursts dropped since the last call */
+	struct serial_rx_burst bursts[SER_RX_BURSTS_MAX];
+};
+
+#define TIOCGRXTSTAMP	_IOR('T', 0x44, struct serial_rx_tstamp)
+#define TIOCSRXTSTAMP	_IOW('T', 0x45, int)
+
 #endif /* _UAPI_LINUX_SERIAL_H */
@@ -27,6 +27,38 @@ struct vhost_vring_file {
 
 };
 
+struct vhost_worker_state {
+	/*
+	 * For VHOST_NEW_WORKER the kernel will return the new vhost_worker id.
+	 * For VHOST_FREE_WORKER this must be set to the id of the vhost_worker
+	 * to free.
+	 */
+	unsigned int worker_id;
+};
+
+struct vhost_vring_worker {
+	/* vring index */
+	unsigned int index;
+	/* The id of the vhost_worker returned from VHOST_NEW_WORKER */
+	unsigned int worker_id;
+};
+
+struct vhost_worker_cpu {
+	unsigned int worker_id;
+	/* The CPU to run the worker on, or -1 to let it run on any CPU */
+	int cpu;
+};
+
+struct vhost_worker_stats {
+	/* Set by userspace to the id of the vhost_worker to report on */
+	unsigned int worker_id;
+	/* The number of vrings the vhost_worker is attached to */
+	unsigned int attachment_cnt;
+	/* The number of work items run and the time spent running them */
+	__u64 work_count;
+	__u64 busy_ns;
+};
+
 struct vhost_vring_addr {
 	unsigned int index;
 	/* Option flags. */
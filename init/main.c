@@ -78,6 +78,7 @@
 #include <linux/kgdb.h>
 #include <linux/ftrace.h>
 #include <linux/async.h>
+#include <linux/workqueue.h>
 #include <linux/shmem_fs.h>
 #include <linux/slab.h>
 #include <linux/perf_event.h>
@@ -1285,18 +1286,10 @@ static inline void do_trace_initcall_finish(initcall_t fn, int ret)
 }
 #endif /* !TRACEPOINTS_ENABLED */
 
-int __init_or_module do_one_initcall(initcall_t fn)
+/* Fix up and warn about what an initcall left behind. */
+static void __init_or_module initcall_check_state(initcall_t fn, int count)
 {
-	int count = preempt_count();
 	char msgbuf[64];
-	int ret;
-
-	if (initcall_blacklisted(fn))
-		return -EPERM;
-
-	do_trace_initcall_start(fn);
-	ret = fn();
-	do_trace_initcall_finish(fn, ret);
 
 	msgbuf[0] = 0;
 
@@ -1311,6 +1304,40 @@ int __init_or_module do_one_initcall(initcall_t fn)
 	WARN(msgbuf[0], "initcall %pS returned with %s\n", fn, msgbuf);
 
 	add_latent_entropy();
+}
+
+int __init_or_module do_one_initcall(initcall_t fn)
+{
+	int count = preempt_count();
+	int ret;
+
+	if (initcall_blacklisted(fn))
+		return -EPERM;
+
+	do_trace_initcall_start(fn);
+	ret = fn();
+	do_trace_initcall_finish(fn, ret);
+
+	initcall_check_state(fn, count);
+	return ret;
+}
+
+/*
+ * Parallel initcalls overlap, which the single calltime of the initcall_debug
+ * callbacks can't follow, so they skip the tracepoints and the caller does
+ * its own reporting.
+ */
+static int __init do_one_parallel_initcall(initcall_t fn)
+{
+	int count = preempt_count();
+	int ret;
+
+	if (initcall_blacklisted(fn))
+		return -EPERM;
+
+	ret = fn();
+
+	initcall_check_state(fn, count);
 	return ret;
 }
 
@@ -1326,6 +1353,15 @@ extern initcall_entry_t __initcall6_start[];
 extern initcall_entry_t __initcall7_start[];
 extern initcall_entry_t __initcall_end[];
 
+extern initcall_entry_t __initcall0s_start[];
+extern initcall_entry_t __initcall1s_start[];
+extern initcall_entry_t __initcall2s_start[];
+extern initcall_entry_t __initcall3s_start[];
+extern initcall_entry_t __initcall4s_start[];
+extern initcall_entry_t __initcall5s_start[];
+extern initcall_entry_t __initcall6s_start[];
+extern initcall_entry_t __initcall7s_start[];
+
 static initcall_entry_t *initcall_levels[] __initdata = {
 	__initcall0_start,
 	__initcall1_start,
@@ -1338,6 +1374,22 @@ static initcall_entry_t *initcall_levels[] __initdata = {
 	__initcall_end,
 };
 
+/*
+ * Start of the *_initcall_sync subsection of each level.  The parallel
+ * initcalls of a level are finished before it, and so before the rootfs
+ * initcalls that follow fs_initcall_sync.
+ */
+static initcall_entry_t *initcall_sync_levels[] __initdata = {
+	__initcall0s_start,
+	__initcall1s_start,
+	__initcall2s_start,
+	__initcall3s_start,
+	__initcall4s_start,
+	__initcall5s_start,
+	__initcall6s_start,
+	__initcall7s_start,
+};
+
 /* Keep these in sync with initcalls in include/linux/init.h */
 static const char *initcall_level_names[] __initdata = {
 	"pure",
@@ -1350,6 +1402,312 @@ static const char *initcall_level_names[] __initdata = {
 	"late",
 };
 
+static bool initcall_parallel __initdata = true;
+
+static int __init set_initcall_parallel(char *str)
+{
+	return kstrtobool(str, &initcall_parallel) == 0;
+}
+__setup("initcall_parallel=", set_initcall_parallel);
+
+extern const struct initcall_parallel __initcall_parallel_start[];
+extern const struct initcall_parallel __initcall_parallel_end[];
+
+struct initcall_node {
+	const struct initcall_parallel *call;
+	struct initcall_level_run *run;
+	struct work_struct work;
+	struct initcall_node **dependents;
+	unsigned int nr_dependents;
+	atomic_t pending;		/* dependencies not returned yet */
+	ktime_t start, end;
+	s64 path_us;			/* longest chain ending here */
+	struct initcall_node *crit;	/* dependency on that chain */
+};
+
+struct initcall_level_run {
+	bool parallel;
+	atomic_t remaining;
+	struct completion done;
+	struct initcall_node **edges;
+	unsigned int *order;		/* dependency order */
+	unsigned int nr;
+	struct initcall_node nodes[];
+};
+
+static const struct initcall_parallel * __init
+initcall_parallel_find(initcall_t fn)
+{
+	const struct initcall_parallel *call;
+
+	for (call = __initcall_parallel_start;
+	     call < __initcall_parallel_end; call++) {
+		if (call->fn == fn)
+			return call;
+	}
+
+	return NULL;
+}
+
+static struct initcall_node * __init
+initcall_node_find(struct initcall_level_run *run, initcall_t fn)
+{
+	unsigned int i;
+
+	for (i = 0; i < run->nr; i++) {
+		if (run->nodes[i].call->fn == fn)
+			return &run->nodes[i];
+	}
+
+	return NULL;
+}
+
+/* Warn about a dependency of @call that can't be waited for */
+static void __init initcall_dep_check(int level,
+				      const struct initcall_parallel *call,
+				      initcall_t fn)
+{
+	const struct initcall_parallel *dep = initcall_parallel_find(fn);
+
+	if (!dep)
+		pr_warn("initcall %pS: dependency %pS is not a parallel initcall, ignored\n",
+			call->fn, fn);
+	else if (dep->level > level)
+		pr_warn("initcall %pS: dependency %pS runs at a later level, ignored\n",
+			call->fn, fn);
+}
+
+/*
+ * Sort the nodes of @run in dependency order. The dependencies of nodes that
+ * can't be sorted, because they are on or behind a cycle, are dropped.
+ */
+static void __init initcall_level_sort(struct initcall_level_run *run,
+				       unsigned int *indeg)
+{
+	unsigned int i, j, head = 0, tail = 0;
+	struct initcall_node *node;
+
+	for (i = 0; i < run->nr; i++) {
+		if (!indeg[i])
+			run->order[tail++] = i;
+	}
+
+	while (head < tail) {
+		node = &run->nodes[run->order[head++]];
+		for (j = 0; j < node->nr_dependents; j++) {
+			i = node->dependents[j] - run->nodes;
+			if (!--indeg[i])
+				run->order[tail++] = i;
+		}
+	}
+
+	for (i = 0; i < run->nr && tail < run->nr; i++) {
+		if (!indeg[i])
+			continue;
+		pr_err("initcall %pS: dependency cycle, ignoring its dependencies\n",
+		       run->nodes[i].call->fn);
+		/* never reaches zero again, see initcall_node_run() */
+		atomic_set(&run->nodes[i].pending, 0);
+		run->order[tail++] = i;
+	}
+}
+
+static void __init initcall_node_run(struct initcall_node *node)
+{
+	struct initcall_level_run *run = node->run;
+	struct initcall_node *dep;
+	unsigned int i;
+	int ret;
+
+	if (initcall_debug)
+		printk(KERN_DEBUG "calling  %pS @ %i (parallel)\n",
+		       node->call->fn, task_pid_nr(current));
+	node->start = ktime_get();
+	ret = do_one_parallel_initcall(node->call->fn);
+	node->end = ktime_get();
+	if (initcall_debug)
+		printk(KERN_DEBUG "initcall %pS returned %d after %lld usecs (parallel)\n",
+		       node->call->fn, ret,
+		       ktime_us_delta(node->end, node->start));
+
+	if (!run->parallel)
+		return;
+
+	for (i = 0; i < node->nr_dependents; i++) {
+		dep = node->dependents[i];
+		if (atomic_dec_and_test(&dep->pending))
+			queue_work(system_unbound_wq, &dep->work);
+	}
+	if (atomic_dec_and_test(&run->remaining))
+		complete(&run->done);
+}
+
+static void __init initcall_node_work(struct work_struct *work)
+{
+	initcall_node_run(container_of(work, struct initcall_node, work));
+}
+
+/*
+ * Set up the parallel initcalls of @level and, unless initcall_parallel=0,
+ * start those without dependencies.
+ */
+static struct initcall_level_run * __init initcall_level_start(int level)
+{
+	const struct initcall_parallel *call;
+	struct initcall_level_run *run;
+	struct initcall_node *node, *dep;
+	unsigned int nr = 0, nr_edges = 0, i, j;
+	unsigned int *indeg;
+
+	for (call = __initcall_parallel_start;
+	     call < __initcall_parallel_end; call++) {
+		if (call->level == level) {
+			nr++;
+			nr_edges += call->nr_deps;
+		}
+	}
+	if (!nr)
+		return NULL;
+
+	run = kzalloc(struct_size(run, nodes, nr), GFP_KERNEL);
+	indeg = kcalloc(nr, sizeof(*indeg), GFP_KERNEL);
+	if (run) {
+		run->order = kcalloc(nr, sizeof(*run->order), GFP_KERNEL);
+		run->edges = kcalloc(nr_edges, sizeof(*run->edges), GFP_KERNEL);
+	}
+	if (!run || !indeg || !run->order || (nr_edges && !run->edges))
+		panic("%s: Failed to allocate %u initcalls\n", __func__, nr);
+
+	run->parallel = initcall_parallel;
+	run->nr = nr;
+	atomic_set(&run->remaining, nr);
+	init_completion(&run->done);
+	for (call = __initcall_parallel_start, i = 0;
+	     call < __initcall_parallel_end; call++) {
+		if (call->level != level)
+			continue;
+		node = &run->nodes[i++];
+		node->call = call;
+		node->run = run;
+		INIT_WORK(&node->work, initcall_node_work);
+	}
+
+	/* count the dependents of each node, then hand out the edges */
+	for (i = 0; i < nr; i++) {
+		node = &run->nodes[i];
+		for (j = 0; j < node->call->nr_deps; j++) {
+			dep = initcall_node_find(run, node->call->deps[j]);
+			if (dep) {
+				dep->nr_dependents++;
+				indeg[i]++;
+			} else {
+				initcall_dep_check(level, node->call,
+						   node->call->deps[j]);
+			}
+		}
+	}
+	for (i = 0, j = 0; i < nr; i++) {
+		run->nodes[i].dependents = run->edges + j;
+		j += run->nodes[i].nr_dependents;
+		run->nodes[i].nr_dependents = 0;
+		atomic_set(&run->nodes[i].pending, indeg[i]);
+	}
+	for (i = 0; i < nr; i++) {
+		node = &run->nodes[i];
+		for (j = 0; j < node->call->nr_deps; j++) {
+			dep = initcall_node_find(run, node->call->deps[j]);
+			if (dep)
+				dep->dependents[dep->nr_dependents++] = node;
+		}
+	}
+
+	initcall_level_sort(run, indeg);
+	kfree(indeg);
+
+	if (run->parallel) {
+		for (i = 0; i < nr; i++) {
+			if (!atomic_read(&run->nodes[i].pending))
+				queue_work(system_unbound_wq,
+					   &run->nodes[i].work);
+		}
+	}
+
+	return run;
+}
+
+/*
+ * Report how long the level took, and the chain of parallel initcalls that
+ * bounds how quickly it could have finished.
+ */
+static void __init initcall_level_report(struct initcall_level_run *run,
+					 int level, s64 level_us,
+					 s64 serial_us)
+{
+	struct initcall_node *node, *last = NULL, **chain;
+	unsigned int i, j, len = 0;
+	s64 sum_us = 0, dur_us;
+
+	for (i = 0; i < run->nr; i++) {
+		node = &run->nodes[run->order[i]];
+		dur_us = ktime_us_delta(node->end, node->start);
+		sum_us += dur_us;
+		node->path_us += dur_us;
+		if (!last || node->path_us > last->path_us)
+			last = node;
+		for (j = 0; j < node->nr_dependents; j++) {
+			if (node->path_us > node->dependents[j]->path_us) {
+				node->dependents[j]->path_us = node->path_us;
+				node->dependents[j]->crit = node;
+			}
+		}
+	}
+
+	printk(KERN_DEBUG "initcall level %s took %lld usecs: plain initcalls %lld usecs, %u parallel initcalls %lld usecs, critical path %lld usecs\n",
+	       initcall_level_names[level], level_us, serial_us, run->nr,
+	       sum_us, last->path_us);
+
+	chain = kcalloc(run->nr, sizeof(*chain), GFP_KERNEL);
+	if (!chain)
+		return;
+	for (node = last; node && len < run->nr; node = node->crit)
+		chain[len++] = node;
+	while (len--)
+		printk(KERN_DEBUG "  critical: %pS %lld usecs\n",
+		       chain[len]->call->fn,
+		       ktime_us_delta(chain[len]->end, chain[len]->start));
+	kfree(chain);
+}
+
+/*
+ * Wait for the parallel initcalls of the level, or run them now with
+ * initcall_parallel=0, then report and free the level.
+ */
+static void __init initcall_level_finish(struct initcall_level_run *run,
+					 int level, ktime_t start,
+					 ktime_t serial_end)
+{
+	unsigned int i;
+
+	if (!run)
+		return;
+
+	if (run->parallel) {
+		wait_for_completion(&run->done);
+	} else {
+		for (i = 0; i < run->nr; i++)
+			initcall_node_run(&run->nodes[run->order[i]]);
+	}
+
+	if (initcall_debug)
+		initcall_level_report(run, level,
+				      ktime_us_delta(ktime_get(), start),
+				      ktime_us_delta(serial_end, start));
+
+	kfree(run->edges);
+	kfree(run->order);
+	kfree(run);
+}
+
 static int __init ignore_unknown_bootoption(char *param, char *val,
 			       const char *unused, void *arg)
 {
@@ -1358,6 +1716,8 @@ static int __init ignore_unknown_bootoption(char *param, char *val,
 
 static void __init do_initcall_level(int level, char *command_line)
 {
+	struct initcall_level_run *run;
+	ktime_t start = ktime_get();
 	initcall_entry_t *fn;
 
 	parse_args(initcall_level_names[level],
@@ -1367,7 +1727,11 @@ static void __init do_initcall_level(int level, char *command_line)
 		   NULL, ignore_unknown_bootoption);
 
 	trace_initcall_level(initcall_level_names[level]);
-	for (fn = initcall_levels[level]; fn < initcall_levels[level+1]; fn++)
+	run = initcall_level_start(level);
+	for (fn = initcall_levels[level]; fn < initcall_sync_levels[level]; fn++)
+		do_one_initcall(initcall_from_entry(fn));
+	initcall_level_finish(run, level, start, ktime_get());
+	for (; fn < initcall_levels[level+1]; fn++)
 		do_one_initcall(initcall_from_entry(fn));
 }
 
@@ -1617,6 +1981,8 @@ static noinline void __init kernel_init_freeable(void)
 	smp_init();
 	sched_init_smp();
 
+	workqueue_init_topology();
+
 	padata_init();
 	page_alloc_init_late();
 	/* Initialize page ext after all struct pages are initialized. */
@@ -792,6 +792,7 @@ void __mmdrop(struct mm_struct *mm)
 	mm_free_pgd(mm);
 	destroy_context(mm);
 	mmu_notifier_subscriptions_destroy(mm);
+	smaps_cache_free(mm);
 	check_mm(mm);
 	put_user_ns(mm->user_ns);
 	mm_pasid_drop(mm);
@@ -1144,6 +1145,12 @@ static struct mm_struct *mm_init(struct mm_struct *mm, struct task_struct *p,
 	init_tlb_flush_pending(mm);
 #if defined(CONFIG_TRANSPARENT_HUGEPAGE) && !USE_SPLIT_PMD_PTLOCKS
 	mm->pmd_huge_pte = NULL;
+#endif
+#ifdef CONFIG_LAZY_PTE_COPY
+	init_llist_head(&mm->lazy_pte_retired);
+#endif
+#ifdef CONFIG_PROC_PAGE_MONITOR
+	mm->smaps_cache = NULL;
 #endif
 	mm_init_uprobes_state(mm);
 	hugetlb_count_init(mm);
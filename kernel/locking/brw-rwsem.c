@@ -0,0 +1,134 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#include <linux/atomic.h>
+#include <linux/percpu.h>
+#include <linux/wait.h>
+#include <linux/lockdep.h>
+#include <linux/brw-rwsem.h>
+#include <linux/rcuwait.h>
+#include <linux/sched.h>
+#include <linux/export.h>
+#include <trace/events/lock.h>
+
+void __brw_init_rwsem(struct brw_semaphore *sem, unsigned int flags,
+		      const char *name, struct lock_class_key *key)
+{
+	__init_rwsem(&sem->rwsem, name, key);
+	sem->read_count = NULL;
+	if (flags & BRW_RWSEM_PERCPU)
+		sem->read_count = alloc_percpu(unsigned int);
+	sem->writer = 0;
+	rcuwait_init(&sem->writer_wait);
+	init_waitqueue_head(&sem->waiters);
+}
+EXPORT_SYMBOL_GPL(__brw_init_rwsem);
+
+/* Must not be called on a lock defined with DEFINE_BRW_RWSEM(). */
+void brw_free_rwsem(struct brw_semaphore *sem)
+{
+	free_percpu(sem->read_count);
+}
+EXPORT_SYMBOL_GPL(brw_free_rwsem);
+
+/*
+ * Slow path of brw_down_read(): a writer is pending or holds the lock. Our
+ * increment is still accounted, so drop it again, letting the writer make
+ * progress, and retry once the writer is gone.
+ */
+void __brw_down_read(struct brw_semaphore *sem)
+{
+	trace_contention_begin(sem, LCB_F_PERCPU | LCB_F_READ);
+	do {
+		__brw_read_exit(sem);
+		wait_event(sem->waiters, !READ_ONCE(sem->writer));
+	} while (!__brw_read_enter(sem));
+	trace_contention_end(sem, 0);
+}
+EXPORT_SYMBOL_GPL(__brw_down_read);
+
+#define per_cpu_sum(var)						\
+({									\
+	typeof(var) __sum = 0;						\
+	int cpu;							\
+	compiletime_assert_atomic_type(__sum);				\
+	for_each_possible_cpu(cpu)					\
+		__sum += per_cpu(var, cpu);				\
+	__sum;								\
+})
+
+/*
+ * Return true if no reader is inside the critical section. Assumes
+ * sem->writer is set, so any reader incrementing its counter after this
+ * point will immediately decrement it again, and a zero sum is stable.
+ */
+static bool brw_readers_idle(struct brw_semaphore *sem)
+{
+	if (per_cpu_sum(*sem->read_count) != 0)
+		return false;
+
+	/*
+	 * If we observed the decrement; ensure we see the entire critical
+	 * section.
+	 */
+	smp_mb(); /* C matches B */
+
+	return true;
+}
+
+/*
+ * Keep new readers out and note the pending writer for the readers inside,
+ * who will wake us as they leave.
+ */
+static void brw_block_readers(struct brw_semaphore *sem)
+{
+	WRITE_ONCE(sem->writer, 1);
+	smp_mb(); /* D matches A and E */
+}
+
+static void brw_unblock_readers(struct brw_semaphore *sem)
+{
+	/* Pairs with the acquire in __brw_read_enter(). */
+	smp_store_release(&sem->writer, 0);
+	wake_up_all(&sem->waiters);
+}
+
+void brw_down_write(struct brw_semaphore *sem)
+{
+	down_write(&sem->rwsem);
+	if (!brw_rwsem_is_percpu(sem))
+		return;
+
+	brw_block_readers(sem);
+	if (brw_readers_idle(sem))
+		return;
+
+	trace_contention_begin(sem, LCB_F_PERCPU | LCB_F_WRITE);
+	rcuwait_wait_event(&sem->writer_wait, brw_readers_idle(sem),
+			   TASK_UNINTERRUPTIBLE);
+	trace_contention_end(sem, 0);
+}
+EXPORT_SYMBOL_GPL(brw_down_write);
+
+int brw_down_write_trylock(struct brw_semaphore *sem)
+{
+	if (!down_write_trylock(&sem->rwsem))
+		return 0;
+	if (!brw_rwsem_is_percpu(sem))
+		return 1;
+
+	brw_block_readers(sem);
+	if (brw_readers_idle(sem))
+		return 1;
+
+	brw_unblock_readers(sem);
+	up_write(&sem->rwsem);
+	return 0;
+}
+EXPORT_SYMBOL_GPL(brw_down_write_trylock);
+
+void brw_up_write(struct brw_semaphore *sem)
+{
+	if (brw_rwsem_is_percpu(sem))
+		brw_unblock_readers(sem);
+	up_write(&sem->rwsem);
+}
+EXPORT_SYMBOL_GPL(brw_up_write);
@@ -660,6 +660,77 @@ static struct lock_torture_ops percpu_rwsem_lock_ops = {
 	.name		= "percpu_rwsem_lock"
 };
 
+#include <linux/brw-rwsem.h>
+static struct brw_semaphore brw_rwsem;
+
+static void torture_brw_rwsem_init(void)
+{
+	brw_init_rwsem(&brw_rwsem, BRW_RWSEM_PERCPU);
+	BUG_ON(!brw_rwsem_is_percpu(&brw_rwsem));
+}
+
+static void torture_brw_rwsem_shared_init(void)
+{
+	brw_init_rwsem(&brw_rwsem, 0);
+}
+
+static void torture_brw_rwsem_exit(void)
+{
+	brw_free_rwsem(&brw_rwsem);
+}
+
+static int torture_brw_rwsem_down_write(int tid __maybe_unused)
+__acquires(brw_rwsem)
+{
+	brw_down_write(&brw_rwsem);
+	return 0;
+}
+
+static void torture_brw_rwsem_up_write(int tid __maybe_unused)
+__releases(brw_rwsem)
+{
+	brw_up_write(&brw_rwsem);
+}
+
+static int torture_brw_rwsem_down_read(int tid __maybe_unused)
+__acquires(brw_rwsem)
+{
+	brw_down_read(&brw_rwsem);
+	return 0;
+}
+
+static void torture_brw_rwsem_up_read(int tid __maybe_unused)
+__releases(brw_rwsem)
+{
+	brw_up_read(&brw_rwsem);
+}
+
+static struct lock_torture_ops brw_rwsem_lock_ops = {
+	.init		= torture_brw_rwsem_init,
+	.exit		= torture_brw_rwsem_exit,
+	.writelock	= torture_brw_rwsem_down_write,
+	.write_delay	= torture_rwsem_write_delay,
+	.task_boost     = torture_boost_dummy,
+	.writeunlock	= torture_brw_rwsem_up_write,
+	.readlock       = torture_brw_rwsem_down_read,
+	.read_delay     = torture_rwsem_read_delay,
+	.readunlock     = torture_brw_rwsem_up_read,
+	.name		= "brw_rwsem_lock"
+};
+
+static struct lock_torture_ops brw_rwsem_shared_lock_ops = {
+	.init		= torture_brw_rwsem_shared_init,
+	.exit		= torture_brw_rwsem_exit,
+	.writelock	= torture_brw_rwsem_down_write,
+	.write_delay	= torture_rwsem_write_delay,
+	.task_boost     = torture_boost_dummy,
+	.writeunlock	= torture_brw_rwsem_up_write,
+	.readlock       = torture_brw_rwsem_down_read,
+	.read_delay     = torture_rwsem_read_delay,
+	.readunlock     = torture_brw_rwsem_up_read,
+	.name		= "brw_rwsem_shared_lock"
+};
+
 /*
  * Lock torture writer kthread.  Repeatedly acquires and releases
  * the lock, checking for duplicate acquisitions.
@@ -912,6 +983,8 @@ static int __init lock_torture_init(void)
 #endif
 		&rwsem_lock_ops,
 		&percpu_rwsem_lock_ops,
+		&brw_rwsem_lock_ops,
+		&brw_rwsem_shared_lock_ops,
 	};
 
 	if (!torture_init_begin(torture_type, verbose))
@@ -0,0 +1,320 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * Module-based read-side scalability benchmark for rw-semaphores
+ *
+ * One reader thread is bound to each of the first @readers online CPUs and
+ * takes and releases the read lock in a tight loop, like the will-it-scale
+ * page fault tests do with mmap_lock. An optional writer takes the write
+ * lock every @write_interval_ms milliseconds and records how long it took.
+ * Results are printed per lock type as total read acquisitions per second
+ * and the worst writer latency.
+ */
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <linux/kernel.h>
+
+#include <linux/brw-rwsem.h>
+#include <linux/completion.h>
+#include <linux/delay.h>
+#include <linux/kthread.h>
+#include <linux/ktime.h>
+#include <linux/module.h>
+#include <linux/percpu-rwsem.h>
+#include <linux/rwsem.h>
+#include <linux/slab.h>
+
+static unsigned int readers;
+module_param(readers, uint, 0444);
+MODULE_PARM_DESC(readers, "Number of reader threads (0 = one per online CPU)");
+
+static unsigned int duration = 5;
+module_param(duration, uint, 0444);
+MODULE_PARM_DESC(duration, "Duration of each run in seconds");
+
+static unsigned int write_interval_ms;
+module_param(write_interval_ms, uint, 0444);
+MODULE_PARM_DESC(write_interval_ms,
+		 "Interval between write acquisitions in ms (0 = no writer)");
+
+static char *type;
+module_param(type, charp, 0444);
+MODULE_PARM_DESC(type, "Lock type to benchmark (default: all)");
+
+static DECLARE_RWSEM(bench_rwsem);
+DEFINE_STATIC_PERCPU_RWSEM(bench_pcpu_rwsem);
+static struct brw_semaphore bench_brw;
+
+struct bench_ops {
+	const char *name;
+	void (*init)(void);
+	void (*exit)(void);
+	void (*read_lock)(void);
+	void (*read_unlock)(void);
+	void (*write_lock)(void);
+	void (*write_unlock)(void);
+};
+
+static void bench_rwsem_read_lock(void)
+{
+	down_read(&bench_rwsem);
+}
+
+static void bench_rwsem_read_unlock(void)
+{
+	up_read(&bench_rwsem);
+}
+
+static void bench_rwsem_write_lock(void)
+{
+	down_write(&bench_rwsem);
+}
+
+static void bench_rwsem_write_unlock(void)
+{
+	up_write(&bench_rwsem);
+}
+
+static void bench_pcpu_read_lock(void)
+{
+	percpu_down_read(&bench_pcpu_rwsem);
+}
+
+static void bench_pcpu_read_unlock(void)
+{
+	percpu_up_read(&bench_pcpu_rwsem);
+}
+
+static void bench_pcpu_write_lock(void)
+{
+	percpu_down_write(&bench_pcpu_rwsem);
+}
+
+static void bench_pcpu_write_unlock(void)
+{
+	percpu_up_write(&bench_pcpu_rwsem);
+}
+
+static void bench_brw_init(void)
+{
+	brw_init_rwsem(&bench_brw, BRW_RWSEM_PERCPU);
+}
+
+static void bench_brw_shared_init(void)
+{
+	brw_init_rwsem(&bench_brw, 0);
+}
+
+static void bench_brw_exit(void)
+{
+	brw_free_rwsem(&bench_brw);
+}
+
+static void bench_brw_read_lock(void)
+{
+	brw_down_read(&bench_brw);
+}
+
+static void bench_brw_read_unlock(void)
+{
+	brw_up_read(&bench_brw);
+}
+
+static void bench_brw_write_lock(void)
+{
+	brw_down_write(&bench_brw);
+}
+
+static void bench_brw_write_unlock(void)
+{
+	brw_up_write(&bench_brw);
+}
+
+static const struct bench_ops bench_ops[] = {
+	{
+		.name		= "rwsem",
+		.read_lock	= bench_rwsem_read_lock,
+		.read_unlock	= bench_rwsem_read_unlock,
+		.write_lock	= bench_rwsem_write_lock,
+		.write_unlock	= bench_rwsem_write_unlock,
+	},
+	{
+		.name		= "percpu_rwsem",
+		.read_lock	= bench_pcpu_read_lock,
+		.read_unlock	= bench_pcpu_read_unlock,
+		.write_lock	= bench_pcpu_write_lock,
+		.write_unlock	= bench_pcpu_write_unlock,
+	},
+	{
+		.name		= "brw_rwsem",
+		.init		= bench_brw_init,
+		.exit		= bench_brw_exit,
+		.read_lock	= bench_brw_read_lock,
+		.read_unlock	= bench_brw_read_unlock,
+		.write_lock	= bench_brw_write_lock,
+		.write_unlock	= bench_brw_write_unlock,
+	},
+	{
+		.name		= "brw_rwsem_shared",
+		.init		= bench_brw_shared_init,
+		.exit		= bench_brw_exit,
+		.read_lock	= bench_brw_read_lock,
+		.read_unlock	= bench_brw_read_unlock,
+		.write_lock	= bench_brw_write_lock,
+		.write_unlock	= bench_brw_write_unlock,
+	},
+};
+
+struct bench_thread {
+	const struct bench_ops *ops;
+	struct completion done;
+	unsigned long count;
+	s64 max_latency_ns;
+} ____cacheline_aligned_in_smp;
+
+static DECLARE_COMPLETION(bench_start);
+static bool bench_stop;
+
+static int bench_reader(void *arg)
+{
+	struct bench_thread *t = arg;
+	const struct bench_ops *ops = t->ops;
+	unsigned long count = 0;
+
+	wait_for_completion(&bench_start);
+	while (!READ_ONCE(bench_stop)) {
+		ops->read_lock();
+		ops->read_unlock();
+		if (!(++count & 1023))
+			cond_resched();
+	}
+
+	t->count = count;
+	complete(&t->done);
+	return 0;
+}
+
+static int bench_writer(void *arg)
+{
+	struct bench_thread *t = arg;
+	const struct bench_ops *ops = t->ops;
+	ktime_t start;
+	s64 latency;
+
+	wait_for_completion(&bench_start);
+	while (!READ_ONCE(bench_stop)) {
+		msleep(write_interval_ms);
+
+		start = ktime_get();
+		ops->write_lock();
+		latency = ktime_to_ns(ktime_sub(ktime_get(), start));
+		ops->write_unlock();
+
+		t->max_latency_ns = max(t->max_latency_ns, latency);
+		t->count++;
+	}
+
+	complete(&t->done);
+	return 0;
+}
+
+static int bench_run(const struct bench_ops *ops, unsigned int nr_readers)
+{
+	struct bench_thread *threads, *writer;
+	struct task_struct *tsk;
+	unsigned long total = 0;
+	unsigned int i, cpu, started = 0;
+	int ret = 0;
+
+	/* The last slot is the writer. */
+	threads = kcalloc(nr_readers + 1, sizeof(*threads), GFP_KERNEL);
+	if (!threads)
+		return -ENOMEM;
+	writer = &threads[nr_readers];
+
+	if (ops->init)
+		ops->init();
+	reinit_completion(&bench_start);
+	WRITE_ONCE(bench_stop, false);
+
+	for_each_online_cpu(cpu) {
+		struct bench_thread *t = &threads[started];
+
+		if (started == nr_readers)
+			break;
+
+		t->ops = ops;
+		init_completion(&t->done);
+		tsk = kthread_run_on_cpu(bench_reader, t, cpu, "brw-bench/%u");
+		if (IS_ERR(tsk)) {
+			ret = PTR_ERR(tsk);
+			break;
+		}
+		started++;
+	}
+
+	writer->ops = ops;
+	init_completion(&writer->done);
+	if (!ret && write_interval_ms) {
+		tsk = kthread_run(bench_writer, writer, "brw-bench-writer");
+		if (IS_ERR(tsk)) {
+			ret = PTR_ERR(tsk);
+			complete(&writer->done);
+		}
+	} else {
+		complete(&writer->done);
+	}
+
+	complete_all(&bench_start);
+	if (!ret)
+		msleep(duration * MSEC_PER_SEC);
+	WRITE_ONCE(bench_stop, true);
+
+	for (i = 0; i < started; i++) {
+		wait_for_completion(&threads[i].done);
+		total += threads[i].count;
+	}
+	wait_for_completion(&writer->done);
+
+	if (!ret)
+		pr_info("%s: readers=%u reads/s=%lu writes=%lu max_write_latency_us=%lld\n",
+			ops->name, nr_readers, total / max(duration, 1U),
+			writer->count, writer->max_latency_ns / NSEC_PER_USEC);
+
+	if (ops->exit)
+		ops->exit();
+	kfree(threads);
+	return ret;
+}
+
+static int __init brw_rwsem_bench_init(void)
+{
+	unsigned int nr_readers = readers;
+	bool found = false;
+	int i, ret;
+
+	if (!nr_readers || nr_readers > num_online_cpus())
+		nr_readers = num_online_cpus();
+
+	for (i = 0; i < ARRAY_SIZE(bench_ops); i++) {
+		if (type && strcmp(type, bench_ops[i].name))
+			continue;
+
+		found = true;
+		ret = bench_run(&bench_ops[i], nr_readers);
+		if (ret)
+			return ret;
+	}
+
+	return found ? 0 : -EINVAL;
+}
+
+static void __exit brw_rwsem_bench_exit(void)
+{
+}
+
+module_init(brw_rwsem_bench_init);
+module_exit(brw_rwsem_bench_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("Read-side scalability benchmark for rw-semaphores");
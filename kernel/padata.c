@@ -19,6 +19,7 @@
 #include <linux/padata.h>
 #include <linux/mutex.h>
 #include <linux/sched.h>
+#include <linux/sched/isolation.h>
 #include <linux/slab.h>
 #include <linux/sysfs.h>
 #include <linux/rcupdate.h>
@@ -69,6 +70,42 @@ static int padata_cpu_hash(struct parallel_data *pd, unsigned int seq_nr)
 	return padata_index_to_cpu(pd, cpu_index);
 }
 
+static struct padata_flow *padata_flow(struct parallel_data *pd,
+				       struct padata_priv *padata)
+{
+	return &pd->flows[padata->flow % pd->nr_flows];
+}
+
+/*
+ * Account an object put on a reorder queue that is now @depth long. Called
+ * with the queue's lock held.
+ */
+static void padata_stats_enqueue(struct padata_shell *ps, unsigned int depth,
+				 bool reordered)
+{
+	this_cpu_inc(ps->stats->enqueued);
+	if (reordered)
+		this_cpu_inc(ps->stats->reordered);
+	if (depth > this_cpu_read(ps->stats->max_depth))
+		this_cpu_write(ps->stats->max_depth, depth);
+}
+
+/*
+ * Whether @cpu may run padata work: online and not isolated from the
+ * scheduler domains, i.e. not claimed by isolcpus= for other purposes.
+ */
+static bool padata_cpu_usable(int cpu)
+{
+	return cpu_online(cpu) && housekeeping_cpu(cpu, HK_TYPE_DOMAIN);
+}
+
+static void padata_usable_cpumask(struct cpumask *dst,
+				  const struct cpumask *cpumask)
+{
+	cpumask_and(dst, cpumask, cpu_online_mask);
+	cpumask_and(dst, dst, housekeeping_cpumask(HK_TYPE_DOMAIN));
+}
+
 static struct padata_work *padata_work_alloc(void)
 {
 	struct padata_work *pw;
@@ -202,8 +239,17 @@ int padata_do_parallel(struct padata_shell *ps,
 	padata->pd = pd;
 	padata->cb_cpu = *cb_cpu;
 
+	if (pd->nr_flows) {
+		struct padata_flow *flow = padata_flow(pd, padata);
+
+		spin_lock(&flow->lock);
+		padata->seq_nr = ++flow->seq_nr;
+		spin_unlock(&flow->lock);
+	}
+
 	spin_lock(&padata_works_lock);
-	padata->seq_nr = ++pd->seq_nr;
+	if (!pd->nr_flows)
+		padata->seq_nr = ++pd->seq_nr;
 	pw = padata_work_alloc();
 	spin_unlock(&padata_works_lock);
 
@@ -265,6 +311,7 @@ static struct padata_priv *padata_find_next(struct parallel_data *pd,
 
 	if (remove_object) {
 		list_del_init(&padata->list);
+		reorder->depth--;
 		++pd->processed;
 		pd->cpu = cpumask_next_wrap(cpu, pd->cpumask.pcpu, -1, false);
 	}
@@ -273,12 +320,27 @@ static struct padata_priv *padata_find_next(struct parallel_data *pd,
 	return padata;
 }
 
+/* Hand an object that is next in order to its serial worker. */
+static void padata_queue_serial(struct parallel_data *pd,
+				struct padata_priv *padata)
+{
+	struct padata_shell *ps = pd->ps;
+	int cb_cpu = padata->cb_cpu;
+	struct padata_serial_queue *squeue = per_cpu_ptr(pd->squeue, cb_cpu);
+
+	spin_lock(&squeue->serial.lock);
+	list_add_tail(&padata->list, &squeue->serial.list);
+	spin_unlock(&squeue->serial.lock);
+
+	this_cpu_inc(ps->stats->serialized);
+
+	queue_work_on(cb_cpu, ps->pinst->serial_wq, &squeue->work);
+}
+
 static void padata_reorder(struct parallel_data *pd)
 {
 	struct padata_instance *pinst = pd->ps->pinst;
-	int cb_cpu;
 	struct padata_priv *padata;
-	struct padata_serial_queue *squeue;
 	struct padata_list *reorder;
 
 	/*
@@ -305,14 +367,7 @@ static void padata_reorder(struct parallel_data *pd)
 		if (!padata)
 			break;
 
-		cb_cpu = padata->cb_cpu;
-		squeue = per_cpu_ptr(pd->squeue, cb_cpu);
-
-		spin_lock(&squeue->serial.lock);
-		list_add_tail(&padata->list, &squeue->serial.list);
-		spin_unlock(&squeue->serial.lock);
-
-		queue_work_on(cb_cpu, pinst->serial_wq, &squeue->work);
+		padata_queue_serial(pd, padata);
 	}
 
 	spin_unlock_bh(&pd->lock);
@@ -376,6 +431,44 @@ static void padata_serial_worker(struct work_struct *serial_work)
 		padata_free_pd(pd);
 }
 
+/*
+ * With flows, each flow is ordered on its own and an object only waits for
+ * earlier objects of the same flow. The flow lock covers both the insertion
+ * and the release of the objects that became ready, so no reorder work or
+ * trylock dance is needed.
+ */
+static void padata_flow_serial(struct parallel_data *pd,
+			       struct padata_priv *padata)
+{
+	struct padata_flow *flow = padata_flow(pd, padata);
+	struct padata_priv *cur;
+	struct list_head *pos;
+
+	spin_lock(&flow->lock);
+	/* Sort in ascending order of sequence number. */
+	list_for_each_prev(pos, &flow->reorder) {
+		cur = list_entry(pos, struct padata_priv, list);
+		if ((int)(cur->seq_nr - padata->seq_nr) < 0)
+			break;
+	}
+	list_add(&padata->list, pos);
+	padata_stats_enqueue(pd->ps, ++flow->depth,
+			     padata->seq_nr != flow->processed);
+
+	while (!list_empty(&flow->reorder)) {
+		cur = list_first_entry(&flow->reorder, struct padata_priv,
+				       list);
+		if (cur->seq_nr != flow->processed)
+			break;
+
+		list_del_init(&cur->list);
+		flow->depth--;
+		flow->processed++;
+		padata_queue_serial(pd, cur);
+	}
+	spin_unlock(&flow->lock);
+}
+
 /**
  * padata_do_serial - padata serialization function
  *
@@ -387,10 +480,18 @@ static void padata_serial_worker(struct work_struct *serial_work)
 void padata_do_serial(struct padata_priv *padata)
 {
 	struct parallel_data *pd = padata->pd;
-	int hashed_cpu = padata_cpu_hash(pd, padata->seq_nr);
-	struct padata_list *reorder = per_cpu_ptr(pd->reorder_list, hashed_cpu);
+	struct padata_list *reorder;
 	struct padata_priv *cur;
 	struct list_head *pos;
+	int hashed_cpu;
+
+	if (pd->nr_flows) {
+		padata_flow_serial(pd, padata);
+		return;
+	}
+
+	hashed_cpu = padata_cpu_hash(pd, padata->seq_nr);
+	reorder = per_cpu_ptr(pd->reorder_list, hashed_cpu);
 
 	spin_lock(&reorder->lock);
 	/* Sort in ascending order of sequence number. */
@@ -400,6 +501,8 @@ void padata_do_serial(struct padata_priv *padata)
 			break;
 	}
 	list_add(&padata->list, pos);
+	padata_stats_enqueue(pd->ps, ++reorder->depth,
+			     padata->seq_nr != READ_ONCE(pd->processed));
 	spin_unlock(&reorder->lock);
 
 	/*
@@ -422,8 +525,14 @@ static int padata_setup_cpumasks(struct padata_instance *pinst)
 	if (!attrs)
 		return -ENOMEM;
 
-	/* Restrict parallel_wq workers to pd->cpumask.pcpu. */
-	cpumask_copy(attrs->cpumask, pinst->cpumask.pcpu);
+	/*
+	 * Restrict parallel_wq workers to pd->cpumask.pcpu, keeping them off
+	 * isolated CPUs unless nothing else is left.
+	 */
+	cpumask_and(attrs->cpumask, pinst->cpumask.pcpu,
+		    housekeeping_cpumask(HK_TYPE_DOMAIN));
+	if (cpumask_empty(attrs->cpumask))
+		cpumask_copy(attrs->cpumask, pinst->cpumask.pcpu);
 	err = apply_workqueue_attrs(pinst->parallel_wq, attrs);
 	free_workqueue_attrs(attrs);
 
@@ -561,6 +670,27 @@ static void padata_init_reorder_list(struct parallel_data *pd)
 	}
 }
 
+static int padata_init_flows(struct parallel_data *pd, unsigned int nr_flows)
+{
+	unsigned int i;
+
+	if (!nr_flows)
+		return 0;
+
+	pd->flows = kcalloc(nr_flows, sizeof(*pd->flows), GFP_KERNEL);
+	if (!pd->flows)
+		return -ENOMEM;
+
+	for (i = 0; i < nr_flows; i++) {
+		INIT_LIST_HEAD(&pd->flows[i].reorder);
+		spin_lock_init(&pd->flows[i].lock);
+		pd->flows[i].seq_nr = -1;
+	}
+	pd->nr_flows = nr_flows;
+
+	return 0;
+}
+
 /* Allocate and initialize the internal cpumask dependend resources. */
 static struct parallel_data *padata_alloc_pd(struct padata_shell *ps)
 {
@@ -585,9 +715,11 @@ static struct parallel_data *padata_alloc_pd(struct padata_shell *ps)
 		goto err_free_squeue;
 	if (!alloc_cpumask_var(&pd->cpumask.cbcpu, GFP_KERNEL))
 		goto err_free_pcpu;
+	if (padata_init_flows(pd, ps->nr_flows))
+		goto err_free_cbcpu;
 
-	cpumask_and(pd->cpumask.pcpu, pinst->cpumask.pcpu, cpu_online_mask);
-	cpumask_and(pd->cpumask.cbcpu, pinst->cpumask.cbcpu, cpu_online_mask);
+	padata_usable_cpumask(pd->cpumask.pcpu, pinst->cpumask.pcpu);
+	padata_usable_cpumask(pd->cpumask.cbcpu, pinst->cpumask.cbcpu);
 
 	padata_init_reorder_list(pd);
 	padata_init_squeues(pd);
@@ -599,6 +731,8 @@ static struct parallel_data *padata_alloc_pd(struct padata_shell *ps)
 
 	return pd;
 
+err_free_cbcpu:
+	free_cpumask_var(pd->cpumask.cbcpu);
 err_free_pcpu:
 	free_cpumask_var(pd->cpumask.pcpu);
 err_free_squeue:
@@ -613,6 +747,7 @@ static struct parallel_data *padata_alloc_pd(struct padata_shell *ps)
 
 static void padata_free_pd(struct parallel_data *pd)
 {
+	kfree(pd->flows);
 	free_cpumask_var(pd->cpumask.pcpu);
 	free_cpumask_var(pd->cpumask.cbcpu);
 	free_percpu(pd->reorder_list);
@@ -674,17 +809,21 @@ static int padata_replace(struct padata_instance *pinst)
 	return err;
 }
 
-/* If cpumask contains no active cpu, we mark the instance as invalid. */
+/* If cpumask contains no usable cpu, we mark the instance as invalid. */
 static bool padata_validate_cpumask(struct padata_instance *pinst,
 				    const struct cpumask *cpumask)
 {
-	if (!cpumask_intersects(cpumask, cpu_online_mask)) {
-		pinst->flags |= PADATA_INVALID;
-		return false;
+	int cpu;
+
+	for_each_cpu(cpu, cpumask) {
+		if (padata_cpu_usable(cpu)) {
+			pinst->flags &= ~PADATA_INVALID;
+			return true;
+		}
 	}
 
-	pinst->flags &= ~PADATA_INVALID;
-	return true;
+	pinst->flags |= PADATA_INVALID;
+	return false;
 }
 
 static int __padata_set_cpumasks(struct padata_instance *pinst,
@@ -916,17 +1055,57 @@ static ssize_t store_cpumask(struct padata_instance *pinst,
 	static struct padata_sysfs_entry _name##_attr = \
 		__ATTR(_name, 0400, _show_name, NULL)
 
+static ssize_t show_reorder_stats(struct padata_instance *pinst,
+				  struct attribute *attr, char *buf)
+{
+	struct padata_shell *ps;
+	ssize_t len = 0;
+	int i = 0;
+
+	mutex_lock(&pinst->lock);
+	list_for_each_entry(ps, &pinst->pslist, list) {
+		unsigned long enqueued = 0, serialized = 0, reordered = 0;
+		unsigned int max_depth = 0;
+		int cpu;
+
+		for_each_possible_cpu(cpu) {
+			struct padata_reorder_stats *stats;
+
+			stats = per_cpu_ptr(ps->stats, cpu);
+			enqueued += READ_ONCE(stats->enqueued);
+			serialized += READ_ONCE(stats->serialized);
+			reordered += READ_ONCE(stats->reordered);
+			max_depth = max(max_depth, READ_ONCE(stats->max_depth));
+		}
+
+		/* Racing with updates, so the depth may be briefly off. */
+		len += sysfs_emit_at(buf, len,
+				     "%d: flows=%u depth=%ld max_depth=%u serialized=%lu reordered=%lu\n",
+				     i++, ps->nr_flows,
+				     (long)(enqueued - serialized), max_depth,
+				     serialized, reordered);
+	}
+	mutex_unlock(&pinst->lock);
+
+	return len;
+}
+
 PADATA_ATTR_RW(serial_cpumask, show_cpumask, store_cpumask);
 PADATA_ATTR_RW(parallel_cpumask, show_cpumask, store_cpumask);
+PADATA_ATTR_RO(reorder_stats, show_reorder_stats);
 
 /*
  * Padata sysfs provides the following objects:
  * serial_cpumask   [RW] - cpumask for serial workers
  * parallel_cpumask [RW] - cpumask for parallel workers
+ * reorder_stats    [RO] - reorder queue statistics, one line per shell
+ *
+ * Isolated CPUs (isolcpus=domain) in the cpumasks are not used.
  */
 static struct attribute *padata_default_attrs[] = {
 	&serial_cpumask_attr.attr,
 	&parallel_cpumask_attr.attr,
+	&reorder_stats_attr.attr,
 	NULL,
 };
 ATTRIBUTE_GROUPS(padata_default);
@@ -1007,8 +1186,9 @@ struct padata_instance *padata_alloc(const char *name)
 
 	INIT_LIST_HEAD(&pinst->pslist);
 
-	cpumask_copy(pinst->cpumask.pcpu, cpu_possible_mask);
-	cpumask_copy(pinst->cpumask.cbcpu, cpu_possible_mask);
+	cpumask_and(pinst->cpumask.pcpu, cpu_possible_mask,
+		    housekeeping_cpumask(HK_TYPE_DOMAIN));
+	cpumask_copy(pinst->cpumask.cbcpu, pinst->cpumask.pcpu);
 
 	if (padata_setup_cpumasks(pinst))
 		goto err_free_masks;
@@ -1056,13 +1236,19 @@ void padata_free(struct padata_instance *pinst)
 EXPORT_SYMBOL(padata_free);
 
 /**
- * padata_alloc_shell - Allocate and initialize padata shell.
+ * padata_alloc_shell_flows - Allocate a padata shell with per-flow ordering.
  *
  * @pinst: Parent padata_instance object.
+ * @nr_flows: Number of independently ordered flows, 0 for a single order.
+ *
+ * Objects are assigned to a flow by &padata_priv.flow modulo @nr_flows and
+ * are only kept in order with respect to earlier objects of the same flow,
+ * so a slow object does not hold back the completion of other flows.
  *
  * Return: new shell on success, NULL on error
  */
-struct padata_shell *padata_alloc_shell(struct padata_instance *pinst)
+struct padata_shell *padata_alloc_shell_flows(struct padata_instance *pinst,
+					      unsigned int nr_flows)
 {
 	struct parallel_data *pd;
 	struct padata_shell *ps;
@@ -1072,13 +1258,18 @@ struct padata_shell *padata_alloc_shell(struct padata_instance *pinst)
 		goto out;
 
 	ps->pinst = pinst;
+	ps->nr_flows = nr_flows;
+
+	ps->stats = alloc_percpu(struct padata_reorder_stats);
+	if (!ps->stats)
+		goto out_free_ps;
 
 	cpus_read_lock();
 	pd = padata_alloc_pd(ps);
 	cpus_read_unlock();
 
 	if (!pd)
-		goto out_free_ps;
+		goto out_free_stats;
 
 	mutex_lock(&pinst->lock);
 	RCU_INIT_POINTER(ps->pd, pd);
@@ -1087,11 +1278,26 @@ struct padata_shell *padata_alloc_shell(struct padata_instance *pinst)
 
 	return ps;
 
+out_free_stats:
+	free_percpu(ps->stats);
 out_free_ps:
 	kfree(ps);
 out:
 	return NULL;
 }
+EXPORT_SYMBOL(padata_alloc_shell_flows);
+
+/**
+ * padata_alloc_shell - Allocate and initialize padata shell.
+ *
+ * @pinst: Parent padata_instance object.
+ *
+ * Return: new shell on success, NULL on error
+ */
+struct padata_shell *padata_alloc_shell(struct padata_instance *pinst)
+{
+	return padata_alloc_shell_flows(pinst, 0);
+}
 EXPORT_SYMBOL(padata_alloc_shell);
 
 /**
@@ -1113,6 +1319,7 @@ void padata_free_shell(struct padata_shell *ps)
 		padata_free_pd(pd);
 	mutex_unlock(&ps->pinst->lock);
 
+	free_percpu(ps->stats);
 	kfree(ps);
 }
 EXPORT_SYMBOL(padata_free_shell);
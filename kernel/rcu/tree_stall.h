@@ -854,6 +854,8 @@ EXPORT_SYMBOL_GPL(rcu_check_boost_fail);
 void show_rcu_gp_kthreads(void)
 {
 	unsigned long cbs = 0;
+	unsigned long __maybe_unused lazy_cbs = 0;
+	unsigned long __maybe_unused lazy_flushes = 0;
 	int cpu;
 	unsigned long j;
 	unsigned long ja;
@@ -908,10 +910,25 @@ void show_rcu_gp_kthreads(void)
 	for_each_possible_cpu(cpu) {
 		rdp = per_cpu_ptr(&rcu_data, cpu);
 		cbs += data_race(READ_ONCE(rdp->n_cbs_invoked));
+#ifdef CONFIG_RCU_LAZY
+		lazy_cbs += data_race(READ_ONCE(rdp->n_lazy_cbs));
+		lazy_flushes += data_race(READ_ONCE(rdp->n_lazy_flushes));
+#endif
 		if (rcu_segcblist_is_offloaded(&rdp->cblist))
 			show_rcu_nocb_state(rdp);
 	}
 	pr_info("RCU callbacks invoked since boot: %lu\n", cbs);
+#ifdef CONFIG_RCU_LAZY
+	/*
+	 * Only an estimate: it assumes each lazy callback would otherwise
+	 * have needed a grace period of its own, while each flushed batch
+	 * needs at most one.  Fewer are saved where unbatched callbacks
+	 * would have shared grace periods anyway.
+	 */
+	pr_info("RCU lazy callbacks delayed: %lu in %lu batches, estimated grace periods saved: at most %lu\n",
+		lazy_cbs, lazy_flushes,
+		lazy_cbs > lazy_flushes ? lazy_cbs - lazy_flushes : 0);
+#endif
 	show_rcu_tasks_gp_kthreads();
 }
 EXPORT_SYMBOL_GPL(show_rcu_gp_kthreads);
@@ -2560,6 +2560,26 @@ SYSCALL_DEFINE5(prctl, int, option, unsigned long, arg2, unsigned long, arg3,
 			clear_bit(MMF_DISABLE_THP, &me->mm->flags);
 		mmap_write_unlock(me->mm);
 		break;
+	case PR_GET_LAZY_PTE_COPY:
+		if (!IS_ENABLED(CONFIG_LAZY_PTE_COPY))
+			return -EINVAL;
+		if (arg2 || arg3 || arg4 || arg5)
+			return -EINVAL;
+		error = !!test_bit(MMF_LAZY_PTE_COPY, &me->mm->flags);
+		break;
+	case PR_SET_LAZY_PTE_COPY:
+		if (!IS_ENABLED(CONFIG_LAZY_PTE_COPY))
+			return -EINVAL;
+		if (arg3 || arg4 || arg5)
+			return -EINVAL;
+		if (mmap_write_lock_killable(me->mm))
+			return -EINTR;
+		if (arg2)
+			set_bit(MMF_LAZY_PTE_COPY, &me->mm->flags);
+		else
+			clear_bit(MMF_LAZY_PTE_COPY, &me->mm->flags);
+		mmap_write_unlock(me->mm);
+		break;
 	case PR_MPX_ENABLE_MANAGEMENT:
 	case PR_MPX_DISABLE_MANAGEMENT:
 		/* No longer implemented: */
@@ -49,8 +49,11 @@
 #include <linux/moduleparam.h>
 #include <linux/uaccess.h>
 #include <linux/sched/isolation.h>
+#include <linux/sched/topology.h>
 #include <linux/nmi.h>
 #include <linux/kvm_para.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 
 #include "workqueue_internal.h"
 
@@ -120,6 +123,10 @@ enum {
  *
  * L: pool->lock protected.  Access with pool->lock held.
  *
+ * K: Only modified by worker while holding pool->lock. Can be safely read by
+ *    self, while holding pool->lock or from IRQ context if %current is the
+ *    kworker.
+ *
  * X: During normal operation, modification requires pool->lock and should
  *    be done only from local cpu.  Either disabling preemption on local
  *    cpu or grabbing pool->lock is enough for read access.  If
@@ -229,6 +236,15 @@ struct pool_workqueue {
 	struct list_head	pwqs_node;	/* WR: node on wq->pwqs */
 	struct list_head	mayday_node;	/* MD: node on wq->maydays */
 
+	/*
+	 * Locality stats of unbound pwqs.  A work item counts as local if
+	 * it executed inside the pool's pod.  Repatriations are wakeups
+	 * which moved a worker back into the pod.  See wake_up_worker().
+	 */
+	u64			nr_local;	/* L: executed inside pod */
+	u64			nr_remote;	/* L: executed outside pod */
+	u64			nr_repatriated;	/* L: wakeups moved into pod */
+
 	/*
 	 * Release of unbound pwq is punted to system_wq.  See put_pwq()
 	 * and pwq_unbound_release_workfn() for details.  pool_workqueue
@@ -295,13 +311,33 @@ struct workqueue_struct {
 	/* hot fields used during command issue, aligned to cacheline */
 	unsigned int		flags ____cacheline_aligned; /* WQ: WQ_* flags */
 	struct pool_workqueue __percpu *cpu_pwqs; /* I: per-cpu pwqs */
-	struct pool_workqueue __rcu *numa_pwq_tbl[]; /* PWR: unbound pwqs indexed by node */
+	struct pool_workqueue __rcu *cpu_pwq_tbl[]; /* PWR: unbound pwqs indexed by cpu */
 };
 
 static struct kmem_cache *pwq_cache;
 
-static cpumask_var_t *wq_numa_possible_cpumask;
-					/* possible CPUs of each node */
+/*
+ * Each pod type describes how CPUs should be grouped for unbound workqueues.
+ * See the comment above workqueue_attrs->affn_scope.
+ */
+struct wq_pod_type {
+	int			nr_pods;	/* number of pods */
+	cpumask_var_t		*pod_cpus;	/* pod -> cpus */
+	int			*pod_node;	/* pod -> node */
+	int			*cpu_pod;	/* cpu -> pod */
+};
+
+static struct wq_pod_type wq_pod_types[WQ_AFFN_NR_TYPES];
+static enum wq_affn_scope wq_affn_dfl = WQ_AFFN_CACHE;
+
+static const char *wq_affn_names[WQ_AFFN_NR_TYPES] = {
+	[WQ_AFFN_DFL]			= "default",
+	[WQ_AFFN_CPU]			= "cpu",
+	[WQ_AFFN_SMT]			= "smt",
+	[WQ_AFFN_CACHE]			= "cache",
+	[WQ_AFFN_NUMA]			= "numa",
+	[WQ_AFFN_SYSTEM]		= "system",
+};
 
 static bool wq_disable_numa;
 module_param_named(disable_numa, wq_disable_numa, bool, 0444);
@@ -310,12 +346,22 @@ module_param_named(disable_numa, wq_disable_numa, bool, 0444);
 static bool wq_power_efficient = IS_ENABLED(CONFIG_WQ_POWER_EFFICIENT_DEFAULT);
 module_param_named(power_efficient, wq_power_efficient, bool, 0444);
 
+/*
+ * Per-cpu work items which hog CPU for longer than the following threshold
+ * are automatically marked CPU_INTENSIVE which excludes them from
+ * concurrency management to prevent them from stalling other work items.
+ * 0 disables the automatic marking.
+ */
+static unsigned long wq_cpu_intensive_thresh_us = 10000;
+module_param_named(cpu_intensive_thresh_us, wq_cpu_intensive_thresh_us,
+		   ulong, 0644);
+
 static bool wq_online;			/* can kworkers be created yet? */
 
 static bool wq_numa_enabled;		/* unbound NUMA affinity enabled */
 
-/* buf for wq_update_unbound_numa_attrs(), protected by CPU hotplug exclusion */
-static struct workqueue_attrs *wq_update_unbound_numa_attrs_buf;
+/* buf for wq_update_pod(), protected by CPU hotplug exclusion */
+static struct workqueue_attrs *wq_update_pod_attrs_buf;
 
 static DEFINE_MUTEX(wq_pool_mutex);	/* protects pools and workqueues list */
 static DEFINE_MUTEX(wq_pool_attach_mutex); /* protects worker attach/detach */
@@ -565,32 +611,21 @@ static int worker_pool_assign_id(struct worker_pool *pool)
 }
 
 /**
- * unbound_pwq_by_node - return the unbound pool_workqueue for the given node
+ * unbound_pwq - return the unbound pool_workqueue for the given cpu
  * @wq: the target workqueue
- * @node: the node ID
+ * @cpu: the CPU to return the pwq for
  *
  * This must be called with any of wq_pool_mutex, wq->mutex or RCU
  * read locked.
  * If the pwq needs to be used beyond the locking in effect, the caller is
  * responsible for guaranteeing that the pwq stays online.
  *
- * Return: The unbound pool_workqueue for @node.
+ * Return: The unbound pool_workqueue for @cpu.
  */
-static struct pool_workqueue *unbound_pwq_by_node(struct workqueue_struct *wq,
-						  int node)
+static struct pool_workqueue *unbound_pwq(struct workqueue_struct *wq, int cpu)
 {
 	assert_rcu_or_wq_mutex_or_pool_mutex(wq);
-
-	/*
-	 * XXX: @node can be NUMA_NO_NODE if CPU goes offline while a
-	 * delayed item is pending.  The plan is to keep CPU -> NODE
-	 * mapping valid and stable across CPU on/offlines.  Once that
-	 * happens, this workaround can be removed.
-	 */
-	if (unlikely(node == NUMA_NO_NODE))
-		return wq->dfl_pwq;
-
-	return rcu_dereference_raw(wq->numa_pwq_tbl[node]);
+	return rcu_dereference_raw(wq->cpu_pwq_tbl[cpu]);
 }
 
 static unsigned int work_color_to_flags(int color)
@@ -848,6 +883,12 @@ static struct worker *first_idle_worker(struct worker_pool *pool)
  *
  * Wake up the first idle worker of @pool.
  *
+ * Workers of unbound pools with a non-strict affinity scope are allowed to
+ * run anywhere in the pool's cpumask but should preferably start inside the
+ * pool's pod.  If the worker last ran outside the pod, steer the wakeup back
+ * into it.  This is only a placement hint and the scheduler is free to
+ * migrate the worker afterwards.
+ *
  * CONTEXT:
  * raw_spin_lock_irq(pool->lock).
  */
@@ -855,9 +896,237 @@ static void wake_up_worker(struct worker_pool *pool)
 {
 	struct worker *worker = first_idle_worker(pool);
 
-	if (likely(worker))
-		wake_up_process(worker->task);
+	if (unlikely(!worker))
+		return;
+
+#ifdef CONFIG_SMP
+	if (pool->cpu < 0 && !pool->attrs->affn_strict &&
+	    !list_empty(&pool->worklist)) {
+		struct task_struct *p = worker->task;
+		struct cpumask *pod_cpus = pool->attrs->__pod_cpumask;
+
+		if (!cpumask_test_cpu(p->wake_cpu, pod_cpus)) {
+			struct work_struct *work =
+				list_first_entry(&pool->worklist,
+						 struct work_struct, entry);
+
+			p->wake_cpu = cpumask_any_distribute(pod_cpus);
+			get_work_pwq(work)->nr_repatriated++;
+		}
+	}
+#endif
+	wake_up_process(worker->task);
+}
+
+#ifdef CONFIG_WQ_FUNC_STATS
+
+#define WQ_FUNC_STATS_BITS	10
+#define WQ_FUNC_STATS_SIZE	(1 << WQ_FUNC_STATS_BITS)
+/* slots probed before a function is counted as dropped */
+#define WQ_FUNC_STATS_PROBE	16
+
+/*
+ * Bucket 0 counts times below 1us, bucket N times in [2^(N-1), 2^N) us and
+ * the last bucket everything from 2^(WQ_FUNC_HIST_BUCKETS - 2) us up.
+ */
+#define WQ_FUNC_HIST_BUCKETS	16
+
+struct wq_func_stats {
+	work_func_t		func;
+	atomic_long_t		count;
+	atomic_long_t		cpu_intensive;	/* # of times auto-marked */
+	atomic64_t		runtime_ns;
+	atomic_long_t		runtime_hist[WQ_FUNC_HIST_BUCKETS];
+	atomic_long_t		latency_hist[WQ_FUNC_HIST_BUCKETS];
+};
+
+/*
+ * Open addressed by work function. Entries are claimed on first use and
+ * never released, functions which don't fit within WQ_FUNC_STATS_PROBE
+ * slots of their hash are counted as dropped. Looked up once per work
+ * item, the worker caches the entry in ->current_stats.
+ */
+static struct wq_func_stats wq_func_stats[WQ_FUNC_STATS_SIZE];
+static atomic_long_t wq_func_stats_dropped;
+
+static bool wq_func_stats_enabled = true;
+module_param_named(func_stats, wq_func_stats_enabled, bool, 0644);
+
+static struct wq_func_stats *wq_func_stats_get(work_func_t func)
+{
+	unsigned int slot = hash_ptr(func, WQ_FUNC_STATS_BITS);
+	int i;
+
+	for (i = 0; i < WQ_FUNC_STATS_PROBE; i++) {
+		struct wq_func_stats *stats = &wq_func_stats[slot];
+		work_func_t cur = READ_ONCE(stats->func);
+
+		if (!cur)
+			cur = cmpxchg(&stats->func, NULL, func) ?: func;
+		if (cur == func)
+			return stats;
+
+		slot = (slot + 1) & (WQ_FUNC_STATS_SIZE - 1);
+	}
+
+	atomic_long_inc(&wq_func_stats_dropped);
+	return NULL;
+}
+
+static int wq_func_hist_bucket(s64 ns)
+{
+	u64 us;
+
+	if (ns < NSEC_PER_USEC)
+		return 0;
+
+	us = div_u64(ns, NSEC_PER_USEC);
+	return min_t(int, ilog2(us) + 1, WQ_FUNC_HIST_BUCKETS - 1);
+}
+
+/* CONTEXT: raw_spin_lock_irq(pool->lock) */
+static void wq_func_stats_work_queued(struct work_struct *work)
+{
+	work->queued_at = local_clock();
+}
+
+/* Returns the start time to be passed to wq_func_stats_work_done() */
+static u64 wq_func_stats_work_start(struct worker *worker,
+				    struct work_struct *work)
+{
+	struct wq_func_stats *stats = NULL;
+	u64 now = local_clock();
+
+	if (READ_ONCE(wq_func_stats_enabled))
+		stats = wq_func_stats_get(work->func);
+	if (stats)
+		atomic_long_inc(&stats->latency_hist[
+			wq_func_hist_bucket(now - work->queued_at)]);
+
+	/* pairs with the READ_ONCE() in wq_func_stats_cpu_intensive() */
+	WRITE_ONCE(worker->current_stats, stats);
+	return now;
+}
+
+static void wq_func_stats_work_done(struct worker *worker, u64 start)
+{
+	struct wq_func_stats *stats = worker->current_stats;
+	u64 runtime = local_clock() - start;
+
+	if (!stats)
+		return;
+
+	WRITE_ONCE(worker->current_stats, NULL);
+	atomic_long_inc(&stats->count);
+	atomic64_add(runtime, &stats->runtime_ns);
+	atomic_long_inc(&stats->runtime_hist[wq_func_hist_bucket(runtime)]);
+}
+
+/* CONTEXT: scheduler tick on the worker's CPU */
+static void wq_func_stats_cpu_intensive(struct worker *worker)
+{
+	struct wq_func_stats *stats = READ_ONCE(worker->current_stats);
+
+	if (stats)
+		atomic_long_inc(&stats->cpu_intensive);
+}
+
+static void wq_func_stats_show_hist(struct seq_file *m, const char *name,
+				    atomic_long_t *hist)
+{
+	int i;
+
+	seq_printf(m, "  %s:", name);
+	for (i = 0; i < WQ_FUNC_HIST_BUCKETS; i++)
+		seq_printf(m, " %lu", atomic_long_read(&hist[i]));
+	seq_putc(m, '\n');
+}
+
+static int wq_func_stats_show(struct seq_file *m, void *v)
+{
+	int i;
+
+	seq_printf(m, "# histogram buckets: <1us, then [2^(N-1), 2^N) us up to >=%lums\n",
+		   (1UL << (WQ_FUNC_HIST_BUCKETS - 2)) / USEC_PER_MSEC);
+	seq_printf(m, "# dropped: %lu\n",
+		   atomic_long_read(&wq_func_stats_dropped));
+
+	for (i = 0; i < WQ_FUNC_STATS_SIZE; i++) {
+		struct wq_func_stats *stats = &wq_func_stats[i];
+		work_func_t func = READ_ONCE(stats->func);
+
+		if (!func)
+			continue;
+
+		seq_printf(m, "%ps: count=%lu cpu_intensive=%lu runtime_us=%llu\n",
+			   func, atomic_long_read(&stats->count),
+			   atomic_long_read(&stats->cpu_intensive),
+			   div_u64(atomic64_read(&stats->runtime_ns),
+				   NSEC_PER_USEC));
+		wq_func_stats_show_hist(m, "runtime", stats->runtime_hist);
+		wq_func_stats_show_hist(m, "latency", stats->latency_hist);
+	}
+
+	return 0;
+}
+
+static int wq_func_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, wq_func_stats_show, NULL);
+}
+
+/* Any write resets the counters, functions keep their entries */
+static ssize_t wq_func_stats_write(struct file *file, const char __user *buf,
+				   size_t count, loff_t *ppos)
+{
+	int i, j;
+
+	for (i = 0; i < WQ_FUNC_STATS_SIZE; i++) {
+		struct wq_func_stats *stats = &wq_func_stats[i];
+
+		atomic_long_set(&stats->count, 0);
+		atomic_long_set(&stats->cpu_intensive, 0);
+		atomic64_set(&stats->runtime_ns, 0);
+		for (j = 0; j < WQ_FUNC_HIST_BUCKETS; j++) {
+			atomic_long_set(&stats->runtime_hist[j], 0);
+			atomic_long_set(&stats->latency_hist[j], 0);
+		}
+	}
+	atomic_long_set(&wq_func_stats_dropped, 0);
+
+	return count;
+}
+
+static const struct file_operations wq_func_stats_fops = {
+	.open		= wq_func_stats_open,
+	.read		= seq_read,
+	.write		= wq_func_stats_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init wq_func_stats_init(void)
+{
+	struct dentry *dir = debugfs_create_dir("workqueue", NULL);
+
+	debugfs_create_file("func_stats", 0644, dir, NULL,
+			    &wq_func_stats_fops);
+	return 0;
+}
+late_initcall(wq_func_stats_init);
+
+#else	/* CONFIG_WQ_FUNC_STATS */
+
+static inline void wq_func_stats_work_queued(struct work_struct *work) { }
+static inline u64 wq_func_stats_work_start(struct worker *worker,
+					   struct work_struct *work)
+{
+	return 0;
 }
+static inline void wq_func_stats_work_done(struct worker *worker, u64 start) { }
+static inline void wq_func_stats_cpu_intensive(struct worker *worker) { }
+
+#endif	/* CONFIG_WQ_FUNC_STATS */
 
 /**
  * wq_worker_running - a worker is running again
@@ -882,6 +1151,13 @@ void wq_worker_running(struct task_struct *task)
 	if (!(worker->flags & WORKER_NOT_RUNNING))
 		worker->pool->nr_running++;
 	preempt_enable();
+
+	/*
+	 * CPU hogging is judged by wq_worker_tick() on the time since the
+	 * work item last slept, not on its total runtime.
+	 */
+	worker->current_at = worker->task->se.sum_exec_runtime;
+
 	worker->sleeping = 0;
 }
 
@@ -930,6 +1206,51 @@ void wq_worker_sleeping(struct task_struct *task)
 	raw_spin_unlock_irq(&pool->lock);
 }
 
+/**
+ * wq_worker_tick - a scheduler tick occurred while a kworker is running
+ * @task: task currently running
+ *
+ * Called from scheduler_tick(). We're in the IRQ context and the current
+ * worker's fields which follow the 'K' locking rule can be accessed safely.
+ */
+void wq_worker_tick(struct task_struct *task)
+{
+	struct worker *worker = kthread_data(task);
+	struct pool_workqueue *pwq = worker->current_pwq;
+	struct worker_pool *pool = worker->pool;
+	unsigned long thresh_us = READ_ONCE(wq_cpu_intensive_thresh_us);
+
+	if (!pwq || !thresh_us)
+		return;
+
+	/*
+	 * If the current worker is concurrency managed and hogged the CPU for
+	 * longer than wq_cpu_intensive_thresh_us, it's automatically marked
+	 * CPU_INTENSIVE to avoid stalling other concurrency-managed work items.
+	 *
+	 * A set @worker->sleeping means that @worker is in the process of
+	 * switching out voluntarily and won't be contributing to
+	 * @pool->nr_running until it wakes up. As wq_worker_sleeping() also
+	 * decrements ->nr_running, setting CPU_INTENSIVE here could lead to
+	 * double decrements. The task is releasing the CPU anyway, skip.
+	 */
+	if ((worker->flags & WORKER_NOT_RUNNING) ||
+	    READ_ONCE(worker->sleeping) ||
+	    worker->task->se.sum_exec_runtime - worker->current_at <
+	    thresh_us * NSEC_PER_USEC)
+		return;
+
+	raw_spin_lock(&pool->lock);
+
+	worker_set_flags(worker, WORKER_CPU_INTENSIVE);
+	wq_func_stats_cpu_intensive(worker);
+
+	if (need_more_worker(pool))
+		wake_up_worker(pool);
+
+	raw_spin_unlock(&pool->lock);
+}
+
 /**
  * wq_worker_last_func - retrieve worker's last work function
  * @task: Task to retrieve last work function of.
@@ -1364,6 +1685,7 @@ static void insert_work(struct pool_workqueue *pwq, struct work_struct *work,
 	set_work_pwq(work, pwq, extra_flags);
 	list_add_tail(&work->entry, head);
 	get_pwq(pwq);
+	wq_func_stats_work_queued(work);
 
 	if (__need_more_worker(pool))
 		wake_up_worker(pool);
@@ -1446,7 +1768,7 @@ static void __queue_work(int cpu, struct workqueue_struct *wq,
 	if (wq->flags & WQ_UNBOUND) {
 		if (req_cpu == WORK_CPU_UNBOUND)
 			cpu = wq_select_unbound_cpu(raw_smp_processor_id());
-		pwq = unbound_pwq_by_node(wq, cpu_to_node(cpu));
+		pwq = unbound_pwq(wq, cpu);
 	} else {
 		if (req_cpu == WORK_CPU_UNBOUND)
 			cpu = raw_smp_processor_id();
@@ -1481,7 +1803,7 @@ static void __queue_work(int cpu, struct workqueue_struct *wq,
 	 * pwq is determined and locked.  For unbound pools, we could have
 	 * raced with pwq release and it could already be dead.  If its
 	 * refcnt is zero, repeat pwq selection.  Note that pwqs never die
-	 * without another pwq replacing it in the numa_pwq_tbl or while
+	 * without another pwq replacing it in the cpu_pwq_tbl or while
 	 * work items are executing on it, so the retrying is guaranteed to
 	 * make forward-progress.
 	 */
@@ -2190,6 +2512,7 @@ __acquires(&pool->lock)
 	bool cpu_intensive = pwq->wq->flags & WQ_CPU_INTENSIVE;
 	unsigned long work_data;
 	struct worker *collision;
+	u64 start;
 #ifdef CONFIG_LOCKDEP
 	/*
 	 * It is permissible to free the struct work_struct from
@@ -2224,9 +2547,18 @@ __acquires(&pool->lock)
 	worker->current_work = work;
 	worker->current_func = work->func;
 	worker->current_pwq = pwq;
+	worker->current_at = worker->task->se.sum_exec_runtime;
 	work_data = *work_data_bits(work);
 	worker->current_color = get_work_color(work_data);
 
+	if (pool->cpu < 0) {
+		if (cpumask_test_cpu(raw_smp_processor_id(),
+				     pool->attrs->__pod_cpumask))
+			pwq->nr_local++;
+		else
+			pwq->nr_remote++;
+	}
+
 	/*
 	 * Record wq name for cmdline and debug reporting, may get
 	 * overridden through set_worker_desc().
@@ -2289,7 +2621,9 @@ __acquires(&pool->lock)
 	 */
 	lockdep_invariant_state(true);
 	trace_workqueue_execute_start(work);
+	start = wq_func_stats_work_start(worker, work);
 	worker->current_func(work);
+	wq_func_stats_work_done(worker, start);
 	/*
 	 * While we must be careful to not use "work" after this, the trace
 	 * point will only record its address.
@@ -2319,9 +2653,12 @@ __acquires(&pool->lock)
 
 	raw_spin_lock_irq(&pool->lock);
 
-	/* clear cpu intensive status */
-	if (unlikely(cpu_intensive))
-		worker_clr_flags(worker, WORKER_CPU_INTENSIVE);
+	/*
+	 * In addition to %WQ_CPU_INTENSIVE, @worker may also have been marked
+	 * CPU intensive by wq_worker_tick() if @work hogged CPU longer than
+	 * wq_cpu_intensive_thresh_us. Clear it.
+	 */
+	worker_clr_flags(worker, WORKER_CPU_INTENSIVE);
 
 	/* tag the worker for identification in schedule() */
 	worker->last_func = worker->current_func;
@@ -3378,6 +3715,7 @@ void free_workqueue_attrs(struct workqueue_attrs *attrs)
 {
 	if (attrs) {
 		free_cpumask_var(attrs->cpumask);
+		free_cpumask_var(attrs->__pod_cpumask);
 		kfree(attrs);
 	}
 }
@@ -3399,8 +3737,12 @@ struct workqueue_attrs *alloc_workqueue_attrs(void)
 		goto fail;
 	if (!alloc_cpumask_var(&attrs->cpumask, GFP_KERNEL))
 		goto fail;
+	if (!alloc_cpumask_var(&attrs->__pod_cpumask, GFP_KERNEL))
+		goto fail;
 
 	cpumask_copy(attrs->cpumask, cpu_possible_mask);
+	cpumask_copy(attrs->__pod_cpumask, cpu_possible_mask);
+	attrs->affn_scope = WQ_AFFN_DFL;
 	return attrs;
 fail:
 	free_workqueue_attrs(attrs);
@@ -3412,11 +3754,16 @@ static void copy_workqueue_attrs(struct workqueue_attrs *to,
 {
 	to->nice = from->nice;
 	cpumask_copy(to->cpumask, from->cpumask);
+	cpumask_copy(to->__pod_cpumask, from->__pod_cpumask);
+	to->affn_strict = from->affn_strict;
+
 	/*
 	 * Unlike hash and equality test, this function doesn't ignore
-	 * ->no_numa as it is used for both pool and wq attrs.  Instead,
-	 * get_unbound_pool() explicitly clears ->no_numa after copying.
+	 * ->affn_scope and ->no_numa as they are used for both pool and wq
+	 * attrs.  Instead, get_unbound_pool() explicitly clears them after
+	 * copying.
 	 */
+	to->affn_scope = from->affn_scope;
 	to->no_numa = from->no_numa;
 }
 
@@ -3428,6 +3775,9 @@ static u32 wqattrs_hash(const struct workqueue_attrs *attrs)
 	hash = jhash_1word(attrs->nice, hash);
 	hash = jhash(cpumask_bits(attrs->cpumask),
 		     BITS_TO_LONGS(nr_cpumask_bits) * sizeof(long), hash);
+	hash = jhash(cpumask_bits(attrs->__pod_cpumask),
+		     BITS_TO_LONGS(nr_cpumask_bits) * sizeof(long), hash);
+	hash = jhash_1word(attrs->affn_strict, hash);
 	return hash;
 }
 
@@ -3439,6 +3789,10 @@ static bool wqattrs_equal(const struct workqueue_attrs *a,
 		return false;
 	if (!cpumask_equal(a->cpumask, b->cpumask))
 		return false;
+	if (!cpumask_equal(a->__pod_cpumask, b->__pod_cpumask))
+		return false;
+	if (a->affn_strict != b->affn_strict)
+		return false;
 	return true;
 }
 
@@ -3634,10 +3988,10 @@ static void put_unbound_pool(struct worker_pool *pool)
  */
 static struct worker_pool *get_unbound_pool(const struct workqueue_attrs *attrs)
 {
+	struct wq_pod_type *pt = &wq_pod_types[WQ_AFFN_NUMA];
 	u32 hash = wqattrs_hash(attrs);
 	struct worker_pool *pool;
-	int node;
-	int target_node = NUMA_NO_NODE;
+	int pod, target_node = NUMA_NO_NODE;
 
 	lockdep_assert_held(&wq_pool_mutex);
 
@@ -3649,14 +4003,11 @@ static struct worker_pool *get_unbound_pool(const struct workqueue_attrs *attrs)
 		}
 	}
 
-	/* if cpumask is contained inside a NUMA node, we belong to that node */
-	if (wq_numa_enabled) {
-		for_each_node(node) {
-			if (cpumask_subset(attrs->cpumask,
-					   wq_numa_possible_cpumask[node])) {
-				target_node = node;
-				break;
-			}
+	/* if pod_cpumask is contained inside a NUMA pod, that's our node */
+	for (pod = 0; pod < pt->nr_pods; pod++) {
+		if (cpumask_subset(attrs->__pod_cpumask, pt->pod_cpus[pod])) {
+			target_node = pt->pod_node[pod];
+			break;
 		}
 	}
 
@@ -3670,9 +4021,10 @@ static struct worker_pool *get_unbound_pool(const struct workqueue_attrs *attrs)
 	pool->node = target_node;
 
 	/*
-	 * no_numa isn't a worker_pool attribute, always clear it.  See
-	 * 'struct workqueue_attrs' comments for detail.
+	 * affn_scope and no_numa aren't worker_pool attributes, always clear
+	 * them.  See 'struct workqueue_attrs' comments for detail.
 	 */
+	pool->attrs->affn_scope = WQ_AFFN_DFL;
 	pool->attrs->no_numa = false;
 
 	if (worker_pool_assign_id(pool) < 0)
@@ -3857,49 +4209,76 @@ static struct pool_workqueue *alloc_unbound_pwq(struct workqueue_struct *wq,
 	return pwq;
 }
 
+/* return the pod type which should be used for @attrs */
+static const struct wq_pod_type *
+wqattrs_pod_type(const struct workqueue_attrs *attrs)
+{
+	enum wq_affn_scope scope = attrs->affn_scope;
+	const struct wq_pod_type *pt;
+
+	if (scope == WQ_AFFN_DFL)
+		scope = wq_affn_dfl;
+
+	/*
+	 * Only SYSTEM and NUMA pod types are available before
+	 * workqueue_init_topology().  Fall back to SYSTEM until then.
+	 */
+	pt = &wq_pod_types[scope];
+	if (likely(pt->nr_pods))
+		return pt;
+
+	pt = &wq_pod_types[WQ_AFFN_SYSTEM];
+	BUG_ON(!pt->nr_pods);
+	return pt;
+}
+
 /**
- * wq_calc_node_cpumask - calculate a wq_attrs' cpumask for the specified node
+ * wq_calc_pod_cpumask - calculate a wq_attrs' pod cpumask for @cpu
  * @attrs: the wq_attrs of the default pwq of the target workqueue
- * @node: the target NUMA node
+ * @cpu: the target CPU
  * @cpu_going_down: if >= 0, the CPU to consider as offline
- * @cpumask: outarg, the resulting cpumask
  *
- * Calculate the cpumask a workqueue with @attrs should use on @node.  If
- * @cpu_going_down is >= 0, that cpu is considered offline during
- * calculation.  The result is stored in @cpumask.
+ * Calculate the cpumask a workqueue with @attrs should use on the pod @cpu
+ * belongs to.  If @cpu_going_down is >= 0, that cpu is considered offline
+ * during calculation.  The result is stored in @attrs->__pod_cpumask.
  *
- * If NUMA affinity is not enabled, @attrs->cpumask is always used.  If
- * enabled and @node has online CPUs requested by @attrs, the returned
- * cpumask is the intersection of the possible CPUs of @node and
+ * If affinity scopes are disabled for @attrs, @attrs->cpumask is always
+ * used.  Otherwise, if the pod has online CPUs requested by @attrs, the
+ * result is the intersection of the possible CPUs of the pod and
  * @attrs->cpumask.
  *
- * The caller is responsible for ensuring that the cpumask of @node stays
+ * The caller is responsible for ensuring that the cpumask of the pod stays
  * stable.
  *
- * Return: %true if the resulting @cpumask is different from @attrs->cpumask,
+ * Return: %true if the resulting cpumask is different from @attrs->cpumask,
  * %false if equal.
  */
-static bool wq_calc_node_cpumask(const struct workqueue_attrs *attrs, int node,
-				 int cpu_going_down, cpumask_t *cpumask)
+static bool wq_calc_pod_cpumask(struct workqueue_attrs *attrs, int cpu,
+				int cpu_going_down)
 {
-	if (!wq_numa_enabled || attrs->no_numa)
+	const struct wq_pod_type *pt = wqattrs_pod_type(attrs);
+	int pod = pt->cpu_pod[cpu];
+	struct cpumask *cpumask = attrs->__pod_cpumask;
+
+	if (attrs->no_numa)
 		goto use_dfl;
 
-	/* does @node have any online CPUs @attrs wants? */
-	cpumask_and(cpumask, cpumask_of_node(node), attrs->cpumask);
+	/* does @pod have any online CPUs @attrs wants? */
+	cpumask_and(cpumask, pt->pod_cpus[pod], attrs->cpumask);
+	cpumask_and(cpumask, cpumask, cpu_online_mask);
 	if (cpu_going_down >= 0)
 		cpumask_clear_cpu(cpu_going_down, cpumask);
 
 	if (cpumask_empty(cpumask))
 		goto use_dfl;
 
-	/* yeap, return possible CPUs in @node that @attrs wants */
-	cpumask_and(cpumask, attrs->cpumask, wq_numa_possible_cpumask[node]);
+	/* yeap, return possible CPUs in @pod that @attrs wants */
+	cpumask_and(cpumask, attrs->cpumask, pt->pod_cpus[pod]);
 
 	if (cpumask_empty(cpumask)) {
 		pr_warn_once("WARNING: workqueue cpumask: online intersect > "
 				"possible intersect\n");
-		return false;
+		goto use_dfl;
 	}
 
 	return !cpumask_equal(cpumask, attrs->cpumask);
@@ -3909,10 +4288,10 @@ static bool wq_calc_node_cpumask(const struct workqueue_attrs *attrs, int node,
 	return false;
 }
 
-/* install @pwq into @wq's numa_pwq_tbl[] for @node and return the old pwq */
-static struct pool_workqueue *numa_pwq_tbl_install(struct workqueue_struct *wq,
-						   int node,
-						   struct pool_workqueue *pwq)
+/* install @pwq into @wq's cpu_pwq_tbl[] for @cpu and return the old pwq */
+static struct pool_workqueue *unbound_pwq_install(struct workqueue_struct *wq,
+						  int cpu,
+						  struct pool_workqueue *pwq)
 {
 	struct pool_workqueue *old_pwq;
 
@@ -3922,8 +4301,8 @@ static struct pool_workqueue *numa_pwq_tbl_install(struct workqueue_struct *wq,
 	/* link_pwq() can handle duplicate calls */
 	link_pwq(pwq);
 
-	old_pwq = rcu_access_pointer(wq->numa_pwq_tbl[node]);
-	rcu_assign_pointer(wq->numa_pwq_tbl[node], pwq);
+	old_pwq = rcu_access_pointer(wq->cpu_pwq_tbl[cpu]);
+	rcu_assign_pointer(wq->cpu_pwq_tbl[cpu], pwq);
 	return old_pwq;
 }
 
@@ -3940,10 +4319,10 @@ struct apply_wqattrs_ctx {
 static void apply_wqattrs_cleanup(struct apply_wqattrs_ctx *ctx)
 {
 	if (ctx) {
-		int node;
+		int cpu;
 
-		for_each_node(node)
-			put_pwq_unlocked(ctx->pwq_tbl[node]);
+		for_each_possible_cpu(cpu)
+			put_pwq_unlocked(ctx->pwq_tbl[cpu]);
 		put_pwq_unlocked(ctx->dfl_pwq);
 
 		free_workqueue_attrs(ctx->attrs);
@@ -3960,11 +4339,11 @@ apply_wqattrs_prepare(struct workqueue_struct *wq,
 {
 	struct apply_wqattrs_ctx *ctx;
 	struct workqueue_attrs *new_attrs, *tmp_attrs;
-	int node;
+	int cpu;
 
 	lockdep_assert_held(&wq_pool_mutex);
 
-	ctx = kzalloc(struct_size(ctx, pwq_tbl, nr_node_ids), GFP_KERNEL);
+	ctx = kzalloc(struct_size(ctx, pwq_tbl, nr_cpu_ids), GFP_KERNEL);
 
 	new_attrs = alloc_workqueue_attrs();
 	tmp_attrs = alloc_workqueue_attrs();
@@ -3981,13 +4360,7 @@ apply_wqattrs_prepare(struct workqueue_struct *wq,
 	cpumask_and(new_attrs->cpumask, new_attrs->cpumask, unbound_cpumask);
 	if (unlikely(cpumask_empty(new_attrs->cpumask)))
 		cpumask_copy(new_attrs->cpumask, unbound_cpumask);
-
-	/*
-	 * We may create multiple pwqs with differing cpumasks.  Make a
-	 * copy of @new_attrs which will be modified and used to obtain
-	 * pools.
-	 */
-	copy_workqueue_attrs(tmp_attrs, new_attrs);
+	cpumask_copy(new_attrs->__pod_cpumask, new_attrs->cpumask);
 
 	/*
 	 * If something goes wrong during CPU up/down, we'll fall back to
@@ -3998,14 +4371,34 @@ apply_wqattrs_prepare(struct workqueue_struct *wq,
 	if (!ctx->dfl_pwq)
 		goto out_free;
 
-	for_each_node(node) {
-		if (wq_calc_node_cpumask(new_attrs, node, -1, tmp_attrs->cpumask)) {
-			ctx->pwq_tbl[node] = alloc_unbound_pwq(wq, tmp_attrs);
-			if (!ctx->pwq_tbl[node])
+	for_each_possible_cpu(cpu) {
+		const struct wq_pod_type *pt = wqattrs_pod_type(new_attrs);
+		int first = cpumask_first(pt->pod_cpus[pt->cpu_pod[cpu]]);
+
+		/* CPUs in the same pod share the pwq of the pod's first CPU */
+		if (first != cpu && ctx->pwq_tbl[first]) {
+			ctx->pwq_tbl[first]->refcnt++;
+			ctx->pwq_tbl[cpu] = ctx->pwq_tbl[first];
+			continue;
+		}
+
+		/*
+		 * We may create multiple pwqs with differing cpumasks.  Make
+		 * a copy of @new_attrs which will be modified and used to
+		 * obtain pools.
+		 */
+		copy_workqueue_attrs(tmp_attrs, new_attrs);
+
+		if (wq_calc_pod_cpumask(tmp_attrs, cpu, -1)) {
+			if (tmp_attrs->affn_strict)
+				cpumask_copy(tmp_attrs->cpumask,
+					     tmp_attrs->__pod_cpumask);
+			ctx->pwq_tbl[cpu] = alloc_unbound_pwq(wq, tmp_attrs);
+			if (!ctx->pwq_tbl[cpu])
 				goto out_free;
 		} else {
 			ctx->dfl_pwq->refcnt++;
-			ctx->pwq_tbl[node] = ctx->dfl_pwq;
+			ctx->pwq_tbl[cpu] = ctx->dfl_pwq;
 		}
 	}
 
@@ -4028,7 +4421,7 @@ apply_wqattrs_prepare(struct workqueue_struct *wq,
 /* set attrs and install prepared pwqs, @ctx points to old pwqs on return */
 static void apply_wqattrs_commit(struct apply_wqattrs_ctx *ctx)
 {
-	int node;
+	int cpu;
 
 	/* all pwqs have been created successfully, let's install'em */
 	mutex_lock(&ctx->wq->mutex);
@@ -4036,9 +4429,9 @@ static void apply_wqattrs_commit(struct apply_wqattrs_ctx *ctx)
 	copy_workqueue_attrs(ctx->wq->unbound_attrs, ctx->attrs);
 
 	/* save the previous pwq and install the new one */
-	for_each_node(node)
-		ctx->pwq_tbl[node] = numa_pwq_tbl_install(ctx->wq, node,
-							  ctx->pwq_tbl[node]);
+	for_each_possible_cpu(cpu)
+		ctx->pwq_tbl[cpu] = unbound_pwq_install(ctx->wq, cpu,
+							ctx->pwq_tbl[cpu]);
 
 	/* @dfl_pwq might not have been used, ensure it's linked */
 	link_pwq(ctx->dfl_pwq);
@@ -4093,12 +4486,12 @@ static int apply_workqueue_attrs_locked(struct workqueue_struct *wq,
  * @wq: the target workqueue
  * @attrs: the workqueue_attrs to apply, allocated with alloc_workqueue_attrs()
  *
- * Apply @attrs to an unbound workqueue @wq.  Unless disabled, on NUMA
- * machines, this function maps a separate pwq to each NUMA node with
- * possibles CPUs in @attrs->cpumask so that work items are affine to the
- * NUMA node it was issued on.  Older pwqs are released as in-flight work
- * items finish.  Note that a work item which repeatedly requeues itself
- * back-to-back will stay on its current pwq.
+ * Apply @attrs to an unbound workqueue @wq.  Unless disabled, this function
+ * maps a separate pwq to each CPU pod of @attrs->affn_scope with possible
+ * CPUs in @attrs->cpumask so that work items are affine to the pod they
+ * were issued on.  Older pwqs are released as in-flight work items finish.
+ * Note that a work item which repeatedly requeues itself back-to-back will
+ * stay on its current pwq.
  *
  * Performs GFP_KERNEL allocations.
  *
@@ -4121,40 +4514,39 @@ int apply_workqueue_attrs(struct workqueue_struct *wq,
 }
 
 /**
- * wq_update_unbound_numa - update NUMA affinity of a wq for CPU hot[un]plug
+ * wq_update_pod - update pod affinity of a wq for CPU hot[un]plug
  * @wq: the target workqueue
  * @cpu: the CPU coming up or going down
  * @online: whether @cpu is coming up or going down
  *
  * This function is to be called from %CPU_DOWN_PREPARE, %CPU_ONLINE and
- * %CPU_DOWN_FAILED.  @cpu is being hot[un]plugged, update NUMA affinity of
- * @wq accordingly.
+ * %CPU_DOWN_FAILED.  @cpu is being hot[un]plugged, update pod affinity of
+ * @wq accordingly.  All CPUs of the pod @cpu belongs to are updated
+ * together as they share the pwq.
  *
- * If NUMA affinity can't be adjusted due to memory allocation failure, it
+ * If pod affinity can't be adjusted due to memory allocation failure, it
  * falls back to @wq->dfl_pwq which may not be optimal but is always
  * correct.
  *
- * Note that when the last allowed CPU of a NUMA node goes offline for a
- * workqueue with a cpumask spanning multiple nodes, the workers which were
- * already executing the work items for the workqueue will lose their CPU
- * affinity and may execute on any CPU.  This is similar to how per-cpu
- * workqueues behave on CPU_DOWN.  If a workqueue user wants strict
- * affinity, it's the user's responsibility to flush the work item from
- * CPU_DOWN_PREPARE.
+ * Note that when the last allowed CPU of a pod goes offline for a workqueue
+ * with a cpumask spanning multiple pods, the workers which were already
+ * executing the work items for the workqueue will lose their CPU affinity
+ * and may execute on any CPU.  This is similar to how per-cpu workqueues
+ * behave on CPU_DOWN.  If a workqueue user wants strict affinity, it's the
+ * user's responsibility to flush the work item from CPU_DOWN_PREPARE.
  */
-static void wq_update_unbound_numa(struct workqueue_struct *wq, int cpu,
-				   bool online)
+static void wq_update_pod(struct workqueue_struct *wq, int cpu, bool online)
 {
-	int node = cpu_to_node(cpu);
 	int cpu_off = online ? -1 : cpu;
-	struct pool_workqueue *old_pwq = NULL, *pwq;
+	const struct wq_pod_type *pt;
+	struct pool_workqueue *pwq;
 	struct workqueue_attrs *target_attrs;
-	cpumask_t *cpumask;
+	struct cpumask *pod_cpus;
+	int tcpu;
 
 	lockdep_assert_held(&wq_pool_mutex);
 
-	if (!wq_numa_enabled || !(wq->flags & WQ_UNBOUND) ||
-	    wq->unbound_attrs->no_numa)
+	if (!(wq->flags & WQ_UNBOUND) || wq->unbound_attrs->no_numa)
 		return;
 
 	/*
@@ -4162,49 +4554,112 @@ static void wq_update_unbound_numa(struct workqueue_struct *wq, int cpu,
 	 * Let's use a preallocated one.  The following buf is protected by
 	 * CPU hotplug exclusion.
 	 */
-	target_attrs = wq_update_unbound_numa_attrs_buf;
-	cpumask = target_attrs->cpumask;
+	target_attrs = wq_update_pod_attrs_buf;
 
 	copy_workqueue_attrs(target_attrs, wq->unbound_attrs);
-	pwq = unbound_pwq_by_node(wq, node);
+	cpumask_copy(target_attrs->cpumask, wq->dfl_pwq->pool->attrs->cpumask);
+	pt = wqattrs_pod_type(target_attrs);
+	pod_cpus = pt->pod_cpus[pt->cpu_pod[cpu]];
 
 	/*
 	 * Let's determine what needs to be done.  If the target cpumask is
-	 * different from the default pwq's, we need to compare it to @pwq's
-	 * and create a new one if they don't match.  If the target cpumask
-	 * equals the default pwq's, the default pwq should be used.
+	 * different from the default pwq's, we need to compare it to the
+	 * current pwq's and create a new one if they don't match.  If the
+	 * target cpumask equals the default pwq's, the default pwq should be
+	 * used.
 	 */
-	if (wq_calc_node_cpumask(wq->dfl_pwq->pool->attrs, node, cpu_off, cpumask)) {
-		if (cpumask_equal(cpumask, pwq->pool->attrs->cpumask))
-			return;
-	} else {
+	if (!wq_calc_pod_cpumask(target_attrs, cpu, cpu_off))
 		goto use_dfl_pwq;
-	}
 
-	/* create a new pwq */
+	if (target_attrs->affn_strict)
+		cpumask_copy(target_attrs->cpumask, target_attrs->__pod_cpumask);
+	if (wqattrs_equal(target_attrs, unbound_pwq(wq, cpu)->pool->attrs))
+		return;
+
+	/* create a new pwq, it starts with a ref for the first pod CPU */
 	pwq = alloc_unbound_pwq(wq, target_attrs);
 	if (!pwq) {
-		pr_warn("workqueue: allocation failed while updating NUMA affinity of \"%s\"\n",
+		pr_warn("workqueue: allocation failed while updating CPU pod affinity of \"%s\"\n",
 			wq->name);
 		goto use_dfl_pwq;
 	}
-
-	/* Install the new pwq. */
-	mutex_lock(&wq->mutex);
-	old_pwq = numa_pwq_tbl_install(wq, node, pwq);
-	goto out_unlock;
+	pwq->refcnt += cpumask_weight(pod_cpus) - 1;
+	goto install;
 
 use_dfl_pwq:
+	pwq = wq->dfl_pwq;
+	raw_spin_lock_irq(&pwq->pool->lock);
+	for_each_cpu(tcpu, pod_cpus)
+		get_pwq(pwq);
+	raw_spin_unlock_irq(&pwq->pool->lock);
+install:
+	/* install @pwq into every CPU of the pod */
 	mutex_lock(&wq->mutex);
-	raw_spin_lock_irq(&wq->dfl_pwq->pool->lock);
-	get_pwq(wq->dfl_pwq);
-	raw_spin_unlock_irq(&wq->dfl_pwq->pool->lock);
-	old_pwq = numa_pwq_tbl_install(wq, node, wq->dfl_pwq);
-out_unlock:
+	for_each_cpu(tcpu, pod_cpus)
+		put_pwq_unlocked(unbound_pwq_install(wq, tcpu, pwq));
 	mutex_unlock(&wq->mutex);
-	put_pwq_unlocked(old_pwq);
 }
 
+static int parse_affn_scope(const char *val)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(wq_affn_names); i++) {
+		if (sysfs_streq(val, wq_affn_names[i]))
+			return i;
+	}
+	return -EINVAL;
+}
+
+static int wq_affn_dfl_set(const char *val, const struct kernel_param *kp)
+{
+	struct workqueue_struct *wq;
+	int affn, cpu;
+
+	affn = parse_affn_scope(val);
+	if (affn < 0)
+		return affn;
+	if (affn == WQ_AFFN_DFL)
+		return -EINVAL;
+
+	/* nothing to update yet if set from the boot command line */
+	if (!wq_update_pod_attrs_buf) {
+		wq_affn_dfl = affn;
+		return 0;
+	}
+
+	cpus_read_lock();
+	mutex_lock(&wq_pool_mutex);
+
+	wq_affn_dfl = affn;
+
+	/* re-pod workqueues which follow the system default */
+	list_for_each_entry(wq, &workqueues, list) {
+		if (!(wq->flags & WQ_UNBOUND) ||
+		    wq->unbound_attrs->affn_scope != WQ_AFFN_DFL)
+			continue;
+		for_each_possible_cpu(cpu)
+			wq_update_pod(wq, cpu, cpu_online(cpu));
+	}
+
+	mutex_unlock(&wq_pool_mutex);
+	cpus_read_unlock();
+
+	return 0;
+}
+
+static int wq_affn_dfl_get(char *buffer, const struct kernel_param *kp)
+{
+	return scnprintf(buffer, PAGE_SIZE, "%s\n", wq_affn_names[wq_affn_dfl]);
+}
+
+static const struct kernel_param_ops wq_affn_dfl_ops = {
+	.set	= wq_affn_dfl_set,
+	.get	= wq_affn_dfl_get,
+};
+
+module_param_cb(default_affinity_scope, &wq_affn_dfl_ops, NULL, 0644);
+
 static int alloc_and_link_pwqs(struct workqueue_struct *wq)
 {
 	bool highpri = wq->flags & WQ_HIGHPRI;
@@ -4314,7 +4769,7 @@ struct workqueue_struct *alloc_workqueue(const char *fmt,
 
 	/* allocate wq and format name */
 	if (flags & WQ_UNBOUND)
-		tbl_size = nr_node_ids * sizeof(wq->numa_pwq_tbl[0]);
+		tbl_size = nr_cpu_ids * sizeof(wq->cpu_pwq_tbl[0]);
 
 	wq = kzalloc(sizeof(*wq) + tbl_size, GFP_KERNEL);
 	if (!wq)
@@ -4411,7 +4866,7 @@ static bool pwq_busy(struct pool_workqueue *pwq)
 void destroy_workqueue(struct workqueue_struct *wq)
 {
 	struct pool_workqueue *pwq;
-	int node;
+	int cpu;
 
 	/*
 	 * Remove it from sysfs first so that sanity check failure doesn't
@@ -4475,12 +4930,12 @@ void destroy_workqueue(struct workqueue_struct *wq)
 	} else {
 		/*
 		 * We're the sole accessor of @wq at this point.  Directly
-		 * access numa_pwq_tbl[] and dfl_pwq to put the base refs.
+		 * access cpu_pwq_tbl[] and dfl_pwq to put the base refs.
 		 * @wq will be freed when the last pwq is released.
 		 */
-		for_each_node(node) {
-			pwq = rcu_access_pointer(wq->numa_pwq_tbl[node]);
-			RCU_INIT_POINTER(wq->numa_pwq_tbl[node], NULL);
+		for_each_possible_cpu(cpu) {
+			pwq = rcu_access_pointer(wq->cpu_pwq_tbl[cpu]);
+			RCU_INIT_POINTER(wq->cpu_pwq_tbl[cpu], NULL);
 			put_pwq_unlocked(pwq);
 		}
 
@@ -4590,7 +5045,7 @@ bool workqueue_congested(int cpu, struct workqueue_struct *wq)
 	if (!(wq->flags & WQ_UNBOUND))
 		pwq = per_cpu_ptr(wq->cpu_pwqs, cpu);
 	else
-		pwq = unbound_pwq_by_node(wq, cpu_to_node(cpu));
+		pwq = unbound_pwq(wq, cpu);
 
 	ret = !list_empty(&pwq->inactive_works);
 	preempt_enable();
@@ -5143,9 +5598,9 @@ int workqueue_online_cpu(unsigned int cpu)
 		mutex_unlock(&wq_pool_attach_mutex);
 	}
 
-	/* update NUMA affinity of unbound workqueues */
+	/* update pod affinity of unbound workqueues */
 	list_for_each_entry(wq, &workqueues, list)
-		wq_update_unbound_numa(wq, cpu, true);
+		wq_update_pod(wq, cpu, true);
 
 	mutex_unlock(&wq_pool_mutex);
 	return 0;
@@ -5161,10 +5616,10 @@ int workqueue_offline_cpu(unsigned int cpu)
 
 	unbind_workers(cpu);
 
-	/* update NUMA affinity of unbound workqueues */
+	/* update pod affinity of unbound workqueues */
 	mutex_lock(&wq_pool_mutex);
 	list_for_each_entry(wq, &workqueues, list)
-		wq_update_unbound_numa(wq, cpu, false);
+		wq_update_pod(wq, cpu, false);
 	mutex_unlock(&wq_pool_mutex);
 
 	return 0;
@@ -5438,10 +5893,14 @@ int workqueue_set_unbound_cpumask(cpumask_var_t cpumask)
  *
  * Unbound workqueues have the following extra attributes.
  *
- *  pool_ids	RO int	: the associated pool IDs for each node
- *  nice	RW int	: nice value of the workers
- *  cpumask	RW mask	: bitmask of allowed CPUs for the workers
- *  numa	RW bool	: whether enable NUMA affinity
+ *  pool_ids		RO int	: the associated pool IDs for each CPU
+ *  nice		RW int	: nice value of the workers
+ *  cpumask		RW mask	: bitmask of allowed CPUs for the workers
+ *  numa		RW bool	: whether enable affinity scopes
+ *  affinity_scope	RW str	: worker CPU affinity scope (cpu, smt, cache,
+ *			  numa, system or default)
+ *  affinity_strict	RW bool	: worker CPU affinity is strict
+ *  affinity_stats	RO str	: nr of local, remote and repatriated executions
  */
 struct wq_device {
 	struct workqueue_struct		*wq;
@@ -5499,14 +5958,14 @@ static ssize_t wq_pool_ids_show(struct device *dev,
 {
 	struct workqueue_struct *wq = dev_to_wq(dev);
 	const char *delim = "";
-	int node, written = 0;
+	int cpu, written = 0;
 
 	cpus_read_lock();
 	rcu_read_lock();
-	for_each_node(node) {
+	for_each_possible_cpu(cpu) {
 		written += scnprintf(buf + written, PAGE_SIZE - written,
-				     "%s%d:%d", delim, node,
-				     unbound_pwq_by_node(wq, node)->pool->id);
+				     "%s%d:%d", delim, cpu,
+				     unbound_pwq(wq, cpu)->pool->id);
 		delim = " ";
 	}
 	written += scnprintf(buf + written, PAGE_SIZE - written, "\n");
@@ -5645,11 +6104,110 @@ static ssize_t wq_numa_store(struct device *dev, struct device_attribute *attr,
 	return ret ?: count;
 }
 
+static ssize_t wq_affn_scope_show(struct device *dev,
+				  struct device_attribute *attr, char *buf)
+{
+	struct workqueue_struct *wq = dev_to_wq(dev);
+	int written;
+
+	mutex_lock(&wq->mutex);
+	if (wq->unbound_attrs->affn_scope == WQ_AFFN_DFL)
+		written = scnprintf(buf, PAGE_SIZE, "%s (%s)\n",
+				    wq_affn_names[WQ_AFFN_DFL],
+				    wq_affn_names[wq_affn_dfl]);
+	else
+		written = scnprintf(buf, PAGE_SIZE, "%s\n",
+			wq_affn_names[wq->unbound_attrs->affn_scope]);
+	mutex_unlock(&wq->mutex);
+
+	return written;
+}
+
+static ssize_t wq_affn_scope_store(struct device *dev,
+				   struct device_attribute *attr,
+				   const char *buf, size_t count)
+{
+	struct workqueue_struct *wq = dev_to_wq(dev);
+	struct workqueue_attrs *attrs;
+	int affn, ret = -ENOMEM;
+
+	affn = parse_affn_scope(buf);
+	if (affn < 0)
+		return affn;
+
+	apply_wqattrs_lock();
+	attrs = wq_sysfs_prep_attrs(wq);
+	if (attrs) {
+		attrs->affn_scope = affn;
+		ret = apply_workqueue_attrs_locked(wq, attrs);
+	}
+	apply_wqattrs_unlock();
+	free_workqueue_attrs(attrs);
+	return ret ?: count;
+}
+
+static ssize_t wq_affinity_strict_show(struct device *dev,
+				       struct device_attribute *attr, char *buf)
+{
+	struct workqueue_struct *wq = dev_to_wq(dev);
+
+	return scnprintf(buf, PAGE_SIZE, "%d\n",
+			 wq->unbound_attrs->affn_strict);
+}
+
+static ssize_t wq_affinity_strict_store(struct device *dev,
+					struct device_attribute *attr,
+					const char *buf, size_t count)
+{
+	struct workqueue_struct *wq = dev_to_wq(dev);
+	struct workqueue_attrs *attrs;
+	int v, ret = -ENOMEM;
+
+	if (sscanf(buf, "%d", &v) != 1)
+		return -EINVAL;
+
+	apply_wqattrs_lock();
+	attrs = wq_sysfs_prep_attrs(wq);
+	if (attrs) {
+		attrs->affn_strict = (bool)v;
+		ret = apply_workqueue_attrs_locked(wq, attrs);
+	}
+	apply_wqattrs_unlock();
+	free_workqueue_attrs(attrs);
+	return ret ?: count;
+}
+
+static ssize_t wq_affinity_stats_show(struct device *dev,
+				      struct device_attribute *attr, char *buf)
+{
+	struct workqueue_struct *wq = dev_to_wq(dev);
+	u64 nr_local = 0, nr_remote = 0, nr_repatriated = 0;
+	struct pool_workqueue *pwq;
+
+	mutex_lock(&wq->mutex);
+	for_each_pwq(pwq, wq) {
+		raw_spin_lock_irq(&pwq->pool->lock);
+		nr_local += pwq->nr_local;
+		nr_remote += pwq->nr_remote;
+		nr_repatriated += pwq->nr_repatriated;
+		raw_spin_unlock_irq(&pwq->pool->lock);
+	}
+	mutex_unlock(&wq->mutex);
+
+	return scnprintf(buf, PAGE_SIZE,
+			 "local %llu remote %llu repatriated %llu\n",
+			 nr_local, nr_remote, nr_repatriated);
+}
+
 static struct device_attribute wq_sysfs_unbound_attrs[] = {
 	__ATTR(pool_ids, 0444, wq_pool_ids_show, NULL),
 	__ATTR(nice, 0644, wq_nice_show, wq_nice_store),
 	__ATTR(cpumask, 0644, wq_cpumask_show, wq_cpumask_store),
 	__ATTR(numa, 0644, wq_numa_show, wq_numa_store),
+	__ATTR(affinity_scope, 0644, wq_affn_scope_show, wq_affn_scope_store),
+	__ATTR(affinity_strict, 0644, wq_affinity_strict_show,
+	       wq_affinity_strict_store),
+	__ATTR(affinity_stats, 0444, wq_affinity_stats_show, NULL),
 	__ATTR_NULL,
 };
 
@@ -5955,13 +6513,66 @@ static inline void wq_watchdog_init(void) { }
 
 #endif	/* CONFIG_WQ_WATCHDOG */
 
-static void __init wq_numa_init(void)
+static void __init init_pod_type(struct wq_pod_type *pt,
+				 bool (*cpus_share_pod)(int, int))
 {
-	cpumask_var_t *tbl;
-	int node, cpu;
+	int cur, pre, cpu, pod;
 
-	if (num_possible_nodes() <= 1)
-		return;
+	pt->nr_pods = 0;
+
+	/* init @pt->cpu_pod[] according to @cpus_share_pod() */
+	pt->cpu_pod = kcalloc(nr_cpu_ids, sizeof(pt->cpu_pod[0]), GFP_KERNEL);
+	BUG_ON(!pt->cpu_pod);
+
+	for_each_possible_cpu(cur) {
+		for_each_possible_cpu(pre) {
+			if (pre >= cur) {
+				pt->cpu_pod[cur] = pt->nr_pods++;
+				break;
+			}
+			if (cpus_share_pod(cur, pre)) {
+				pt->cpu_pod[cur] = pt->cpu_pod[pre];
+				break;
+			}
+		}
+	}
+
+	/* init the rest to match @pt->cpu_pod[] */
+	pt->pod_cpus = kcalloc(pt->nr_pods, sizeof(pt->pod_cpus[0]), GFP_KERNEL);
+	pt->pod_node = kcalloc(pt->nr_pods, sizeof(pt->pod_node[0]), GFP_KERNEL);
+	BUG_ON(!pt->pod_cpus || !pt->pod_node);
+
+	for (pod = 0; pod < pt->nr_pods; pod++)
+		BUG_ON(!zalloc_cpumask_var(&pt->pod_cpus[pod], GFP_KERNEL));
+
+	for_each_possible_cpu(cpu) {
+		cpumask_set_cpu(cpu, pt->pod_cpus[pt->cpu_pod[cpu]]);
+		pt->pod_node[pt->cpu_pod[cpu]] = cpu_to_node(cpu);
+	}
+}
+
+static bool __init cpus_dont_share(int cpu0, int cpu1)
+{
+	return false;
+}
+
+static bool __init cpus_share_smt(int cpu0, int cpu1)
+{
+#ifdef CONFIG_SCHED_SMT
+	return cpumask_test_cpu(cpu0, cpu_smt_mask(cpu1));
+#else
+	return false;
+#endif
+}
+
+static bool __init cpus_share_numa(int cpu0, int cpu1)
+{
+	return cpu_to_node(cpu0) == cpu_to_node(cpu1);
+}
+
+static void __init wq_numa_init(void)
+{
+	int cpu;
 
 	if (wq_disable_numa) {
 		pr_info("workqueue: NUMA affinity support disabled\n");
@@ -5975,28 +6586,8 @@ static void __init wq_numa_init(void)
 		}
 	}
 
-	wq_update_unbound_numa_attrs_buf = alloc_workqueue_attrs();
-	BUG_ON(!wq_update_unbound_numa_attrs_buf);
-
-	/*
-	 * We want masks of possible CPUs of each node which isn't readily
-	 * available.  Build one from cpu_to_node() which should have been
-	 * fully initialized by now.
-	 */
-	tbl = kcalloc(nr_node_ids, sizeof(tbl[0]), GFP_KERNEL);
-	BUG_ON(!tbl);
-
-	for_each_node(node)
-		BUG_ON(!zalloc_cpumask_var_node(&tbl[node], GFP_KERNEL,
-				node_online(node) ? node : NUMA_NO_NODE));
-
-	for_each_possible_cpu(cpu) {
-		node = cpu_to_node(cpu);
-		cpumask_set_cpu(cpu, tbl[node]);
-	}
-
-	wq_numa_possible_cpumask = tbl;
-	wq_numa_enabled = true;
+	init_pod_type(&wq_pod_types[WQ_AFFN_NUMA], cpus_share_numa);
+	wq_numa_enabled = num_possible_nodes() > 1;
 }
 
 /**
@@ -6011,6 +6602,7 @@ static void __init wq_numa_init(void)
  */
 void __init workqueue_init_early(void)
 {
+	struct wq_pod_type *pt = &wq_pod_types[WQ_AFFN_SYSTEM];
 	int std_nice[NR_STD_WORKER_POOLS] = { 0, HIGHPRI_NICE_LEVEL };
 	int i, cpu;
 
@@ -6022,6 +6614,21 @@ void __init workqueue_init_early(void)
 
 	pwq_cache = KMEM_CACHE(pool_workqueue, SLAB_PANIC);
 
+	wq_update_pod_attrs_buf = alloc_workqueue_attrs();
+	BUG_ON(!wq_update_pod_attrs_buf);
+
+	/* initialize WQ_AFFN_SYSTEM pods */
+	pt->pod_cpus = kcalloc(1, sizeof(pt->pod_cpus[0]), GFP_KERNEL);
+	pt->pod_node = kcalloc(1, sizeof(pt->pod_node[0]), GFP_KERNEL);
+	pt->cpu_pod = kcalloc(nr_cpu_ids, sizeof(pt->cpu_pod[0]), GFP_KERNEL);
+	BUG_ON(!pt->pod_cpus || !pt->pod_node || !pt->cpu_pod);
+
+	BUG_ON(!zalloc_cpumask_var(&pt->pod_cpus[0], GFP_KERNEL));
+
+	pt->nr_pods = 1;
+	cpumask_copy(pt->pod_cpus[0], cpu_possible_mask);
+	pt->pod_node[0] = NUMA_NO_NODE;
+
 	/* initialize CPU pools */
 	for_each_possible_cpu(cpu) {
 		struct worker_pool *pool;
@@ -6031,6 +6638,8 @@ void __init workqueue_init_early(void)
 			BUG_ON(init_worker_pool(pool));
 			pool->cpu = cpu;
 			cpumask_copy(pool->attrs->cpumask, cpumask_of(cpu));
+			cpumask_copy(pool->attrs->__pod_cpumask,
+				     cpumask_of(cpu));
 			pool->attrs->nice = std_nice[i++];
 			pool->node = cpu_to_node(cpu);
 
@@ -6052,7 +6661,8 @@ void __init workqueue_init_early(void)
 		/*
 		 * An ordered wq should have only one pwq as ordering is
 		 * guaranteed by max_active which is enforced by pwqs.
-		 * Turn off NUMA so that dfl_pwq is used for all nodes.
+		 * Turn off affinity scopes so that dfl_pwq is used for all
+		 * CPUs.
 		 */
 		BUG_ON(!(attrs = alloc_workqueue_attrs()));
 		attrs->nice = std_nice[i];
@@ -6098,7 +6708,9 @@ void __init workqueue_init(void)
 	 * CPU to node mapping may not be available that early on some
 	 * archs such as power and arm64.  As per-cpu pools created
 	 * previously could be missing node hint and unbound pools NUMA
-	 * affinity, fix them up.
+	 * affinity, fix them up.  The remaining pod types are initialized
+	 * from workqueue_init_topology() once the scheduler topology is
+	 * known.
 	 *
 	 * Also, while iterating workqueues, create rescuers if requested.
 	 */
@@ -6113,7 +6725,7 @@ void __init workqueue_init(void)
 	}
 
 	list_for_each_entry(wq, &workqueues, list) {
-		wq_update_unbound_numa(wq, smp_processor_id(), true);
+		wq_update_pod(wq, smp_processor_id(), true);
 		WARN(init_rescuer(wq),
 		     "workqueue: failed to create early rescuer for %s",
 		     wq->name);
@@ -6136,6 +6748,37 @@ void __init workqueue_init(void)
 	wq_watchdog_init();
 }
 
+/**
+ * workqueue_init_topology - initialize CPU pods for unbound workqueues
+ *
+ * This is the third step of workqueue subsystem initialization and invoked
+ * after SMP and topology information are fully initialized.  It initializes
+ * the unbound CPU pods accordingly and re-pods the existing workqueues.
+ */
+void __init workqueue_init_topology(void)
+{
+	struct workqueue_struct *wq;
+	int cpu;
+
+	init_pod_type(&wq_pod_types[WQ_AFFN_CPU], cpus_dont_share);
+	init_pod_type(&wq_pod_types[WQ_AFFN_SMT], cpus_share_smt);
+	init_pod_type(&wq_pod_types[WQ_AFFN_CACHE], cpus_share_cache);
+
+	mutex_lock(&wq_pool_mutex);
+
+	/*
+	 * Workqueues allocated earlier would have all CPUs sharing the default
+	 * worker pool.  Explicitly call wq_update_pod() on all workqueue and
+	 * CPU combinations to apply per-pod sharing.
+	 */
+	list_for_each_entry(wq, &workqueues, list) {
+		for_each_possible_cpu(cpu)
+			wq_update_pod(wq, cpu, cpu_online(cpu));
+	}
+
+	mutex_unlock(&wq_pool_mutex);
+}
+
 /*
  * Despite the naming, this is a no-op function which is here only for avoiding
  * link error. Since compile-time warning may fail to catch, we will need to
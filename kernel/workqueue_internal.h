@@ -13,6 +13,7 @@
 #include <linux/preempt.h>
 
 struct worker_pool;
+struct wq_func_stats;
 
 /*
  * The poor guys doing the actual heavy lifting.  All on-duty workers are
@@ -31,6 +32,10 @@ struct worker {
 	struct work_struct	*current_work;	/* L: work being processed */
 	work_func_t		current_func;	/* L: current_work's fn */
 	struct pool_workqueue	*current_pwq;	/* L: current_work's pwq */
+	u64			current_at;	/* K: runtime at start or wakeup */
+#ifdef CONFIG_WQ_FUNC_STATS
+	struct wq_func_stats	*current_stats;	/* K: current_func's stats */
+#endif
 	unsigned int		current_color;	/* L: current_work's color */
 	struct list_head	scheduled;	/* L: scheduled works */
 
@@ -76,6 +81,7 @@ static inline struct worker *current_wq_worker(void)
  */
 void wq_worker_running(struct task_struct *task);
 void wq_worker_sleeping(struct task_struct *task);
+void wq_worker_tick(struct task_struct *task);
 work_func_t wq_worker_last_func(struct task_struct *task);
 
 #endif /* _KERNEL_WORKQUEUE_INTERNAL_H */
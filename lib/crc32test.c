@@ -844,7 +844,7 @@ static void __exit crc32_exit(void)
 {
 }
 
-module_init(crc32test_init);
+device_initcall_parallel(crc32test_init);
 module_exit(crc32_exit);
 
 MODULE_AUTHOR("Matt Domsch <Matt_Domsch@dell.com>");
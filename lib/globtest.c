@@ -160,7 +160,7 @@ static int __init glob_init(void)
 /* We need a dummy exit function to allow unload */
 static void __exit glob_fini(void) { }
 
-module_init(glob_init);
+device_initcall_parallel(glob_init);
 module_exit(glob_fini);
 
 MODULE_DESCRIPTION("glob(7) matching tests");
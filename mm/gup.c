@@ -620,6 +620,12 @@ static struct page *follow_page_pte(struct vm_area_struct *vma,
 		goto out;
 	}
 
+	/* Pages mapped by a pte table shared by fork() are not exclusive */
+	if ((flags & FOLL_PIN) && lazy_pte_table_shared(pmd)) {
+		page = ERR_PTR(-EMLINK);
+		goto out;
+	}
+
 	VM_BUG_ON_PAGE((flags & FOLL_PIN) && PageAnon(page) &&
 		       !PageAnonExclusive(page), page);
 
@@ -2429,6 +2435,10 @@ static int gup_pte_range(pmd_t pmd, pmd_t *pmdp, unsigned long addr,
 	int nr_start = *nr, ret = 0;
 	pte_t *ptep, *ptem;
 
+	/* Leave pte tables shared by fork() to the slow path. */
+	if (lazy_pte_pmd_shared(pmd))
+		return 0;
+
 	ptem = ptep = pte_offset_map(&pmd, addr);
 	do {
 		pte_t pte = ptep_get_lockless(ptep);
@@ -882,6 +882,9 @@ static int find_pmd_or_thp_or_none(struct mm_struct *mm,
 		return SCAN_PMD_NULL;
 	if (pmd_bad(pmde))
 		return SCAN_PMD_NULL;
+	/* Collapsing would modify the table for every mm sharing it */
+	if (lazy_pte_pmd_shared(pmde))
+		return SCAN_PMD_NULL;
 	return SCAN_SUCCEED;
 }
 
@@ -214,6 +214,9 @@ static void check_sync_rss_stat(struct task_struct *task)
 
 #endif /* SPLIT_RSS_COUNTING */
 
+static bool lazy_pte_detach(struct mmu_gather *tlb, pmd_t *pmd,
+			    unsigned long addr);
+
 /*
  * Note: this doesn't free the actual pages themselves. That
  * has been handled earlier when unmapping all the memory regions.
@@ -222,6 +225,10 @@ static void free_pte_range(struct mmu_gather *tlb, pmd_t *pmd,
 			   unsigned long addr)
 {
 	pgtable_t token = pmd_pgtable(*pmd);
+
+	/* Another mm may still map a shared table, only drop our reference */
+	if (lazy_pte_table_shared(pmd) && lazy_pte_detach(tlb, pmd, addr))
+		return;
 	pmd_clear(pmd);
 	pte_free_tlb(tlb, token, addr);
 	mm_dec_nr_ptes(tlb->mm);
@@ -1144,6 +1151,347 @@ copy_pte_range(struct vm_area_struct *dst_vma, struct vm_area_struct *src_vma,
 	return ret;
 }
 
+#ifdef CONFIG_LAZY_PTE_COPY
+/*
+ * Lazy pte table copying.
+ *
+ * For an mm with MMF_LAZY_PTE_COPY set, fork() does not copy the pte tables
+ * that map a whole pmd of a private anonymous vma: the child's pmd points at
+ * the parent's table, whose entries are write-protected, and the table's
+ * pt_share_count counts the page tables referencing it. The entries own a
+ * single mapcount, page reference or swap count, however many mms map them.
+ *
+ * A shared table is never modified. Whoever wants to change an entry, or to
+ * rely on the mapcount of the pages it maps, first gives its mm a private
+ * copy with lazy_pte_unshare(): the entries are copied the way fork() would
+ * copy them and the pmd switched over under the pmd lock and the table's
+ * ptl. Lockless walkers in the mm are gone once the TLB has been flushed,
+ * after which the reference to the old table is dropped. The last holder
+ * releases whatever its entries map.
+ *
+ * Rmap walks skip shared tables, so their pages cannot be reclaimed or
+ * migrated until one of the mms takes a copy.
+ */
+
+static void lazy_pte_free_table(struct mm_struct *mm, pgtable_t table)
+{
+	struct vm_area_struct pseudo_vma;
+	spinlock_t *ptl = ptlock_ptr(table);
+	pte_t *pte = page_address(table);
+	int i;
+
+	/* Shared tables are never mlocked, nothing else needs the vma. */
+	vma_init(&pseudo_vma, mm);
+
+	spin_lock(ptl);
+	for (i = 0; i < PTRS_PER_PTE; i++, pte++) {
+		pte_t ptent = *pte;
+		struct page *page;
+
+		if (pte_none(ptent))
+			continue;
+		if (!pte_present(ptent)) {
+			free_swap_and_cache(pte_to_swp_entry(ptent));
+			continue;
+		}
+		if (is_zero_pfn(pte_pfn(ptent)))
+			continue;
+		page = pte_page(ptent);
+		page_remove_rmap(page, &pseudo_vma, false);
+		put_page(page);
+	}
+	spin_unlock(ptl);
+	pte_free(mm, table);
+}
+
+static void lazy_pte_put(struct mm_struct *mm, pgtable_t table)
+{
+	if (atomic_dec_and_test(&table->pt_share_count))
+		lazy_pte_free_table(mm, table);
+}
+
+/*
+ * Map the parent's pte table at @src_pmd into the child instead of copying
+ * it. Returns false if the table has to be copied after all.
+ */
+static bool lazy_pte_share(struct vm_area_struct *dst_vma,
+			   struct vm_area_struct *src_vma, pmd_t *dst_pmd,
+			   pmd_t *src_pmd, unsigned long addr, unsigned long end)
+{
+	struct mm_struct *dst_mm = dst_vma->vm_mm;
+	struct mm_struct *src_mm = src_vma->vm_mm;
+	unsigned long start = addr;
+	int rss[NR_MM_COUNTERS];
+	pte_t *start_pte, *pte;
+	spinlock_t *ptl;
+	pgtable_t table;
+
+	if (!test_bit(MMF_LAZY_PTE_COPY, &src_mm->flags))
+		return false;
+	if (!vma_is_anonymous(src_vma) || !src_vma->anon_vma ||
+	    (src_vma->vm_flags & (VM_LOCKED | VM_MERGEABLE)) ||
+	    userfaultfd_armed(src_vma))
+		return false;
+	if ((addr & ~PMD_MASK) || end - addr != PMD_SIZE ||
+	    !pmd_none(*dst_pmd))
+		return false;
+
+	init_rss_vec(rss);
+	start_pte = pte_offset_map_lock(src_mm, src_pmd, addr, &ptl);
+
+	/*
+	 * Only normal pages and swap entries can be shared. The pages are
+	 * all anonymous, so count them without touching their refcount or
+	 * mapcount; page_needs_cow_for_dma() only does so if the mm ever
+	 * pinned pages.
+	 *
+	 * rmap walks skip shared tables, so pages that must stay migratable
+	 * (ZONE_MOVABLE and CMA) are copied as usual.
+	 */
+	for (pte = start_pte; addr != end; pte++, addr += PAGE_SIZE) {
+		pte_t ptent = *pte;
+		struct page *page;
+
+		if (pte_none(ptent))
+			continue;
+		if (!pte_present(ptent)) {
+			if (non_swap_entry(pte_to_swp_entry(ptent)))
+				goto out_copy;
+			rss[MM_SWAPENTS]++;
+			continue;
+		}
+		page = vm_normal_page(src_vma, addr, ptent);
+		if (!page)
+			continue;
+		if (page_needs_cow_for_dma(src_vma, page) ||
+		    is_zone_movable_page(page) || is_migrate_cma_page(page))
+			goto out_copy;
+		rss[MM_ANONPAGES]++;
+	}
+
+	arch_enter_lazy_mmu_mode();
+	for (pte = start_pte, addr = start; addr != end;
+	     pte++, addr += PAGE_SIZE) {
+		if (pte_present(*pte) && pte_write(*pte))
+			ptep_set_wrprotect(src_mm, addr, pte);
+	}
+	arch_leave_lazy_mmu_mode();
+
+	table = pmd_page(*src_pmd);
+	atomic_inc(&table->pt_share_count);
+	pte_unmap_unlock(start_pte, ptl);
+
+	/* make sure dst_mm is on swapoff's mmlist. */
+	if (rss[MM_SWAPENTS] && unlikely(list_empty(&dst_mm->mmlist))) {
+		spin_lock(&mmlist_lock);
+		if (list_empty(&dst_mm->mmlist))
+			list_add(&dst_mm->mmlist, &src_mm->mmlist);
+		spin_unlock(&mmlist_lock);
+	}
+
+	ptl = pmd_lock(dst_mm, dst_pmd);
+	mm_inc_nr_ptes(dst_mm);
+	pmd_populate(dst_mm, dst_pmd, table);
+	spin_unlock(ptl);
+	add_mm_rss_vec(dst_mm, rss);
+	count_vm_event(PTE_TABLE_SHARE);
+	return true;
+
+out_copy:
+	pte_unmap_unlock(start_pte, ptl);
+	return false;
+}
+
+int __lazy_pte_unshare(struct vm_area_struct *vma, pmd_t *pmd,
+		       unsigned long addr, gfp_t gfp)
+{
+	struct mm_struct *mm = vma->vm_mm;
+	unsigned long start = addr & PMD_MASK;
+	unsigned long end = start + PMD_SIZE;
+	swp_entry_t entry = (swp_entry_t){0};
+	struct page *prealloc = NULL;
+	pgtable_t table = NULL, new;
+	pte_t *src_pte, *dst_pte;
+	int rss[NR_MM_COUNTERS];
+	spinlock_t *pml, *ptl;
+	int ret = 0;
+
+	new = __pte_alloc_one(mm, GFP_PGTABLE_USER | (gfp & __GFP_NOFAIL));
+	if (!new)
+		return -ENOMEM;
+
+	addr = start;
+again:
+	pml = pmd_lock(mm, pmd);
+	/* Somebody else may have taken the copy while we were unlocked. */
+	if (!lazy_pte_table_shared(pmd) || (table && pmd_page(*pmd) != table)) {
+		spin_unlock(pml);
+		goto out;
+	}
+	table = pmd_page(*pmd);
+	ptl = ptlock_ptr(table);
+	spin_lock_nested(ptl, SINGLE_DEPTH_NESTING);
+
+	/* The copy replaces the mappings of the old table: ignore its rss. */
+	init_rss_vec(rss);
+	src_pte = (pte_t *)page_address(table) + pte_index(addr);
+	dst_pte = (pte_t *)page_address(new) + pte_index(addr);
+	for (; addr != end; src_pte++, dst_pte++, addr += PAGE_SIZE) {
+		if (pte_none(*src_pte))
+			continue;
+		if (!pte_present(*src_pte)) {
+			ret = copy_nonpresent_pte(mm, mm, dst_pte, src_pte,
+						  vma, vma, addr, rss);
+			if (ret == -EIO) {
+				entry = pte_to_swp_entry(*src_pte);
+				break;
+			}
+			continue;
+		}
+		ret = copy_present_pte(vma, vma, dst_pte, src_pte, addr, rss,
+				       &prealloc);
+		if (unlikely(ret == -EAGAIN))
+			break;
+		if (unlikely(prealloc)) {
+			put_page(prealloc);
+			prealloc = NULL;
+		}
+	}
+
+	if (addr == end) {
+		/* See comment in pmd_install() */
+		smp_wmb();
+		pmd_populate(mm, pmd, new);
+		new = NULL;
+	}
+	spin_unlock(ptl);
+	spin_unlock(pml);
+
+	if (!new) {
+		flush_tlb_range(vma, start, end);
+		tlb_remove_table_sync_one();
+		lazy_pte_put(mm, table);
+		count_vm_event(PTE_TABLE_UNSHARE);
+		ret = 0;
+		goto out;
+	}
+
+	if (ret == -EIO) {
+		VM_WARN_ON_ONCE(!entry.val);
+		if (add_swap_count_continuation(entry, GFP_KERNEL) < 0 &&
+		    !(gfp & __GFP_NOFAIL)) {
+			ret = -ENOMEM;
+			goto out;
+		}
+		entry.val = 0;
+	} else if (ret == -EAGAIN) {
+		prealloc = page_copy_prealloc(mm, vma, addr);
+		if (!prealloc && !(gfp & __GFP_NOFAIL)) {
+			ret = -ENOMEM;
+			goto out;
+		}
+	}
+	ret = 0;
+	cond_resched();
+	goto again;
+
+out:
+	if (unlikely(prealloc))
+		put_page(prealloc);
+	/* Release whatever was copied before we gave up. */
+	if (new)
+		lazy_pte_free_table(mm, new);
+	return ret;
+}
+
+/*
+ * Unmap the whole shared table at @pmd from the mm. The table is released
+ * by lazy_pte_drain(), which flushes the mmu_gather first. Shared tables
+ * only map private anonymous memory, so any present entry other than the
+ * zero page is an anonymous page.
+ */
+static bool lazy_pte_detach(struct mmu_gather *tlb, pmd_t *pmd,
+			    unsigned long addr)
+{
+	struct mm_struct *mm = tlb->mm;
+	unsigned long end;
+	int rss[NR_MM_COUNTERS];
+	spinlock_t *pml, *ptl;
+	pgtable_t table;
+	pte_t *pte;
+
+	pml = pmd_lock(mm, pmd);
+	if (!lazy_pte_table_shared(pmd)) {
+		spin_unlock(pml);
+		return false;
+	}
+	table = pmd_page(*pmd);
+	ptl = ptlock_ptr(table);
+	spin_lock_nested(ptl, SINGLE_DEPTH_NESTING);
+
+	addr &= PMD_MASK;
+	end = addr + PMD_SIZE;
+	init_rss_vec(rss);
+	pte = page_address(table);
+	for (; addr != end; pte++, addr += PAGE_SIZE) {
+		if (pte_none(*pte))
+			continue;
+		if (!pte_present(*pte))
+			rss[MM_SWAPENTS]--;
+		else if (!is_zero_pfn(pte_pfn(*pte)))
+			rss[MM_ANONPAGES]--;
+	}
+	pmd_clear(pmd);
+
+	spin_unlock(ptl);
+	spin_unlock(pml);
+
+	add_mm_rss_vec(mm, rss);
+	mm_dec_nr_ptes(mm);
+	tlb_flush_pmd_range(tlb, end - PMD_SIZE, PMD_SIZE);
+	tlb->freed_tables = 1;
+	llist_add(&table->pt_retired, &mm->lazy_pte_retired);
+	return true;
+}
+
+/**
+ * lazy_pte_drain - release the shared pte tables unmapped from an mm
+ * @tlb: the mmu_gather used to unmap them
+ *
+ * Must be called after free_pgtables(), which retires the shared tables
+ * that unmap_vmas() left in place, and before tlb_finish_mmu().
+ */
+void lazy_pte_drain(struct mmu_gather *tlb)
+{
+	struct mm_struct *mm = tlb->mm;
+	struct llist_node *first = llist_del_all(&mm->lazy_pte_retired);
+	pgtable_t table, next;
+
+	if (!first)
+		return;
+
+	tlb_flush_mmu(tlb);
+	/* Wait for GUP-fast walkers that may still see the tables. */
+	tlb_remove_table_sync_one();
+	llist_for_each_entry_safe(table, next, first, pt_retired)
+		lazy_pte_put(mm, table);
+}
+#else
+static inline bool lazy_pte_share(struct vm_area_struct *dst_vma,
+				  struct vm_area_struct *src_vma,
+				  pmd_t *dst_pmd, pmd_t *src_pmd,
+				  unsigned long addr, unsigned long end)
+{
+	return false;
+}
+
+static inline bool lazy_pte_detach(struct mmu_gather *tlb, pmd_t *pmd,
+				   unsigned long addr)
+{
+	return false;
+}
+#endif /* CONFIG_LAZY_PTE_COPY */
+
 static inline int
 copy_pmd_range(struct vm_area_struct *dst_vma, struct vm_area_struct *src_vma,
 	       pud_t *dst_pud, pud_t *src_pud, unsigned long addr,
@@ -1174,6 +1522,9 @@ copy_pmd_range(struct vm_area_struct *dst_vma, struct vm_area_struct *src_vma,
 		}
 		if (pmd_none_or_clear_bad(src_pmd))
 			continue;
+		if (lazy_pte_share(dst_vma, src_vma, dst_pmd, src_pmd,
+				   addr, next))
+			continue;
 		if (copy_pte_range(dst_vma, src_vma, dst_pmd, src_pmd,
 				   addr, next))
 			return -ENOMEM;
@@ -1571,6 +1922,25 @@ static inline unsigned long zap_pmd_range(struct mmu_gather *tlb,
 		 */
 		if (pmd_none_or_trans_huge_or_clear_bad(pmd))
 			goto next;
+		if (lazy_pte_table_shared(pmd)) {
+			/*
+			 * munmap() of the whole table, and exit() of any part
+			 * of it, drop the table altogether.
+			 */
+			if (details && (details->zap_flags & ZAP_FLAG_UNMAP) &&
+			    (next - addr == PMD_SIZE ||
+			     !atomic_read(&tlb->mm->mm_users)) &&
+			    lazy_pte_detach(tlb, pmd, addr))
+				goto next;
+			/*
+			 * The oom reaper must not allocate. It never frees
+			 * page tables, so leave the table to exit().
+			 */
+			if (!details && test_bit(MMF_UNSTABLE, &tlb->mm->flags))
+				goto next;
+			lazy_pte_unshare(vma, pmd, addr,
+					 GFP_KERNEL | __GFP_NOFAIL);
+		}
 		next = zap_pte_range(tlb, vma, pmd, addr, next, details);
 next:
 		cond_resched();
@@ -5168,6 +5538,9 @@ static vm_fault_t __handle_mm_fault(struct vm_area_struct *vma,
 		}
 	}
 
+	if (lazy_pte_unshare(vma, vmf.pmd, address, GFP_KERNEL))
+		return VM_FAULT_OOM;
+
 	return handle_pte_fault(&vmf);
 }
 
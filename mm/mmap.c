@@ -2329,6 +2329,7 @@ static void unmap_region(struct mm_struct *mm, struct maple_tree *mt,
 	unmap_vmas(&tlb, mt, vma, start, end);
 	free_pgtables(&tlb, mt, vma, prev ? prev->vm_end : FIRST_USER_ADDRESS,
 				 next ? next->vm_start : USER_PGTABLES_CEILING);
+	lazy_pte_drain(&tlb);
 	tlb_finish_mmu(&tlb);
 }
 
@@ -3236,6 +3237,7 @@ void exit_mmap(struct mm_struct *mm)
 	mt_clear_in_rcu(&mm->mm_mt);
 	free_pgtables(&tlb, &mm->mm_mt, vma, FIRST_USER_ADDRESS,
 		      USER_PGTABLES_CEILING);
+	lazy_pte_drain(&tlb);
 	tlb_finish_mmu(&tlb);
 
 	/*
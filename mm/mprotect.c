@@ -415,6 +415,13 @@ static inline unsigned long change_pmd_range(struct mmu_gather *tlb,
 			}
 			/* fall through, the trans huge pmd just split */
 		}
+		if (lazy_pte_table_shared(pmd)) {
+			/* A hinting fault would only unshare the table */
+			if (cp_flags & MM_CP_PROT_NUMA)
+				goto next;
+			lazy_pte_unshare(vma, pmd, addr,
+					 GFP_KERNEL | __GFP_NOFAIL);
+		}
 		this_pages = change_pte_range(tlb, vma, pmd, addr, next,
 					      newprot, cp_flags);
 		pages += this_pages;
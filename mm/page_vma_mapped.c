@@ -117,6 +117,23 @@ static bool check_pmd(unsigned long pfn, struct page_vma_mapped_walk *pvmw)
 	return true;
 }
 
+/*
+ * The entries of a pte table shared by fork() are frozen, and so are those
+ * of a table replaced by a private copy after pvmw->pte was looked up.
+ * Called with the table's ptl held.
+ */
+static bool pte_table_frozen(struct page_vma_mapped_walk *pvmw)
+{
+	pmd_t pmde;
+
+	if (!IS_ENABLED(CONFIG_LAZY_PTE_COPY))
+		return false;
+
+	pmde = READ_ONCE(*pvmw->pmd);
+	return lazy_pte_pmd_shared(pmde) ||
+	       pmd_page(pmde) != virt_to_page(pvmw->pte);
+}
+
 static void step_forward(struct page_vma_mapped_walk *pvmw, unsigned long size)
 {
 	pvmw->address = (pvmw->address + size) & ~(size - 1);
@@ -254,7 +271,7 @@ bool page_vma_mapped_walk(struct page_vma_mapped_walk *pvmw)
 		if (!map_pte(pvmw))
 			goto next_pte;
 this_pte:
-		if (check_pte(pvmw))
+		if (!pte_table_frozen(pvmw) && check_pte(pvmw))
 			return true;
 next_pte:
 		do {
@@ -120,6 +120,12 @@ static int walk_pmd_range(pud_t *pud, unsigned long addr, unsigned long end,
 
 		walk->action = ACTION_SUBTREE;
 
+		if (walk->vma && !ops->read_only) {
+			err = lazy_pte_unshare(walk->vma, pmd, addr, GFP_KERNEL);
+			if (err)
+				break;
+		}
+
 		/*
 		 * This implies that each ->pmd_entry() handler
 		 * needs to know about pmd_trans_huge() pmds
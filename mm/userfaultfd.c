@@ -664,6 +664,10 @@ static __always_inline ssize_t __mcopy_atomic(struct mm_struct *dst_mm,
 		BUG_ON(pmd_none(*dst_pmd));
 		BUG_ON(pmd_trans_huge(*dst_pmd));
 
+		err = lazy_pte_unshare(dst_vma, dst_pmd, dst_addr, GFP_KERNEL);
+		if (unlikely(err))
+			break;
+
 		err = mfill_atomic_pte(dst_mm, dst_pmd, dst_vma, dst_addr,
 				       src_addr, &page, mcopy_mode, wp_copy);
 		cond_resched();
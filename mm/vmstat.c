@@ -1392,6 +1392,10 @@ const char * const vmstat_text[] = {
 	"zswpin",
 	"zswpout",
 #endif
+#ifdef CONFIG_LAZY_PTE_COPY
+	"pte_table_share",
+	"pte_table_unshare",
+#endif
 #ifdef CONFIG_X86
 	"direct_map_level2_splits",
 	"direct_map_level3_splits",
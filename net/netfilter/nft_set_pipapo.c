@@ -340,6 +340,7 @@
 #include <linux/bitops.h>
 
 #include "nft_set_pipapo_avx2.h"
+#include "nft_set_pipapo_neon.h"
 #include "nft_set_pipapo.h"
 
 /**
@@ -435,17 +436,23 @@ bool nft_pipapo_lookup(const struct net *net, const struct nft_set *set,
 	pipapo_resmap_init(m, res_map);
 
 	nft_pipapo_for_each_field(f, i, m) {
+		const unsigned long *buckets[NFT_PIPAPO_MAX_GROUPS];
 		bool last = i == m->field_count - 1;
 		int b;
 
 		/* For each bit group: select lookup table bucket depending on
-		 * packet bytes value, then AND bucket value
+		 * packet bytes value, then AND bucket values. If nothing is
+		 * left, the result map is already clean for the next packet.
 		 */
-		if (likely(f->bb == 8))
-			pipapo_and_field_buckets_8bit(f, res_map, rp);
-		else
-			pipapo_and_field_buckets_4bit(f, res_map, rp);
+		pipapo_field_buckets(f, rp, buckets);
 		NFT_PIPAPO_GROUP_BITS_ARE_8_OR_4;
+		if (!pipapo_and_buckets(res_map, buckets, f->groups,
+					f->bsize)) {
+			scratch->map_index = map_index;
+			local_bh_enable();
+
+			return false;
+		}
 
 		rp += f->groups / NFT_PIPAPO_GROUPS_PER_BYTE(f);
 
@@ -2336,3 +2343,28 @@ const struct nft_set_type nft_set_pipapo_avx2_type = {
 	},
 };
 #endif
+
+#if defined(CONFIG_ARM64) && defined(CONFIG_KERNEL_MODE_NEON)
+const struct nft_set_type nft_set_pipapo_neon_type = {
+	.features	= NFT_SET_INTERVAL | NFT_SET_MAP | NFT_SET_OBJECT |
+			  NFT_SET_TIMEOUT,
+	.ops		= {
+		.lookup		= nft_pipapo_neon_lookup,
+		.insert		= nft_pipapo_insert,
+		.activate	= nft_pipapo_activate,
+		.deactivate	= nft_pipapo_deactivate,
+		.flush		= nft_pipapo_flush,
+		.remove		= nft_pipapo_remove,
+		.walk		= nft_pipapo_walk,
+		.get		= nft_pipapo_get,
+		.privsize	= nft_pipapo_privsize,
+		.estimate	= nft_pipapo_neon_estimate,
+		.init		= nft_pipapo_init,
+		.destroy	= nft_pipapo_destroy,
+		.gc_init	= nft_pipapo_gc_init,
+		.commit		= nft_pipapo_commit,
+		.abort		= nft_pipapo_abort,
+		.elemsize	= offsetof(struct nft_pipapo_elem, ext),
+	},
+};
+#endif
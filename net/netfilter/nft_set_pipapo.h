@@ -24,6 +24,10 @@
 		     (NFT_PIPAPO_GROUP_BITS_LARGE_SET != 4))
 #define NFT_PIPAPO_GROUPS_PER_BYTE(f)	(BITS_PER_BYTE / (f)->bb)
 
+/* Largest number of groups in a field, with the small group width */
+#define NFT_PIPAPO_MAX_GROUPS						\
+	(NFT_PIPAPO_MAX_BITS / NFT_PIPAPO_GROUP_BITS_LARGE_SET)
+
 /* If a lookup table gets bigger than NFT_PIPAPO_LT_SIZE_HIGH, switch to the
  * small group width, and switch to the big group width if the table gets
  * smaller than NFT_PIPAPO_LT_SIZE_LOW.
@@ -235,6 +239,71 @@ static inline void pipapo_and_field_buckets_8bit(const struct nft_pipapo_field *
 	}
 }
 
+/**
+ * pipapo_field_buckets() - Select lookup table buckets for input data
+ * @f:		Field including lookup table
+ * @data:	Input data selecting table buckets
+ * @b:		Selected buckets, one for each group of @f
+ */
+static inline void pipapo_field_buckets(const struct nft_pipapo_field *f,
+					const u8 *data,
+					const unsigned long **b)
+{
+	const unsigned long *lt = NFT_PIPAPO_LT_ALIGN(f->lt);
+	int group;
+
+	if (likely(f->bb == 8)) {
+		for (group = 0; group < f->groups; group++, data++) {
+			b[group] = lt + *data * f->bsize;
+			lt += f->bsize * NFT_PIPAPO_BUCKETS(8);
+		}
+		return;
+	}
+
+	for (group = 0; group < f->groups; group += BITS_PER_BYTE / 4, data++) {
+		b[group] = lt + (*data >> 4) * f->bsize;
+		lt += f->bsize * NFT_PIPAPO_BUCKETS(4);
+
+		b[group + 1] = lt + (*data & 0x0f) * f->bsize;
+		lt += f->bsize * NFT_PIPAPO_BUCKETS(4);
+	}
+}
+
+/**
+ * pipapo_and_buckets() - Intersect selected buckets, one word at a time
+ * @dst:	Area to store result, also ANDed with the buckets
+ * @b:		Buckets from pipapo_field_buckets()
+ * @groups:	Number of buckets
+ * @bsize:	Size of each bucket, in longs
+ *
+ * Instead of going through the whole result bitmap once per group, like
+ * pipapo_and_field_buckets_8bit() and pipapo_and_field_buckets_4bit() do,
+ * take each word through all the groups and store it once. A word that drops
+ * to zero doesn't need to be ANDed with the remaining buckets.
+ *
+ * Return: true if any bit is left in @dst, false otherwise.
+ */
+static inline bool pipapo_and_buckets(unsigned long *dst,
+				      const unsigned long **b,
+				      int groups, size_t bsize)
+{
+	unsigned long any = 0;
+	size_t k;
+	int group;
+
+	for (k = 0; k < bsize; k++) {
+		unsigned long v = dst[k];
+
+		for (group = 0; group < groups && v; group++)
+			v &= b[group][k];
+
+		dst[k] = v;
+		any |= v;
+	}
+
+	return any;
+}
+
 /**
  * pipapo_estimate_size() - Estimate worst-case for set size
  * @desc:	Set description, element count and field description used here
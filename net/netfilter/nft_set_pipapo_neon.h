@@ -0,0 +1,13 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef _NFT_SET_PIPAPO_NEON_H
+
+#if defined(CONFIG_ARM64) && defined(CONFIG_KERNEL_MODE_NEON)
+bool nft_pipapo_neon_estimate(const struct nft_set_desc *desc, u32 features,
+			      struct nft_set_estimate *est);
+
+/* in nft_set_pipapo_neon_inner.c, call between kernel_neon_begin/end() */
+int nft_pipapo_neon_and(unsigned long *dst, const unsigned long **b,
+			int groups, unsigned long bsize);
+#endif /* defined(CONFIG_ARM64) && defined(CONFIG_KERNEL_MODE_NEON) */
+
+#endif /* _NFT_SET_PIPAPO_NEON_H */
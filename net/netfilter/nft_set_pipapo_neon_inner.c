@@ -0,0 +1,83 @@
+// SPDX-License-Identifier: GPL-2.0-only
+
+/* PIPAPO: PIle PAcket POlicies: NEON bucket intersection
+ *
+ * This file is built with FP/SIMD registers enabled, so that the compiler
+ * can use them anywhere in it: only call it between kernel_neon_begin() and
+ * kernel_neon_end(). See nft_set_pipapo_neon.c for the lookup function.
+ */
+
+#include <asm/neon-intrinsics.h>
+
+int nft_pipapo_neon_and(unsigned long *dst, const unsigned long **b,
+			int groups, unsigned long bsize);
+
+#define NFT_PIPAPO_NEON_LOAD(p)		vld1q_u64((const uint64_t *)(p))
+#define NFT_PIPAPO_NEON_STORE(p, v)	vst1q_u64((uint64_t *)(p), (v))
+
+/* Check for an empty result every few groups, it's not free either */
+#define NFT_PIPAPO_NEON_ZERO_CHECK	4
+
+static inline int nft_pipapo_neon_zero(uint64x2_t v)
+{
+	return !vmaxvq_u32(vreinterpretq_u32_u64(v));
+}
+
+/**
+ * nft_pipapo_neon_and() - Intersect lookup table buckets into result bitmap
+ * @dst:	Result bitmap, also ANDed with the buckets
+ * @b:		Buckets selected by packet data, one for each group
+ * @groups:	Number of buckets
+ * @bsize:	Size of each bucket, in longs
+ *
+ * Go through the bitmap in blocks of four words, in two Q registers, and
+ * AND each block with all the buckets before storing it, the same way
+ * pipapo_and_buckets() does with single words.
+ *
+ * Return: non-zero if any bit is left in @dst, zero otherwise.
+ */
+int nft_pipapo_neon_and(unsigned long *dst, const unsigned long **b,
+			int groups, unsigned long bsize)
+{
+	uint64x2_t any = vdupq_n_u64(0);
+	unsigned long k, tail = 0;
+	int g;
+
+	for (k = 0; k + 4 <= bsize; k += 4) {
+		uint64x2_t v0 = NFT_PIPAPO_NEON_LOAD(dst + k);
+		uint64x2_t v1 = NFT_PIPAPO_NEON_LOAD(dst + k + 2);
+
+		for (g = 0; g < groups; g++) {
+			v0 = vandq_u64(v0, NFT_PIPAPO_NEON_LOAD(b[g] + k));
+			v1 = vandq_u64(v1, NFT_PIPAPO_NEON_LOAD(b[g] + k + 2));
+
+			if (!((g + 1) % NFT_PIPAPO_NEON_ZERO_CHECK) &&
+			    nft_pipapo_neon_zero(vorrq_u64(v0, v1)))
+				break;
+		}
+
+		NFT_PIPAPO_NEON_STORE(dst + k, v0);
+		NFT_PIPAPO_NEON_STORE(dst + k + 2, v1);
+		any = vorrq_u64(any, vorrq_u64(v0, v1));
+	}
+
+	if (k + 2 <= bsize) {
+		uint64x2_t v = NFT_PIPAPO_NEON_LOAD(dst + k);
+
+		for (g = 0; g < groups; g++)
+			v = vandq_u64(v, NFT_PIPAPO_NEON_LOAD(b[g] + k));
+
+		NFT_PIPAPO_NEON_STORE(dst + k, v);
+		any = vorrq_u64(any, v);
+		k += 2;
+	}
+
+	if (k < bsize) {
+		tail = dst[k];
+		for (g = 0; g < groups && tail; g++)
+			tail &= b[g][k];
+		dst[k] = tail;
+	}
+
+	return tail || !nft_pipapo_neon_zero(any);
+}
@@ -9,18 +9,120 @@
  */
 
 #include <linux/errno.h>
+#include <linux/jhash.h>
 #include <linux/kernel.h>
 #include <linux/mm.h>
+#include <linux/moduleparam.h>
 #include <linux/slab.h>
 #include <linux/vmalloc.h>
 #include <linux/err.h>
 #include <linux/kref.h>
+#include <linux/percpu.h>
 
+#include "include/apparmor.h"
 #include "include/lib.h"
 #include "include/match.h"
+#include "include/policy.h"
 
 #define base_idx(X) ((X) & 0xffffff)
 
+/*
+ * Matching acceleration, built by aa_dfa_unpack() next to the tables:
+ *
+ * - equivalence classes, generated when the policy doesn't provide them,
+ *   so that bytes the dfa never tells apart share one column
+ * - a dense transition table, one entry per (state, class), for the lowest
+ *   numbered states, which are the ones closest to the start state that
+ *   every path goes through. It replaces the base/check/default walk with
+ *   a single load.
+ * - a per-CPU cache of the states reached after recently matched path
+ *   prefixes, for the states the dense table doesn't cover
+ */
+#define DFA_DENSE_MAX_SIZE	(64 * 1024)	/* bytes of dense table */
+#define DFA_EC_MAX_STATES	16384		/* generating classes is O(n) */
+#define DFA_BUILD_MAX_COST	(1024 * 1024)	/* table lookups per dfa */
+
+struct aa_dfa_accel {
+	struct aa_dfa dfa;
+	u64 id;				/* tags prefix cache entries */
+	unsigned int classes;
+	unsigned int dense_states;	/* states in @dense */
+	size_t dense_bytes;		/* charged for @dense */
+	u16 *dense;
+	u8 ec[256];
+};
+
+#define dfa_accel(X) container_of(X, struct aa_dfa_accel, dfa)
+
+static atomic64_t dfa_accel_ids = ATOMIC64_INIT(0);
+
+/*
+ * Bytes of dense tables all dfas together may use. A policy with many
+ * profiles would otherwise pin up to DFA_DENSE_MAX_SIZE per dfa; once the
+ * budget is used up, further dfas are matched without a dense table.
+ * 0 disables dense tables.
+ */
+static unsigned int dfa_dense_budget = 4 * 1024 * 1024;
+
+static int param_set_dfa_dense_budget(const char *val,
+				      const struct kernel_param *kp)
+{
+	if (!apparmor_enabled)
+		return -EINVAL;
+	if (apparmor_initialized && !aa_current_policy_admin_capable(NULL))
+		return -EPERM;
+	return param_set_uint(val, kp);
+}
+
+static int param_get_dfa_dense_budget(char *buffer,
+				      const struct kernel_param *kp)
+{
+	if (!apparmor_enabled)
+		return -EINVAL;
+	if (apparmor_initialized && !aa_current_policy_view_capable(NULL))
+		return -EPERM;
+	return param_get_uint(buffer, kp);
+}
+
+module_param_call(dfa_dense_budget, param_set_dfa_dense_budget,
+		  param_get_dfa_dense_budget, &dfa_dense_budget, 0600);
+
+static atomic_long_t dfa_dense_bytes = ATOMIC_LONG_INIT(0);
+
+/* Charge a dense table of @size bytes against dfa_dense_budget */
+static bool dfa_dense_charge(size_t size)
+{
+	if (atomic_long_add_return(size, &dfa_dense_bytes) >
+	    READ_ONCE(dfa_dense_budget)) {
+		atomic_long_sub(size, &dfa_dense_bytes);
+		return false;
+	}
+	return true;
+}
+
+#define PREFIX_CACHE_SLOTS	16
+#define PREFIX_MIN_LEN		16
+#define PREFIX_MAX_LEN		128
+
+/*
+ * Entries are only used by their own CPU with preemption disabled; @seq is
+ * odd while an entry is written and catches an interrupt rewriting it.
+ */
+struct prefix_cache_entry {
+	u32 seq;
+	unsigned int start;
+	unsigned int state;
+	unsigned int len;
+	u64 id;
+	char prefix[PREFIX_MAX_LEN];
+};
+
+struct prefix_cache {
+	struct prefix_cache_entry slots[PREFIX_CACHE_SLOTS];
+};
+
+static DEFINE_PER_CPU(struct prefix_cache, prefix_cache);
+
 static char nulldfa_src[] = {
 	#include "nulldfa.in"
 };
@@ -271,14 +373,200 @@ static int verify_dfa(struct aa_dfa *dfa)
 static void dfa_free(struct aa_dfa *dfa)
 {
 	if (dfa) {
+		struct aa_dfa_accel *accel = dfa_accel(dfa);
 		int i;
 
 		for (i = 0; i < ARRAY_SIZE(dfa->tables); i++) {
 			kvfree(dfa->tables[i]);
 			dfa->tables[i] = NULL;
 		}
-		kfree(dfa);
+		if (accel->dense)
+			atomic_long_sub(accel->dense_bytes, &dfa_dense_bytes);
+		kvfree(accel->dense);
+		kfree(accel);
+	}
+}
+
+/**
+ * dfa_build_trans - compute one transition the way match_char() does
+ * @dfa: dfa to compute the transition in (NOT NULL)
+ * @state: state to transition from
+ * @c: input character, after equivalence class mapping if any
+ * @cost: Returns - incremented by the number of states walked
+ *
+ * Tables may not have been verified, so check every index.
+ *
+ * Returns: next state or -1 if the tables are out of bounds
+ */
+static int dfa_build_trans(struct aa_dfa *dfa, unsigned int state,
+			   unsigned int c, size_t *cost)
+{
+	size_t state_count = dfa->tables[YYTD_ID_BASE]->td_lolen;
+	size_t trans_count = dfa->tables[YYTD_ID_NXT]->td_lolen;
+	size_t steps, pos;
+	u32 b;
+
+	for (steps = 0; steps < state_count; steps++) {
+		(*cost)++;
+		if (state >= state_count)
+			return -1;
+		b = BASE_TABLE(dfa)[state];
+		pos = base_idx(b) + c;
+		if (pos >= trans_count)
+			return -1;
+		if (CHECK_TABLE(dfa)[pos] == state)
+			return NEXT_TABLE(dfa)[pos];
+		state = DEFAULT_TABLE(dfa)[state];
+		if (!(b & MATCH_FLAG_DIFF_ENCODE))
+			return state;
+	}
+
+	return -1;
+}
+
+/**
+ * dfa_build_ec - generate equivalence classes for a dfa without them
+ * @dfa: dfa to generate classes for (NOT NULL)
+ * @ec: Returns - class of each byte
+ * @cost: Returns - incremented by the work done
+ *
+ * Refine a single class containing all bytes, state by state: two bytes
+ * stay in the same class only if they lead to the same next state from
+ * every state. Classes from only some of the states would be wrong, so
+ * give up once @cost exceeds DFA_BUILD_MAX_COST.
+ *
+ * Returns: number of classes, or 0 if the dfa is too large or malformed
+ */
+static unsigned int dfa_build_ec(struct aa_dfa *dfa, u8 *ec, size_t *cost)
+{
+	size_t state_count = dfa->tables[YYTD_ID_BASE]->td_lolen;
+	unsigned int classes = 1, nclasses, c, k;
+	int *next, *rep;
+	u8 *nec;
+	size_t i;
+
+	if (state_count > DFA_EC_MAX_STATES)
+		return 0;
+
+	next = kmalloc_array(256, sizeof(*next), GFP_KERNEL);
+	rep = kmalloc_array(256, sizeof(*rep), GFP_KERNEL);
+	nec = kmalloc(256, GFP_KERNEL);
+	if (!next || !rep || !nec) {
+		classes = 0;
+		goto out;
+	}
+
+	memset(ec, 0, 256);
+	for (i = 0; i < state_count && classes < 256; i++) {
+		for (c = 0; c < 256; c++) {
+			next[c] = dfa_build_trans(dfa, i, c, cost);
+			if (next[c] < 0) {
+				classes = 0;
+				goto out;
+			}
+		}
+
+		/* split each class by next state, rep[] is a new class' byte */
+		nclasses = 0;
+		for (c = 0; c < 256; c++) {
+			for (k = 0; k < nclasses; k++) {
+				if (ec[rep[k]] == ec[c] &&
+				    next[rep[k]] == next[c])
+					break;
+			}
+			if (k == nclasses)
+				rep[nclasses++] = c;
+			nec[c] = k;
+		}
+		memcpy(ec, nec, 256);
+		classes = nclasses;
+
+		*cost += 256 * nclasses;
+		if (*cost > DFA_BUILD_MAX_COST) {
+			classes = 0;
+			goto out;
+		}
 	}
+
+out:
+	kfree(nec);
+	kfree(rep);
+	kfree(next);
+	return classes;
+}
+
+/**
+ * dfa_accel_build - build the matching acceleration of a verified dfa
+ * @accel: dfa to accelerate (NOT NULL)
+ *
+ * Matching works without acceleration, so failing here is not an error.
+ *
+ * This runs at policy load, so the work is bounded by DFA_BUILD_MAX_COST
+ * table lookups. The dense table gets rows until the bound is reached;
+ * chains of default states make some rows far more expensive than others.
+ */
+static void dfa_accel_build(struct aa_dfa_accel *accel)
+{
+	struct aa_dfa *dfa = &accel->dfa;
+	size_t state_count = dfa->tables[YYTD_ID_BASE]->td_lolen;
+	unsigned int i, c, k, states;
+	size_t cost = 0, size;
+	u8 rep[256];
+	u16 *dense;
+	int next;
+
+	accel->id = atomic64_inc_return(&dfa_accel_ids);
+
+	if (dfa->tables[YYTD_ID_EC]) {
+		memcpy(accel->ec, EQUIV_TABLE(dfa), 256);
+		accel->classes = 0;
+		for (c = 0; c < 256; c++)
+			accel->classes = max_t(unsigned int, accel->classes,
+					       accel->ec[c] + 1);
+	} else {
+		accel->classes = dfa_build_ec(dfa, accel->ec, &cost);
+		if (!accel->classes)
+			return;
+	}
+
+	/* all bytes of a class lead to the same state, so compute one */
+	for (c = 0; c < 256; c++)
+		rep[accel->ec[c]] = c;
+
+	states = min_t(size_t, state_count,
+		       DFA_DENSE_MAX_SIZE / (accel->classes * sizeof(u16)));
+	size = (size_t)states * accel->classes * sizeof(u16);
+	if (!states || !dfa_dense_charge(size))
+		return;
+
+	dense = kvmalloc(size, GFP_KERNEL);
+	if (!dense)
+		goto uncharge;
+
+	for (i = 0; i < states && cost <= DFA_BUILD_MAX_COST; i++) {
+		for (k = 0; k < accel->classes; k++) {
+			/* the dfa sees the class when it has an EC table */
+			next = dfa_build_trans(dfa, i, dfa->tables[YYTD_ID_EC] ?
+					       k : rep[k], &cost);
+			if (next < 0) {
+				kvfree(dense);
+				goto uncharge;
+			}
+			dense[i * accel->classes + k] = next;
+		}
+	}
+	if (!i) {
+		kvfree(dense);
+		goto uncharge;
+	}
+
+	accel->dense = dense;
+	accel->dense_states = i;
+	accel->dense_bytes = size;
+	return;
+
+uncharge:
+	atomic_long_sub(size, &dfa_dense_bytes);
 }
 
 /**
@@ -309,7 +597,8 @@ struct aa_dfa *aa_dfa_unpack(void *blob, size_t size, int flags)
 	int error = -ENOMEM;
 	char *data = blob;
 	struct table_header *table = NULL;
-	struct aa_dfa *dfa = kzalloc(sizeof(struct aa_dfa), GFP_KERNEL);
+	struct aa_dfa_accel *accel = kzalloc(sizeof(*accel), GFP_KERNEL);
+	struct aa_dfa *dfa = accel ? &accel->dfa : NULL;
 	if (!dfa)
 		goto fail;
 
@@ -398,6 +687,8 @@ struct aa_dfa *aa_dfa_unpack(void *blob, size_t size, int flags)
 			goto fail;
 	}
 
+	dfa_accel_build(accel);
+
 	return dfa;
 
 fail:
@@ -420,6 +711,135 @@ do {							\
 	break;						\
 } while (1)
 
+/**
+ * dfa_accel_next - step one character using the dense table if possible
+ * @accel: accelerated dfa to traverse (NOT NULL)
+ * @state: the state to start in
+ * @c: the input character to transition on
+ *
+ * Returns: state reached after input @c
+ */
+static inline unsigned int dfa_accel_next(struct aa_dfa_accel *accel,
+					  unsigned int state, u8 c)
+{
+	struct aa_dfa *dfa = &accel->dfa;
+
+	if (state < accel->dense_states)
+		return accel->dense[state * accel->classes + accel->ec[c]];
+
+	if (dfa->tables[YYTD_ID_EC])
+		c = accel->ec[c];
+	match_char(state, DEFAULT_TABLE(dfa), BASE_TABLE(dfa), NEXT_TABLE(dfa),
+		   CHECK_TABLE(dfa), c);
+
+	return state;
+}
+
+/* length of @str up to its last '/' in the first PREFIX_MAX_LEN bytes */
+static unsigned int prefix_len(const char *str)
+{
+	unsigned int i, len = 0;
+
+	for (i = 0; i < PREFIX_MAX_LEN && str[i]; i++) {
+		if (str[i] == '/')
+			len = i + 1;
+	}
+
+	return len >= PREFIX_MIN_LEN ? len : 0;
+}
+
+static struct prefix_cache_entry *prefix_cache_slot(struct prefix_cache *cache,
+						    u64 id, unsigned int start,
+						    const char *str,
+						    unsigned int len)
+{
+	u32 hash = jhash(str, len, (u32)id ^ (u32)(id >> 32) ^ start);
+
+	return &cache->slots[hash % PREFIX_CACHE_SLOTS];
+}
+
+/*
+ * A hit needs the whole prefix to compare equal: the state decides what the
+ * task may access, so a hash collision must never return it.
+ */
+static bool prefix_cache_lookup(struct aa_dfa_accel *accel, unsigned int start,
+				const char *str, unsigned int len,
+				unsigned int *state)
+{
+	struct prefix_cache *cache = get_cpu_ptr(&prefix_cache);
+	struct prefix_cache_entry *e;
+	bool hit = false;
+	u32 seq;
+
+	e = prefix_cache_slot(cache, accel->id, start, str, len);
+	seq = READ_ONCE(e->seq);
+	barrier();
+	if (!(seq & 1) && e->id == accel->id && e->start == start &&
+	    e->len == len && !memcmp(e->prefix, str, len)) {
+		*state = e->state;
+		barrier();
+		hit = READ_ONCE(e->seq) == seq;
+	}
+	put_cpu_ptr(&prefix_cache);
+
+	return hit;
+}
+
+static void prefix_cache_fill(struct aa_dfa_accel *accel, unsigned int start,
+			      const char *str, unsigned int len,
+			      unsigned int state)
+{
+	struct prefix_cache *cache = get_cpu_ptr(&prefix_cache);
+	struct prefix_cache_entry *e;
+
+	e = prefix_cache_slot(cache, accel->id, start, str, len);
+	/* an odd seq means we interrupted a fill of this entry, leave it */
+	if (!(e->seq & 1)) {
+		WRITE_ONCE(e->seq, e->seq + 1);
+		barrier();
+		e->id = accel->id;
+		e->start = start;
+		e->len = len;
+		e->state = state;
+		memcpy(e->prefix, str, len);
+		barrier();
+		WRITE_ONCE(e->seq, e->seq + 1);
+	}
+	put_cpu_ptr(&prefix_cache);
+}
+
+/**
+ * dfa_accel_match - aa_dfa_match() using the acceleration tables
+ * @accel: accelerated dfa to match @str against (NOT NULL)
+ * @start: the state of the dfa to start matching in
+ * @str: the null terminated string of bytes to match against the dfa (NOT NULL)
+ *
+ * Returns: final state reached after input is consumed
+ */
+static unsigned int dfa_accel_match(struct aa_dfa_accel *accel,
+				    unsigned int start, const char *str)
+{
+	unsigned int state = start, len = 0, i;
+
+	/* walking the dense table is cheaper than the cache lookup */
+	if (accel->dense_states < accel->dfa.tables[YYTD_ID_BASE]->td_lolen)
+		len = prefix_len(str);
+
+	if (len) {
+		if (!prefix_cache_lookup(accel, start, str, len, &state)) {
+			for (i = 0; i < len; i++)
+				state = dfa_accel_next(accel, state, str[i]);
+			prefix_cache_fill(accel, start, str, len, state);
+		}
+		str += len;
+	}
+
+	while (*str)
+		state = dfa_accel_next(accel, state, *str++);
+
+	return state;
+}
+
 /**
  * aa_dfa_match_len - traverse @dfa to find state @str stops at
  * @dfa: the dfa to match @str against  (NOT NULL)
@@ -439,6 +859,7 @@ do {							\
 unsigned int aa_dfa_match_len(struct aa_dfa *dfa, unsigned int start,
 			      const char *str, int len)
 {
+	struct aa_dfa_accel *accel = dfa_accel(dfa);
 	u16 *def = DEFAULT_TABLE(dfa);
 	u32 *base = BASE_TABLE(dfa);
 	u16 *next = NEXT_TABLE(dfa);
@@ -448,6 +869,12 @@ unsigned int aa_dfa_match_len(struct aa_dfa *dfa, unsigned int start,
 	if (state == 0)
 		return 0;
 
+	if (accel->dense) {
+		for (; len; len--)
+			state = dfa_accel_next(accel, state, *str++);
+		return state;
+	}
+
 	/* current state is <state>, matching character *str */
 	if (dfa->tables[YYTD_ID_EC]) {
 		/* Equivalence class table defined */
@@ -479,6 +906,7 @@ unsigned int aa_dfa_match_len(struct aa_dfa *dfa, unsigned int start,
 unsigned int aa_dfa_match(struct aa_dfa *dfa, unsigned int start,
 			  const char *str)
 {
+	struct aa_dfa_accel *accel = dfa_accel(dfa);
 	u16 *def = DEFAULT_TABLE(dfa);
 	u32 *base = BASE_TABLE(dfa);
 	u16 *next = NEXT_TABLE(dfa);
@@ -488,6 +916,9 @@ unsigned int aa_dfa_match(struct aa_dfa *dfa, unsigned int start,
 	if (state == 0)
 		return 0;
 
+	if (accel->classes)
+		return dfa_accel_match(accel, state, str);
+
 	/* current state is <state>, matching character *str */
 	if (dfa->tables[YYTD_ID_EC]) {
 		/* Equivalence class table defined */
@@ -28,6 +28,7 @@
 #include <linux/ipv6.h>
 #include <net/ipv6.h>
 #include "avc.h"
+#include "avc_lookaside.h"
 #include "avc_ss.h"
 #include "classmap.h"
 
@@ -37,11 +38,16 @@
 #define AVC_CACHE_SLOTS			512
 #define AVC_DEF_CACHE_THRESHOLD		512
 #define AVC_CACHE_RECLAIM		16
+/* most node count changes kept per CPU before they reach active_nodes */
+#define AVC_CACHE_BATCH			16
+#define AVC_LOOKASIDE_SLOTS		64
 
 #ifdef CONFIG_SECURITY_SELINUX_AVC_STATS
 #define avc_cache_stats_incr(field)	this_cpu_inc(avc_cache_stats.field)
+#define avc_lookaside_stats_incr(field)	this_cpu_inc(avc_lookaside_stats.field)
 #else
 #define avc_cache_stats_incr(field)	do {} while (0)
+#define avc_lookaside_stats_incr(field)	do {} while (0)
 #endif
 
 struct avc_entry {
@@ -74,8 +80,30 @@ struct avc_cache {
 	atomic_t		lru_hint;	/* LRU hint for reclaim scan */
 	atomic_t		active_nodes;
 	u32			latest_notif;	/* latest revocation notification */
+	atomic64_t		lookaside_gen;	/* bumped on decision changes */
 };
 
+/*
+ * Per-CPU direct-mapped cache of recent decisions, looked up before the
+ * hash table.  An entry holds a copy of the decision, not a node, so it
+ * outlives the node, and is only valid while lookaside_gen hasn't moved
+ * since the decision was read from the AVC.  Each CPU only touches its own
+ * entries, with preemption disabled; @seq is odd while an entry is being
+ * written and catches an interrupt rewriting the entry under a lookup.
+ */
+struct avc_lookaside_entry {
+	u32			seq;
+	u64			gen;
+	u32			ssid;
+	u32			tsid;
+	u16			tclass;
+	struct av_decision	avd;
+};
+
+static DEFINE_PER_CPU(struct avc_lookaside_entry [AVC_LOOKASIDE_SLOTS],
+		      avc_lookaside);
+static DEFINE_PER_CPU(int, avc_nodes_delta);
+
 struct avc_callback_node {
 	int (*callback) (u32 event);
 	u32 events;
@@ -84,26 +112,43 @@ struct avc_callback_node {
 
 #ifdef CONFIG_SECURITY_SELINUX_AVC_STATS
 DEFINE_PER_CPU(struct avc_cache_stats, avc_cache_stats) = { 0 };
+DEFINE_PER_CPU(struct avc_lookaside_stats, avc_lookaside_stats) = { 0 };
 #endif
 
 struct selinux_avc {
 	unsigned int avc_cache_threshold;
+	int avc_nodes_batch;
 	struct avc_cache avc_cache;
 };
 
 static struct selinux_avc selinux_avc;
 
+/*
+ * Every CPU can hold back up to batch - 1 node count changes.  Keep all of
+ * them together within an eighth of the threshold, so that reclaim starts
+ * close to where it should even on large machines.
+ */
+static int avc_nodes_batch(unsigned int cache_threshold)
+{
+	return clamp_t(unsigned int,
+		       cache_threshold / (8 * num_possible_cpus()),
+		       1, AVC_CACHE_BATCH);
+}
+
 void selinux_avc_init(struct selinux_avc **avc)
 {
 	int i;
 
 	selinux_avc.avc_cache_threshold = AVC_DEF_CACHE_THRESHOLD;
+	selinux_avc.avc_nodes_batch = avc_nodes_batch(AVC_DEF_CACHE_THRESHOLD);
 	for (i = 0; i < AVC_CACHE_SLOTS; i++) {
 		INIT_HLIST_HEAD(&selinux_avc.avc_cache.slots[i]);
 		spin_lock_init(&selinux_avc.avc_cache.slots_lock[i]);
 	}
 	atomic_set(&selinux_avc.avc_cache.active_nodes, 0);
 	atomic_set(&selinux_avc.avc_cache.lru_hint, 0);
+	/* zeroed lookaside entries are never valid */
+	atomic64_set(&selinux_avc.avc_cache.lookaside_gen, 1);
 	*avc = &selinux_avc;
 }
 
@@ -116,6 +161,7 @@ void avc_set_cache_threshold(struct selinux_avc *avc,
 			     unsigned int cache_threshold)
 {
 	avc->avc_cache_threshold = cache_threshold;
+	WRITE_ONCE(avc->avc_nodes_batch, avc_nodes_batch(cache_threshold));
 }
 
 static struct avc_callback_node *avc_callbacks __ro_after_init;
@@ -129,6 +175,113 @@ static inline int avc_hash(u32 ssid, u32 tsid, u16 tclass)
 	return (ssid ^ (tsid<<2) ^ (tclass<<4)) & (AVC_CACHE_SLOTS - 1);
 }
 
+static inline int avc_lookaside_hash(u32 ssid, u32 tsid, u16 tclass)
+{
+	return (ssid ^ (tsid<<3) ^ (tclass<<1)) & (AVC_LOOKASIDE_SLOTS - 1);
+}
+
+/*
+ * Generation to tag lookaside entries with, read before the decision is
+ * looked up.  Pairs with the barrier in avc_lookaside_invalidate(): if we
+ * see the new generation, we also see the new decision.
+ */
+static inline u64 avc_lookaside_gen(struct selinux_avc *avc)
+{
+	u64 gen = atomic64_read(&avc->avc_cache.lookaside_gen);
+
+	smp_rmb();
+	return gen;
+}
+
+/* called after a decision in the AVC was replaced or removed */
+static inline void avc_lookaside_invalidate(struct selinux_avc *avc)
+{
+	smp_mb__before_atomic();
+	atomic64_inc(&avc->avc_cache.lookaside_gen);
+}
+
+static bool avc_lookaside_lookup(u64 gen, u32 ssid, u32 tsid, u16 tclass,
+				 struct av_decision *avd)
+{
+	struct avc_lookaside_entry *e;
+	bool hit = false;
+	u32 seq;
+
+	e = get_cpu_ptr(&avc_lookaside[avc_lookaside_hash(ssid, tsid, tclass)]);
+	seq = READ_ONCE(e->seq);
+	barrier();
+	if (!(seq & 1) && e->ssid == ssid && e->tsid == tsid &&
+	    e->tclass == tclass) {
+		if (e->gen == gen) {
+			*avd = e->avd;
+			barrier();
+			hit = READ_ONCE(e->seq) == seq;
+		} else {
+			avc_lookaside_stats_incr(stale);
+		}
+	}
+
+	if (hit)
+		avc_lookaside_stats_incr(hits);
+	else
+		avc_lookaside_stats_incr(misses);
+	put_cpu_ptr(&avc_lookaside);
+
+	return hit;
+}
+
+static void avc_lookaside_fill(u64 gen, u32 ssid, u32 tsid, u16 tclass,
+			       const struct av_decision *avd)
+{
+	struct avc_lookaside_entry *e;
+	u32 seq;
+
+	e = get_cpu_ptr(&avc_lookaside[avc_lookaside_hash(ssid, tsid, tclass)]);
+	seq = READ_ONCE(e->seq);
+	/* we interrupted a fill of the same entry, leave it alone */
+	if (seq & 1)
+		goto out;
+
+	WRITE_ONCE(e->seq, seq + 1);
+	barrier();
+	e->gen = gen;
+	e->ssid = ssid;
+	e->tsid = tsid;
+	e->tclass = tclass;
+	e->avd = *avd;
+	barrier();
+	WRITE_ONCE(e->seq, seq + 2);
+out:
+	put_cpu_ptr(&avc_lookaside);
+}
+
+/*
+ * Account for @nr nodes allocated or freed.  Changes reach the shared
+ * active_nodes counter in batches, see avc_nodes_batch(), which is precise
+ * enough for comparing against the cache threshold.
+ */
+static int avc_nodes_add(struct selinux_avc *avc, int nr)
+{
+	int delta = this_cpu_add_return(avc_nodes_delta, nr);
+
+	if (abs(delta) >= READ_ONCE(avc->avc_nodes_batch)) {
+		this_cpu_sub(avc_nodes_delta, delta);
+		return atomic_add_return(delta, &avc->avc_cache.active_nodes);
+	}
+
+	return atomic_read(&avc->avc_cache.active_nodes);
+}
+
+/* The node count, including the changes still held per CPU */
+static int avc_nodes_read(struct selinux_avc *avc)
+{
+	int cpu, nr = atomic_read(&avc->avc_cache.active_nodes);
+
+	for_each_possible_cpu(cpu)
+		nr += per_cpu(avc_nodes_delta, cpu);
+	return nr;
+}
+
 /**
  * avc_init - Initialize the AVC.
  *
@@ -176,7 +329,7 @@ int avc_get_hash_stats(struct selinux_avc *avc, char *page)
 
 	return scnprintf(page, PAGE_SIZE, "entries: %d\nbuckets used: %d/%d\n"
 			 "longest chain: %d\n",
-			 atomic_read(&avc->avc_cache.active_nodes),
+			 avc_nodes_read(avc),
 			 slots_used, AVC_CACHE_SLOTS, max_chain_len);
 }
 
@@ -443,7 +596,7 @@ static void avc_node_delete(struct selinux_avc *avc, struct avc_node *node)
 {
 	hlist_del_rcu(&node->list);
 	call_rcu(&node->rhead, avc_node_free);
-	atomic_dec(&avc->avc_cache.active_nodes);
+	avc_nodes_add(avc, -1);
 }
 
 static void avc_node_kill(struct selinux_avc *avc, struct avc_node *node)
@@ -451,7 +604,7 @@ static void avc_node_kill(struct selinux_avc *avc, struct avc_node *node)
 	avc_xperms_free(node->ae.xp_node);
 	kmem_cache_free(avc_node_cachep, node);
 	avc_cache_stats_incr(frees);
-	atomic_dec(&avc->avc_cache.active_nodes);
+	avc_nodes_add(avc, -1);
 }
 
 static void avc_node_replace(struct selinux_avc *avc,
@@ -459,20 +612,22 @@ static void avc_node_replace(struct selinux_avc *avc,
 {
 	hlist_replace_rcu(&old->list, &new->list);
 	call_rcu(&old->rhead, avc_node_free);
-	atomic_dec(&avc->avc_cache.active_nodes);
+	avc_nodes_add(avc, -1);
+	avc_lookaside_invalidate(avc);
 }
 
 static inline int avc_reclaim_node(struct selinux_avc *avc)
 {
 	struct avc_node *node;
-	int hvalue, try, ecx;
+	int hint, hvalue, try, ecx;
 	unsigned long flags;
 	struct hlist_head *head;
 	spinlock_t *lock;
 
+	/* scan from the hint, only publish where we stopped */
+	hint = atomic_read(&avc->avc_cache.lru_hint);
 	for (try = 0, ecx = 0; try < AVC_CACHE_SLOTS; try++) {
-		hvalue = atomic_inc_return(&avc->avc_cache.lru_hint) &
-			(AVC_CACHE_SLOTS - 1);
+		hvalue = (hint + try + 1) & (AVC_CACHE_SLOTS - 1);
 		head = &avc->avc_cache.slots[hvalue];
 		lock = &avc->avc_cache.slots_lock[hvalue];
 
@@ -494,6 +649,7 @@ static inline int avc_reclaim_node(struct selinux_avc *avc)
 		spin_unlock_irqrestore(lock, flags);
 	}
 out:
+	atomic_set(&avc->avc_cache.lru_hint, hint + try + 1);
 	return ecx;
 }
 
@@ -508,8 +664,7 @@ static struct avc_node *avc_alloc_node(struct selinux_avc *avc)
 	INIT_HLIST_NODE(&node->list);
 	avc_cache_stats_incr(allocations);
 
-	if (atomic_inc_return(&avc->avc_cache.active_nodes) >
-	    avc->avc_cache_threshold)
+	if (avc_nodes_add(avc, 1) > avc->avc_cache_threshold)
 		avc_reclaim_node(avc);
 
 out:
@@ -960,6 +1115,8 @@ static void avc_flush(struct selinux_avc *avc)
 		rcu_read_unlock();
 		spin_unlock_irqrestore(lock, flag);
 	}
+
+	avc_lookaside_invalidate(avc);
 }
 
 /**
@@ -1143,18 +1300,30 @@ inline int avc_has_perm_noaudit(struct selinux_state *state,
 	struct avc_xperms_node xp_node;
 	int rc = 0;
 	u32 denied;
+	u64 gen;
 
 	if (WARN_ON(!requested))
 		return -EACCES;
 
+	gen = avc_lookaside_gen(state->avc);
+
 	rcu_read_lock();
 
+	if (avc_lookaside_lookup(gen, ssid, tsid, tclass, avd))
+		goto check;
+
 	node = avc_lookup(state->avc, ssid, tsid, tclass);
 	if (unlikely(!node))
-		avc_compute_av(state, ssid, tsid, tclass, avd, &xp_node);
+		node = avc_compute_av(state, ssid, tsid, tclass, avd,
+				      &xp_node);
 	else
 		memcpy(avd, &node->ae.avd, sizeof(*avd));
 
+	/* only remember decisions the AVC holds, it tracks their changes */
+	if (node)
+		avc_lookaside_fill(gen, ssid, tsid, tclass, avd);
+
+check:
 	denied = requested & ~(avd->allowed);
 	if (unlikely(denied))
 		rc = avc_denied(state, ssid, tsid, tclass, requested, 0, 0,
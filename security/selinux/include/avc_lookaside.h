@@ -0,0 +1,20 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Per-CPU lookaside cache in front of the access vector cache.
+ */
+#ifndef _SELINUX_AVC_LOOKASIDE_H_
+#define _SELINUX_AVC_LOOKASIDE_H_
+
+#include <linux/percpu.h>
+
+struct avc_lookaside_stats {
+	unsigned int hits;
+	unsigned int misses;
+	unsigned int stale;	/* entry matched, but the AVC changed since */
+};
+
+#ifdef CONFIG_SECURITY_SELINUX_AVC_STATS
+DECLARE_PER_CPU(struct avc_lookaside_stats, avc_lookaside_stats);
+#endif
+
+#endif /* _SELINUX_AVC_LOOKASIDE_H_ */
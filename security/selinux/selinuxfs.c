@@ -37,6 +37,7 @@
 
 #include "flask.h"
 #include "avc.h"
+#include "avc_lookaside.h"
 #include "avc_ss.h"
 #include "security.h"
 #include "objsec.h"
@@ -1612,7 +1613,7 @@ static const struct file_operations sel_avc_hash_stats_ops = {
 };
 
 #ifdef CONFIG_SECURITY_SELINUX_AVC_STATS
-static struct avc_cache_stats *sel_avc_get_stat_idx(loff_t *idx)
+static int sel_avc_get_stat_cpu(loff_t *idx)
 {
 	int cpu;
 
@@ -1620,10 +1621,17 @@ static struct avc_cache_stats *sel_avc_get_stat_idx(loff_t *idx)
 		if (!cpu_possible(cpu))
 			continue;
 		*idx = cpu + 1;
-		return &per_cpu(avc_cache_stats, cpu);
+		return cpu;
 	}
 	(*idx)++;
-	return NULL;
+	return -1;
+}
+
+static struct avc_cache_stats *sel_avc_get_stat_idx(loff_t *idx)
+{
+	int cpu = sel_avc_get_stat_cpu(idx);
+
+	return cpu < 0 ? NULL : &per_cpu(avc_cache_stats, cpu);
 }
 
 static void *sel_avc_stats_seq_start(struct seq_file *seq, loff_t *pos)
@@ -1669,6 +1677,47 @@ static const struct seq_operations sel_avc_cache_stats_seq_ops = {
 	.stop		= sel_avc_stats_seq_stop,
 };
 
+static struct avc_lookaside_stats *sel_avc_get_lookaside_idx(loff_t *idx)
+{
+	int cpu = sel_avc_get_stat_cpu(idx);
+
+	return cpu < 0 ? NULL : &per_cpu(avc_lookaside_stats, cpu);
+}
+
+static void *sel_avc_lookaside_seq_start(struct seq_file *seq, loff_t *pos)
+{
+	loff_t n = *pos - 1;
+
+	if (*pos == 0)
+		return SEQ_START_TOKEN;
+
+	return sel_avc_get_lookaside_idx(&n);
+}
+
+static void *sel_avc_lookaside_seq_next(struct seq_file *seq, void *v,
+					loff_t *pos)
+{
+	return sel_avc_get_lookaside_idx(pos);
+}
+
+static int sel_avc_lookaside_seq_show(struct seq_file *seq, void *v)
+{
+	struct avc_lookaside_stats *st = v;
+
+	if (v == SEQ_START_TOKEN)
+		seq_puts(seq, "hits misses stale\n");
+	else
+		seq_printf(seq, "%u %u %u\n", st->hits, st->misses, st->stale);
+	return 0;
+}
+
+static const struct seq_operations sel_avc_lookaside_stats_seq_ops = {
+	.start		= sel_avc_lookaside_seq_start,
+	.next		= sel_avc_lookaside_seq_next,
+	.show		= sel_avc_lookaside_seq_show,
+	.stop		= sel_avc_stats_seq_stop,
+};
+
 static int sel_open_avc_cache_stats(struct inode *inode, struct file *file)
 {
 	return seq_open(file, &sel_avc_cache_stats_seq_ops);
@@ -1680,6 +1729,18 @@ static const struct file_operations sel_avc_cache_stats_ops = {
 	.llseek		= seq_lseek,
 	.release	= seq_release,
 };
+
+static int sel_open_avc_lookaside_stats(struct inode *inode, struct file *file)
+{
+	return seq_open(file, &sel_avc_lookaside_stats_seq_ops);
+}
+
+static const struct file_operations sel_avc_lookaside_stats_ops = {
+	.open		= sel_open_avc_lookaside_stats,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= seq_release,
+};
 #endif
 
 static int sel_make_avc_files(struct dentry *dir)
@@ -1693,6 +1754,7 @@ static int sel_make_avc_files(struct dentry *dir)
 		{ "hash_stats", &sel_avc_hash_stats_ops, S_IRUGO },
 #ifdef CONFIG_SECURITY_SELINUX_AVC_STATS
 		{ "cache_stats", &sel_avc_cache_stats_ops, S_IRUGO },
+		{ "lookaside_stats", &sel_avc_lookaside_stats_ops, S_IRUGO },
 #endif
 	};
 
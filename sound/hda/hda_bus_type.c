@@ -8,6 +8,7 @@
 #include <linux/mod_devicetable.h>
 #include <linux/export.h>
 #include <sound/hdaudio.h>
+#include "local.h"
 
 MODULE_DESCRIPTION("HD-audio bus");
 MODULE_LICENSE("GPL");
@@ -91,6 +92,7 @@ static int __init hda_bus_init(void)
 static void __exit hda_bus_exit(void)
 {
 	bus_unregister(&snd_hda_bus_type);
+	snd_hdac_topo_cleanup();
 }
 
 subsys_initcall(hda_bus_init);
@@ -135,6 +135,110 @@ int snd_hdac_bus_exec_verb_unlocked(struct hdac_bus *bus, unsigned int addr,
 }
 EXPORT_SYMBOL_GPL(snd_hdac_bus_exec_verb_unlocked);
 
+/* leave CORB room for the other codecs and keep the RIRB from overflowing */
+#define HDAC_MAX_BATCH_VERBS	32
+
+static int exec_verb_batch(struct hdac_bus *bus, unsigned int addr,
+			   const unsigned int *cmds, unsigned int *res,
+			   unsigned int num)
+{
+	unsigned int i, n, tmp;
+	int err = 0;
+
+	for (i = 0; i < num; i++)
+		res[i] = -1;
+
+	spin_lock_irq(&bus->reg_lock);
+	/* stale responses would be taken for ours */
+	if (bus->rirb.cmds[addr]) {
+		spin_unlock_irq(&bus->reg_lock);
+		return -EBUSY;
+	}
+	bus->batch_res[addr] = res;
+	bus->batch_len[addr] = 0;
+	bus->batch_max[addr] = num;
+	spin_unlock_irq(&bus->reg_lock);
+
+	trace_hda_send_cmds(bus, addr, num);
+	for (i = 0; i < num; ) {
+		if (cmds[i] == ~0) {
+			err = -EINVAL;
+			break;
+		}
+		trace_hda_send_cmd(bus, cmds[i]);
+		err = bus->ops->command(bus, cmds[i]);
+		if (err == -EAGAIN) {
+			/* CORB full, wait for the verbs in flight */
+			err = bus->ops->get_response(bus, addr, &tmp);
+			if (err)
+				break;
+			continue;
+		}
+		if (err)
+			break;
+		i++;
+	}
+	if (!err)
+		err = bus->ops->get_response(bus, addr, &tmp);
+
+	spin_lock_irq(&bus->reg_lock);
+	bus->batch_res[addr] = NULL;
+	n = bus->batch_len[addr];
+	spin_unlock_irq(&bus->reg_lock);
+
+	for (i = 0; i < n; i++)
+		trace_hda_get_response(bus, addr, res[i]);
+	/* a controller falling back to immediate commands bypasses the RIRB */
+	if (!err && n != num)
+		err = -EIO;
+	return err;
+}
+
+/**
+ * snd_hdac_bus_exec_verbs_unlocked - execute several verbs at once
+ * @bus: bus object
+ * @addr: the HDAC device address
+ * @cmds: HD-audio encoded verbs
+ * @res: array to store the @num responses
+ * @num: number of verbs
+ *
+ * Queues the verbs to the CORB before waiting for the responses, so that
+ * the round trip to the codec is paid once per batch instead of once per
+ * verb. The caller must hold bus->cmd_mutex. Without CORB/RIRB batching
+ * support the verbs are executed one by one.
+ *
+ * On error, the responses are undefined and the verbs may have been only
+ * partially executed; callers should retry one by one.
+ *
+ * Returns 0 if successful, or a negative error code.
+ */
+int snd_hdac_bus_exec_verbs_unlocked(struct hdac_bus *bus, unsigned int addr,
+				     const unsigned int *cmds,
+				     unsigned int *res, unsigned int num)
+{
+	unsigned int i, n;
+	int err = 0;
+
+	if (!bus->batch_verbs) {
+		for (i = 0; i < num; i++) {
+			err = snd_hdac_bus_exec_verb_unlocked(bus, addr, cmds[i],
+							      &res[i]);
+			if (err)
+				break;
+		}
+		return err;
+	}
+
+	for (i = 0; i < num; i += n) {
+		n = min_t(unsigned int, num - i, HDAC_MAX_BATCH_VERBS);
+		err = exec_verb_batch(bus, addr, cmds + i, res + i, n);
+		if (err)
+			break;
+	}
+	return err;
+}
+EXPORT_SYMBOL_GPL(snd_hdac_bus_exec_verbs_unlocked);
+
 /**
  * snd_hdac_bus_queue_event - add an unsolicited event to queue
  * @bus: the BUS
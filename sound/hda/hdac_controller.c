@@ -216,7 +216,11 @@ void snd_hdac_bus_update_rirb(struct hdac_bus *bus)
 		} else if (res_ex & AZX_RIRB_EX_UNSOL_EV)
 			snd_hdac_bus_queue_event(bus, res, res_ex);
 		else if (bus->rirb.cmds[addr]) {
+			unsigned int *batch = bus->batch_res[addr];
+
 			bus->rirb.res[addr] = res;
+			if (batch && bus->batch_len[addr] < bus->batch_max[addr])
+				batch[bus->batch_len[addr]++] = res;
 			bus->rirb.cmds[addr]--;
 			if (!bus->rirb.cmds[addr] &&
 			    waitqueue_active(&bus->rirb_wq))
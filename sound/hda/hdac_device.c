@@ -91,15 +91,19 @@ int snd_hdac_device_init(struct hdac_device *codec, struct hdac_bus *bus,
 
 	fg = codec->afg ? codec->afg : codec->mfg;
 
+	/* reread ssid if not set by parameter */
+	if (codec->subsystem_id == -1 || codec->subsystem_id == 0)
+		snd_hdac_read(codec, fg, AC_VERB_GET_SUBSYSTEM_ID, 0,
+			      &codec->subsystem_id);
+
+	/* the topology cache is keyed by the IDs, so only now */
+	snd_hdac_topo_attach(codec);
+
 	err = snd_hdac_refresh_widgets(codec);
 	if (err < 0)
 		goto error;
 
 	codec->power_caps = snd_hdac_read_parm(codec, fg, AC_PAR_POWER_STATE);
-	/* reread ssid if not set by parameter */
-	if (codec->subsystem_id == -1 || codec->subsystem_id == 0)
-		snd_hdac_read(codec, fg, AC_VERB_GET_SUBSYSTEM_ID, 0,
-			      &codec->subsystem_id);
 
 	err = get_codec_vendor_name(codec);
 	if (err < 0)
@@ -130,6 +134,7 @@ void snd_hdac_device_exit(struct hdac_device *codec)
 	/* keep balance of runtime PM child_count in parent device */
 	pm_runtime_set_suspended(&codec->dev);
 	snd_hdac_bus_remove_device(codec->bus, codec);
+	snd_hdac_topo_detach(codec);
 	kfree(codec->vendor_name);
 	kfree(codec->chip_name);
 }
@@ -251,16 +256,92 @@ static unsigned int snd_hdac_make_cmd(struct hdac_device *codec, hda_nid_t nid,
  * Returns zero if successful, or a negative error code.
  *
  * This calls the exec_verb op when set in hdac_codec.  If not,
- * call the default snd_hdac_bus_exec_verb().
+ * call the default snd_hdac_bus_exec_verb().  Reads of read-only
+ * parameters may be served from the topology cache instead.
  */
 int snd_hdac_exec_verb(struct hdac_device *codec, unsigned int cmd,
 		       unsigned int flags, unsigned int *res)
 {
+	int err;
+
+	if (res && snd_hdac_topo_lookup(codec, cmd, res))
+		return 0;
 	if (codec->exec_verb)
-		return codec->exec_verb(codec, cmd, flags, res);
-	return snd_hdac_bus_exec_verb(codec->bus, codec->addr, cmd, res);
+		err = codec->exec_verb(codec, cmd, flags, res);
+	else
+		err = snd_hdac_bus_exec_verb(codec->bus, codec->addr, cmd, res);
+	if (!err && res)
+		snd_hdac_topo_record(codec, cmd, *res);
+	return err;
 }
 
+/* serve the whole batch from the topology cache, or nothing */
+static bool exec_verbs_cached(struct hdac_device *codec,
+			      const unsigned int *cmds, unsigned int *res,
+			      unsigned int num)
+{
+	unsigned int i;
+
+	for (i = 0; i < num; i++) {
+		if (!snd_hdac_topo_lookup(codec, cmds[i], &res[i]))
+			return false;
+	}
+	return true;
+}
+
+/**
+ * snd_hdac_exec_verbs - execute several encoded verbs at once
+ * @codec: the codec object
+ * @cmds: encoded verbs to execute
+ * @res: array to store the @num responses
+ * @num: number of verbs
+ *
+ * Returns zero if successful, or a negative error code.
+ *
+ * This calls the exec_verbs op when set in hdac_codec.  If not, the verbs
+ * are batched via snd_hdac_bus_exec_verbs_unlocked() and executed one by
+ * one again if the batch fails.  Only pass verbs that can be repeated.
+ * Responses of failed verbs are set to -1.
+ */
+int snd_hdac_exec_verbs(struct hdac_device *codec, const unsigned int *cmds,
+			unsigned int *res, unsigned int num)
+{
+	struct hdac_bus *bus = codec->bus;
+	unsigned int i;
+	int err;
+
+	if (exec_verbs_cached(codec, cmds, res, num))
+		return 0;
+
+	if (codec->exec_verbs) {
+		err = codec->exec_verbs(codec, cmds, res, num);
+	} else {
+		mutex_lock(&bus->cmd_mutex);
+		err = snd_hdac_bus_exec_verbs_unlocked(bus, codec->addr,
+						       cmds, res, num);
+		mutex_unlock(&bus->cmd_mutex);
+	}
+	if (!err) {
+		for (i = 0; i < num; i++)
+			snd_hdac_topo_record(codec, cmds[i], res[i]);
+		return 0;
+	}
+	if (codec->exec_verbs)
+		return err;
+
+	err = 0;
+	for (i = 0; i < num; i++) {
+		int ret;
+
+		res[i] = -1;
+		ret = snd_hdac_exec_verb(codec, cmds[i], 0, &res[i]);
+		if (ret < 0 && !err)
+			err = ret;
+	}
+	return err;
+}
+EXPORT_SYMBOL_GPL(snd_hdac_exec_verbs);
+
 
 /**
  * snd_hdac_read - execute a verb
@@ -321,6 +402,48 @@ int snd_hdac_read_parm_uncached(struct hdac_device *codec, hda_nid_t nid,
 }
 EXPORT_SYMBOL_GPL(snd_hdac_read_parm_uncached);
 
+/**
+ * snd_hdac_prefetch_parms - read a parameter of several widgets at once
+ * @codec: the codec object
+ * @nids: NIDs to read the parameter of
+ * @num: number of entries in @nids
+ * @parm: the parameter to read
+ *
+ * Reads the parameter with batched verbs and stores the values in the
+ * regmap cache, so that the following snd_hdac_read_parm() calls don't
+ * wait for the codec one by one.  Does nothing without regmap.
+ *
+ * Returns zero if successful, or a negative error code.
+ */
+int snd_hdac_prefetch_parms(struct hdac_device *codec, const hda_nid_t *nids,
+			    unsigned int num, unsigned int parm)
+{
+	unsigned int *cmds, *res;
+	unsigned int i;
+	int err;
+
+	if (!codec->regmap || !num)
+		return 0;
+
+	cmds = kmalloc_array(num, 2 * sizeof(*cmds), GFP_KERNEL);
+	if (!cmds)
+		return -ENOMEM;
+	res = cmds + num;
+
+	for (i = 0; i < num; i++)
+		cmds[i] = snd_hdac_make_cmd(codec, nids[i], AC_VERB_PARAMETERS,
+					    parm);
+	err = snd_hdac_exec_verbs(codec, cmds, res, num);
+	for (i = 0; !err && i < num; i++) {
+		if (res[i] != -1)
+			snd_hdac_override_parm(codec, nids[i], parm, res[i]);
+	}
+
+	kfree(cmds);
+	return err;
+}
+EXPORT_SYMBOL_GPL(snd_hdac_prefetch_parms);
+
 /**
  * snd_hdac_override_parm - override read-only parameters
  * @codec: the codec object
@@ -419,6 +542,11 @@ int snd_hdac_refresh_widgets(struct hdac_device *codec)
 		goto unlock;
 	}
 
+	/* the widgets were changed at runtime, e.g. by vendor verbs */
+	if (codec->num_nodes &&
+	    (nums != codec->num_nodes || start_nid != codec->start_nid))
+		snd_hdac_topo_invalidate(codec);
+
 	err = hda_widget_sysfs_reinit(codec, start_nid, nums);
 	if (err < 0)
 		goto unlock;
@@ -72,6 +72,9 @@ static const struct attribute_group hdac_dev_attr_group = {
 
 const struct attribute_group *hdac_dev_attr_groups[] = {
 	&hdac_dev_attr_group,
+#ifdef CONFIG_SND_HDA_TOPO_CACHE
+	&snd_hdac_topo_attr_group,
+#endif
 	NULL
 };
 
@@ -0,0 +1,578 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * HD-audio codec topology cache
+ *
+ * The parameters and the connection lists of a codec are read-only, yet
+ * they are read again with verbs whenever the codec is probed, i.e. at
+ * each boot, driver rebind or reconfig.  This caches the responses per
+ * codec model, keyed by the vendor, subsystem and revision IDs, so that
+ * the next probe of the same model can skip most of the verb traffic.
+ *
+ * A codec picks up the cache left by a previous instance of its model, or
+ * loads hda-topology/<vendor>-<subsystem>-<revision>.bin via firmware.
+ * The "topology" sysfs file of each codec shows the cache for saving it,
+ * and accepts a saved blob for the next probe.  A few entries are checked
+ * against the codec before a cache is used.
+ */
+
+#include <linux/firmware.h>
+#include <linux/list.h>
+#include <linux/mutex.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+#include <linux/sysfs.h>
+#include <sound/hdaudio.h>
+#include "local.h"
+
+#define HDAC_TOPO_MAGIC		0x54414448	/* "HDAT" */
+#define HDAC_TOPO_VERSION	1
+#define HDAC_TOPO_MAX_ENTRIES	8192
+#define HDAC_TOPO_MAX_SAVED	16
+#define HDAC_TOPO_SPOT_CHECKS	4
+
+/* blob format, all fields little-endian */
+struct hdac_topo_header {
+	__le32 magic;
+	__le32 version;
+	__le32 vendor_id;
+	__le32 subsystem_id;
+	__le32 revision_id;
+	__le32 count;		/* number of following cmd/res pairs */
+};
+
+struct hdac_topo_entry {
+	u32 cmd;		/* verb without the codec address */
+	u32 res;
+};
+
+struct hdac_topo_cache {
+	struct list_head list;	/* entry in topo_saved */
+	unsigned int vendor_id;
+	unsigned int subsystem_id;
+	unsigned int revision_id;
+
+	struct mutex lock;
+	struct hdac_topo_entry *entries; /* sorted by cmd */
+	unsigned int count;
+	unsigned int alloc;
+	unsigned int hits;
+	unsigned int misses;
+	bool disabled;		/* topology changed at runtime */
+
+	/* blob being written via sysfs */
+	void *upload;
+	size_t upload_len;
+};
+
+/* caches left by the codecs gone, most recent first */
+static LIST_HEAD(topo_saved);
+static DEFINE_MUTEX(topo_saved_lock);
+
+#define topo_key(cmd)	((cmd) & 0x0fffffff)
+
+/*
+ * Only the parameters and connection lists are cached.  The IDs are used
+ * for looking up the cache itself, and the node counts may change when a
+ * codec driver enables hidden widgets.
+ */
+static bool topo_cacheable(unsigned int cmd)
+{
+	switch ((cmd >> 8) & 0xfff) {
+	case AC_VERB_PARAMETERS:
+		switch (cmd & 0xff) {
+		case AC_PAR_VENDOR_ID:
+		case AC_PAR_SUBSYSTEM_ID:
+		case AC_PAR_REV_ID:
+		case AC_PAR_NODE_COUNT:
+			return false;
+		}
+		return true;
+	case AC_VERB_GET_CONNECT_LIST:
+		return true;
+	}
+	return false;
+}
+
+static bool topo_match(struct hdac_topo_cache *cache,
+		       struct hdac_device *codec)
+{
+	return cache->vendor_id == codec->vendor_id &&
+		cache->subsystem_id == codec->subsystem_id &&
+		cache->revision_id == codec->revision_id;
+}
+
+static struct hdac_topo_cache *topo_cache_new(unsigned int vendor_id,
+					      unsigned int subsystem_id,
+					      unsigned int revision_id)
+{
+	struct hdac_topo_cache *cache;
+
+	cache = kzalloc(sizeof(*cache), GFP_KERNEL);
+	if (!cache)
+		return NULL;
+	INIT_LIST_HEAD(&cache->list);
+	mutex_init(&cache->lock);
+	cache->vendor_id = vendor_id;
+	cache->subsystem_id = subsystem_id;
+	cache->revision_id = revision_id;
+	return cache;
+}
+
+static void topo_cache_free(struct hdac_topo_cache *cache)
+{
+	kvfree(cache->entries);
+	kfree(cache->upload);
+	kfree(cache);
+}
+
+/* binary search; returns true if found, @pos is the insertion point */
+static bool topo_find(struct hdac_topo_cache *cache, u32 key,
+		      unsigned int *pos)
+{
+	unsigned int lo = 0, hi = cache->count;
+
+	while (lo < hi) {
+		unsigned int mid = lo + (hi - lo) / 2;
+
+		if (cache->entries[mid].cmd == key) {
+			*pos = mid;
+			return true;
+		}
+		if (cache->entries[mid].cmd < key)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	*pos = lo;
+	return false;
+}
+
+static int topo_insert(struct hdac_topo_cache *cache, u32 key, u32 res)
+{
+	struct hdac_topo_entry *entries;
+	unsigned int pos, alloc;
+
+	if (topo_find(cache, key, &pos)) {
+		cache->entries[pos].res = res;
+		return 0;
+	}
+
+	if (cache->count >= cache->alloc) {
+		if (cache->count >= HDAC_TOPO_MAX_ENTRIES)
+			return -ENOSPC;
+		alloc = cache->alloc ? cache->alloc * 2 : 64;
+		entries = kvrealloc(cache->entries,
+				    cache->alloc * sizeof(*entries),
+				    alloc * sizeof(*entries), GFP_KERNEL);
+		if (!entries)
+			return -ENOMEM;
+		cache->entries = entries;
+		cache->alloc = alloc;
+	}
+
+	memmove(cache->entries + pos + 1, cache->entries + pos,
+		(cache->count - pos) * sizeof(*cache->entries));
+	cache->entries[pos].cmd = key;
+	cache->entries[pos].res = res;
+	cache->count++;
+	return 0;
+}
+
+static int topo_copy(struct hdac_topo_cache *dst, struct hdac_topo_cache *src)
+{
+	if (!src->count)
+		return 0;
+	dst->entries = kvmalloc_array(src->count, sizeof(*src->entries),
+				      GFP_KERNEL);
+	if (!dst->entries)
+		return -ENOMEM;
+	memcpy(dst->entries, src->entries, src->count * sizeof(*src->entries));
+	dst->count = dst->alloc = src->count;
+	return 0;
+}
+
+/* parse a blob into a new cache */
+static struct hdac_topo_cache *topo_parse(const void *data, size_t size)
+{
+	const struct hdac_topo_header *hdr = data;
+	const __le32 *p = data + sizeof(*hdr);
+	struct hdac_topo_cache *cache;
+	unsigned int i, count;
+	int err = 0;
+
+	if (size < sizeof(*hdr) ||
+	    le32_to_cpu(hdr->magic) != HDAC_TOPO_MAGIC ||
+	    le32_to_cpu(hdr->version) != HDAC_TOPO_VERSION)
+		return ERR_PTR(-EINVAL);
+	count = le32_to_cpu(hdr->count);
+	if (count > HDAC_TOPO_MAX_ENTRIES ||
+	    size != sizeof(*hdr) + count * 2 * sizeof(*p))
+		return ERR_PTR(-EINVAL);
+
+	cache = topo_cache_new(le32_to_cpu(hdr->vendor_id),
+			       le32_to_cpu(hdr->subsystem_id),
+			       le32_to_cpu(hdr->revision_id));
+	if (!cache)
+		return ERR_PTR(-ENOMEM);
+
+	for (i = 0; i < count && !err; i++, p += 2) {
+		u32 cmd = le32_to_cpu(p[0]);
+
+		if (cmd != topo_key(cmd) || !topo_cacheable(cmd))
+			err = -EINVAL;
+		else
+			err = topo_insert(cache, cmd, le32_to_cpu(p[1]));
+	}
+	if (err) {
+		topo_cache_free(cache);
+		return ERR_PTR(err);
+	}
+	return cache;
+}
+
+/* store a cache for the next probe of the same codec model */
+static void topo_save(struct hdac_topo_cache *cache)
+{
+	struct hdac_topo_cache *c, *tmp;
+	unsigned int num = 0;
+
+	mutex_lock(&topo_saved_lock);
+	list_for_each_entry_safe(c, tmp, &topo_saved, list) {
+		if (c->vendor_id == cache->vendor_id &&
+		    c->subsystem_id == cache->subsystem_id &&
+		    c->revision_id == cache->revision_id) {
+			list_del(&c->list);
+			topo_cache_free(c);
+		} else if (++num >= HDAC_TOPO_MAX_SAVED) {
+			list_del(&c->list);
+			topo_cache_free(c);
+		}
+	}
+	list_add(&cache->list, &topo_saved);
+	mutex_unlock(&topo_saved_lock);
+}
+
+/* fill the codec cache from a saved one or from the firmware file */
+static int topo_load(struct hdac_device *codec, struct hdac_topo_cache *cache)
+{
+	const struct firmware *fw;
+	struct hdac_topo_cache *c;
+	char name[48];
+	int err = -ENOENT;
+
+	mutex_lock(&topo_saved_lock);
+	list_for_each_entry(c, &topo_saved, list) {
+		if (topo_match(c, codec)) {
+			err = topo_copy(cache, c);
+			break;
+		}
+	}
+	mutex_unlock(&topo_saved_lock);
+	if (err != -ENOENT)
+		return err;
+
+	snprintf(name, sizeof(name), "hda-topology/%08x-%08x-%x.bin",
+		 codec->vendor_id, codec->subsystem_id, codec->revision_id);
+	if (request_firmware_direct(&fw, name, codec->bus->dev))
+		return -ENOENT;
+
+	c = topo_parse(fw->data, fw->size);
+	release_firmware(fw);
+	if (IS_ERR(c)) {
+		dev_warn(&codec->dev, "invalid topology cache %s\n", name);
+		return PTR_ERR(c);
+	}
+	if (topo_match(c, codec))
+		err = topo_copy(cache, c);
+	topo_cache_free(c);
+	return err;
+}
+
+/* compare a few cached entries spread over the cache with the codec */
+static bool topo_spot_check(struct hdac_device *codec,
+			    struct hdac_topo_cache *cache)
+{
+	unsigned int i, n, idx, res;
+	struct hdac_topo_entry *e;
+
+	n = min(cache->count, HDAC_TOPO_SPOT_CHECKS);
+	for (i = 0; i < n; i++) {
+		idx = n > 1 ? i * (cache->count - 1) / (n - 1) : 0;
+		e = &cache->entries[idx];
+		if (snd_hdac_exec_verb(codec, (codec->addr << 28) | e->cmd,
+				       0, &res) || res != e->res)
+			return false;
+	}
+	return true;
+}
+
+/**
+ * snd_hdac_topo_attach - set up the topology cache of a codec
+ * @codec: the codec object, with the IDs read
+ *
+ * Picks up a saved cache of the same codec model if any and if it passes
+ * the spot checks.  Otherwise the codec starts with an empty cache that
+ * records the reads.
+ */
+void snd_hdac_topo_attach(struct hdac_device *codec)
+{
+	struct hdac_topo_cache *cache;
+
+	if (codec->vendor_id == -1)
+		return;
+
+	cache = topo_cache_new(codec->vendor_id, codec->subsystem_id,
+			       codec->revision_id);
+	if (!cache)
+		return;
+
+	if (!topo_load(codec, cache)) {
+		if (topo_spot_check(codec, cache)) {
+			dev_dbg(&codec->dev, "using topology cache, %u entries\n",
+				cache->count);
+		} else {
+			dev_info(&codec->dev, "topology cache is stale, ignored\n");
+			cache->count = 0;
+		}
+	}
+	codec->topo = cache;
+}
+
+/**
+ * snd_hdac_topo_detach - release the topology cache of a codec
+ * @codec: the codec object
+ *
+ * The cache is kept for the next probe of the same codec model unless the
+ * topology was changed at runtime.
+ */
+void snd_hdac_topo_detach(struct hdac_device *codec)
+{
+	struct hdac_topo_cache *cache = codec->topo;
+
+	if (!cache)
+		return;
+	codec->topo = NULL;
+
+	dev_dbg(&codec->dev, "topology cache: %u hits, %u misses\n",
+		cache->hits, cache->misses);
+	kfree(cache->upload);
+	cache->upload = NULL;
+	if (cache->disabled || !cache->count)
+		topo_cache_free(cache);
+	else
+		topo_save(cache);
+}
+
+/**
+ * snd_hdac_topo_invalidate - drop the topology cache of a codec
+ * @codec: the codec object
+ *
+ * Called when the widgets of the codec changed, e.g. after enabling hidden
+ * widgets via vendor verbs.  The parameters read before may not be valid
+ * any longer, so the codec isn't cached at all from now on.
+ */
+void snd_hdac_topo_invalidate(struct hdac_device *codec)
+{
+	struct hdac_topo_cache *cache = codec->topo;
+
+	if (!cache)
+		return;
+	mutex_lock(&cache->lock);
+	cache->disabled = true;
+	kvfree(cache->entries);
+	cache->entries = NULL;
+	cache->count = cache->alloc = 0;
+	mutex_unlock(&cache->lock);
+}
+
+/**
+ * snd_hdac_topo_lookup - look up a verb in the topology cache
+ * @codec: the codec object
+ * @cmd: encoded verb
+ * @res: pointer to store the cached response
+ *
+ * Returns true if the response was found in the cache.
+ */
+bool snd_hdac_topo_lookup(struct hdac_device *codec, unsigned int cmd,
+			  unsigned int *res)
+{
+	struct hdac_topo_cache *cache = codec->topo;
+	unsigned int pos;
+	bool found = false;
+
+	if (!cache || !topo_cacheable(cmd))
+		return false;
+
+	mutex_lock(&cache->lock);
+	if (!cache->disabled) {
+		found = topo_find(cache, topo_key(cmd), &pos);
+		if (found) {
+			*res = cache->entries[pos].res;
+			cache->hits++;
+		} else {
+			cache->misses++;
+		}
+	}
+	mutex_unlock(&cache->lock);
+	return found;
+}
+
+/**
+ * snd_hdac_topo_record - store a verb response in the topology cache
+ * @codec: the codec object
+ * @cmd: encoded verb
+ * @res: response from the codec
+ */
+void snd_hdac_topo_record(struct hdac_device *codec, unsigned int cmd,
+			  unsigned int res)
+{
+	struct hdac_topo_cache *cache = codec->topo;
+
+	if (!cache || res == -1 || !topo_cacheable(cmd))
+		return;
+
+	mutex_lock(&cache->lock);
+	if (!cache->disabled)
+		topo_insert(cache, topo_key(cmd), res);
+	mutex_unlock(&cache->lock);
+}
+
+/*
+ * sysfs
+ */
+
+static ssize_t topology_read(struct file *file, struct kobject *kobj,
+			     struct bin_attribute *attr, char *buf,
+			     loff_t off, size_t count)
+{
+	struct hdac_device *codec = dev_to_hdac_dev(kobj_to_dev(kobj));
+	struct hdac_topo_cache *cache = codec->topo;
+	struct hdac_topo_header *hdr;
+	__le32 *p;
+	size_t size;
+	unsigned int i;
+	ssize_t ret;
+
+	if (!cache)
+		return -ENODATA;
+
+	mutex_lock(&cache->lock);
+	if (cache->disabled) {
+		ret = -ENODATA;
+		goto unlock;
+	}
+	size = sizeof(*hdr) + cache->count * 2 * sizeof(*p);
+	hdr = kvzalloc(size, GFP_KERNEL);
+	if (!hdr) {
+		ret = -ENOMEM;
+		goto unlock;
+	}
+	hdr->magic = cpu_to_le32(HDAC_TOPO_MAGIC);
+	hdr->version = cpu_to_le32(HDAC_TOPO_VERSION);
+	hdr->vendor_id = cpu_to_le32(cache->vendor_id);
+	hdr->subsystem_id = cpu_to_le32(cache->subsystem_id);
+	hdr->revision_id = cpu_to_le32(cache->revision_id);
+	hdr->count = cpu_to_le32(cache->count);
+	p = (__le32 *)(hdr + 1);
+	for (i = 0; i < cache->count; i++) {
+		*p++ = cpu_to_le32(cache->entries[i].cmd);
+		*p++ = cpu_to_le32(cache->entries[i].res);
+	}
+	ret = memory_read_from_buffer(buf, count, &off, hdr, size);
+	kvfree(hdr);
+ unlock:
+	mutex_unlock(&cache->lock);
+	return ret;
+}
+
+/*
+ * A blob may arrive in several chunks; it's taken once complete.  It must
+ * match the codec, and is used from the next probe of the codec model on.
+ */
+static ssize_t topology_write(struct file *file, struct kobject *kobj,
+			      struct bin_attribute *attr, char *buf,
+			      loff_t off, size_t count)
+{
+	struct hdac_device *codec = dev_to_hdac_dev(kobj_to_dev(kobj));
+	struct hdac_topo_cache *cache = codec->topo;
+	const struct hdac_topo_header *hdr;
+	struct hdac_topo_cache *c;
+	size_t size = 0;
+	void *upload;
+	ssize_t ret = count;
+
+	if (!cache)
+		return -ENODEV;
+
+	mutex_lock(&cache->lock);
+	if (!off) {
+		kfree(cache->upload);
+		cache->upload = NULL;
+		cache->upload_len = 0;
+	}
+	if (off != cache->upload_len ||
+	    off + count > sizeof(*hdr) + HDAC_TOPO_MAX_ENTRIES * 8) {
+		ret = -EINVAL;
+		goto error;
+	}
+	upload = krealloc(cache->upload, off + count, GFP_KERNEL);
+	if (!upload) {
+		ret = -ENOMEM;
+		goto error;
+	}
+	memcpy(upload + off, buf, count);
+	cache->upload = upload;
+	cache->upload_len = off + count;
+
+	if (cache->upload_len >= sizeof(*hdr)) {
+		hdr = cache->upload;
+		size = sizeof(*hdr) + (size_t)le32_to_cpu(hdr->count) * 8;
+	}
+	if (!size || cache->upload_len < size)
+		goto unlock; /* wait for more */
+
+	c = topo_parse(cache->upload, cache->upload_len);
+	if (IS_ERR(c)) {
+		ret = PTR_ERR(c);
+		goto error;
+	}
+	if (!topo_match(c, codec)) {
+		topo_cache_free(c);
+		ret = -EINVAL;
+		goto error;
+	}
+	topo_save(c);
+
+ error:
+	kfree(cache->upload);
+	cache->upload = NULL;
+	cache->upload_len = 0;
+ unlock:
+	mutex_unlock(&cache->lock);
+	return ret;
+}
+
+static BIN_ATTR_ADMIN_RW(topology, 0);
+
+static struct bin_attribute *hdac_topo_bin_attrs[] = {
+	&bin_attr_topology,
+	NULL
+};
+
+const struct attribute_group snd_hdac_topo_attr_group = {
+	.bin_attrs	= hdac_topo_bin_attrs,
+};
+EXPORT_SYMBOL_GPL(snd_hdac_topo_attr_group);
+
+/* drop the saved caches at module unload */
+void snd_hdac_topo_cleanup(void)
+{
+	struct hdac_topo_cache *c, *tmp;
+
+	mutex_lock(&topo_saved_lock);
+	list_for_each_entry_safe(c, tmp, &topo_saved, list) {
+		list_del(&c->list);
+		topo_cache_free(c);
+	}
+	mutex_unlock(&topo_saved_lock);
+}
@@ -43,4 +43,27 @@ int snd_hdac_bus_exec_verb(struct hdac_bus *bus, unsigned int addr,
 int snd_hdac_exec_verb(struct hdac_device *codec, unsigned int cmd,
 		       unsigned int flags, unsigned int *res);
 
+#ifdef CONFIG_SND_HDA_TOPO_CACHE
+void snd_hdac_topo_attach(struct hdac_device *codec);
+void snd_hdac_topo_detach(struct hdac_device *codec);
+void snd_hdac_topo_invalidate(struct hdac_device *codec);
+bool snd_hdac_topo_lookup(struct hdac_device *codec, unsigned int cmd,
+			  unsigned int *res);
+void snd_hdac_topo_record(struct hdac_device *codec, unsigned int cmd,
+			  unsigned int res);
+void snd_hdac_topo_cleanup(void);
+#else
+static inline void snd_hdac_topo_attach(struct hdac_device *codec) {}
+static inline void snd_hdac_topo_detach(struct hdac_device *codec) {}
+static inline void snd_hdac_topo_invalidate(struct hdac_device *codec) {}
+static inline bool snd_hdac_topo_lookup(struct hdac_device *codec,
+					unsigned int cmd, unsigned int *res)
+{
+	return false;
+}
+static inline void snd_hdac_topo_record(struct hdac_device *codec,
+					unsigned int cmd, unsigned int res) {}
+static inline void snd_hdac_topo_cleanup(void) {}
+#endif
+
 #endif /* __HDAC_LOCAL_H */
@@ -46,6 +46,22 @@ TRACE_EVENT(hda_get_response,
 	TP_printk("[%s:%d] val=0x%08x", __get_str(name), __entry->addr, __entry->res)
 );
 
+TRACE_EVENT(hda_send_cmds,
+	TP_PROTO(struct hdac_bus *bus, unsigned int addr, unsigned int num),
+	TP_ARGS(bus, addr, num),
+	TP_STRUCT__entry(
+		__string(name, dev_name((bus)->dev))
+		__field(u32, addr)
+		__field(u32, num)
+	),
+	TP_fast_assign(
+		__assign_str(name, dev_name((bus)->dev));
+		__entry->addr = addr;
+		__entry->num = num;
+	),
+	TP_printk("[%s:%d] num=%u", __get_str(name), __entry->addr, __entry->num)
+);
+
 TRACE_EVENT(hda_unsol_event,
 	TP_PROTO(struct hdac_bus *bus, u32 res, u32 res_ex),
 	TP_ARGS(bus, res, res_ex),
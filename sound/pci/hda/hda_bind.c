@@ -71,7 +71,8 @@ int snd_hda_codec_set_name(struct hda_codec *codec, const char *name)
 	if (err < 0)
 		return err;
 
-	/* update the mixer name */
+	/* update the mixer name; codecs may be probed in parallel */
+	mutex_lock(&codec->bus->core.lock);
 	if (!*codec->card->mixername ||
 	    codec->bus->mixer_assigned >= codec->core.addr) {
 		snprintf(codec->card->mixername,
@@ -79,6 +80,7 @@ int snd_hda_codec_set_name(struct hda_codec *codec, const char *name)
 			 codec->core.vendor_name, codec->core.chip_name);
 		codec->bus->mixer_assigned = codec->core.addr;
 	}
+	mutex_unlock(&codec->bus->core.lock);
 
 	return 0;
 }
@@ -106,6 +108,7 @@ static int hda_codec_driver_probe(struct device *dev)
 	err = snd_hdac_regmap_init(&codec->core);
 	if (err < 0)
 		goto error;
+	snd_hda_codec_prefetch_caps(codec);
 
 	if (!try_module_get(owner)) {
 		err = -EINVAL;
@@ -119,6 +122,14 @@ static int hda_codec_driver_probe(struct device *dev)
 			goto error_module_put;
 	}
 
+	/*
+	 * PCM device numbers and control names are shared by all codecs on
+	 * the card; when probed in parallel, the bus builds them afterwards
+	 * in codec order via snd_hda_codec_build_deferred().
+	 */
+	if (codec->build_deferred)
+		goto out;
+
 	err = snd_hda_codec_build_pcms(codec);
 	if (err < 0)
 		goto error_module;
@@ -133,6 +144,7 @@ static int hda_codec_driver_probe(struct device *dev)
 		snd_hda_codec_register(codec);
 	}
 
+ out:
 	codec->core.lazy_cache = true;
 	return 0;
 
@@ -301,6 +313,33 @@ static int codec_bind_generic(struct hda_codec *codec)
 #define is_generic_config(codec)	0
 #endif
 
+/**
+ * snd_hda_codec_build_deferred - build PCMs and controls skipped at probe
+ * @codec: the HDA codec
+ *
+ * Codecs configured with @codec->build_deferred set leave building the
+ * PCMs and controls to the caller, which does it for all codecs of the bus
+ * in a fixed order once they are configured.
+ *
+ * Returns 0 if successful or a negative error code.
+ */
+int snd_hda_codec_build_deferred(struct hda_codec *codec)
+{
+	int err;
+
+	if (!codec->build_deferred)
+		return 0;
+	codec->build_deferred = 0;
+	if (!codec->configured)
+		return 0;
+
+	err = snd_hda_codec_build_pcms(codec);
+	if (err < 0)
+		return err;
+	return snd_hda_codec_build_controls(codec);
+}
+EXPORT_SYMBOL_GPL(snd_hda_codec_build_deferred);
+
 /**
  * snd_hda_codec_configure - (Re-)configure the HD-audio codec
  * @codec: the HDA codec
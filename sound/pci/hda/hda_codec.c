@@ -52,6 +52,13 @@ static int codec_exec_verb(struct hdac_device *dev, unsigned int cmd,
 	err = snd_hdac_bus_exec_verb_unlocked(&bus->core, codec->core.addr,
 					      cmd, res);
 	bus->no_response_fallback = 0;
+	/*
+	 * clear reset-flag when the communication gets recovered; done under
+	 * cmd_mutex as codecs may be probed in parallel and the bus flags
+	 * share a word
+	 */
+	if (!err || codec_in_pm(codec))
+		bus->response_reset = 0;
 	mutex_unlock(&bus->core.cmd_mutex);
 	snd_hda_power_down_pm(codec);
 	if (!codec_in_pm(codec) && res && err == -EAGAIN) {
@@ -62,9 +69,42 @@ static int codec_exec_verb(struct hdac_device *dev, unsigned int cmd,
 		}
 		goto again;
 	}
-	/* clear reset-flag when the communication gets recovered */
-	if (!err || codec_in_pm(codec))
+	return err;
+}
+
+/*
+ * Send verbs in batches; on any error fall back to the single verb path,
+ * which takes care of the error recovery.
+ */
+static int codec_exec_verbs(struct hdac_device *dev, const unsigned int *cmds,
+			    unsigned int *res, unsigned int num)
+{
+	struct hda_codec *codec = container_of(dev, struct hda_codec, core);
+	struct hda_bus *bus = codec->bus;
+	unsigned int i;
+	int err;
+
+	snd_hda_power_up_pm(codec);
+	mutex_lock(&bus->core.cmd_mutex);
+	err = snd_hdac_bus_exec_verbs_unlocked(&bus->core, codec->core.addr,
+					       cmds, res, num);
+	if (!err)
 		bus->response_reset = 0;
+	mutex_unlock(&bus->core.cmd_mutex);
+	snd_hda_power_down_pm(codec);
+	if (!err)
+		return 0;
+
+	codec_dbg(codec, "verb batch failed (%d), retrying one by one\n", err);
+	err = 0;
+	for (i = 0; i < num; i++) {
+		int ret;
+
+		res[i] = -1;
+		ret = codec_exec_verb(dev, cmds[i], 0, &res[i]);
+		if (ret < 0 && !err)
+			err = ret;
+	}
 	return err;
 }
 
@@ -415,26 +455,37 @@ EXPORT_SYMBOL_GPL(snd_hda_set_dev_select);
  */
 static int read_widget_caps(struct hda_codec *codec, hda_nid_t fg_node)
 {
+	unsigned int *cmds;
 	int i;
 	hda_nid_t nid;
 
 	codec->wcaps = kmalloc_array(codec->core.num_nodes, 4, GFP_KERNEL);
 	if (!codec->wcaps)
 		return -ENOMEM;
+	cmds = kmalloc_array(codec->core.num_nodes, sizeof(*cmds), GFP_KERNEL);
+	if (!cmds)
+		return -ENOMEM;
 	nid = codec->core.start_nid;
 	for (i = 0; i < codec->core.num_nodes; i++, nid++)
-		codec->wcaps[i] = snd_hdac_read_parm_uncached(&codec->core,
-					nid, AC_PAR_AUDIO_WIDGET_CAP);
+		cmds[i] = snd_hdac_make_cmd(&codec->core, nid,
+					    AC_VERB_PARAMETERS,
+					    AC_PAR_AUDIO_WIDGET_CAP);
+	/* failed reads are left as -1 like snd_hdac_read_parm_uncached() */
+	snd_hdac_exec_verbs(&codec->core, cmds, codec->wcaps,
+			    codec->core.num_nodes);
+	kfree(cmds);
 	return 0;
 }
 
 /* read all pin default configurations and save codec->init_pins */
 static int read_pin_defaults(struct hda_codec *codec)
 {
+	struct hda_pincfg *pin;
+	unsigned int *cmds, *res;
+	int i, num = 0;
 	hda_nid_t nid;
 
 	for_each_hda_codec_node(nid, codec) {
-		struct hda_pincfg *pin;
 		unsigned int wcaps = get_wcaps(codec, nid);
 		unsigned int wid_type = get_wcaps_type(wcaps);
 		if (wid_type != AC_WID_PIN)
@@ -443,16 +494,34 @@ static int read_pin_defaults(struct hda_codec *codec)
 		if (!pin)
 			return -ENOMEM;
 		pin->nid = nid;
-		pin->cfg = snd_hda_codec_read(codec, nid, 0,
-					      AC_VERB_GET_CONFIG_DEFAULT, 0);
+		num++;
+	}
+	if (!num)
+		return 0;
+
+	/* read both values of all pins in one batch */
+	cmds = kmalloc_array(num, 4 * sizeof(*cmds), GFP_KERNEL);
+	if (!cmds)
+		return -ENOMEM;
+	res = cmds + 2 * num;
+	snd_array_for_each(&codec->init_pins, i, pin) {
+		cmds[2 * i] = snd_hdac_make_cmd(&codec->core, pin->nid,
+						AC_VERB_GET_CONFIG_DEFAULT, 0);
 		/*
 		 * all device entries are the same widget control so far
 		 * fixme: if any codec is different, need fix here
 		 */
-		pin->ctrl = snd_hda_codec_read(codec, nid, 0,
-					       AC_VERB_GET_PIN_WIDGET_CONTROL,
-					       0);
+		cmds[2 * i + 1] =
+			snd_hdac_make_cmd(&codec->core, pin->nid,
+					  AC_VERB_GET_PIN_WIDGET_CONTROL, 0);
 	}
+	/* failed reads are left as -1 like snd_hda_codec_read() */
+	snd_hdac_exec_verbs(&codec->core, cmds, res, 2 * num);
+	snd_array_for_each(&codec->init_pins, i, pin) {
+		pin->cfg = res[2 * i];
+		pin->ctrl = res[2 * i + 1];
+	}
+	kfree(cmds);
 	return 0;
 }
 
@@ -998,6 +1067,7 @@ int snd_hda_codec_device_new(struct hda_bus *bus, struct snd_card *card,
 		return -EINVAL;
 
 	codec->core.exec_verb = codec_exec_verb;
+	codec->core.exec_verbs = codec_exec_verbs;
 	codec->card = card;
 	codec->addr = codec_addr;
 
@@ -1278,6 +1348,54 @@ u32 query_amp_caps(struct hda_codec *codec, hda_nid_t nid, int direction)
 }
 EXPORT_SYMBOL_GPL(query_amp_caps);
 
+/*
+ * Read the capabilities the parsers query for each widget in a few verb
+ * batches and keep them in the regmap cache, instead of waiting for the
+ * codec on every single query during the parsing.
+ */
+void snd_hda_codec_prefetch_caps(struct hda_codec *codec)
+{
+	enum { PF_PIN, PF_AMP_IN, PF_AMP_OUT, PF_CONN, PF_NUM };
+	static const unsigned int parms[PF_NUM] = {
+		[PF_PIN] = AC_PAR_PIN_CAP,
+		[PF_AMP_IN] = AC_PAR_AMP_IN_CAP,
+		[PF_AMP_OUT] = AC_PAR_AMP_OUT_CAP,
+		[PF_CONN] = AC_PAR_CONNLIST_LEN,
+	};
+	unsigned int num[PF_NUM] = {};
+	int nodes = codec->core.num_nodes;
+	hda_nid_t *nids, nid;
+	int i;
+
+	if (nodes <= 0)
+		return;
+	nids = kmalloc_array(PF_NUM * nodes, sizeof(*nids), GFP_KERNEL);
+	if (!nids)
+		return;
+
+	for_each_hda_codec_node(nid, codec) {
+		unsigned int wcaps = get_wcaps(codec, nid);
+
+#define PF_ADD(t)	(nids[(t) * nodes + num[t]++] = nid)
+		if (get_wcaps_type(wcaps) == AC_WID_PIN)
+			PF_ADD(PF_PIN);
+		if (wcaps & AC_WCAP_AMP_OVRD) {
+			if (wcaps & AC_WCAP_IN_AMP)
+				PF_ADD(PF_AMP_IN);
+			if (wcaps & AC_WCAP_OUT_AMP)
+				PF_ADD(PF_AMP_OUT);
+		}
+		if (wcaps & AC_WCAP_CONN_LIST)
+			PF_ADD(PF_CONN);
+#undef PF_ADD
+	}
+
+	for (i = 0; i < PF_NUM; i++)
+		snd_hdac_prefetch_parms(&codec->core, nids + i * nodes, num[i],
+					parms[i]);
+	kfree(nids);
+}
+
 /**
  * snd_hda_check_amp_caps - query AMP capabilities
  * @codec: the HD-audio codec
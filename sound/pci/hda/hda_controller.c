@@ -821,6 +821,7 @@ static int azx_rirb_get_response(struct hdac_bus *bus, unsigned int addr,
 		"azx_get_response timeout, switching to single_cmd mode: last cmd=0x%08x\n",
 		bus->last_cmd[addr]);
 	chip->single_cmd = 1;
+	bus->batch_verbs = 0;
 	hbus->response_reset = 0;
 	snd_hdac_bus_stop_cmd_io(bus);
 	return -EIO;
@@ -1184,6 +1185,8 @@ int azx_bus_init(struct azx *chip, const char *model)
 
 	/* enable sync_write flag for stable communication as default */
 	bus->core.sync_write = 1;
+	/* opt-in; immediate commands can't have several verbs in flight */
+	bus->core.batch_verbs = chip->batch_verbs && !chip->single_cmd;
 
 	return 0;
 }
@@ -1226,7 +1229,10 @@ int azx_probe_codecs(struct azx *chip, unsigned int max_slots)
 	for (c = 0; c < max_slots; c++) {
 		if ((bus->codec_mask & (1 << c)) & chip->codec_probe_mask) {
 			struct hda_codec *codec;
+
+			trace_azx_codec_new_start(chip, c, 0);
 			err = snd_hda_codec_new(&chip->bus, chip->card, c, &codec);
+			trace_azx_codec_new_end(chip, c, err);
 			if (err < 0)
 				continue;
 			codec->jackpoll_interval = chip->jackpoll_interval;
@@ -1243,15 +1249,89 @@ int azx_probe_codecs(struct azx *chip, unsigned int max_slots)
 }
 EXPORT_SYMBOL_GPL(azx_probe_codecs);
 
+static int azx_codec_configure_one(struct azx *chip, struct hda_codec *codec)
+{
+	int err;
+
+	trace_azx_codec_configure_start(chip, codec->core.addr, 0);
+	err = snd_hda_codec_configure(codec);
+	trace_azx_codec_configure_end(chip, codec->core.addr, err);
+	return err;
+}
+
+struct azx_codec_work {
+	struct work_struct work;
+	struct azx *chip;
+	struct hda_codec *codec;
+};
+
+static void azx_codec_configure_work(struct work_struct *work)
+{
+	struct azx_codec_work *cw =
+		container_of(work, struct azx_codec_work, work);
+
+	azx_codec_configure_one(cw->chip, cw->codec);
+}
+
+/*
+ * Configure all codecs concurrently, each from its own worker; the codec
+ * drivers may load modules, so this can't use async_schedule().  Building
+ * the PCMs and controls shared by the card is deferred and done in codec
+ * order afterwards, so the result doesn't depend on the timing.
+ *
+ * Returns the number of configured codecs, or -ENOMEM.
+ */
+static int azx_codec_configure_parallel(struct azx *chip)
+{
+	struct azx_codec_work *works;
+	struct hda_codec *codec;
+	int i, num = 0, success = 0;
+
+	list_for_each_codec(codec, &chip->bus)
+		num++;
+	works = kcalloc(num, sizeof(*works), GFP_KERNEL);
+	if (!works)
+		return -ENOMEM;
+
+	i = 0;
+	list_for_each_codec(codec, &chip->bus) {
+		codec->build_deferred = 1;
+		works[i].chip = chip;
+		works[i].codec = codec;
+		INIT_WORK(&works[i].work, azx_codec_configure_work);
+		queue_work(system_unbound_wq, &works[i].work);
+		i++;
+	}
+	for (i = 0; i < num; i++)
+		flush_work(&works[i].work);
+	kfree(works);
+
+	list_for_each_codec(codec, &chip->bus) {
+		if (snd_hda_codec_build_deferred(codec) < 0) {
+			codec_err(codec, "Unable to build PCMs or controls\n");
+			codec->configured = 0;
+		}
+		if (codec->configured)
+			success++;
+	}
+	return success;
+}
+
 /* configure each codec instance */
 int azx_codec_configure(struct azx *chip)
 {
 	struct hda_codec *codec, *next;
 	int success = 0;
 
-	list_for_each_codec(codec, &chip->bus) {
-		if (!snd_hda_codec_configure(codec))
-			success++;
+	if (chip->parallel_probe && chip->bus.core.num_codecs > 1)
+		success = azx_codec_configure_parallel(chip);
+
+	if (success <= 0) {
+		success = 0;
+		list_for_each_codec(codec, &chip->bus) {
+			if (!azx_codec_configure_one(chip, codec))
+				success++;
+		}
 	}
 
 	if (success) {
@@ -142,6 +142,8 @@ struct azx {
 	unsigned int align_buffer_size:1;
 	unsigned int disabled:1; /* disabled by vga_switcheroo */
 	unsigned int pm_prepared:1;
+	unsigned int parallel_probe:1; /* configure codecs concurrently */
+	unsigned int batch_verbs:1; /* several CORB verbs in flight */
 
 	/* GTS present */
 	unsigned int gts_present:1;
@@ -91,6 +91,46 @@ DEFINE_EVENT(azx_pcm, azx_pcm_prepare,
 	TP_ARGS(chip, azx_dev)
 );
 
+DECLARE_EVENT_CLASS(azx_codec,
+	TP_PROTO(struct azx *chip, unsigned int addr, int err),
+
+	TP_ARGS(chip, addr, err),
+
+	TP_STRUCT__entry(
+		__field( int, card )
+		__field( unsigned int, addr )
+		__field( int, err )
+	),
+
+	TP_fast_assign(
+		__entry->card = (chip)->card->number;
+		__entry->addr = addr;
+		__entry->err = err;
+	),
+
+	TP_printk("[%d:%u] err=%d", __entry->card, __entry->addr, __entry->err)
+);
+
+DEFINE_EVENT(azx_codec, azx_codec_new_start,
+	TP_PROTO(struct azx *chip, unsigned int addr, int err),
+	TP_ARGS(chip, addr, err)
+);
+
+DEFINE_EVENT(azx_codec, azx_codec_new_end,
+	TP_PROTO(struct azx *chip, unsigned int addr, int err),
+	TP_ARGS(chip, addr, err)
+);
+
+DEFINE_EVENT(azx_codec, azx_codec_configure_start,
+	TP_PROTO(struct azx *chip, unsigned int addr, int err),
+	TP_ARGS(chip, addr, err)
+);
+
+DEFINE_EVENT(azx_codec, azx_codec_configure_end,
+	TP_PROTO(struct azx *chip, unsigned int addr, int err),
+	TP_ARGS(chip, addr, err)
+);
+
 #endif /* _TRACE_HDA_CONTROLLER_H */
 
 /* This part must be outside protection */
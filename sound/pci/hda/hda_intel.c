@@ -112,6 +112,8 @@ static int probe_mask[SNDRV_CARDS] = {[0 ... (SNDRV_CARDS-1)] = -1};
 static int probe_only[SNDRV_CARDS];
 static int jackpoll_ms[SNDRV_CARDS];
 static int single_cmd = -1;
+static bool parallel_probe;
+static bool batch_verbs;
 static int enable_msi = -1;
 #ifdef CONFIG_SND_HDA_PATCH_LOADER
 static char *patch[SNDRV_CARDS];
@@ -145,6 +147,10 @@ MODULE_PARM_DESC(jackpoll_ms, "Ms between polling for jack events (default = 0,
 module_param(single_cmd, bint, 0444);
 MODULE_PARM_DESC(single_cmd, "Use single command to communicate with codecs "
 		 "(for debugging only).");
+module_param(parallel_probe, bool, 0444);
+MODULE_PARM_DESC(parallel_probe, "Configure codecs in parallel (default = 0).");
+module_param(batch_verbs, bool, 0444);
+MODULE_PARM_DESC(batch_verbs, "Queue several verbs per codec in the CORB (default = 0).");
 module_param(enable_msi, bint, 0444);
 MODULE_PARM_DESC(enable_msi, "Enable Message Signaled Interrupt (MSI)");
 #ifdef CONFIG_SND_HDA_PATCH_LOADER
@@ -1817,6 +1823,8 @@ static int azx_create(struct snd_card *card, struct pci_dev *pci,
 		chip->fallback_to_single_cmd = 1;
 	else /* explicitly set to single_cmd or not */
 		chip->single_cmd = single_cmd;
+	chip->parallel_probe = parallel_probe;
+	chip->batch_verbs = batch_verbs;
 
 	azx_check_snoop_available(chip);
 
@@ -2269,6 +2277,7 @@ static int azx_probe_continue(struct azx *chip)
 
 	to_hda_bus(bus)->bus_probing = 1;
 	hda->probe_continued = 1;
+	trace_azx_probe_stage(chip, "start");
 
 	/* bind with i915 if needed */
 	if (chip->driver_caps & AZX_DCAPS_I915_COMPONENT) {
@@ -2304,6 +2313,7 @@ static int azx_probe_continue(struct azx *chip)
 	err = azx_first_init(chip);
 	if (err < 0)
 		goto out_free;
+	trace_azx_probe_stage(chip, "first_init");
 
 #ifdef CONFIG_SND_HDA_INPUT_BEEP
 	chip->beep_mode = beep_mode[dev];
@@ -2316,6 +2326,7 @@ static int azx_probe_continue(struct azx *chip)
 		err = azx_probe_codecs(chip, azx_max_codecs[chip->driver_type]);
 		if (err < 0)
 			goto out_free;
+		trace_azx_probe_stage(chip, "probe_codecs");
 	}
 
 #ifdef CONFIG_SND_HDA_PATCH_LOADER
@@ -2344,11 +2355,13 @@ static int azx_probe_continue(struct azx *chip)
 			dev_err(chip->card->dev, "Cannot probe codecs, giving up\n");
 			goto out_free;
 		}
+		trace_azx_probe_stage(chip, "configure");
 	}
 
 	err = snd_card_register(chip->card);
 	if (err < 0)
 		goto out_free;
+	trace_azx_probe_stage(chip, "register");
 
 	setup_vga_switcheroo_runtime_pm(chip);
 
@@ -2375,6 +2388,7 @@ static int azx_probe_continue(struct azx *chip)
 	complete_all(&hda->probe_wait);
 	to_hda_bus(bus)->bus_probing = 0;
 	hda->probe_retry = 0;
+	trace_azx_probe_stage(chip, "done");
 	return 0;
 }
 
@@ -34,6 +34,25 @@ DEFINE_EVENT(hda_pm, azx_resume,
 	TP_ARGS(chip)
 );
 
+TRACE_EVENT(azx_probe_stage,
+	TP_PROTO(struct azx *chip, const char *stage),
+
+	TP_ARGS(chip, stage),
+
+	TP_STRUCT__entry(
+		__field(int, dev_index)
+		__string(stage, stage)
+	),
+
+	TP_fast_assign(
+		__entry->dev_index = (chip)->dev_index;
+		__assign_str(stage, stage);
+	),
+
+	TP_printk("card index: %d stage: %s", __entry->dev_index,
+		  __get_str(stage))
+);
+
 #ifdef CONFIG_PM
 DEFINE_EVENT(hda_pm, azx_runtime_suspend,
 	TP_PROTO(struct azx *chip),
@@ -485,6 +485,7 @@ static inline void snd_hda_override_wcaps(struct hda_codec *codec,
 }
 
 u32 query_amp_caps(struct hda_codec *codec, hda_nid_t nid, int direction);
+void snd_hda_codec_prefetch_caps(struct hda_codec *codec);
 int snd_hda_override_amp_caps(struct hda_codec *codec, hda_nid_t nid, int dir,
 			      unsigned int caps);
 /**
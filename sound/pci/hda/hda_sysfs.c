@@ -765,6 +765,9 @@ static const struct attribute_group hda_dev_attr_group = {
 
 const struct attribute_group *snd_hda_dev_attr_groups[] = {
 	&hda_dev_attr_group,
+#ifdef CONFIG_SND_HDA_TOPO_CACHE
+	&snd_hdac_topo_attr_group,
+#endif
 	NULL
 };
 
@@ -4278,7 +4278,7 @@ int snd_soc_dapm_new_dai_widgets(struct snd_soc_dapm_context *dapm,
 }
 EXPORT_SYMBOL_GPL(snd_soc_dapm_new_dai_widgets);
 
-int snd_soc_dapm_link_dai_widgets(struct snd_soc_card *card)
+static void dapm_link_dai_widgets(struct snd_soc_card *card, bool only_new)
 {
 	struct snd_soc_dapm_widget *dai_w, *w;
 	struct snd_soc_dapm_widget *src, *sink;
@@ -4305,7 +4305,7 @@ int snd_soc_dapm_link_dai_widgets(struct snd_soc_card *card)
 
 		/* ...find all widgets with the same stream and link them */
 		for_each_card_widgets(card, w) {
-			if (w->dapm != dai_w->dapm)
+			if (w->dapm != dai_w->dapm || (only_new && w->new))
 				continue;
 
 			switch (w->id) {
@@ -4330,10 +4330,30 @@ int snd_soc_dapm_link_dai_widgets(struct snd_soc_card *card)
 			snd_soc_dapm_add_path(w->dapm, src, sink, NULL, NULL);
 		}
 	}
+}
 
+int snd_soc_dapm_link_dai_widgets(struct snd_soc_card *card)
+{
+	dapm_link_dai_widgets(card, false);
 	return 0;
 }
 
+/**
+ * snd_soc_dapm_link_new_dai_widgets - link DAI widgets to new widgets
+ * @card: the card
+ *
+ * Like snd_soc_dapm_link_dai_widgets(), but only for the widgets created
+ * after the card was instantiated and not set up yet by
+ * snd_soc_dapm_new_widgets().  Must be called before the latter.
+ */
+void snd_soc_dapm_link_new_dai_widgets(struct snd_soc_card *card)
+{
+	mutex_lock_nested(&card->dapm_mutex, SND_SOC_DAPM_CLASS_RUNTIME);
+	dapm_link_dai_widgets(card, true);
+	mutex_unlock(&card->dapm_mutex);
+}
+EXPORT_SYMBOL_GPL(snd_soc_dapm_link_new_dai_widgets);
+
 static void dapm_connect_dai_routes(struct snd_soc_dapm_context *dapm,
 				    struct snd_soc_dai *src_dai,
 				    struct snd_soc_dapm_widget *src,
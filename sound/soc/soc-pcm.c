@@ -25,6 +25,7 @@
 #include <sound/soc.h>
 #include <sound/soc-dpcm.h>
 #include <sound/soc-link.h>
+#include <sound/soc-topology.h>
 #include <sound/initval.h>
 
 #define soc_pcm_ret(rtd, ret) _soc_pcm_ret(rtd, __func__, ret)
@@ -2714,6 +2715,11 @@ static int dpcm_fe_dai_open(struct snd_pcm_substream *fe_substream)
 	snd_soc_dpcm_mutex_lock(fe);
 	fe->dpcm[stream].runtime = fe_substream->runtime;
 
+	/* the topology may create the pipeline widgets only now */
+	ret = snd_soc_tplg_pcm_open(fe, stream);
+	if (ret < 0)
+		goto open_end;
+
 	ret = dpcm_path_get(fe, stream, &list);
 	if (ret < 0)
 		goto open_end;
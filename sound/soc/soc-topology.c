@@ -24,6 +24,7 @@
 #include <linux/export.h>
 #include <linux/list.h>
 #include <linux/firmware.h>
+#include <linux/mutex.h>
 #include <linux/slab.h>
 #include <sound/soc.h>
 #include <sound/soc-dapm.h>
@@ -75,6 +76,39 @@ struct soc_tplg {
 
 	/* optional fw loading callbacks to component drivers */
 	struct snd_soc_tplg_ops *ops;
+
+	/* loader mode, see SND_SOC_TPLG_FLAG_* */
+	bool in_place;
+	bool lazy;
+	size_t in_place_bytes;	/* string bytes not copied */
+	unsigned int deferred;	/* widgets not created at load */
+};
+
+/* topology objects of a component whose creation is deferred */
+struct snd_soc_tplg_lazy {
+	const struct firmware *fw;
+	struct snd_soc_tplg_ops *ops;
+	struct mutex mutex;
+	struct list_head widgets;	/* struct soc_tplg_lazy_widget */
+	struct list_head routes;	/* struct soc_tplg_lazy_route */
+	unsigned int pending;		/* widgets not created yet */
+};
+
+struct soc_tplg_lazy_widget {
+	struct list_head list;
+	struct snd_soc_tplg_dapm_widget *w;	/* in the firmware */
+	u32 index;
+	bool needed;	/* to be created for the PCM being opened */
+	bool created;
+};
+
+struct soc_tplg_lazy_route {
+	struct list_head list;
+	struct snd_soc_tplg_dapm_graph_elem *elem;	/* in the firmware */
+	u32 index;
+	/* deferred widgets at either end, NULL if created at load */
+	struct soc_tplg_lazy_widget *source;
+	struct soc_tplg_lazy_widget *sink;
 };
 
 static int soc_tplg_process_headers(struct soc_tplg *tplg);
@@ -123,6 +157,24 @@ static inline unsigned long soc_tplg_get_offset(struct soc_tplg *tplg)
 	return (unsigned long)(tplg->pos - tplg->fw->data);
 }
 
+/*
+ * Copy a name from the topology, or reference it in place when the caller
+ * keeps the firmware.  Names of objects converted from an older ABI don't
+ * live in the firmware and are always copied.
+ */
+static const char *soc_tplg_strdup(struct soc_tplg *tplg, const char *s)
+{
+	const u8 *p = (const u8 *)s;
+
+	if (tplg->in_place && p >= tplg->fw->data &&
+	    p < tplg->fw->data + tplg->fw->size) {
+		tplg->in_place_bytes += strlen(s) + 1;
+		return s;
+	}
+
+	return devm_kstrdup(tplg->dev, s, GFP_KERNEL);
+}
+
 /* mapping of Kcontrol types and associated operations. */
 static const struct snd_soc_tplg_kcontrol_ops io_ops[] = {
 	{SND_SOC_TPLG_CTL_VOLSW, snd_soc_get_volsw,
@@ -849,7 +901,8 @@ static int soc_tplg_denum_create_texts(struct soc_tplg *tplg, struct soc_enum *s
 			goto err;
 		}
 
-		se->dobj.control.dtexts[i] = devm_kstrdup(tplg->dev, ec->texts[i], GFP_KERNEL);
+		se->dobj.control.dtexts[i] =
+			(char *)soc_tplg_strdup(tplg, ec->texts[i]);
 		if (!se->dobj.control.dtexts[i]) {
 			ret = -ENOMEM;
 			goto err;
@@ -1060,13 +1113,54 @@ static int soc_tplg_add_route(struct soc_tplg *tplg,
 	return 0;
 }
 
+static int soc_tplg_add_graph_elem(struct soc_tplg *tplg,
+	struct snd_soc_tplg_dapm_graph_elem *elem)
+{
+	struct snd_soc_dapm_context *dapm = &tplg->comp->dapm;
+	struct snd_soc_dapm_route *route;
+	int ret;
+
+	route = devm_kzalloc(tplg->dev, sizeof(*route), GFP_KERNEL);
+	if (!route)
+		return -ENOMEM;
+
+	route->source = soc_tplg_strdup(tplg, elem->source);
+	route->sink = soc_tplg_strdup(tplg, elem->sink);
+	if (!route->source || !route->sink)
+		return -ENOMEM;
+
+	if (strnlen(elem->control, SNDRV_CTL_ELEM_ID_NAME_MAXLEN) != 0) {
+		route->control = soc_tplg_strdup(tplg, elem->control);
+		if (!route->control)
+			return -ENOMEM;
+	}
+
+	/* add route dobj to dobj_list */
+	route->dobj.type = SND_SOC_DOBJ_GRAPH;
+	route->dobj.ops = tplg->ops;
+	route->dobj.index = tplg->index;
+	list_add(&route->dobj.list, &tplg->comp->dobj_list);
+
+	ret = soc_tplg_add_route(tplg, route);
+	if (ret < 0) {
+		dev_err(tplg->dev, "ASoC: topology: add_route failed: %d\n", ret);
+		return ret;
+	}
+
+	/* add route, but keep going if some fail */
+	snd_soc_dapm_add_routes(dapm, route, 1);
+
+	return 0;
+}
+
+static int soc_tplg_lazy_add_route(struct soc_tplg *tplg,
+	struct snd_soc_tplg_dapm_graph_elem *elem);
+
 static int soc_tplg_dapm_graph_elems_load(struct soc_tplg *tplg,
 	struct snd_soc_tplg_hdr *hdr)
 {
-	struct snd_soc_dapm_context *dapm = &tplg->comp->dapm;
 	const size_t maxlen = SNDRV_CTL_ELEM_ID_NAME_MAXLEN;
 	struct snd_soc_tplg_dapm_graph_elem *elem;
-	struct snd_soc_dapm_route *route;
 	int count, i;
 	int ret = 0;
 
@@ -1081,9 +1175,6 @@ static int soc_tplg_dapm_graph_elems_load(struct soc_tplg *tplg,
 		hdr->index);
 
 	for (i = 0; i < count; i++) {
-		route = devm_kzalloc(tplg->dev, sizeof(*route), GFP_KERNEL);
-		if (!route)
-			return -ENOMEM;
 		elem = (struct snd_soc_tplg_dapm_graph_elem *)tplg->pos;
 		tplg->pos += sizeof(struct snd_soc_tplg_dapm_graph_elem);
 
@@ -1095,35 +1186,20 @@ static int soc_tplg_dapm_graph_elems_load(struct soc_tplg *tplg,
 			break;
 		}
 
-		route->source = devm_kstrdup(tplg->dev, elem->source, GFP_KERNEL);
-		route->sink = devm_kstrdup(tplg->dev, elem->sink, GFP_KERNEL);
-		if (!route->source || !route->sink) {
-			ret = -ENOMEM;
-			break;
-		}
-
-		if (strnlen(elem->control, maxlen) != 0) {
-			route->control = devm_kstrdup(tplg->dev, elem->control, GFP_KERNEL);
-			if (!route->control) {
-				ret = -ENOMEM;
+		/* routes to widgets not created yet wait for them */
+		if (tplg->lazy) {
+			ret = soc_tplg_lazy_add_route(tplg, elem);
+			if (ret < 0)
 				break;
+			if (ret) {
+				ret = 0;
+				continue;
 			}
 		}
 
-		/* add route dobj to dobj_list */
-		route->dobj.type = SND_SOC_DOBJ_GRAPH;
-		route->dobj.ops = tplg->ops;
-		route->dobj.index = tplg->index;
-		list_add(&route->dobj.list, &tplg->comp->dobj_list);
-
-		ret = soc_tplg_add_route(tplg, route);
-		if (ret < 0) {
-			dev_err(tplg->dev, "ASoC: topology: add_route failed: %d\n", ret);
+		ret = soc_tplg_add_graph_elem(tplg, elem);
+		if (ret < 0)
 			break;
-		}
-
-		/* add route, but keep going if some fail */
-		snd_soc_dapm_add_routes(dapm, route, 1);
 	}
 
 	return ret;
@@ -1153,7 +1229,7 @@ static int soc_tplg_dapm_widget_dmixer_create(struct soc_tplg *tplg, struct snd_
 		mc->hdr.name);
 
 	kc->private_value = (long)sm;
-	kc->name = devm_kstrdup(tplg->dev, mc->hdr.name, GFP_KERNEL);
+	kc->name = soc_tplg_strdup(tplg, mc->hdr.name);
 	if (!kc->name)
 		return -ENOMEM;
 	kc->iface = SNDRV_CTL_ELEM_IFACE_MIXER;
@@ -1225,7 +1301,7 @@ static int soc_tplg_dapm_widget_denum_create(struct soc_tplg *tplg, struct snd_k
 		ec->hdr.name);
 
 	kc->private_value = (long)se;
-	kc->name = devm_kstrdup(tplg->dev, ec->hdr.name, GFP_KERNEL);
+	kc->name = soc_tplg_strdup(tplg, ec->hdr.name);
 	if (!kc->name)
 		return -ENOMEM;
 	kc->iface = SNDRV_CTL_ELEM_IFACE_MIXER;
@@ -1311,7 +1387,7 @@ static int soc_tplg_dapm_widget_dbytes_create(struct soc_tplg *tplg, struct snd_
 		be->hdr.name, be->hdr.access);
 
 	kc->private_value = (long)sbe;
-	kc->name = devm_kstrdup(tplg->dev, be->hdr.name, GFP_KERNEL);
+	kc->name = soc_tplg_strdup(tplg, be->hdr.name);
 	if (!kc->name)
 		return -ENOMEM;
 	kc->iface = SNDRV_CTL_ELEM_IFACE_MIXER;
@@ -1347,6 +1423,7 @@ static int soc_tplg_dapm_widget_create(struct soc_tplg *tplg,
 	struct snd_soc_card *card = tplg->comp->card;
 	unsigned int *kcontrol_type = NULL;
 	struct snd_kcontrol_new *kc;
+	char *name = NULL, *sname = NULL;
 	int mixer_count = 0;
 	int bytes_count = 0;
 	int enum_count = 0;
@@ -1370,14 +1447,21 @@ static int soc_tplg_dapm_widget_create(struct soc_tplg *tplg,
 	if ((int)template.id < 0)
 		return template.id;
 
-	/* strings are allocated here, but used and freed by the widget */
-	template.name = kstrdup(w->name, GFP_KERNEL);
-	if (!template.name)
-		return -ENOMEM;
-	template.sname = kstrdup(w->sname, GFP_KERNEL);
-	if (!template.sname) {
-		ret = -ENOMEM;
-		goto err;
+	/* the widget makes its own copy of the strings */
+	if (tplg->in_place) {
+		template.name = w->name;
+		template.sname = w->sname;
+	} else {
+		name = kstrdup(w->name, GFP_KERNEL);
+		if (!name)
+			return -ENOMEM;
+		sname = kstrdup(w->sname, GFP_KERNEL);
+		if (!sname) {
+			ret = -ENOMEM;
+			goto err;
+		}
+		template.name = name;
+		template.sname = sname;
 	}
 	template.reg = le32_to_cpu(w->reg);
 	template.shift = le32_to_cpu(w->shift);
@@ -1490,8 +1574,8 @@ static int soc_tplg_dapm_widget_create(struct soc_tplg *tplg,
 	if (ret < 0)
 		goto ready_err;
 
-	kfree(template.sname);
-	kfree(template.name);
+	kfree(sname);
+	kfree(name);
 
 	return 0;
 
@@ -1499,9 +1583,294 @@ static int soc_tplg_dapm_widget_create(struct soc_tplg *tplg,
 	remove_widget(widget->dapm->component, &widget->dobj, SOC_TPLG_PASS_WIDGET);
 	snd_soc_dapm_free_widget(widget);
 hdr_err:
-	kfree(template.sname);
+	kfree(sname);
 err:
-	kfree(template.name);
+	kfree(name);
+	return ret;
+}
+
+/* step over a widget and its controls without creating them */
+static int soc_tplg_dapm_widget_skip(struct soc_tplg *tplg,
+	struct snd_soc_tplg_dapm_widget *w)
+{
+	struct snd_soc_tplg_ctl_hdr *control_hdr;
+	struct snd_soc_tplg_private *priv;
+	size_t size;
+	int i;
+
+	tplg->pos += sizeof(*w) + le32_to_cpu(w->priv.size);
+
+	for (i = 0; i < le32_to_cpu(w->num_kcontrols); i++) {
+		control_hdr = (struct snd_soc_tplg_ctl_hdr *)tplg->pos;
+		if (soc_tplg_get_offset(tplg) + sizeof(*control_hdr) >=
+		    tplg->fw->size)
+			return -EINVAL;
+
+		switch (le32_to_cpu(control_hdr->ops.info)) {
+		case SND_SOC_TPLG_CTL_VOLSW:
+		case SND_SOC_TPLG_CTL_STROBE:
+		case SND_SOC_TPLG_CTL_VOLSW_SX:
+		case SND_SOC_TPLG_CTL_VOLSW_XR_SX:
+		case SND_SOC_TPLG_CTL_RANGE:
+		case SND_SOC_TPLG_DAPM_CTL_VOLSW:
+			size = sizeof(struct snd_soc_tplg_mixer_control);
+			priv = &((struct snd_soc_tplg_mixer_control *)
+				 control_hdr)->priv;
+			break;
+		case SND_SOC_TPLG_CTL_ENUM:
+		case SND_SOC_TPLG_CTL_ENUM_VALUE:
+		case SND_SOC_TPLG_DAPM_CTL_ENUM_DOUBLE:
+		case SND_SOC_TPLG_DAPM_CTL_ENUM_VIRT:
+		case SND_SOC_TPLG_DAPM_CTL_ENUM_VALUE:
+			size = sizeof(struct snd_soc_tplg_enum_control);
+			priv = &((struct snd_soc_tplg_enum_control *)
+				 control_hdr)->priv;
+			break;
+		case SND_SOC_TPLG_CTL_BYTES:
+			size = sizeof(struct snd_soc_tplg_bytes_control);
+			priv = &((struct snd_soc_tplg_bytes_control *)
+				 control_hdr)->priv;
+			break;
+		default:
+			dev_err(tplg->dev, "ASoC: invalid widget control type %d\n",
+				le32_to_cpu(control_hdr->ops.info));
+			return -EINVAL;
+		}
+
+		if (soc_tplg_get_offset(tplg) + size >= tplg->fw->size)
+			return -EINVAL;
+		size += le32_to_cpu(priv->size);
+		if (soc_tplg_get_offset(tplg) + size > tplg->fw->size)
+			return -EINVAL;
+
+		tplg->pos += size;
+	}
+
+	return 0;
+}
+
+static struct soc_tplg_lazy_widget *soc_tplg_lazy_find(
+	struct snd_soc_tplg_lazy *lazy, const char *name)
+{
+	struct soc_tplg_lazy_widget *lw;
+
+	list_for_each_entry(lw, &lazy->widgets, list) {
+		if (!lw->created && !strcmp(lw->w->name, name))
+			return lw;
+	}
+
+	return NULL;
+}
+
+/* record a widget to be created when a PCM using it is opened */
+static int soc_tplg_lazy_add_widget(struct soc_tplg *tplg,
+	struct snd_soc_tplg_dapm_widget *w)
+{
+	struct snd_soc_tplg_lazy *lazy = tplg->comp->tplg_lazy;
+	struct soc_tplg_lazy_widget *lw;
+	int ret;
+
+	if (strnlen(w->name, SNDRV_CTL_ELEM_ID_NAME_MAXLEN) ==
+		SNDRV_CTL_ELEM_ID_NAME_MAXLEN)
+		return -EINVAL;
+	if (strnlen(w->sname, SNDRV_CTL_ELEM_ID_NAME_MAXLEN) ==
+		SNDRV_CTL_ELEM_ID_NAME_MAXLEN)
+		return -EINVAL;
+	if ((int)get_widget_id(le32_to_cpu(w->id)) < 0)
+		return -EINVAL;
+
+	ret = soc_tplg_dapm_widget_skip(tplg, w);
+	if (ret < 0)
+		return ret;
+
+	lw = kzalloc(sizeof(*lw), GFP_KERNEL);
+	if (!lw)
+		return -ENOMEM;
+
+	lw->w = w;
+	lw->index = tplg->index;
+	list_add_tail(&lw->list, &lazy->widgets);
+	lazy->pending++;
+	tplg->deferred++;
+
+	return 0;
+}
+
+/*
+ * Defer a route until the widgets at both ends exist.  Returns 1 if the
+ * route was deferred, 0 if it can be added now.
+ */
+static int soc_tplg_lazy_add_route(struct soc_tplg *tplg,
+	struct snd_soc_tplg_dapm_graph_elem *elem)
+{
+	struct snd_soc_tplg_lazy *lazy = tplg->comp->tplg_lazy;
+	struct soc_tplg_lazy_widget *source, *sink;
+	struct soc_tplg_lazy_route *lr;
+
+	source = soc_tplg_lazy_find(lazy, elem->source);
+	sink = soc_tplg_lazy_find(lazy, elem->sink);
+	if (!source && !sink)
+		return 0;
+
+	lr = kzalloc(sizeof(*lr), GFP_KERNEL);
+	if (!lr)
+		return -ENOMEM;
+
+	lr->elem = elem;
+	lr->index = tplg->index;
+	lr->source = source;
+	lr->sink = sink;
+	list_add_tail(&lr->list, &lazy->routes);
+
+	return 1;
+}
+
+static void soc_tplg_setup(struct soc_tplg *tplg,
+	struct snd_soc_component *comp, struct snd_soc_tplg_ops *ops,
+	const struct firmware *fw)
+{
+	memset(tplg, 0, sizeof(*tplg));
+	tplg->fw = fw;
+	tplg->dev = comp->card->dev;
+	tplg->comp = comp;
+	if (ops) {
+		tplg->ops = ops;
+		tplg->io_ops = ops->io_ops;
+		tplg->io_ops_count = ops->io_ops_count;
+		tplg->bytes_ext_ops = ops->bytes_ext_ops;
+		tplg->bytes_ext_ops_count = ops->bytes_ext_ops_count;
+		tplg->in_place = ops->flags & SND_SOC_TPLG_FLAG_IN_PLACE;
+		tplg->lazy = ops->flags & SND_SOC_TPLG_FLAG_LAZY_WIDGETS;
+	}
+}
+
+static int soc_tplg_lazy_init(struct snd_soc_component *comp,
+	struct snd_soc_tplg_ops *ops, const struct firmware *fw)
+{
+	struct snd_soc_tplg_lazy *lazy;
+
+	if (comp->tplg_lazy)
+		return -EBUSY;
+
+	lazy = kzalloc(sizeof(*lazy), GFP_KERNEL);
+	if (!lazy)
+		return -ENOMEM;
+
+	lazy->fw = fw;
+	lazy->ops = ops;
+	mutex_init(&lazy->mutex);
+	INIT_LIST_HEAD(&lazy->widgets);
+	INIT_LIST_HEAD(&lazy->routes);
+	comp->tplg_lazy = lazy;
+
+	return 0;
+}
+
+static void soc_tplg_lazy_free(struct snd_soc_component *comp)
+{
+	struct snd_soc_tplg_lazy *lazy = comp->tplg_lazy;
+	struct soc_tplg_lazy_widget *lw, *next_lw;
+	struct soc_tplg_lazy_route *lr, *next_lr;
+
+	if (!lazy)
+		return;
+
+	list_for_each_entry_safe(lr, next_lr, &lazy->routes, list)
+		kfree(lr);
+	list_for_each_entry_safe(lw, next_lw, &lazy->widgets, list)
+		kfree(lw);
+	mutex_destroy(&lazy->mutex);
+	kfree(lazy);
+	comp->tplg_lazy = NULL;
+}
+
+/*
+ * Create the deferred widgets connected to the CPU DAI stream of @rtd,
+ * then the routes whose both ends now exist.
+ */
+static int soc_tplg_lazy_create(struct snd_soc_component *comp,
+	struct snd_soc_pcm_runtime *rtd, int stream)
+{
+	struct snd_soc_tplg_lazy *lazy = comp->tplg_lazy;
+	struct snd_soc_card *card = comp->card;
+	struct soc_tplg_lazy_route *lr, *next;
+	struct soc_tplg_lazy_widget *lw;
+	struct snd_soc_pcm_stream *pcm;
+	struct soc_tplg tplg;
+	unsigned int created = 0;
+	bool changed;
+	int ret = 0;
+
+	mutex_lock(&lazy->mutex);
+	if (!lazy->pending)
+		goto out;
+
+	pcm = snd_soc_dai_get_pcm_stream(asoc_rtd_to_cpu(rtd, 0), stream);
+	if (!pcm->stream_name || !*pcm->stream_name)
+		goto out;
+
+	list_for_each_entry(lw, &lazy->widgets, list)
+		lw->needed = !lw->created &&
+			     strstr(lw->w->sname, pcm->stream_name);
+
+	/* everything connected to those widgets is needed as well */
+	do {
+		changed = false;
+		list_for_each_entry(lr, &lazy->routes, list) {
+			if (!lr->source || !lr->sink ||
+			    lr->source->created || lr->sink->created ||
+			    lr->source->needed == lr->sink->needed)
+				continue;
+			lr->source->needed = true;
+			lr->sink->needed = true;
+			changed = true;
+		}
+	} while (changed);
+
+	soc_tplg_setup(&tplg, comp, lazy->ops, lazy->fw);
+	list_for_each_entry(lw, &lazy->widgets, list) {
+		if (!lw->needed)
+			continue;
+
+		tplg.pos = (const u8 *)lw->w;
+		tplg.index = lw->index;
+		ret = soc_tplg_dapm_widget_create(&tplg, lw->w);
+		if (ret < 0) {
+			dev_err(tplg.dev, "ASoC: failed to load widget %s\n",
+				lw->w->name);
+			goto out;
+		}
+
+		lw->created = true;
+		lazy->pending--;
+		created++;
+	}
+
+	if (!created)
+		goto out;
+
+	snd_soc_dapm_link_new_dai_widgets(card);
+
+	list_for_each_entry_safe(lr, next, &lazy->routes, list) {
+		if ((lr->source && !lr->source->created) ||
+		    (lr->sink && !lr->sink->created))
+			continue;
+
+		tplg.index = lr->index;
+		ret = soc_tplg_add_graph_elem(&tplg, lr->elem);
+		list_del(&lr->list);
+		kfree(lr);
+		if (ret < 0)
+			goto out;
+	}
+
+	ret = snd_soc_dapm_new_widgets(card);
+	dev_dbg(tplg.dev, "ASoC: created %u widgets for %s, %u pending\n",
+		created, pcm->stream_name, lazy->pending);
+out:
+	list_for_each_entry(lw, &lazy->widgets, list)
+		lw->needed = false;
+	mutex_unlock(&lazy->mutex);
 	return ret;
 }
 
@@ -1540,7 +1909,10 @@ static int soc_tplg_dapm_widget_elems_load(struct soc_tplg *tplg,
 			return -EINVAL;
 		}
 
-		ret = soc_tplg_dapm_widget_create(tplg, widget);
+		if (tplg->lazy)
+			ret = soc_tplg_lazy_add_widget(tplg, widget);
+		else
+			ret = soc_tplg_dapm_widget_create(tplg, widget);
 		if (ret < 0) {
 			dev_err(tplg->dev, "ASoC: failed to load widget %s\n",
 				widget->name);
@@ -1576,7 +1948,7 @@ static int soc_tplg_dapm_complete(struct soc_tplg *tplg)
 static int set_stream_info(struct soc_tplg *tplg, struct snd_soc_pcm_stream *stream,
 			   struct snd_soc_tplg_stream_caps *caps)
 {
-	stream->stream_name = devm_kstrdup(tplg->dev, caps->name, GFP_KERNEL);
+	stream->stream_name = soc_tplg_strdup(tplg, caps->name);
 	if (!stream->stream_name)
 		return -ENOMEM;
 
@@ -1625,7 +1997,7 @@ static int soc_tplg_dai_create(struct soc_tplg *tplg,
 		return -ENOMEM;
 
 	if (strlen(pcm->dai_name)) {
-		dai_drv->name = devm_kstrdup(tplg->dev, pcm->dai_name, GFP_KERNEL);
+		dai_drv->name = soc_tplg_strdup(tplg, pcm->dai_name);
 		if (!dai_drv->name) {
 			ret = -ENOMEM;
 			goto err;
@@ -1734,8 +2106,8 @@ static int soc_tplg_fe_link_create(struct soc_tplg *tplg,
 	link->dobj.type = SND_SOC_DOBJ_DAI_LINK;
 
 	if (strlen(pcm->pcm_name)) {
-		link->name = devm_kstrdup(tplg->dev, pcm->pcm_name, GFP_KERNEL);
-		link->stream_name = devm_kstrdup(tplg->dev, pcm->pcm_name, GFP_KERNEL);
+		link->name = soc_tplg_strdup(tplg, pcm->pcm_name);
+		link->stream_name = soc_tplg_strdup(tplg, pcm->pcm_name);
 		if (!link->name || !link->stream_name) {
 			ret = -ENOMEM;
 			goto err;
@@ -1744,7 +2116,7 @@ static int soc_tplg_fe_link_create(struct soc_tplg *tplg,
 	link->id = le32_to_cpu(pcm->pcm_id);
 
 	if (strlen(pcm->dai_name)) {
-		link->cpus->dai_name = devm_kstrdup(tplg->dev, pcm->dai_name, GFP_KERNEL);
+		link->cpus->dai_name = soc_tplg_strdup(tplg, pcm->dai_name);
 		if (!link->cpus->dai_name) {
 			ret = -ENOMEM;
 			goto err;
@@ -2593,22 +2965,25 @@ int snd_soc_tplg_component_load(struct snd_soc_component *comp,
 		return -EINVAL;
 
 	/* setup parsing context */
-	memset(&tplg, 0, sizeof(tplg));
-	tplg.fw = fw;
-	tplg.dev = comp->card->dev;
-	tplg.comp = comp;
-	if (ops) {
-		tplg.ops = ops;
-		tplg.io_ops = ops->io_ops;
-		tplg.io_ops_count = ops->io_ops_count;
-		tplg.bytes_ext_ops = ops->bytes_ext_ops;
-		tplg.bytes_ext_ops_count = ops->bytes_ext_ops_count;
+	soc_tplg_setup(&tplg, comp, ops, fw);
+
+	/* deferred widgets point into the firmware */
+	if (tplg.lazy) {
+		if (!tplg.in_place)
+			return -EINVAL;
+		ret = soc_tplg_lazy_init(comp, ops, fw);
+		if (ret < 0)
+			return ret;
 	}
 
 	ret = soc_tplg_load(&tplg);
 	/* free the created components if fail to load topology */
 	if (ret)
 		snd_soc_tplg_component_remove(comp);
+	else if (tplg.in_place)
+		dev_dbg(tplg.dev,
+			"ASoC: topology: %zu bytes of names in place, %u widgets deferred\n",
+			tplg.in_place_bytes, tplg.deferred);
 
 	return ret;
 }
@@ -2667,7 +3042,39 @@ int snd_soc_tplg_component_remove(struct snd_soc_component *comp)
 		up_write(&card->controls_rwsem);
 	}
 
+	soc_tplg_lazy_free(comp);
+
 	/* let caller know if FW can be freed when no objects are left */
 	return !list_empty(&comp->dobj_list);
 }
 EXPORT_SYMBOL_GPL(snd_soc_tplg_component_remove);
+
+/**
+ * snd_soc_tplg_pcm_open - create the topology widgets a PCM needs
+ * @rtd: runtime of the PCM being opened
+ * @stream: direction being opened
+ *
+ * Creates the widgets of topologies loaded with
+ * SND_SOC_TPLG_FLAG_LAZY_WIDGETS that are connected to the CPU DAI stream
+ * of @rtd, along with their routes.  Widgets are created only once, so
+ * opening the PCM again is cheap.
+ *
+ * Return: 0 on success or a negative error code.
+ */
+int snd_soc_tplg_pcm_open(struct snd_soc_pcm_runtime *rtd, int stream)
+{
+	struct snd_soc_component *component;
+	int i, ret;
+
+	for_each_rtd_components(rtd, i, component) {
+		if (!component->tplg_lazy)
+			continue;
+
+		ret = soc_tplg_lazy_create(component, rtd, stream);
+		if (ret < 0)
+			return ret;
+	}
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(snd_soc_tplg_pcm_open);
@@ -452,6 +452,10 @@ int snd_sof_device_remove(struct device *dev)
 	 */
 	snd_sof_machine_unregister(sdev, pdata);
 
+	/* in case the card never got to remove the topology component */
+	release_firmware(sdev->tplg_fw);
+	sdev->tplg_fw = NULL;
+
 	if (sdev->fw_state > SOF_FW_BOOT_NOT_STARTED) {
 		sof_fw_trace_free(sdev);
 		ret = snd_sof_dsp_power_down_notify(sdev);
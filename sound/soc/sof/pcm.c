@@ -10,6 +10,7 @@
 // PCM Layer, interface between ALSA and IPC.
 //
 
+#include <linux/firmware.h>
 #include <linux/pm_runtime.h>
 #include <sound/pcm_params.h>
 #include <sound/sof.h>
@@ -638,8 +639,13 @@ static int sof_pcm_probe(struct snd_soc_component *component)
 
 static void sof_pcm_remove(struct snd_soc_component *component)
 {
+	struct snd_sof_dev *sdev = snd_soc_component_get_drvdata(component);
+
 	/* remove topology */
 	snd_soc_tplg_component_remove(component);
+
+	release_firmware(sdev->tplg_fw);
+	sdev->tplg_fw = NULL;
 }
 
 static int sof_pcm_ack(struct snd_soc_component *component,
@@ -556,6 +556,7 @@ struct snd_sof_dev {
 
 	/* topology */
 	struct snd_soc_tplg_ops *tplg_ops;
+	const struct firmware *tplg_fw;	/* referenced by the topology */
 	struct list_head pcm_list;
 	struct list_head kcontrol_list;
 	struct list_head widget_list;
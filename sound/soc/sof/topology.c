@@ -2077,6 +2077,9 @@ static struct snd_soc_tplg_ops sof_tplg_ops = {
 	/* vendor specific bytes ext handlers available for binding */
 	.bytes_ext_ops	= sof_bytes_ext_ops,
 	.bytes_ext_ops_count	= ARRAY_SIZE(sof_bytes_ext_ops),
+
+	/* the firmware is kept until the topology is removed */
+	.flags		= SND_SOC_TPLG_FLAG_IN_PLACE,
 };
 
 int snd_sof_load_topology(struct snd_soc_component *scomp, const char *file)
@@ -2101,12 +2104,21 @@ int snd_sof_load_topology(struct snd_soc_component *scomp, const char *file)
 		dev_err(scomp->dev, "error: tplg component load failed %d\n",
 			ret);
 		ret = -EINVAL;
+		release_firmware(fw);
+	} else {
+		/* names are referenced in place, see sof_pcm_remove() */
+		sdev->tplg_fw = fw;
 	}
 
-	release_firmware(fw);
-
-	if (ret >= 0 && sdev->led_present)
+	if (ret >= 0 && sdev->led_present) {
 		ret = snd_ctl_led_request();
+		if (ret < 0) {
+			/* the probe fails, so sof_pcm_remove() won't run */
+			snd_soc_tplg_component_remove(scomp);
+			release_firmware(sdev->tplg_fw);
+			sdev->tplg_fw = NULL;
+		}
+	}
 
 	return ret;
 }
@@ -0,0 +1,449 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Tests for sharing anonymous pte tables at fork (PR_SET_LAZY_PTE_COPY).
+ *
+ * Every test maps a PMD-aligned anonymous region, fills it, opts in and
+ * forks. The child then modifies the shared range in some way and the
+ * contents seen by parent and child are checked to stay isolated.
+ */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/wait.h>
+
+#include "../kselftest.h"
+#include "../../../../mm/gup_test.h"
+
+#ifndef PR_SET_LAZY_PTE_COPY
+#define PR_SET_LAZY_PTE_COPY	90
+#define PR_GET_LAZY_PTE_COPY	91
+#endif
+
+#ifndef MADV_PAGEOUT
+#define MADV_PAGEOUT		21
+#endif
+
+#define PMD_SIZE		(2UL << 20)
+#define NR_PMDS			4
+#define REGION_SIZE		(NR_PMDS * PMD_SIZE)
+
+static size_t pagesize;
+static unsigned long nr_pages;
+
+static unsigned char parent_val(unsigned long i)
+{
+	return (i * 7 + 1) & 0xff;
+}
+
+static unsigned char child_val(unsigned long i)
+{
+	return parent_val(i) ^ 0xff;
+}
+
+static long read_vmstat(const char *name)
+{
+	char key[64];
+	long val, ret = -1;
+	FILE *f;
+
+	f = fopen("/proc/vmstat", "r");
+	if (!f)
+		return -1;
+	while (fscanf(f, "%63s %ld", key, &val) == 2) {
+		if (!strcmp(key, name)) {
+			ret = val;
+			break;
+		}
+	}
+	fclose(f);
+	return ret;
+}
+
+static char *map_region(void)
+{
+	char *map, *area;
+
+	map = mmap(NULL, REGION_SIZE + PMD_SIZE, PROT_READ | PROT_WRITE,
+		   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (map == MAP_FAILED)
+		ksft_exit_fail_msg("mmap: %s\n", strerror(errno));
+
+	area = (char *)(((uintptr_t)map + PMD_SIZE - 1) & ~(PMD_SIZE - 1));
+	if (area != map)
+		munmap(map, area - map);
+	munmap(area + REGION_SIZE, map + PMD_SIZE - area);
+
+	/* Only pte-mapped memory is shared at fork. */
+	madvise(area, REGION_SIZE, MADV_NOHUGEPAGE);
+	return area;
+}
+
+static void fill(char *area, unsigned long first, unsigned long last,
+		 unsigned char (*val)(unsigned long))
+{
+	unsigned long i;
+
+	for (i = first; i < last; i++)
+		memset(area + i * pagesize, val(i), pagesize);
+}
+
+static bool check_page(char *area, unsigned long i, unsigned char expect)
+{
+	char *p = area + i * pagesize;
+
+	return p[0] == (char)expect && p[pagesize / 2] == (char)expect &&
+	       p[pagesize - 1] == (char)expect;
+}
+
+static bool check(char *area, unsigned long first, unsigned long last,
+		  unsigned char (*val)(unsigned long))
+{
+	unsigned long i;
+
+	for (i = first; i < last; i++) {
+		if (!check_page(area, i, val(i))) {
+			ksft_print_msg("page %lu: got %#x, expected %#x\n", i,
+				       (unsigned char)area[i * pagesize],
+				       val(i));
+			return false;
+		}
+	}
+	return true;
+}
+
+static bool check_zero(char *area, unsigned long first, unsigned long last)
+{
+	unsigned long i;
+
+	for (i = first; i < last; i++)
+		if (!check_page(area, i, 0))
+			return false;
+	return true;
+}
+
+/*
+ * Fork with a freshly filled region. @child runs in the child, whose exit
+ * status is 0 on success, 1 on failure or KSFT_SKIP. @parent runs in the
+ * parent while the child is alive; the child only starts once it returns.
+ * Afterwards the parent checks its copy against @parent_check.
+ */
+static void run_test(const char *name, int (*child)(char *area),
+		     void (*parent)(char *area),
+		     bool (*parent_check)(char *area))
+{
+	long shared = read_vmstat("pte_table_share");
+	int fds[2], status;
+	char *area;
+	pid_t pid;
+	char c;
+
+	area = map_region();
+	fill(area, 0, nr_pages, parent_val);
+
+	if (pipe(fds))
+		ksft_exit_fail_msg("pipe: %s\n", strerror(errno));
+
+	pid = fork();
+	if (pid < 0)
+		ksft_exit_fail_msg("fork: %s\n", strerror(errno));
+	if (!pid) {
+		close(fds[1]);
+		if (read(fds[0], &c, 1) != 1)
+			_exit(1);
+		_exit(child(area));
+	}
+	close(fds[0]);
+
+	if (read_vmstat("pte_table_share") - shared < NR_PMDS) {
+		ksft_print_msg("%s: pte tables were not shared\n", name);
+		status = 1 << 8;
+		write(fds[1], "x", 1);
+		close(fds[1]);
+		waitpid(pid, NULL, 0);
+		goto out;
+	}
+
+	if (parent)
+		parent(area);
+	write(fds[1], "x", 1);
+	close(fds[1]);
+	if (waitpid(pid, &status, 0) != pid)
+		ksft_exit_fail_msg("waitpid: %s\n", strerror(errno));
+
+	if (WIFEXITED(status) && WEXITSTATUS(status) == KSFT_SKIP) {
+		ksft_test_result_skip("%s\n", name);
+		goto out_unmap;
+	}
+	if (!parent_check(area))
+		status = 1 << 8;
+out:
+	ksft_test_result(WIFEXITED(status) && !WEXITSTATUS(status), "%s\n",
+			 name);
+out_unmap:
+	munmap(area, REGION_SIZE);
+}
+
+static bool parent_unchanged(char *area)
+{
+	return check(area, 0, nr_pages, parent_val);
+}
+
+/* Writes in parent and child must not be visible to the other side. */
+static void fork_write_parent(char *area)
+{
+	unsigned long i;
+
+	for (i = 0; i < nr_pages; i += 2)
+		memset(area + i * pagesize, child_val(i) ^ 0x55, pagesize);
+}
+
+static unsigned char fork_write_parent_val(unsigned long i)
+{
+	return i & 1 ? parent_val(i) : child_val(i) ^ 0x55;
+}
+
+static int fork_write_child(char *area)
+{
+	if (!check(area, 0, nr_pages, parent_val))
+		return 1;
+	fill(area, 0, nr_pages, child_val);
+	return !check(area, 0, nr_pages, child_val);
+}
+
+static bool fork_write_check(char *area)
+{
+	if (!check(area, 0, nr_pages, fork_write_parent_val))
+		return false;
+	/* The parent can still write after the child is gone. */
+	fill(area, 0, nr_pages, child_val);
+	return check(area, 0, nr_pages, child_val);
+}
+
+/* The child exits without touching the region. */
+static int exit_child(char *area)
+{
+	return 0;
+}
+
+static bool exit_check(char *area)
+{
+	if (!parent_unchanged(area))
+		return false;
+	fill(area, 0, nr_pages, child_val);
+	return check(area, 0, nr_pages, child_val);
+}
+
+/* Unmap a whole shared table and part of another one. */
+static int munmap_child(char *area)
+{
+	unsigned long per_pmd = PMD_SIZE / pagesize;
+
+	if (munmap(area + PMD_SIZE, PMD_SIZE))
+		return 1;
+	if (munmap(area + 2 * PMD_SIZE, pagesize))
+		return 1;
+	if (!check(area, 0, per_pmd, parent_val) ||
+	    !check(area, 2 * per_pmd + 1, nr_pages, parent_val))
+		return 1;
+	fill(area, 2 * per_pmd + 1, nr_pages, child_val);
+	return !check(area, 2 * per_pmd + 1, nr_pages, child_val);
+}
+
+/*
+ * Split two shared tables over two vmas each without touching their ptes.
+ * Unmap the first one and leave the other one to exit.
+ */
+static int split_child(char *area)
+{
+	unsigned long per_pmd = PMD_SIZE / pagesize;
+
+	if (madvise(area + PMD_SIZE, PMD_SIZE / 2, MADV_RANDOM) ||
+	    madvise(area + 2 * PMD_SIZE, PMD_SIZE / 2, MADV_RANDOM))
+		return 1;
+	if (munmap(area + PMD_SIZE, PMD_SIZE))
+		return 1;
+	return !check(area, 0, per_pmd, parent_val) ||
+	       !check(area, 2 * per_pmd, nr_pages, parent_val);
+}
+
+/* Move a shared table elsewhere in the child. */
+static int mremap_child(char *area)
+{
+	unsigned long per_pmd = PMD_SIZE / pagesize;
+	char *dst, *map;
+
+	map = mmap(NULL, 2 * PMD_SIZE, PROT_NONE,
+		   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (map == MAP_FAILED)
+		return 1;
+	dst = (char *)(((uintptr_t)map + PMD_SIZE - 1) & ~(PMD_SIZE - 1));
+
+	if (mremap(area, PMD_SIZE, PMD_SIZE, MREMAP_MAYMOVE | MREMAP_FIXED,
+		   dst) != dst)
+		return 1;
+	if (!check(dst, 0, per_pmd, parent_val))
+		return 1;
+	fill(dst, 0, per_pmd, child_val);
+	if (!check(dst, 0, per_pmd, child_val))
+		return 1;
+
+	/* Partial moves split the table. */
+	if (mremap(area + PMD_SIZE + pagesize, pagesize, pagesize,
+		   MREMAP_MAYMOVE | MREMAP_FIXED, dst) != dst)
+		return 1;
+	return !check_page(dst, 0, parent_val(per_pmd + 1)) ||
+	       !check(area, per_pmd + 2, nr_pages, parent_val);
+}
+
+/* Change protections across table boundaries, then write. */
+static int mprotect_child(char *area)
+{
+	unsigned long start = PMD_SIZE / 2, len = 2 * PMD_SIZE;
+	unsigned long first = start / pagesize, last = (start + len) / pagesize;
+
+	if (mprotect(area + start, len, PROT_READ))
+		return 1;
+	if (!check(area, 0, nr_pages, parent_val))
+		return 1;
+	if (mprotect(area + start, len, PROT_READ | PROT_WRITE))
+		return 1;
+	fill(area, first, last, child_val);
+	return !check(area, first, last, child_val) ||
+	       !check(area, 0, first, parent_val) ||
+	       !check(area, last, nr_pages, parent_val);
+}
+
+/* MADV_DONTNEED on either side only drops that side's mappings. */
+static void dontneed_parent(char *area)
+{
+	madvise(area + PMD_SIZE, PMD_SIZE, MADV_DONTNEED);
+}
+
+static int dontneed_child(char *area)
+{
+	unsigned long per_pmd = PMD_SIZE / pagesize;
+
+	if (!check(area, per_pmd, 2 * per_pmd, parent_val))
+		return 1;
+	if (madvise(area, PMD_SIZE + PMD_SIZE / 2, MADV_DONTNEED))
+		return 1;
+	if (!check_zero(area, 0, per_pmd + per_pmd / 2))
+		return 1;
+	return !check(area, per_pmd + per_pmd / 2, nr_pages, parent_val);
+}
+
+static bool dontneed_check(char *area)
+{
+	unsigned long per_pmd = PMD_SIZE / pagesize;
+
+	return check(area, 0, per_pmd, parent_val) &&
+	       check_zero(area, per_pmd, 2 * per_pmd) &&
+	       check(area, 2 * per_pmd, nr_pages, parent_val);
+}
+
+/* Swap out the shared range and fault it back in on both sides. */
+static int pageout_child(char *area)
+{
+	if (madvise(area, REGION_SIZE, MADV_PAGEOUT))
+		return errno == EINVAL ? KSFT_SKIP : 1;
+	if (!check(area, 0, nr_pages, parent_val))
+		return 1;
+	if (madvise(area, REGION_SIZE, MADV_PAGEOUT))
+		return 1;
+	fill(area, 0, nr_pages / 2, child_val);
+	return !check(area, 0, nr_pages / 2, child_val) ||
+	       !check(area, nr_pages / 2, nr_pages, parent_val);
+}
+
+static bool pageout_check(char *area)
+{
+	if (!parent_unchanged(area))
+		return false;
+	madvise(area, REGION_SIZE, MADV_PAGEOUT);
+	return parent_unchanged(area);
+}
+
+/*
+ * FOLL_PIN needs exclusive pages: pinning through a shared table must give
+ * the child its own copy first, for read-only and writable pins alike.
+ */
+static int pin(int fd, char *addr, unsigned long size, bool write)
+{
+	struct gup_test gup = {
+		.addr = (uintptr_t)addr,
+		.size = size,
+		.nr_pages_per_call = size / pagesize,
+		.gup_flags = write ? 0x1 /* FOLL_WRITE */ : 0,
+	};
+
+	return ioctl(fd, PIN_BASIC_TEST, &gup);
+}
+
+static int pin_child(char *area)
+{
+	long unshared = read_vmstat("pte_table_unshare");
+	int fd;
+
+	fd = open("/sys/kernel/debug/gup_test", O_RDWR);
+	if (fd < 0)
+		return KSFT_SKIP;
+
+	if (pin(fd, area, PMD_SIZE, false) || pin(fd, area + PMD_SIZE,
+						  PMD_SIZE, true))
+		return 1;
+	close(fd);
+
+	if (read_vmstat("pte_table_unshare") - unshared < 2)
+		return 1;
+	if (!check(area, 0, nr_pages, parent_val))
+		return 1;
+	fill(area, 0, nr_pages, child_val);
+	return !check(area, 0, nr_pages, child_val);
+}
+
+int main(void)
+{
+	int ret;
+
+	pagesize = getpagesize();
+	nr_pages = REGION_SIZE / pagesize;
+
+	ksft_print_header();
+
+	ret = prctl(PR_SET_LAZY_PTE_COPY, 1, 0, 0, 0);
+	if (ret && errno == EINVAL)
+		ksft_exit_skip("PR_SET_LAZY_PTE_COPY not supported\n");
+	if (ret)
+		ksft_exit_fail_msg("prctl: %s\n", strerror(errno));
+	if (prctl(PR_GET_LAZY_PTE_COPY, 0, 0, 0, 0) != 1)
+		ksft_exit_fail_msg("PR_GET_LAZY_PTE_COPY does not report 1\n");
+
+	ksft_set_plan(9);
+
+	run_test("fork, write in parent and child", fork_write_child,
+		 fork_write_parent, fork_write_check);
+	run_test("exit", exit_child, NULL, exit_check);
+	run_test("munmap", munmap_child, NULL, parent_unchanged);
+	run_test("split vma", split_child, NULL, parent_unchanged);
+	run_test("mremap", mremap_child, NULL, parent_unchanged);
+	run_test("mprotect", mprotect_child, NULL, parent_unchanged);
+	run_test("MADV_DONTNEED", dontneed_child, dontneed_parent,
+		 dontneed_check);
+	run_test("MADV_PAGEOUT", pageout_child, NULL, pageout_check);
+	run_test("FOLL_PIN", pin_child, NULL, parent_unchanged);
+
+	ret = ksft_get_fail_cnt();
+	if (ret)
+		ksft_exit_fail_msg("%d out of %d tests failed\n",
+				   ret, ksft_test_num());
+	return ksft_exit_pass();
+}
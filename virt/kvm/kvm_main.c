@@ -48,6 +48,7 @@
 #include <linux/slab.h>
 #include <linux/sort.h>
 #include <linux/bsearch.h>
+#include <linux/hash.h>
 #include <linux/io.h>
 #include <linux/lockdep.h>
 #include <linux/kthread.h>
@@ -93,6 +94,14 @@ unsigned int halt_poll_ns_shrink;
 module_param(halt_poll_ns_shrink, uint, 0644);
 EXPORT_SYMBOL_GPL(halt_poll_ns_shrink);
 
+/*
+ * Size the halt-poll window from the learned wakeup period of each wakeup
+ * source instead of growing and shrinking it, and only poll when a wakeup
+ * is predicted within the window.
+ */
+static bool halt_poll_predict;
+module_param(halt_poll_predict, bool, 0644);
+
 /*
  * Ordering of locks:
  *
@@ -1317,6 +1326,8 @@ static void kvm_destroy_vm(struct kvm *kvm)
 			kvm_io_bus_destroy(bus);
 		kvm->buses[i] = NULL;
 	}
+	/* Wait for buses replaced by kvm_io_bus_register_dev() to be freed */
+	srcu_barrier(&kvm->srcu);
 	kvm_coalesced_mmio_free(kvm);
 #if defined(CONFIG_MMU_NOTIFIER) && defined(KVM_ARCH_WANT_MMU_NOTIFIER)
 	mmu_notifier_unregister(&kvm->mmu_notifier, kvm->mm);
@@ -3417,6 +3428,74 @@ static void shrink_halt_poll_ns(struct kvm_vcpu *vcpu)
 	trace_kvm_halt_poll_ns_shrink(vcpu->vcpu_id, val, old);
 }
 
+static u64 kvm_halt_predict_slack_ns(struct kvm_halt_predictor *hp, int src)
+{
+	return max(2 * hp->jitter_ns[src], hp->period_ns[src] / 16);
+}
+
+/*
+ * Return how long to poll for the next predicted wakeup, or 0 if no wakeup
+ * source is expected to fire within @max_ns of @now_ns.
+ */
+static unsigned int kvm_vcpu_predict_halt_poll_ns(struct kvm_vcpu *vcpu,
+						  u64 now_ns,
+						  unsigned int max_ns)
+{
+	struct kvm_halt_predictor *hp = &vcpu->halt_predict;
+	u64 next, poll_ns, best = U64_MAX;
+	int src;
+
+	for (src = 0; src < KVM_NR_WAKE_SOURCES; src++) {
+		u64 period = hp->period_ns[src];
+
+		if (!period)
+			continue;
+
+		/* A source that has been quiet for a few periods has stopped. */
+		if (now_ns - hp->last_wake_ns[src] > 4 * period)
+			continue;
+
+		next = hp->last_wake_ns[src] + period;
+		if (next < now_ns)
+			next += period * (div64_u64(now_ns - next, period) + 1);
+
+		poll_ns = next - now_ns + kvm_halt_predict_slack_ns(hp, src);
+		if (poll_ns <= max_ns && poll_ns < best)
+			best = poll_ns;
+	}
+
+	return best == U64_MAX ? 0 : best;
+}
+
+static void kvm_vcpu_learn_wakeup(struct kvm_vcpu *vcpu, int src, u64 now_ns)
+{
+	struct kvm_halt_predictor *hp = &vcpu->halt_predict;
+	u64 interval, dev, period = hp->period_ns[src];
+
+	if (hp->last_wake_ns[src]) {
+		interval = now_ns - hp->last_wake_ns[src];
+		if (!period) {
+			hp->period_ns[src] = interval;
+		} else {
+			dev = interval > period ? interval - period :
+						  period - interval;
+			hp->jitter_ns[src] = (3 * hp->jitter_ns[src] + dev) / 4;
+			hp->period_ns[src] = (7 * period + interval) / 8;
+		}
+	}
+	hp->last_wake_ns[src] = now_ns;
+}
+
+static int kvm_vcpu_wake_source(struct kvm_vcpu *vcpu)
+{
+	int idx = srcu_read_lock(&vcpu->kvm->srcu);
+	int src = kvm_cpu_has_pending_timer(vcpu) ? KVM_WAKE_TIMER :
+						    KVM_WAKE_IRQ;
+
+	srcu_read_unlock(&vcpu->kvm->srcu, idx);
+	return src;
+}
+
 static int kvm_vcpu_check_block(struct kvm_vcpu *vcpu)
 {
 	int ret = -EINTR;
@@ -3522,19 +3601,26 @@ static unsigned int kvm_vcpu_max_halt_poll_ns(struct kvm_vcpu *vcpu)
  */
 void kvm_vcpu_halt(struct kvm_vcpu *vcpu)
 {
+	struct kvm_vcpu_stat_generic *stats = &vcpu->stat.generic;
 	unsigned int max_halt_poll_ns = kvm_vcpu_max_halt_poll_ns(vcpu);
 	bool halt_poll_allowed = !kvm_arch_no_poll(vcpu);
+	bool predict = READ_ONCE(halt_poll_predict);
 	ktime_t start, cur, poll_end;
 	bool waited = false;
 	bool do_halt_poll;
 	u64 halt_ns;
 
-	if (vcpu->halt_poll_ns > max_halt_poll_ns)
+	start = cur = poll_end = ktime_get();
+
+	if (predict)
+		vcpu->halt_poll_ns =
+			kvm_vcpu_predict_halt_poll_ns(vcpu, ktime_to_ns(start),
+						      max_halt_poll_ns);
+	else if (vcpu->halt_poll_ns > max_halt_poll_ns)
 		vcpu->halt_poll_ns = max_halt_poll_ns;
 
 	do_halt_poll = halt_poll_allowed && vcpu->halt_poll_ns;
 
-	start = cur = poll_end = ktime_get();
 	if (do_halt_poll) {
 		ktime_t stop = ktime_add_ns(start, vcpu->halt_poll_ns);
 
@@ -3571,7 +3657,24 @@ void kvm_vcpu_halt(struct kvm_vcpu *vcpu)
 	if (do_halt_poll)
 		update_halt_poll_stats(vcpu, start, poll_end, !waited);
 
-	if (halt_poll_allowed) {
+	if (predict) {
+		if (halt_poll_allowed && vcpu_valid_wakeup(vcpu)) {
+			if (do_halt_poll && !waited) {
+				++stats->halt_poll_predict_hits;
+			} else if (do_halt_poll) {
+				/* polled for a wakeup that came too late */
+				++stats->halt_poll_predict_misses;
+				stats->halt_poll_predict_wasted_ns +=
+					ktime_to_ns(ktime_sub(poll_end, start));
+			} else if (halt_ns <= max_halt_poll_ns) {
+				/* a poll would have caught this wakeup */
+				++stats->halt_poll_predict_misses;
+			}
+
+			kvm_vcpu_learn_wakeup(vcpu, kvm_vcpu_wake_source(vcpu),
+					      ktime_to_ns(cur));
+		}
+	} else if (halt_poll_allowed) {
 		/* Recompute the max halt poll time in case it changed. */
 		max_halt_poll_ns = kvm_vcpu_max_halt_poll_ns(vcpu);
 
@@ -5236,6 +5339,87 @@ static int kvm_io_bus_sort_cmp(const void *p1, const void *p2)
 	return kvm_io_bus_cmp(p1, p2);
 }
 
+static struct kvm_io_bus *kvm_io_bus_alloc(int dev_count)
+{
+	unsigned int hash_bits = 0;
+	struct kvm_io_bus *bus;
+	size_t size;
+
+	/* Keep the hash table at most half full */
+	if (dev_count)
+		hash_bits = ilog2(roundup_pow_of_two(dev_count)) + 1;
+
+	size = struct_size(bus, range, dev_count);
+	if (hash_bits)
+		size += sizeof(*bus->hash) << hash_bits;
+
+	bus = kmalloc(size, GFP_KERNEL_ACCOUNT);
+	if (!bus)
+		return NULL;
+
+	bus->dev_count = dev_count;
+	bus->hash_bits = hash_bits;
+	bus->hash = hash_bits ? (int *)&bus->range[dev_count] : NULL;
+	return bus;
+}
+
+/*
+ * Hash the ranges that are the only ones an access to their address can
+ * hit. Identical ranges, e.g. ioeventfds that differ only in datamatch, are
+ * kept together and hashed through the first of them. Ranges are treated as
+ * closed intervals here, because kvm_io_bus_cmp() lets a zero length access
+ * match the end of a range.
+ */
+static void kvm_io_bus_build_hash(struct kvm_io_bus *bus)
+{
+	unsigned int mask, slot;
+	gpa_t max_end = 0;
+	int i, j;
+
+	if (!bus->hash_bits)
+		return;
+
+	mask = (1U << bus->hash_bits) - 1;
+	memset(bus->hash, -1, sizeof(*bus->hash) << bus->hash_bits);
+
+	for (i = 0; i < bus->dev_count; i = j) {
+		struct kvm_io_range *range = &bus->range[i];
+		gpa_t end = range->addr + range->len;
+
+		for (j = i + 1; j < bus->dev_count; j++)
+			if (bus->range[j].addr != range->addr ||
+			    bus->range[j].len != range->len)
+				break;
+
+		if ((!i || max_end < range->addr) &&
+		    (j == bus->dev_count || end < bus->range[j].addr)) {
+			slot = hash_64(range->addr, bus->hash_bits);
+			while (bus->hash[slot] >= 0)
+				slot = (slot + 1) & mask;
+			bus->hash[slot] = i;
+		}
+
+		max_end = max(max_end, end);
+	}
+}
+
+static int kvm_io_bus_hash_lookup(struct kvm_io_bus *bus, gpa_t addr)
+{
+	unsigned int mask, slot;
+	int idx;
+
+	if (!bus->hash_bits)
+		return -ENOENT;
+
+	mask = (1U << bus->hash_bits) - 1;
+	for (slot = hash_64(addr, bus->hash_bits);
+	     (idx = bus->hash[slot]) >= 0; slot = (slot + 1) & mask)
+		if (bus->range[idx].addr == addr)
+			return idx;
+
+	return -ENOENT;
+}
+
 static int kvm_io_bus_get_first_dev(struct kvm_io_bus *bus,
 			     gpa_t addr, int len)
 {
@@ -5247,6 +5431,14 @@ static int kvm_io_bus_get_first_dev(struct kvm_io_bus *bus,
 		.len = len,
 	};
 
+	/*
+	 * No other range can match an access to a hashed address, so if the
+	 * ranges there don't match either, there is nothing to search for.
+	 */
+	off = kvm_io_bus_hash_lookup(bus, addr);
+	if (off >= 0)
+		return kvm_io_bus_cmp(&key, &bus->range[off]) ? -ENOENT : off;
+
 	range = bsearch(&key, bus->range, bus->dev_count,
 			sizeof(struct kvm_io_range), kvm_io_bus_sort_cmp);
 	if (range == NULL)
@@ -5371,6 +5563,11 @@ int kvm_io_bus_read(struct kvm_vcpu *vcpu, enum kvm_bus bus_idx, gpa_t addr,
 	return r < 0 ? r : 0;
 }
 
+static void kvm_io_bus_free_rcu(struct rcu_head *head)
+{
+	kfree(container_of(head, struct kvm_io_bus, rcu));
+}
+
 /* Caller must hold slots_lock. */
 int kvm_io_bus_register_dev(struct kvm *kvm, enum kvm_bus bus_idx, gpa_t addr,
 			    int len, struct kvm_io_device *dev)
@@ -5387,8 +5584,7 @@ int kvm_io_bus_register_dev(struct kvm *kvm, enum kvm_bus bus_idx, gpa_t addr,
 	if (bus->dev_count - bus->ioeventfd_count > NR_IOBUS_DEVS - 1)
 		return -ENOSPC;
 
-	new_bus = kmalloc(struct_size(bus, range, bus->dev_count + 1),
-			  GFP_KERNEL_ACCOUNT);
+	new_bus = kvm_io_bus_alloc(bus->dev_count + 1);
 	if (!new_bus)
 		return -ENOMEM;
 
@@ -5402,14 +5598,20 @@ int kvm_io_bus_register_dev(struct kvm *kvm, enum kvm_bus bus_idx, gpa_t addr,
 		if (kvm_io_bus_cmp(&bus->range[i], &range) > 0)
 			break;
 
-	memcpy(new_bus, bus, sizeof(*bus) + i * sizeof(struct kvm_io_range));
-	new_bus->dev_count++;
+	new_bus->ioeventfd_count = bus->ioeventfd_count;
+	memcpy(new_bus->range, bus->range, i * sizeof(struct kvm_io_range));
 	new_bus->range[i] = range;
 	memcpy(new_bus->range + i + 1, bus->range + i,
 		(bus->dev_count - i) * sizeof(struct kvm_io_range));
+	kvm_io_bus_build_hash(new_bus);
 	rcu_assign_pointer(kvm->buses[bus_idx], new_bus);
-	synchronize_srcu_expedited(&kvm->srcu);
-	kfree(bus);
+
+	/*
+	 * The old bus only refers to devices that stay registered, so there
+	 * is no need to wait for readers here.  This keeps registering many
+	 * ioeventfds from paying for a grace period each.
+	 */
+	call_srcu(&kvm->srcu, &bus->rcu, kvm_io_bus_free_rcu);
 
 	return 0;
 }
@@ -5435,13 +5637,14 @@ int kvm_io_bus_unregister_dev(struct kvm *kvm, enum kvm_bus bus_idx,
 	if (i == bus->dev_count)
 		return 0;
 
-	new_bus = kmalloc(struct_size(bus, range, bus->dev_count - 1),
-			  GFP_KERNEL_ACCOUNT);
+	new_bus = kvm_io_bus_alloc(bus->dev_count - 1);
 	if (new_bus) {
-		memcpy(new_bus, bus, struct_size(bus, range, i));
-		new_bus->dev_count--;
+		new_bus->ioeventfd_count = bus->ioeventfd_count;
+		memcpy(new_bus->range, bus->range,
+		       flex_array_size(new_bus, range, i));
 		memcpy(new_bus->range + i, bus->range + i + 1,
 				flex_array_size(new_bus, range, new_bus->dev_count - i));
+		kvm_io_bus_build_hash(new_bus);
 	}
 
 	rcu_assign_pointer(kvm->buses[bus_idx], new_bus);